@@ -19,7 +19,7 @@ def main():
     # Project paths
     project_root = Path(__file__).parent.resolve()
     src_dir = project_root / "src"
-    include_dir = project_root / "include"
+    include_dir = project_root / "templates" / "include"   # json.hpp, for --batch manifests
     bin_dir = project_root / "bin"
     
     # Create bin directory if it doesn't exist
@@ -58,7 +58,7 @@ def main():
     
     print(f"Building llama-app-generator...")
     print(f"Compiler: {compiler}")
-    print(f"Compiling... (fast build, no large headers)")
+    print(f"Compiling...")
     print(f"Progress: ", end="", flush=True)
     
     try:
@@ -0,0 +1,377 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file admission_control.hpp
+ * @brief Load Shedding in front of the Request Handlers
+ *
+ * Rejects work up front instead of letting it queue until timeouts fire:
+ *
+ *  - 503 when the scheduler queue already holds max_queue jobs, or when
+ *    max_in_flight requests are being served in total
+ *  - 429 when an action is at its own in-flight limit
+ *  - 429 when a tenant (identified by its API key) is at its quota
+ *
+ * Admission also assigns the request's RequestScheduler priority class:
+ * the tenant's if it has one, else the action's. Rejections carry a
+ * Retry-After hint. Admission is a few atomic operations; limits,
+ * tenants and classes are fixed before serving starts, so no locking is
+ * needed.
+ *
+ * @author Pooria Yousefi
+ * @date October 6, 2025
+ */
+
+#ifndef POORIAYOUSEFI_LLAMA_APP_ADMISSION_CONTROL_HPP
+#define POORIAYOUSEFI_LLAMA_APP_ADMISSION_CONTROL_HPP
+
+#include <string>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include "json.hpp"
+#include "request_context.hpp"
+
+namespace pooriayousefi
+{
+namespace llama
+{
+namespace app
+{
+
+using json = nlohmann::json;
+
+/**
+ * @brief Thrown when a request is shed; maps to an HTTP status
+ */
+class AdmissionError : public std::runtime_error
+{
+private:
+    int status_;
+    int retry_after_;
+
+public:
+    AdmissionError(int status, int retry_after, const std::string& message)
+        : std::runtime_error(message)
+        , status_(status)
+        , retry_after_(retry_after)
+    {
+    }
+
+    int status() const
+    {
+        return status_;
+    }
+
+    /**
+     * @brief Seconds the client should wait before retrying
+     */
+    int retry_after() const
+    {
+        return retry_after_;
+    }
+};
+
+/**
+ * @class AdmissionControl
+ * @brief Global, per-action and queue-depth limits with RAII tickets
+ */
+class AdmissionControl
+{
+private:
+    struct Limit
+    {
+        size_t max;
+        std::atomic<size_t> in_flight{0};
+        std::atomic<uint64_t> rejected{0};
+    };
+
+    struct Tenant
+    {
+        std::string name;
+        size_t priority_class;          ///< RequestContext::NO_CLASS = the action's
+        Limit limit;
+    };
+
+    Limit total_;
+    std::map<std::string, std::unique_ptr<Limit>> actions_; ///< Immutable after construction
+    std::map<std::string, std::unique_ptr<Tenant>> tenants_;    ///< By API key
+    std::map<std::string, size_t> action_classes_;          ///< Action -> priority class
+    size_t max_queue_;
+    int retry_after_;
+    std::function<size_t()> queue_depth_;
+    std::atomic<uint64_t> queue_rejected_{0};
+
+    /**
+     * @brief Take a unit of a limit, or count a rejection
+     */
+    static bool try_take(Limit& limit)
+    {
+        size_t previous = limit.in_flight.fetch_add(1, std::memory_order_relaxed);
+        if (limit.max > 0 && previous >= limit.max)
+        {
+            limit.in_flight.fetch_sub(1, std::memory_order_relaxed);
+            limit.rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Give the current request a priority class unless it has one
+     */
+    static void classify(size_t priority_class)
+    {
+        auto context = RequestContext::current();
+        if (context && priority_class != RequestContext::NO_CLASS
+            && context->priority_class() == RequestContext::NO_CLASS)
+        {
+            context->set_priority_class(priority_class);
+        }
+    }
+
+public:
+    /**
+     * @class Ticket
+     * @brief Admitted unit of work; releases its limit when destroyed
+     */
+    class Ticket
+    {
+    private:
+        Limit* limit_;
+
+    public:
+        explicit Ticket(Limit* limit = nullptr)
+            : limit_(limit)
+        {
+        }
+
+        Ticket(Ticket&& other) noexcept
+            : limit_(other.limit_)
+        {
+            other.limit_ = nullptr;
+        }
+
+        Ticket& operator=(Ticket&& other) noexcept
+        {
+            if (this != &other)
+            {
+                release();
+                limit_ = other.limit_;
+                other.limit_ = nullptr;
+            }
+            return *this;
+        }
+
+        Ticket(const Ticket&) = delete;
+        Ticket& operator=(const Ticket&) = delete;
+
+        ~Ticket()
+        {
+            release();
+        }
+
+        void release()
+        {
+            if (limit_)
+            {
+                limit_->in_flight.fetch_sub(1, std::memory_order_relaxed);
+                limit_ = nullptr;
+            }
+        }
+    };
+
+    /**
+     * @brief Construct admission control
+     *
+     * @param max_in_flight Requests served at once in total, 0 = unlimited
+     * @param action_limits In-flight limit per action name (0 = unlimited)
+     * @param max_queue Scheduler queue depth that triggers shedding, 0 = never
+     * @param retry_after Retry-After hint in seconds
+     * @param queue_depth Returns the current scheduler queue depth
+     */
+    AdmissionControl(size_t max_in_flight, const std::map<std::string, size_t>& action_limits,
+                     size_t max_queue, int retry_after, std::function<size_t()> queue_depth)
+        : max_queue_(max_queue)
+        , retry_after_(retry_after > 0 ? retry_after : 1)
+        , queue_depth_(std::move(queue_depth))
+    {
+        total_.max = max_in_flight;
+        for (const auto& [action, max] : action_limits)
+        {
+            auto limit = std::make_unique<Limit>();
+            limit->max = max;
+            actions_.emplace(action, std::move(limit));
+        }
+    }
+
+    AdmissionControl(const AdmissionControl&) = delete;
+    AdmissionControl& operator=(const AdmissionControl&) = delete;
+
+    /**
+     * @brief Admit one request against the queue-depth and total limits
+     *
+     * @throws AdmissionError (503) if the server is saturated
+     */
+    Ticket admit()
+    {
+        if (max_queue_ > 0 && queue_depth_ && queue_depth_() >= max_queue_)
+        {
+            queue_rejected_.fetch_add(1, std::memory_order_relaxed);
+            throw AdmissionError(503, retry_after_, "Server overloaded: llama-server queue is full");
+        }
+
+        if (!try_take(total_))
+        {
+            throw AdmissionError(503, retry_after_, "Server overloaded: too many requests in flight");
+        }
+        return Ticket(&total_);
+    }
+
+    /**
+     * @brief Admit one request against its action's limit
+     *
+     * Actions without a configured limit are always admitted. Assigns the
+     * action's priority class to the current request unless its tenant
+     * already gave it one.
+     *
+     * @throws AdmissionError (429) if the action is at its limit
+     */
+    Ticket admit(const std::string& action)
+    {
+        if (auto priority = action_classes_.find(action); priority != action_classes_.end())
+        {
+            classify(priority->second);
+        }
+
+        auto it = actions_.find(action);
+        if (it == actions_.end())
+        {
+            return Ticket();
+        }
+
+        if (!try_take(*it->second))
+        {
+            throw AdmissionError(429, retry_after_, "Too many concurrent " + action + " requests");
+        }
+        return Ticket(it->second.get());
+    }
+
+    /**
+     * @brief Admit one request against its tenant's quota
+     *
+     * Assigns the tenant's priority class, if it has one, to the current
+     * request. Requests without a known API key belong to no tenant and
+     * are always admitted.
+     *
+     * @param api_key API key the request was sent with (may be empty)
+     *
+     * @throws AdmissionError (429) if the tenant is at its quota
+     */
+    Ticket admit_tenant(const std::string& api_key)
+    {
+        auto it = api_key.empty() ? tenants_.end() : tenants_.find(api_key);
+        if (it == tenants_.end())
+        {
+            return Ticket();
+        }
+
+        Tenant& tenant = *it->second;
+        classify(tenant.priority_class);
+        if (!try_take(tenant.limit))
+        {
+            throw AdmissionError(429, retry_after_, "Too many concurrent requests for tenant " + tenant.name);
+        }
+        return Ticket(&tenant.limit);
+    }
+
+    /**
+     * @brief Register a tenant
+     *
+     * Call before serving requests.
+     *
+     * @param name Tenant name (reported in stats)
+     * @param api_key API key identifying the tenant's requests
+     * @param priority_class Class of its requests, RequestContext::NO_CLASS
+     *                       = the class of each request's action
+     * @param max_in_flight Requests of the tenant served at once, 0 = unlimited
+     */
+    void add_tenant(const std::string& name, const std::string& api_key, size_t priority_class, size_t max_in_flight)
+    {
+        auto tenant = std::make_unique<Tenant>();
+        tenant->name = name;
+        tenant->priority_class = priority_class;
+        tenant->limit.max = max_in_flight;
+        tenants_[api_key] = std::move(tenant);
+    }
+
+    /**
+     * @brief Set the priority class of an action's requests
+     *
+     * Call before serving requests.
+     */
+    void set_action_class(const std::string& action, size_t priority_class)
+    {
+        action_classes_[action] = priority_class;
+    }
+
+    /**
+     * @brief In-flight counts, limits and rejections
+     *
+     * @return JSON object suitable for a diagnostics endpoint
+     */
+    json stats() const
+    {
+        json actions = json::object();
+        for (const auto& [action, limit] : actions_)
+        {
+            actions[action] = {
+                {"limit", limit->max},
+                {"in_flight", limit->in_flight.load(std::memory_order_relaxed)},
+                {"rejected", limit->rejected.load(std::memory_order_relaxed)}
+            };
+        }
+
+        json tenants = json::object();
+        for (const auto& [api_key, tenant] : tenants_)
+        {
+            tenants[tenant->name] = {
+                {"limit", tenant->limit.max},
+                {"in_flight", tenant->limit.in_flight.load(std::memory_order_relaxed)},
+                {"rejected", tenant->limit.rejected.load(std::memory_order_relaxed)}
+            };
+        }
+
+        return {
+            {"max_in_flight", total_.max},
+            {"in_flight", total_.in_flight.load(std::memory_order_relaxed)},
+            {"rejected_in_flight", total_.rejected.load(std::memory_order_relaxed)},
+            {"max_queue", max_queue_},
+            {"rejected_queue_full", queue_rejected_.load(std::memory_order_relaxed)},
+            {"actions", actions},
+            {"tenants", tenants}
+        };
+    }
+};
+
+} // namespace app
+} // namespace llama
+} // namespace pooriayousefi
+
+#endif // POORIAYOUSEFI_LLAMA_APP_ADMISSION_CONTROL_HPP
@@ -0,0 +1,307 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file connection_pool.hpp
+ * @brief Keep-Alive Connection Pool for llama-server
+ *
+ * Thread-safe pool of persistent httplib::Client instances. Each client
+ * keeps its TCP connection open between requests, so a busy app-server
+ * reuses a handful of sockets instead of connecting per request.
+ *
+ * A client is leased to one thread at a time (httplib::Client serializes
+ * requests internally, so sharing one across threads would not help).
+ * When every connection is leased and the pool is full, acquire() waits
+ * for one to be returned instead of opening more sockets.
+ *
+ * @author Pooria Yousefi
+ * @date October 6, 2025
+ */
+
+#ifndef POORIAYOUSEFI_LLAMA_APP_CONNECTION_POOL_HPP
+#define POORIAYOUSEFI_LLAMA_APP_CONNECTION_POOL_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "httplib.h"
+
+namespace pooriayousefi
+{
+namespace llama
+{
+namespace app
+{
+
+/**
+ * @class ConnectionPool
+ * @brief Bounded pool of keep-alive HTTP connections to one host:port
+ *
+ * Idle connections older than the idle timeout are closed lazily on the
+ * next acquire()/release(), so no background thread is needed.
+ */
+class ConnectionPool
+{
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct IdleEntry
+    {
+        std::unique_ptr<httplib::Client> client;
+        Clock::time_point last_used;
+    };
+
+    std::string host_;
+    int port_;
+    size_t max_size_;                   ///< Upper bound on open connections
+    std::chrono::seconds idle_timeout_; ///< Close connections idle for longer
+    int timeout_seconds_;               ///< Default read/write timeout
+
+    std::mutex mutex_;
+    std::condition_variable available_;
+    std::vector<IdleEntry> idle_;       ///< LIFO stack of idle connections
+    size_t open_count_ = 0;             ///< Idle + leased connections
+
+    /**
+     * @brief Create a new keep-alive client
+     */
+    std::unique_ptr<httplib::Client> create_client() const
+    {
+        auto client = std::make_unique<httplib::Client>(host_, port_);
+        client->set_keep_alive(true);
+        return client;
+    }
+
+    /**
+     * @brief Drop idle connections that exceeded the idle timeout
+     *
+     * Caller must hold mutex_. The stack is LIFO, so the oldest entries
+     * sit at the front.
+     */
+    void evict_idle_locked(Clock::time_point now)
+    {
+        size_t expired = 0;
+        while (expired < idle_.size() && now - idle_[expired].last_used > idle_timeout_)
+        {
+            expired++;
+        }
+
+        if (expired > 0)
+        {
+            idle_.erase(idle_.begin(), idle_.begin() + static_cast<std::ptrdiff_t>(expired));
+            open_count_ -= expired;
+        }
+    }
+
+    /**
+     * @brief Return a leased client to the pool
+     *
+     * @param client Client being returned
+     * @param reusable false if the connection is broken and must be closed
+     */
+    void release(std::unique_ptr<httplib::Client> client, bool reusable)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto now = Clock::now();
+
+            if (reusable && client->is_valid())
+            {
+                idle_.push_back({std::move(client), now});
+            }
+            else
+            {
+                open_count_--;
+            }
+
+            evict_idle_locked(now);
+        }
+
+        available_.notify_one();
+    }
+
+public:
+    /**
+     * @class Lease
+     * @brief RAII handle to a pooled client
+     *
+     * Returns the client to the pool on destruction. Call discard() after
+     * a transport error so the connection is closed rather than reused.
+     */
+    class Lease
+    {
+    private:
+        ConnectionPool* pool_;
+        std::unique_ptr<httplib::Client> client_;
+        bool reusable_ = true;
+
+    public:
+        Lease(ConnectionPool* pool, std::unique_ptr<httplib::Client> client)
+            : pool_(pool)
+            , client_(std::move(client))
+        {
+        }
+
+        Lease(Lease&& other) noexcept
+            : pool_(other.pool_)
+            , client_(std::move(other.client_))
+            , reusable_(other.reusable_)
+        {
+            other.pool_ = nullptr;
+        }
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease& operator=(Lease&&) = delete;
+
+        ~Lease()
+        {
+            if (pool_ && client_)
+            {
+                pool_->release(std::move(client_), reusable_);
+            }
+        }
+
+        /**
+         * @brief Mark the connection as broken
+         */
+        void discard()
+        {
+            reusable_ = false;
+        }
+
+        httplib::Client* operator->()
+        {
+            return client_.get();
+        }
+
+        httplib::Client& operator*()
+        {
+            return *client_;
+        }
+    };
+
+    /**
+     * @brief Construct connection pool
+     *
+     * @param host Server hostname
+     * @param port Server port
+     * @param max_size Maximum number of open connections (default: 8)
+     * @param idle_timeout Seconds before an idle connection is closed (default: 60)
+     * @param timeout Default read/write timeout in seconds (default: 300)
+     */
+    ConnectionPool(const std::string& host, int port, size_t max_size = 8,
+                   int idle_timeout = 60, int timeout = 300)
+        : host_(host)
+        , port_(port)
+        , max_size_(max_size > 0 ? max_size : 1)
+        , idle_timeout_(idle_timeout)
+        , timeout_seconds_(timeout)
+    {
+        idle_.reserve(max_size_);
+    }
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    /**
+     * @brief Lease a connection, waiting if the pool is exhausted
+     *
+     * The client's read/write timeouts are reset to the pool default on
+     * every lease, so per-call overrides do not leak to the next user.
+     *
+     * @return Lease holding an exclusive client
+     */
+    Lease acquire()
+    {
+        std::unique_ptr<httplib::Client> client;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            evict_idle_locked(Clock::now());
+
+            available_.wait(lock, [this]
+            {
+                return !idle_.empty() || open_count_ < max_size_;
+            });
+
+            if (!idle_.empty())
+            {
+                client = std::move(idle_.back().client);
+                idle_.pop_back();
+            }
+            else
+            {
+                open_count_++;
+            }
+        }
+
+        if (!client)
+        {
+            try
+            {
+                client = create_client();
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                open_count_--;
+                available_.notify_one();
+                throw;
+            }
+        }
+
+        client->set_read_timeout(std::chrono::seconds(timeout_seconds_));
+        client->set_write_timeout(std::chrono::seconds(timeout_seconds_));
+
+        return Lease(this, std::move(client));
+    }
+
+    /**
+     * @brief Number of open connections (idle + leased)
+     */
+    size_t open_connections()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return open_count_;
+    }
+
+    /**
+     * @brief Number of idle connections ready for reuse
+     */
+    size_t idle_connections()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return idle_.size();
+    }
+
+    /**
+     * @brief Maximum pool size
+     */
+    size_t max_size() const
+    {
+        return max_size_;
+    }
+};
+
+} // namespace app
+} // namespace llama
+} // namespace pooriayousefi
+
+#endif // POORIAYOUSEFI_LLAMA_APP_CONNECTION_POOL_HPP
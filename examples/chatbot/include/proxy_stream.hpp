@@ -0,0 +1,388 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file proxy_stream.hpp
+ * @brief Byte Pass-through from llama-server to a Downstream Client
+ *
+ * Backs AppServerBase's /v1/... proxy. The upstream call runs on a scheduler
+ * worker and the downstream response is written by the server thread:
+ *
+ *   llama-server --bytes--> run() --[ProxyStream queue]--> next() --> client
+ *
+ * The reply is never parsed: status and headers are handed over as soon as
+ * they arrive, so the server thread can answer with them, then body bytes
+ * follow chunk by chunk as llama-server sends them. The queue holds at most
+ * MAX_BUFFERED bytes; beyond that the upstream read waits, which pushes
+ * back on llama-server instead of buffering a slow client's reply. close()
+ * (the client went away) makes the upstream read stop.
+ *
+ * @author Pooria Yousefi
+ * @date October 6, 2025
+ */
+
+#ifndef POORIAYOUSEFI_LLAMA_APP_PROXY_STREAM_HPP
+#define POORIAYOUSEFI_LLAMA_APP_PROXY_STREAM_HPP
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <cctype>
+#include <stdexcept>
+#include "httplib.h"
+#include "backend_pool.hpp"
+#include "request_context.hpp"
+
+namespace pooriayousefi
+{
+namespace llama
+{
+namespace app
+{
+
+/**
+ * @struct ProxyRequest
+ * @brief Request forwarded to llama-server (rewritable before it is sent)
+ */
+struct ProxyRequest
+{
+    std::string method;
+    std::string target;         ///< Path and query string, e.g. /v1/chat/completions
+    httplib::Headers headers;   ///< End-to-end request headers
+    std::string body;
+};
+
+/**
+ * @class ProxyStream
+ * @brief Hand-off of one proxied reply between the upstream and downstream threads
+ */
+class ProxyStream
+{
+public:
+    static constexpr size_t MAX_BUFFERED = 1024 * 1024; ///< Queued bytes before the upstream read waits
+
+private:
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;     ///< Headers, a chunk or the end arrived
+    std::condition_variable space_;     ///< The queue drained or the client went away
+
+    bool has_headers_ = false;
+    int status_ = 0;
+    httplib::Headers headers_;
+    int64_t content_length_ = -1;
+    std::deque<std::string> chunks_;
+    size_t buffered_ = 0;
+    uint64_t bytes_ = 0;
+    bool finished_ = false;             ///< No more chunks will arrive
+    bool closed_ = false;               ///< Downstream client is gone
+    std::string error_;
+
+    static bool iequals(const std::string& a, const char* b)
+    {
+        size_t i = 0;
+        for (; i < a.size() && b[i]; i++)
+        {
+            if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i])))
+            {
+                return false;
+            }
+        }
+        return i == a.size() && !b[i];
+    }
+
+    void finish(const std::string& error)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            finished_ = true;
+            error_ = error;
+        }
+        ready_.notify_all();
+    }
+
+    bool on_headers(const httplib::Response& response)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            status_ = response.status;
+            for (const auto& [name, value] : response.headers)
+            {
+                if (iequals(name, "Content-Length"))
+                {
+                    content_length_ = std::stoll(value);
+                }
+                else if (forwarded(name))
+                {
+                    headers_.emplace(name, value);
+                }
+            }
+            has_headers_ = true;
+        }
+        ready_.notify_all();
+        return !closed();
+    }
+
+    bool on_data(const char* data, size_t length)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            space_.wait(lock, [this] { return closed_ || buffered_ < MAX_BUFFERED; });
+            if (closed_)
+            {
+                return false;
+            }
+
+            chunks_.emplace_back(data, length);
+            buffered_ += length;
+            bytes_ += length;
+        }
+        ready_.notify_all();
+        return true;
+    }
+
+public:
+    /**
+     * @brief Whether a header is passed through
+     *
+     * Hop-by-hop headers belong to one connection, httplib adds
+     * REMOTE_ADDR and friends to every request, and Accept-Encoding is
+     * dropped so llama-server replies uncompressed.
+     */
+    static bool forwarded(const std::string& name)
+    {
+        static const char* const dropped[] = {
+            "Connection", "Keep-Alive", "Proxy-Connection", "Transfer-Encoding", "TE", "Trailer",
+            "Upgrade", "Host", "Content-Length", "Accept-Encoding",
+            "REMOTE_ADDR", "REMOTE_PORT", "LOCAL_ADDR", "LOCAL_PORT"
+        };
+        for (const char* header : dropped)
+        {
+            if (iequals(name, header))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Copy a downstream request into a ProxyRequest
+     */
+    static ProxyRequest make_request(const httplib::Request& req)
+    {
+        ProxyRequest request;
+        request.method = req.method;
+        request.target = req.target.empty() ? req.path : req.target;
+        for (const auto& [name, value] : req.headers)
+        {
+            if (forwarded(name))
+            {
+                request.headers.emplace(name, value);
+            }
+        }
+        request.body = req.body;
+        return request;
+    }
+
+    /**
+     * @brief Send the request and feed the reply into the stream (blocking)
+     *
+     * Call once, from the thread that owns the upstream call. Honours the
+     * calling thread's RequestContext: cancel() aborts the call and the
+     * deadline bounds it. The request body is moved out.
+     *
+     * @param backends Pool to lease the least loaded backend from
+     * @param request Request to forward
+     *
+     * @throws std::runtime_error on transport errors (the stream is finished with the error)
+     */
+    void run(BackendPool& backends, ProxyRequest& request)
+    {
+        auto context = RequestContext::current();
+
+        try
+        {
+            if (context)
+            {
+                context->check();
+            }
+
+            auto client = backends.acquire();
+
+            httplib::Request upstream_request;
+            upstream_request.method = request.method;
+            upstream_request.path = request.target;
+            upstream_request.headers = std::move(request.headers);
+            upstream_request.body = std::move(request.body);
+            upstream_request.response_handler = [this](const httplib::Response& response)
+            {
+                return on_headers(response);
+            };
+            upstream_request.content_receiver = [this](const char* data, size_t length, uint64_t, uint64_t)
+            {
+                return on_data(data, length);
+            };
+
+            httplib::Result result;
+            {
+                RequestContext::Upstream upstream(context.get(), &*client);
+                result = client->send(upstream_request);
+            }
+
+            if (!result)
+            {
+                // Stopping early leaves the connection mid-reply; that is
+                // not the backend's fault
+                if (closed() || (context && (context->cancelled() || context->expired())))
+                {
+                    client.discard();
+                    finish("Proxy request abandoned");
+                    return;
+                }
+
+                client.fail();
+                throw std::runtime_error("llama-server proxy request failed: " + httplib::to_string(result.error()));
+            }
+
+            finish("");
+        }
+        catch (const std::exception& e)
+        {
+            finish(e.what());
+            throw;
+        }
+    }
+
+    /**
+     * @brief Wait for the reply headers, or the end of a failed call
+     *
+     * @param timeout Longest wait
+     * @return true once headers arrived or the call ended
+     */
+    bool wait_headers(std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return ready_.wait_for(lock, timeout, [this] { return has_headers_ || finished_; });
+    }
+
+    /**
+     * @brief Take the next body chunk, waiting for one
+     *
+     * @param chunk Receives the bytes
+     * @return false once the reply is complete (or the call failed)
+     */
+    bool next(std::string& chunk)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.wait(lock, [this] { return !chunks_.empty() || finished_; });
+            if (chunks_.empty())
+            {
+                return false;
+            }
+
+            chunk = std::move(chunks_.front());
+            chunks_.pop_front();
+            buffered_ -= chunk.size();
+        }
+        space_.notify_all();
+        return true;
+    }
+
+    /**
+     * @brief The downstream client is gone: stop reading upstream
+     */
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+        space_.notify_all();
+    }
+
+    bool closed() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return closed_;
+    }
+
+    bool has_headers() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return has_headers_;
+    }
+
+    /**
+     * @brief Whether the call ended with an error (valid once next() returned false)
+     */
+    bool failed() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return finished_ && !error_.empty();
+    }
+
+    std::string error() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return error_;
+    }
+
+    /**
+     * @brief Upstream status code (valid once has_headers())
+     */
+    int status() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return status_;
+    }
+
+    /**
+     * @brief Upstream end-to-end headers (valid once has_headers())
+     */
+    httplib::Headers headers() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return headers_;
+    }
+
+    /**
+     * @brief Upstream Content-Length, or -1 for chunked replies
+     */
+    int64_t content_length() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return content_length_;
+    }
+
+    /**
+     * @brief Body bytes received from llama-server so far
+     */
+    uint64_t bytes() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return bytes_;
+    }
+};
+
+} // namespace app
+} // namespace llama
+} // namespace pooriayousefi
+
+#endif // POORIAYOUSEFI_LLAMA_APP_PROXY_STREAM_HPP
@@ -0,0 +1,718 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file request_scheduler.hpp
+ * @brief Slot-aware Job Scheduler in front of llama-server
+ *
+ * Sits between AppServerBase handlers and LlamaClient:
+ *
+ *   /api handlers --submit()--> [queue] --N slot workers--> LlamaClient
+ *
+ * - At most `slots` jobs run against llama-server at once, matching its
+ *   parallel slot count (--parallel), so it is neither idle nor flooded.
+ * - Jobs that arrive within a short coalescing window are released
+ *   together, so they land in the same llama-server batch.
+ * - Identical deterministic requests already queued or running share one
+ *   upstream call and one result.
+ * - Completions are answered from an optional ResponseCache, then an
+ *   optional SemanticCache, before they are queued at all.
+ * - Jobs wait in one queue per priority class (the submitting request's
+ *   RequestContext names it). Backlogged classes are served in proportion
+ *   to their weights (stride scheduling: weighted fair queuing with one
+ *   unit per job), FIFO within a class, and a class can be capped to a
+ *   number of slots, so interactive requests overtake a backlog of batch
+ *   jobs instead of queueing behind it.
+ * - Results are handed back through futures.
+ * - The submitting thread's RequestContext travels with the job: jobs
+ *   whose request was cancelled or ran out of time while queued fail
+ *   without reaching llama-server, and the blocking helpers stop waiting
+ *   as soon as the client disconnects or the deadline passes.
+ * - A coalescable job instead runs under a shared context its waiters
+ *   hold (see RequestContext::hold()). It has no deadline of its own; each
+ *   waiter gives up at its own, and the upstream call is aborted only
+ *   once every waiter has.
+ *
+ * @author Pooria Yousefi
+ * @date October 6, 2025
+ */
+
+#ifndef POORIAYOUSEFI_LLAMA_APP_REQUEST_SCHEDULER_HPP
+#define POORIAYOUSEFI_LLAMA_APP_REQUEST_SCHEDULER_HPP
+
+#include <string>
+#include <cstdint>
+#include <stdexcept>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <unordered_map>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include "json.hpp"
+#include "llama_client.hpp"
+#include "response_cache.hpp"
+#include "semantic_cache.hpp"
+#include "metrics.hpp"
+#include "request_context.hpp"
+
+namespace pooriayousefi
+{
+namespace llama
+{
+namespace app
+{
+
+using json = nlohmann::json;
+
+/**
+ * @class RequestScheduler
+ * @brief Bounded-concurrency job queue for llama-server calls
+ */
+class RequestScheduler
+{
+public:
+    using Job = std::function<json(LlamaClient&)>;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct PendingJob
+    {
+        Job job;
+        std::string coalesce_key;
+        std::shared_ptr<std::promise<json>> promise;
+        Clock::time_point enqueued;
+        std::shared_ptr<RequestContext> context;   ///< Submitter's, or shared by the waiters if coalescable
+    };
+
+    /// Coalescable job that is queued or running
+    struct SharedJob
+    {
+        std::shared_future<json> future;
+        std::shared_ptr<RequestContext> context;   ///< Held by every waiter
+    };
+
+    /// Pass advance of a weight-1 class per dispatched job
+    static constexpr uint64_t STRIDE = uint64_t(1) << 20;
+
+    struct JobClass
+    {
+        std::string name;
+        unsigned weight = 1;
+        size_t max_running = 0;             ///< 0 = no cap
+        std::deque<PendingJob> queue;
+        uint64_t pass = 0;                  ///< Virtual time of the class's next dispatch
+        size_t running = 0;
+        uint64_t dispatched = 0;
+        double total_wait_ms = 0.0;
+        double max_wait_ms = 0.0;
+        Histogram* wait_histogram = nullptr;    ///< In metrics_, resolved on first dispatch
+
+        bool ready() const
+        {
+            return !queue.empty() && (max_running == 0 || running < max_running);
+        }
+    };
+
+    LlamaClient& client_;
+    size_t slots_;
+    std::chrono::milliseconds window_;
+    ResponseCache* cache_ = nullptr;    ///< Optional completion cache (not owned)
+    SemanticCache* semantic_cache_ = nullptr; ///< Optional similarity cache (not owned)
+    Metrics* metrics_ = nullptr;        ///< Optional queue-wait histogram sink (not owned)
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_available_;
+    std::vector<JobClass> classes_;     ///< [0] is "default"
+    size_t queued_ = 0;                 ///< Jobs over all class queues
+    uint64_t virtual_time_ = 0;         ///< Pass of the last dispatch
+    std::unordered_map<std::string, SharedJob> pending_by_key_;
+    std::vector<std::thread> workers_;
+    Clock::time_point batch_release_;   ///< Dispatch time of the current coalescing batch
+    size_t running_ = 0;
+    bool stopping_ = false;
+
+    // Counters (guarded by mutex_)
+    uint64_t submitted_ = 0;
+    uint64_t completed_ = 0;
+    uint64_t failed_ = 0;
+    uint64_t coalesced_ = 0;
+    uint64_t dispatched_ = 0;
+    double total_wait_ms_ = 0.0;
+    double max_wait_ms_ = 0.0;
+
+    /**
+     * @brief Class whose job runs next: the lowest pass among classes
+     *        with queued work and a free share of the slots
+     *
+     * @return Index into classes_, or classes_.size() if none may run
+     */
+    size_t next_class_locked() const
+    {
+        size_t best = classes_.size();
+        for (size_t i = 0; i < classes_.size(); i++)
+        {
+            if (classes_[i].ready() && (best == classes_.size() || classes_[i].pass < classes_[best].pass))
+            {
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    /**
+     * @brief Slot worker loop
+     */
+    void worker_loop()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        while (true)
+        {
+            work_available_.wait(lock, [this]
+            {
+                return (stopping_ && queued_ == 0) || next_class_locked() < classes_.size();
+            });
+
+            if (queued_ == 0)
+            {
+                return; // stopping_ and drained
+            }
+
+            // Hold the batch open until the window closes or there is
+            // already enough queued work to fill every idle slot
+            if (window_.count() > 0 && !stopping_)
+            {
+                work_available_.wait_until(lock, batch_release_, [this]
+                {
+                    return stopping_ || queued_ >= slots_ - running_;
+                });
+            }
+
+            size_t index = next_class_locked();
+            if (index == classes_.size())
+            {
+                continue;
+            }
+
+            JobClass& job_class = classes_[index];
+            PendingJob pending = std::move(job_class.queue.front());
+            job_class.queue.pop_front();
+            queued_--;
+            virtual_time_ = job_class.pass;
+            job_class.pass += std::max<uint64_t>(STRIDE / job_class.weight, 1);
+            job_class.running++;
+            job_class.dispatched++;
+            running_++;
+            dispatched_++;
+
+            double wait_ms = std::chrono::duration<double, std::milli>(Clock::now() - pending.enqueued).count();
+            total_wait_ms_ += wait_ms;
+            max_wait_ms_ = std::max(max_wait_ms_, wait_ms);
+            job_class.total_wait_ms += wait_ms;
+            job_class.max_wait_ms = std::max(job_class.max_wait_ms, wait_ms);
+
+            if (metrics_)
+            {
+                metrics_->queue_wait.observe(wait_ms / 1000.0);
+                if (!job_class.wait_histogram)
+                {
+                    job_class.wait_histogram = &metrics_->class_queue_wait(job_class.name);
+                }
+                job_class.wait_histogram->observe(wait_ms / 1000.0);
+            }
+
+            lock.unlock();
+
+            bool ok = true;
+            try
+            {
+                // Dead requests fail here instead of occupying a slot
+                if (pending.context)
+                {
+                    pending.context->check();
+                }
+
+                RequestContext::Scope scope(pending.context);
+                pending.promise->set_value(pending.job(client_));
+            }
+            catch (...)
+            {
+                ok = false;
+                pending.promise->set_exception(std::current_exception());
+            }
+
+            lock.lock();
+            running_--;
+            (ok ? completed_ : failed_)++;
+
+            // classes_ only grows before serving starts, so the reference holds
+            bool was_capped = job_class.max_running > 0 && job_class.running == job_class.max_running;
+            job_class.running--;
+            if (was_capped && !job_class.queue.empty())
+            {
+                // Its queued jobs may be all that is left for idle workers
+                work_available_.notify_all();
+            }
+
+            if (!pending.coalesce_key.empty())
+            {
+                // A cancelled shared job may already have been replaced under its key
+                auto shared = pending_by_key_.find(pending.coalesce_key);
+                if (shared != pending_by_key_.end() && shared->second.context == pending.context)
+                {
+                    pending_by_key_.erase(shared);
+                }
+            }
+        }
+    }
+
+public:
+    /**
+     * @brief Construct scheduler and start slot workers
+     *
+     * @param client LlamaClient used by every job (must outlive the scheduler)
+     * @param slots Maximum concurrent llama-server requests (default: 4)
+     * @param coalesce_window_ms Batch window in milliseconds, 0 disables (default: 2)
+     */
+    RequestScheduler(LlamaClient& client, size_t slots = 4, int coalesce_window_ms = 2)
+        : client_(client)
+        , slots_(slots > 0 ? slots : 1)
+        , window_(coalesce_window_ms)
+    {
+        classes_.emplace_back();
+        classes_.back().name = "default";
+
+        workers_.reserve(slots_);
+        for (size_t i = 0; i < slots_; i++)
+        {
+            workers_.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    RequestScheduler(const RequestScheduler&) = delete;
+    RequestScheduler& operator=(const RequestScheduler&) = delete;
+
+    /**
+     * @brief Stop accepting work, finish queued jobs and join workers
+     */
+    ~RequestScheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        work_available_.notify_all();
+
+        for (auto& worker : workers_)
+        {
+            worker.join();
+        }
+    }
+
+    /**
+     * @brief Queue a job for execution on a llama-server slot
+     *
+     * @param job Callable performing the LlamaClient call
+     * @param coalesce_key Jobs with the same non-empty key that are queued or
+     *                     running share a single execution and result
+     * @return Future for the job's result (rethrows the job's exception)
+     */
+    std::shared_future<json> submit(Job job, const std::string& coalesce_key = "")
+    {
+        std::shared_future<json> future;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            if (stopping_)
+            {
+                throw std::runtime_error("Scheduler is shutting down");
+            }
+
+            submitted_++;
+
+            std::shared_ptr<RequestContext> context = RequestContext::current();
+
+            if (!coalesce_key.empty())
+            {
+                // Joining a job whose waiters have all given up would only
+                // inherit its cancellation: such a job is submitted afresh
+                auto it = pending_by_key_.find(coalesce_key);
+                if (it != pending_by_key_.end() && !it->second.context->cancelled())
+                {
+                    coalesced_++;
+                    RequestContext::hold(context, it->second.context);
+                    return it->second.future;
+                }
+            }
+
+            auto now = Clock::now();
+            if (queued_ == 0)
+            {
+                batch_release_ = now + window_;
+            }
+
+            size_t index = context ? context->priority_class() : 0;
+            JobClass& job_class = classes_[index < classes_.size() ? index : 0];
+
+            // A class that was idle starts at the current virtual time:
+            // idling earns no credit to be spent in a burst later
+            if (job_class.queue.empty() && job_class.running == 0)
+            {
+                job_class.pass = std::max(job_class.pass, virtual_time_);
+            }
+
+            auto promise = std::make_shared<std::promise<json>>();
+            future = promise->get_future().share();
+
+            if (!coalesce_key.empty())
+            {
+                // Other requests may join while it runs, so it must not run
+                // under (and be cancelled with) the submitter's context
+                auto shared = std::make_shared<RequestContext>();
+                shared->set_priority_class(index);
+                RequestContext::hold(context, shared);
+                pending_by_key_[coalesce_key] = {future, shared};
+                context = std::move(shared);
+            }
+
+            job_class.queue.push_back({std::move(job), coalesce_key, std::move(promise), now, std::move(context)});
+            queued_++;
+        }
+
+        work_available_.notify_all();
+        return future;
+    }
+
+    /**
+     * @brief Queue a text completion
+     *
+     * Deterministic requests (temperature <= 0) are coalesced with
+     * identical ones already in flight.
+     */
+    std::shared_future<json> submit_completion(const std::string& prompt, int max_tokens = 512, float temperature = 0.7)
+    {
+        return submit_completion(prompt, CompletionParams(max_tokens, temperature));
+    }
+
+    /**
+     * @brief Queue a text completion with explicit sampling parameters
+     *
+     * Cache hits are returned as ready futures without touching the queue.
+     * With a semantic cache, an exact-cache miss costs one /embedding call
+     * on the calling thread.
+     */
+    std::shared_future<json> submit_completion(const std::string& prompt, const CompletionParams& params)
+    {
+        std::string cache_key;
+        if (cache_ && cache_->cacheable(params))
+        {
+            cache_key = ResponseCache::make_key(prompt, params);
+
+            if (auto cached = cache_->get(cache_key))
+            {
+                std::promise<json> ready;
+                ready.set_value(std::move(*cached));
+                return ready.get_future().share();
+            }
+        }
+
+        SemanticCache* semantic = semantic_cache_;
+        std::vector<float> embedding;
+        uint64_t scope = 0;
+        if (semantic && semantic->cacheable(prompt, params))
+        {
+            embedding = semantic->embed(prompt);
+            scope = SemanticCache::scope_of(params);
+
+            if (auto cached = semantic->find(embedding, scope))
+            {
+                std::promise<json> ready;
+                ready.set_value(std::move(*cached));
+                return ready.get_future().share();
+            }
+        }
+
+        std::string coalesce_key;
+        if (params.temperature <= 0.0f)
+        {
+            coalesce_key = "completion";
+            coalesce_key += '\0';
+            coalesce_key += cache_key.empty() ? ResponseCache::make_key(prompt, params) : cache_key;
+        }
+
+        ResponseCache* cache = cache_;
+        return submit([prompt, params, cache, cache_key = std::move(cache_key),
+                       semantic, embedding = std::move(embedding), scope](LlamaClient& client)
+        {
+            json response = client.complete(prompt, params);
+
+            if (cache && !cache_key.empty())
+            {
+                cache->put(cache_key, response);
+            }
+
+            if (semantic)
+            {
+                semantic->put(embedding, scope, response);
+            }
+
+            return response;
+        }, coalesce_key);
+    }
+
+    /**
+     * @brief Queue a chat completion
+     */
+    std::shared_future<json> submit_chat(const json& messages, int max_tokens = 512, float temperature = 0.7)
+    {
+        return submit_chat(messages, CompletionParams(max_tokens, temperature));
+    }
+
+    /**
+     * @brief Queue a chat completion with explicit sampling parameters
+     */
+    std::shared_future<json> submit_chat(const json& messages, const CompletionParams& params)
+    {
+        std::string key;
+        if (params.temperature <= 0.0f)
+        {
+            key = json{{"chat", messages}, {"n", params.n_predict}}.dump();
+        }
+
+        return submit([messages, params](LlamaClient& client)
+        {
+            return client.chat(messages, params);
+        }, key);
+    }
+
+    /**
+     * @brief Wait for a job's result on behalf of the current request
+     *
+     * See RequestContext::wait(): gives up early, cancelling the request,
+     * when the client disconnects or the deadline passes.
+     *
+     * @param future Future returned by submit()
+     * @return Job result
+     *
+     * @throws RequestCancelled, DeadlineExceeded, or the job's exception
+     */
+    static json wait(const std::shared_future<json>& future)
+    {
+        return RequestContext::wait(future);
+    }
+
+    /**
+     * @brief Blocking text completion through the scheduler
+     *
+     * Drop-in replacement for LlamaClient::complete().
+     */
+    json complete(const std::string& prompt, int max_tokens = 512, float temperature = 0.7)
+    {
+        return wait(submit_completion(prompt, max_tokens, temperature));
+    }
+
+    /**
+     * @brief Blocking text completion with explicit sampling parameters
+     */
+    json complete(const std::string& prompt, const CompletionParams& params)
+    {
+        return wait(submit_completion(prompt, params));
+    }
+
+    /**
+     * @brief Blocking chat completion through the scheduler
+     *
+     * Drop-in replacement for LlamaClient::chat().
+     */
+    json chat(const json& messages, int max_tokens = 512, float temperature = 0.7)
+    {
+        return wait(submit_chat(messages, max_tokens, temperature));
+    }
+
+    /**
+     * @brief Blocking chat completion with explicit sampling parameters
+     */
+    json chat(const json& messages, const CompletionParams& params)
+    {
+        return wait(submit_chat(messages, params));
+    }
+
+    /**
+     * @brief Client the jobs run on
+     *
+     * For calls that need no slot, such as counting tokens.
+     */
+    LlamaClient& client()
+    {
+        return client_;
+    }
+
+    /**
+     * @brief Define (or redefine) a priority class
+     *
+     * Call before serving requests. While several classes have jobs
+     * queued, each gets dispatches in proportion to its weight. A cap is
+     * useful to keep some slots free of long-running batch work.
+     *
+     * @param name Class name ("default" is predefined with weight 1)
+     * @param weight Relative share, at least 1
+     * @param max_slots Slots the class may hold at once, 0 = no cap
+     * @return Class id for RequestContext::set_priority_class()
+     */
+    size_t add_class(const std::string& name, unsigned weight, size_t max_slots = 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        size_t index = 0;
+        while (index < classes_.size() && classes_[index].name != name)
+        {
+            index++;
+        }
+        if (index == classes_.size())
+        {
+            classes_.emplace_back();
+            classes_.back().name = name;
+        }
+
+        classes_[index].weight = std::max(weight, 1u);
+        classes_[index].max_running = max_slots;
+        return index;
+    }
+
+    /**
+     * @brief Id of a priority class, or of "default" if unknown
+     */
+    size_t find_class(const std::string& name) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        for (size_t i = 0; i < classes_.size(); i++)
+        {
+            if (classes_[i].name == name)
+            {
+                return i;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Jobs waiting for a slot
+     */
+    size_t queue_depth() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queued_;
+    }
+
+    /**
+     * @brief Snapshot of queue depth, concurrency and wait times
+     *
+     * @return JSON object suitable for a diagnostics endpoint
+     */
+    json stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        json classes = json::array();
+        for (const auto& job_class : classes_)
+        {
+            classes.push_back({
+                {"name", job_class.name},
+                {"weight", job_class.weight},
+                {"max_slots", job_class.max_running},
+                {"queue_depth", job_class.queue.size()},
+                {"in_flight", job_class.running},
+                {"dispatched", job_class.dispatched},
+                {"avg_queue_wait_ms", job_class.dispatched > 0
+                    ? job_class.total_wait_ms / static_cast<double>(job_class.dispatched) : 0.0},
+                {"max_queue_wait_ms", job_class.max_wait_ms}
+            });
+        }
+
+        return {
+            {"slots", slots_},
+            {"coalesce_window_ms", window_.count()},
+            {"queue_depth", queued_},
+            {"in_flight", running_},
+            {"submitted", submitted_},
+            {"completed", completed_},
+            {"failed", failed_},
+            {"coalesced", coalesced_},
+            {"avg_queue_wait_ms", dispatched_ > 0 ? total_wait_ms_ / static_cast<double>(dispatched_) : 0.0},
+            {"max_queue_wait_ms", max_wait_ms_},
+            {"classes", std::move(classes)}
+        };
+    }
+
+    /**
+     * @brief Attach a response cache consulted by submit_completion()
+     *
+     * Call before serving requests.
+     *
+     * @param cache Cache to use, or nullptr to disable (not owned)
+     */
+    void set_response_cache(ResponseCache* cache)
+    {
+        cache_ = cache;
+    }
+
+    /**
+     * @brief Attach a similarity cache consulted by submit_completion()
+     *
+     * Call before serving requests.
+     *
+     * @param cache Cache to use, or nullptr to disable (not owned)
+     */
+    void set_semantic_cache(SemanticCache* cache)
+    {
+        semantic_cache_ = cache;
+    }
+
+    /**
+     * @brief Record queue wait times into a metrics registry
+     * 
+     * Call before serving requests.
+     * 
+     * @param metrics Registry to use, or nullptr to disable (not owned)
+     */
+    void set_metrics(Metrics* metrics)
+    {
+        metrics_ = metrics;
+    }
+
+    /**
+     * @brief Number of concurrent llama-server slots
+     */
+    size_t slots() const
+    {
+        return slots_;
+    }
+};
+
+} // namespace app
+} // namespace llama
+} // namespace pooriayousefi
+
+#endif // POORIAYOUSEFI_LLAMA_APP_REQUEST_SCHEDULER_HPP
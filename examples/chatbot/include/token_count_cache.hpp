@@ -0,0 +1,205 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file token_count_cache.hpp
+ * @brief LRU Cache of Token Counts per Text Segment
+ *
+ * Prompts are assembled from segments that recur across requests: system
+ * prompts, instructions, earlier chat turns. LlamaClient::count_tokens()
+ * asks llama-server's /tokenize once per distinct segment and keeps the
+ * count here.
+ *
+ * Entries are keyed by a 64-bit hash and the length of the text, not the
+ * text itself, so an entry costs the same few dozen bytes whatever the
+ * segment size. A collision would only skew one token budget.
+ *
+ * @author Pooria Yousefi
+ * @date October 6, 2025
+ */
+
+#ifndef POORIAYOUSEFI_LLAMA_APP_TOKEN_COUNT_CACHE_HPP
+#define POORIAYOUSEFI_LLAMA_APP_TOKEN_COUNT_CACHE_HPP
+
+#include <string_view>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <optional>
+#include <functional>
+#include <cstdint>
+#include "json.hpp"
+
+namespace pooriayousefi
+{
+namespace llama
+{
+namespace app
+{
+
+using json = nlohmann::json;
+
+/**
+ * @class TokenCountCache
+ * @brief Thread-safe LRU map of text segment to token count
+ */
+class TokenCountCache
+{
+private:
+    struct Key
+    {
+        size_t hash;
+        size_t length;
+
+        bool operator==(const Key& other) const
+        {
+            return hash == other.hash && length == other.length;
+        }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const
+        {
+            return key.hash;
+        }
+    };
+
+    struct Entry
+    {
+        size_t tokens;
+        std::list<Key>::iterator lru_pos;
+    };
+
+    size_t max_entries_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<Key, Entry, KeyHash> entries_;
+    std::list<Key> lru_;            ///< Most recent at front
+
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+
+    static Key make_key(std::string_view text)
+    {
+        return Key{std::hash<std::string_view>()(text), text.size()};
+    }
+
+public:
+    /**
+     * @brief Construct cache
+     *
+     * @param max_entries Segments kept, 0 disables caching (default: 16384)
+     */
+    explicit TokenCountCache(size_t max_entries = 16384)
+        : max_entries_(max_entries)
+    {
+    }
+
+    TokenCountCache(const TokenCountCache&) = delete;
+    TokenCountCache& operator=(const TokenCountCache&) = delete;
+
+    /**
+     * @brief Change the capacity, dropping entries beyond it
+     *
+     * @param max_entries Segments kept, 0 disables caching
+     */
+    void set_capacity(size_t max_entries)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        max_entries_ = max_entries;
+        while (lru_.size() > max_entries_)
+        {
+            entries_.erase(lru_.back());
+            lru_.pop_back();
+        }
+    }
+
+    /**
+     * @brief Cached token count of a segment
+     */
+    std::optional<size_t> find(std::string_view text)
+    {
+        Key key = make_key(text);
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = entries_.find(key);
+        if (it == entries_.end())
+        {
+            misses_++;
+            return std::nullopt;
+        }
+
+        hits_++;
+        lru_.splice(lru_.begin(), lru_, it->second.lru_pos);
+        return it->second.tokens;
+    }
+
+    /**
+     * @brief Remember the token count of a segment
+     */
+    void insert(std::string_view text, size_t tokens)
+    {
+        Key key = make_key(text);
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (max_entries_ == 0)
+        {
+            return;
+        }
+
+        auto it = entries_.find(key);
+        if (it != entries_.end())
+        {
+            it->second.tokens = tokens;
+            lru_.splice(lru_.begin(), lru_, it->second.lru_pos);
+            return;
+        }
+
+        if (entries_.size() >= max_entries_)
+        {
+            entries_.erase(lru_.back());
+            lru_.pop_back();
+        }
+
+        lru_.push_front(key);
+        entries_.emplace(key, Entry{tokens, lru_.begin()});
+    }
+
+    /**
+     * @brief Size and hit/miss counters
+     *
+     * @return JSON object suitable for a diagnostics endpoint
+     */
+    json stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        return {
+            {"entries", entries_.size()},
+            {"max_entries", max_entries_},
+            {"hits", hits_},
+            {"misses", misses_}
+        };
+    }
+};
+
+} // namespace app
+} // namespace llama
+} // namespace pooriayousefi
+
+#endif // POORIAYOUSEFI_LLAMA_APP_TOKEN_COUNT_CACHE_HPP
@@ -0,0 +1,719 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file backend_pool.hpp
+ * @brief Load Balancing Across Several llama-server Instances
+ *
+ * Each backend (host:port) has its own keep-alive ConnectionPool and a
+ * weight. acquire() picks the healthy backend with the fewest outstanding
+ * requests relative to its weight, so a backend with weight 2 carries
+ * about twice the concurrent load of one with weight 1.
+ *
+ * Each backend has a circuit breaker. A run of consecutive connection
+ * failures opens it: the backend gets no requests for the cooldown, after
+ * which one trial request is let through (half-open). The circuit closes
+ * if the trial is answered and opens again if it fails; a trial abandoned
+ * before an answer (a cancelled stream, a client that went away) decides
+ * nothing, and the next request becomes the trial. A successful health
+ * probe also ends the cooldown early. When every circuit is open, acquire()
+ * fails fast with BackendUnavailable (a 503 with Retry-After) instead of
+ * piling more requests onto sick instances.
+ *
+ * Independently, a failed health probe (see LlamaClient::is_alive()) takes
+ * a backend out of rotation until a probe succeeds again. If every backend
+ * is out, requests are still spread over those with a closed circuit
+ * rather than failing outright.
+ *
+ * @author Pooria Yousefi
+ * @date October 6, 2025
+ */
+
+#ifndef POORIAYOUSEFI_LLAMA_APP_BACKEND_POOL_HPP
+#define POORIAYOUSEFI_LLAMA_APP_BACKEND_POOL_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include "json.hpp"
+#include "connection_pool.hpp"
+#include "admission_control.hpp"
+
+namespace pooriayousefi
+{
+namespace llama
+{
+namespace app
+{
+
+using json = nlohmann::json;
+
+/**
+ * @brief Thrown when every backend's circuit is open
+ */
+class BackendUnavailable : public AdmissionError
+{
+public:
+    explicit BackendUnavailable(int retry_after)
+        : AdmissionError(503, retry_after, "No llama-server backend available (circuit open)")
+    {
+    }
+};
+
+/**
+ * @class BackendPool
+ * @brief Weighted least-outstanding-requests balancer with health ejection
+ */
+class BackendPool
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Circuit breaker state of a backend
+     */
+    enum class Circuit
+    {
+        Closed,     ///< Normal operation
+        Open,       ///< Failing; no requests until the cooldown ends
+        HalfOpen    ///< Cooldown over; one trial request decides
+    };
+
+    /**
+     * @struct Backend
+     * @brief One llama-server instance and its counters
+     *
+     * Counters and health are guarded by the owning pool's mutex.
+     */
+    struct Backend
+    {
+        std::string host;
+        int port;
+        int weight;
+        std::unique_ptr<ConnectionPool> pool;
+
+        size_t outstanding = 0;             ///< Requests currently leased
+        bool healthy = true;
+        size_t consecutive_failures = 0;
+        uint64_t requests = 0;
+        uint64_t failures = 0;
+        uint64_t ejections = 0;
+
+        Circuit circuit = Circuit::Closed;
+        Clock::time_point open_until;       ///< End of the cooldown while open
+        bool trial_in_flight = false;       ///< Half-open trial request leased
+        uint64_t circuit_opens = 0;
+
+        std::string url() const
+        {
+            return "http://" + host + ":" + std::to_string(port);
+        }
+    };
+
+private:
+    size_t connections_per_backend_;
+    int idle_timeout_;
+    int timeout_seconds_;
+    size_t max_failures_;
+    std::chrono::milliseconds cooldown_;
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Backend>> backends_;    ///< Stable addresses for leases
+
+    /**
+     * @brief Mark a backend (un)healthy (caller holds mutex_)
+     */
+    void set_healthy_locked(Backend& backend, bool healthy)
+    {
+        if (backend.healthy && !healthy)
+        {
+            backend.ejections++;
+        }
+        backend.healthy = healthy;
+        if (healthy)
+        {
+            backend.consecutive_failures = 0;
+        }
+    }
+
+    /**
+     * @brief Open a backend's circuit for the cooldown (caller holds mutex_)
+     */
+    void open_circuit_locked(Backend& backend)
+    {
+        backend.circuit = Circuit::Open;
+        backend.open_until = Clock::now() + cooldown_;
+        backend.circuit_opens++;
+    }
+
+    /**
+     * @brief Whether a backend may take a request (caller holds mutex_)
+     *
+     * Moves an open circuit whose cooldown has ended to half-open.
+     */
+    static bool admits_locked(Backend& backend, Clock::time_point now)
+    {
+        if (backend.circuit == Circuit::Open && now >= backend.open_until)
+        {
+            backend.circuit = Circuit::HalfOpen;
+            backend.trial_in_flight = false;
+        }
+
+        switch (backend.circuit)
+        {
+        case Circuit::Closed:
+            return true;
+        case Circuit::HalfOpen:
+            return !backend.trial_in_flight;
+        default:
+            return false;
+        }
+    }
+
+    /**
+     * @brief How a request on a backend ended
+     */
+    enum class Outcome
+    {
+        Answered,   ///< The backend replied
+        Failed,     ///< Transport error: counts against the backend
+        Abandoned   ///< Given up before a reply (cancelled, deadline): no verdict
+    };
+
+    /**
+     * @brief Finish a request on a backend
+     *
+     * @param backend Backend the request ran on
+     * @param outcome How the request ended
+     * @param trial true for the trial request of a half-open circuit
+     */
+    void release(Backend* backend, Outcome outcome, bool trial = false)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        backend->outstanding--;
+
+        if (trial)
+        {
+            // An abandoned trial leaves the circuit half-open for another one
+            backend->trial_in_flight = false;
+        }
+
+        if (outcome == Outcome::Abandoned)
+        {
+            return;
+        }
+
+        if (outcome == Outcome::Answered)
+        {
+            backend->consecutive_failures = 0;
+            if (trial && backend->circuit == Circuit::HalfOpen)
+            {
+                backend->circuit = Circuit::Closed;
+            }
+            return;
+        }
+
+        backend->failures++;
+        backend->consecutive_failures++;
+        if (trial && backend->circuit == Circuit::HalfOpen)
+        {
+            open_circuit_locked(*backend);
+        }
+        else if (backend->circuit == Circuit::Closed && backend->consecutive_failures >= max_failures_)
+        {
+            open_circuit_locked(*backend);
+        }
+    }
+
+    /**
+     * @brief Least loaded admitted backend (caller holds mutex_)
+     *
+     * @param avoid Backend to skip, or nullptr
+     * @param allow_trial Whether a half-open backend may be chosen
+     * @return Chosen backend, or nullptr if none admits a request
+     */
+    Backend* choose_locked(const Backend* avoid, bool allow_trial)
+    {
+        Backend* chosen = nullptr;
+        auto now = Clock::now();
+
+        for (int pass = 0; pass < 2 && !chosen; pass++)
+        {
+            // Second pass ignores health: better to try than to refuse
+            for (auto& backend : backends_)
+            {
+                if (backend.get() == avoid || (pass == 0 && !backend->healthy) || !admits_locked(*backend, now))
+                {
+                    continue;
+                }
+                if (!allow_trial && backend->circuit != Circuit::Closed)
+                {
+                    continue;
+                }
+
+                // Compare outstanding/weight without dividing
+                if (!chosen || backend->outstanding * static_cast<size_t>(chosen->weight)
+                               < chosen->outstanding * static_cast<size_t>(backend->weight))
+                {
+                    chosen = backend.get();
+                }
+            }
+        }
+
+        return chosen;
+    }
+
+    /**
+     * @brief Count a request on a backend chosen by choose_locked() (caller holds mutex_)
+     *
+     * @return true if it is the trial request of a half-open circuit
+     */
+    static bool start_locked(Backend& backend)
+    {
+        bool trial = backend.circuit == Circuit::HalfOpen;
+        if (trial)
+        {
+            backend.trial_in_flight = true;
+        }
+        backend.outstanding++;
+        backend.requests++;
+        return trial;
+    }
+
+    /**
+     * @brief Seconds until the first open circuit admits a trial (caller holds mutex_)
+     */
+    int retry_after_locked() const
+    {
+        auto now = Clock::now();
+        auto soonest = Clock::time_point::max();
+        for (const auto& backend : backends_)
+        {
+            if (backend->circuit == Circuit::Open)
+            {
+                soonest = std::min(soonest, backend->open_until);
+            }
+        }
+
+        if (soonest == Clock::time_point::max() || soonest <= now)
+        {
+            return 1;
+        }
+        auto wait = std::chrono::duration_cast<std::chrono::seconds>(soonest - now + std::chrono::milliseconds(999));
+        return static_cast<int>(std::max<std::chrono::seconds::rep>(wait.count(), 1));
+    }
+
+    static const char* circuit_name(Circuit circuit)
+    {
+        switch (circuit)
+        {
+        case Circuit::Open:
+            return "open";
+        case Circuit::HalfOpen:
+            return "half_open";
+        default:
+            return "closed";
+        }
+    }
+
+public:
+    /**
+     * @class Lease
+     * @brief RAII handle to one pooled connection on the chosen backend
+     *
+     * discard() closes the connection without blaming the backend (e.g.,
+     * a cancelled stream) and without crediting it either; fail() also
+     * counts a backend failure.
+     */
+    class Lease
+    {
+    private:
+        BackendPool* owner_;
+        Backend* backend_;
+        ConnectionPool::Lease connection_;
+        Outcome outcome_ = Outcome::Answered;
+        bool trial_;
+
+    public:
+        Lease(BackendPool* owner, Backend* backend, ConnectionPool::Lease connection, bool trial = false)
+            : owner_(owner)
+            , backend_(backend)
+            , connection_(std::move(connection))
+            , trial_(trial)
+        {
+        }
+
+        Lease(Lease&& other) noexcept
+            : owner_(other.owner_)
+            , backend_(other.backend_)
+            , connection_(std::move(other.connection_))
+            , outcome_(other.outcome_)
+            , trial_(other.trial_)
+        {
+            other.owner_ = nullptr;
+        }
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease& operator=(Lease&&) = delete;
+
+        ~Lease()
+        {
+            if (owner_)
+            {
+                owner_->release(backend_, outcome_, trial_);
+            }
+        }
+
+        /**
+         * @brief Close the connection instead of reusing it
+         */
+        void discard()
+        {
+            connection_.discard();
+            if (outcome_ == Outcome::Answered)
+            {
+                outcome_ = Outcome::Abandoned;
+            }
+        }
+
+        /**
+         * @brief Record a transport error against the backend
+         */
+        void fail()
+        {
+            connection_.discard();
+            outcome_ = Outcome::Failed;
+        }
+
+        /**
+         * @brief Backend serving this lease
+         */
+        const Backend& backend() const
+        {
+            return *backend_;
+        }
+
+        httplib::Client* operator->()
+        {
+            return connection_.operator->();
+        }
+
+        httplib::Client& operator*()
+        {
+            return *connection_;
+        }
+    };
+
+    /**
+     * @brief Construct an empty backend pool
+     *
+     * @param connections_per_backend Keep-alive connections per backend (default: 8)
+     * @param idle_timeout Seconds before an idle connection is closed (default: 60)
+     * @param timeout Default read/write timeout in seconds (default: 300)
+     * @param max_failures Consecutive connection failures that open a circuit (default: 2)
+     * @param cooldown Seconds an open circuit stays open (default: 5)
+     */
+    explicit BackendPool(size_t connections_per_backend = 8, int idle_timeout = 60,
+                         int timeout = 300, size_t max_failures = 2, int cooldown = 5)
+        : connections_per_backend_(connections_per_backend)
+        , idle_timeout_(idle_timeout)
+        , timeout_seconds_(timeout)
+        , max_failures_(max_failures > 0 ? max_failures : 1)
+        , cooldown_(std::chrono::seconds(cooldown > 0 ? cooldown : 1))
+    {
+    }
+
+    BackendPool(const BackendPool&) = delete;
+    BackendPool& operator=(const BackendPool&) = delete;
+
+    /**
+     * @brief Register a backend
+     *
+     * Call before serving requests.
+     *
+     * @param host Server hostname
+     * @param port Server port
+     * @param weight Relative capacity, at least 1 (default: 1)
+     */
+    void add(const std::string& host, int port, int weight = 1)
+    {
+        auto backend = std::make_unique<Backend>();
+        backend->host = host;
+        backend->port = port;
+        backend->weight = weight > 0 ? weight : 1;
+        backend->pool = std::make_unique<ConnectionPool>(
+            host, port, connections_per_backend_, idle_timeout_, timeout_seconds_);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        backends_.push_back(std::move(backend));
+    }
+
+    /**
+     * @brief Lease a connection on the least loaded healthy backend
+     *
+     * Load is outstanding requests divided by weight; ties go to the
+     * backend registered first. Backends with an open circuit are skipped.
+     *
+     * @return Lease on the chosen backend
+     *
+     * @throws std::runtime_error if no backend is registered;
+     *         BackendUnavailable if every circuit is open
+     */
+    Lease acquire()
+    {
+        Backend* chosen = nullptr;
+        bool trial = false;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            if (backends_.empty())
+            {
+                throw std::runtime_error("No llama-server backends configured");
+            }
+
+            chosen = choose_locked(nullptr, true);
+            if (!chosen)
+            {
+                throw BackendUnavailable(retry_after_locked());
+            }
+
+            trial = start_locked(*chosen);
+        }
+
+        try
+        {
+            return Lease(this, chosen, chosen->pool->acquire(), trial);
+        }
+        catch (...)
+        {
+            release(chosen, Outcome::Failed, trial);
+            throw;
+        }
+    }
+
+    /**
+     * @brief Lease a connection on another backend, for a hedged request
+     *
+     * Only backends in rotation with a closed circuit qualify: a hedge is
+     * extra load and should not land on a backend that is struggling.
+     *
+     * @param avoid Backend already serving the request
+     * @return Lease, or nothing if no other backend qualifies
+     */
+    std::optional<Lease> acquire_other(const Backend& avoid)
+    {
+        Backend* chosen = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            chosen = choose_locked(&avoid, false);
+            if (!chosen || !chosen->healthy)
+            {
+                return std::nullopt;
+            }
+
+            start_locked(*chosen);
+        }
+
+        try
+        {
+            return Lease(this, chosen, chosen->pool->acquire());
+        }
+        catch (...)
+        {
+            release(chosen, Outcome::Failed);
+            throw;
+        }
+    }
+
+    /**
+     * @brief Lease a connection on the backend holding a pinned slot
+     *
+     * For calls pinned to one of its slots (see SlotAffinity). The backend
+     * qualifies only while it is in rotation and its circuit admits the
+     * request, as acquire() would require.
+     *
+     * @param index Backend index in registration order
+     * @return Lease, or nothing if that backend does not qualify now
+     */
+    std::optional<Lease> acquire_pinned(size_t index)
+    {
+        Backend* chosen = nullptr;
+        bool trial = false;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            if (index >= backends_.size())
+            {
+                return std::nullopt;
+            }
+            chosen = backends_[index].get();
+            if (!chosen->healthy || !admits_locked(*chosen, Clock::now()))
+            {
+                return std::nullopt;
+            }
+
+            trial = start_locked(*chosen);
+        }
+
+        try
+        {
+            return Lease(this, chosen, chosen->pool->acquire(), trial);
+        }
+        catch (...)
+        {
+            release(chosen, Outcome::Failed, trial);
+            throw;
+        }
+    }
+
+    /**
+     * @brief Lease a connection on a specific backend (health probes)
+     *
+     * @param index Backend index in registration order
+     */
+    Lease acquire(size_t index)
+    {
+        Backend* backend = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            backend = backends_.at(index).get();
+            backend->outstanding++;
+        }
+
+        try
+        {
+            return Lease(this, backend, backend->pool->acquire());
+        }
+        catch (...)
+        {
+            release(backend, Outcome::Abandoned);
+            throw;
+        }
+    }
+
+    /**
+     * @brief Record a health probe result
+     *
+     * A failed probe ejects the backend; a successful one re-admits it
+     * and ends the cooldown of an open circuit.
+     *
+     * @param index Backend index in registration order
+     * @param alive Probe result
+     */
+    void set_health(size_t index, bool alive)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        Backend& backend = *backends_.at(index);
+        set_healthy_locked(backend, alive);
+        if (alive && backend.circuit == Circuit::Open)
+        {
+            backend.open_until = Clock::now();
+        }
+    }
+
+    /**
+     * @brief Number of registered backends
+     */
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return backends_.size();
+    }
+
+    /**
+     * @brief Number of backends currently in rotation
+     */
+    size_t healthy_count() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        size_t count = 0;
+        for (const auto& backend : backends_)
+        {
+            count += backend->healthy ? 1 : 0;
+        }
+        return count;
+    }
+
+    /**
+     * @brief URL of a backend
+     *
+     * @param index Backend index in registration order
+     */
+    std::string url(size_t index) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return backends_.at(index)->url();
+    }
+
+    /**
+     * @brief Connection pool of a backend (for diagnostics)
+     *
+     * @param index Backend index in registration order
+     */
+    ConnectionPool& connection_pool(size_t index)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return *backends_.at(index)->pool;
+    }
+
+    /**
+     * @brief Per-backend load, health and failure counters
+     *
+     * @return JSON array suitable for a diagnostics endpoint
+     */
+    json stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        json result = json::array();
+        for (const auto& backend : backends_)
+        {
+            result.push_back({
+                {"url", backend->url()},
+                {"weight", backend->weight},
+                {"healthy", backend->healthy},
+                {"outstanding", backend->outstanding},
+                {"requests", backend->requests},
+                {"failures", backend->failures},
+                {"ejections", backend->ejections},
+                {"circuit", circuit_name(backend->circuit)},
+                {"circuit_opens", backend->circuit_opens},
+                {"open_connections", backend->pool->open_connections()}
+            });
+        }
+        return result;
+    }
+};
+
+} // namespace app
+} // namespace llama
+} // namespace pooriayousefi
+
+#endif // POORIAYOUSEFI_LLAMA_APP_BACKEND_POOL_HPP
@@ -0,0 +1,288 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file json_fields.hpp
+ * @brief Lazy Extraction of Top-level JSON Fields
+ *
+ * extract_fields() runs nlohmann's SAX parser over a JSON object and
+ * materializes only the requested top-level members. Everything else is
+ * validated and skipped without allocating DOM nodes, and extracted
+ * strings are moved out of the parser's buffer rather than copied.
+ *
+ * Used on the hot path where only a few fields of a large document
+ * matter: llama-server replies (which echo the prompt and generation
+ * settings) and large /api request bodies.
+ *
+ * @author Pooria Yousefi
+ * @date October 6, 2025
+ */
+
+#ifndef POORIAYOUSEFI_LLAMA_APP_JSON_FIELDS_HPP
+#define POORIAYOUSEFI_LLAMA_APP_JSON_FIELDS_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdexcept>
+#include <utility>
+#include "json.hpp"
+
+namespace pooriayousefi
+{
+namespace llama
+{
+namespace app
+{
+
+using json = nlohmann::json;
+
+/// Names of the top-level members to extract
+using FieldList = std::vector<std::string_view>;
+
+/**
+ * @class FieldExtractor
+ * @brief SAX handler that keeps only selected top-level members
+ */
+class FieldExtractor
+{
+private:
+    const FieldList& fields_;
+    json result_ = json::object();
+
+    size_t depth_ = 0;                  ///< Current nesting depth (root object = 1)
+    bool want_next_ = false;            ///< Next root-level value is selected
+    std::string root_key_;              ///< Key of the selected root-level value
+    std::vector<json*> stack_;          ///< Containers being built for a selected value
+    std::vector<std::string> keys_;     ///< Pending key per container on stack_
+    std::string error_;
+
+    bool wanted(const std::string& key) const
+    {
+        for (const auto& field : fields_)
+        {
+            if (field == key)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Store a value that belongs to a selected member
+     *
+     * @return Pointer to the stored value (used when it is a container)
+     */
+    json* store(json&& value)
+    {
+        if (!stack_.empty())
+        {
+            json* parent = stack_.back();
+            if (parent->is_array())
+            {
+                parent->push_back(std::move(value));
+                return &parent->back();
+            }
+
+            json& slot = (*parent)[keys_.back()];
+            slot = std::move(value);
+            return &slot;
+        }
+
+        if (depth_ == 1 && want_next_)
+        {
+            want_next_ = false;
+            json& slot = result_[root_key_];
+            slot = std::move(value);
+            return &slot;
+        }
+
+        return nullptr;
+    }
+
+    bool value(json&& v)
+    {
+        store(std::move(v));
+        return true;
+    }
+
+    bool start_container(json&& empty)
+    {
+        if (depth_ == 0)
+        {
+            depth_++;
+            return true;
+        }
+
+        json* container = store(std::move(empty));
+        if (container)
+        {
+            stack_.push_back(container);
+            keys_.emplace_back();
+        }
+
+        depth_++;
+        return true;
+    }
+
+    bool end_container()
+    {
+        depth_--;
+
+        // Containers on stack_ sit at depths 2.. so pop when leaving one
+        if (!stack_.empty() && depth_ >= 1 && stack_.size() == depth_)
+        {
+            stack_.pop_back();
+            keys_.pop_back();
+        }
+        return true;
+    }
+
+public:
+    explicit FieldExtractor(const FieldList& fields)
+        : fields_(fields)
+    {
+    }
+
+    bool null()
+    {
+        return value(json(nullptr));
+    }
+
+    bool boolean(bool val)
+    {
+        return value(json(val));
+    }
+
+    bool number_integer(json::number_integer_t val)
+    {
+        return value(json(val));
+    }
+
+    bool number_unsigned(json::number_unsigned_t val)
+    {
+        return value(json(val));
+    }
+
+    bool number_float(json::number_float_t val, const json::string_t&)
+    {
+        return value(json(val));
+    }
+
+    bool string(json::string_t& val)
+    {
+        if (stack_.empty() && !(depth_ == 1 && want_next_))
+        {
+            return true;
+        }
+        return value(json(std::move(val)));
+    }
+
+    bool binary(json::binary_t& val)
+    {
+        return value(json::binary(std::move(val)));
+    }
+
+    bool start_object(std::size_t)
+    {
+        return start_container(json::object());
+    }
+
+    bool start_array(std::size_t)
+    {
+        return start_container(json::array());
+    }
+
+    bool end_object()
+    {
+        return end_container();
+    }
+
+    bool end_array()
+    {
+        return end_container();
+    }
+
+    bool key(json::string_t& val)
+    {
+        if (!stack_.empty())
+        {
+            keys_.back() = std::move(val);
+        }
+        else if (depth_ == 1)
+        {
+            want_next_ = wanted(val);
+            if (want_next_)
+            {
+                root_key_ = std::move(val);
+            }
+        }
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex)
+    {
+        error_ = ex.what();
+        return false;
+    }
+
+    /**
+     * @brief Extracted members (moved out)
+     */
+    json take_result()
+    {
+        return std::move(result_);
+    }
+
+    /**
+     * @brief Parser error message, empty on success
+     */
+    const std::string& error() const
+    {
+        return error_;
+    }
+};
+
+/**
+ * @brief Extract selected top-level members from JSON object text
+ *
+ * Missing members are simply absent from the result. The whole input is
+ * still validated.
+ *
+ * @param text JSON text (expected to be an object)
+ * @param fields Names of members to keep
+ * @return JSON object holding only the requested members
+ *
+ * @throws std::runtime_error if text is not valid JSON
+ */
+inline json extract_fields(const std::string& text, const FieldList& fields)
+{
+    FieldExtractor extractor(fields);
+
+    if (!json::sax_parse(text, &extractor) || !extractor.error().empty())
+    {
+        throw std::runtime_error(extractor.error().empty() ? "JSON parse error" : extractor.error());
+    }
+
+    return extractor.take_result();
+}
+
+} // namespace app
+} // namespace llama
+} // namespace pooriayousefi
+
+#endif // POORIAYOUSEFI_LLAMA_APP_JSON_FIELDS_HPP
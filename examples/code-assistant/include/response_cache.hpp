@@ -0,0 +1,266 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file response_cache.hpp
+ * @brief Exact-match LRU Cache for Completion Responses
+ *
+ * Caches llama-server /completion replies keyed by
+ * prompt + n_predict + temperature + stop list. Only low-temperature
+ * (near-deterministic) requests are cached; anything sampled above the
+ * configured threshold bypasses the cache.
+ *
+ * Bounded by an approximate memory budget (least recently used entries
+ * are evicted first) and a TTL.
+ *
+ * @author Pooria Yousefi
+ * @date October 6, 2025
+ */
+
+#ifndef POORIAYOUSEFI_LLAMA_APP_RESPONSE_CACHE_HPP
+#define POORIAYOUSEFI_LLAMA_APP_RESPONSE_CACHE_HPP
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <optional>
+#include <cstdint>
+#include "json.hpp"
+#include "llama_client.hpp"
+
+namespace pooriayousefi
+{
+namespace llama
+{
+namespace app
+{
+
+using json = nlohmann::json;
+
+/**
+ * @class ResponseCache
+ * @brief Thread-safe LRU cache with memory budget and TTL
+ */
+class ResponseCache
+{
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+        json value;
+        size_t bytes;
+        Clock::time_point expires;
+        std::list<const std::string*>::iterator lru_pos;
+    };
+
+    /// Rough per-entry bookkeeping cost (map node, list node, json header)
+    static constexpr size_t ENTRY_OVERHEAD = 128;
+
+    size_t max_bytes_;
+    std::chrono::seconds ttl_;
+    float max_temperature_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<const std::string*> lru_;  ///< Most recent at front; points at map keys
+    size_t bytes_ = 0;
+
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t bypassed_ = 0;
+    uint64_t evictions_ = 0;
+    uint64_t expirations_ = 0;
+
+    /**
+     * @brief Remove an entry (caller holds mutex_)
+     */
+    void erase_locked(std::unordered_map<std::string, Entry>::iterator it)
+    {
+        bytes_ -= it->second.bytes;
+        lru_.erase(it->second.lru_pos);
+        entries_.erase(it);
+    }
+
+public:
+    /**
+     * @brief Construct response cache
+     *
+     * @param max_bytes Approximate memory budget in bytes
+     * @param ttl_seconds Entry lifetime in seconds, 0 = no expiry (default: 300)
+     * @param max_temperature Requests sampled above this bypass the cache (default: 0.3)
+     */
+    explicit ResponseCache(size_t max_bytes, int ttl_seconds = 300, float max_temperature = 0.3f)
+        : max_bytes_(max_bytes)
+        , ttl_(ttl_seconds)
+        , max_temperature_(max_temperature)
+    {
+    }
+
+    ResponseCache(const ResponseCache&) = delete;
+    ResponseCache& operator=(const ResponseCache&) = delete;
+
+    /**
+     * @brief Build the cache key for a completion request
+     *
+     * @param prompt Input text prompt
+     * @param params Sampling parameters
+     * @return Key string (fields separated by NUL)
+     */
+    static std::string make_key(const std::string& prompt, const CompletionParams& params)
+    {
+        std::string key;
+        key.reserve(prompt.size() + 32);
+        key += prompt;
+        key += '\0';
+        key += std::to_string(params.n_predict);
+        key += '\0';
+        key += std::to_string(params.temperature);
+        for (const auto& stop : params.stop)
+        {
+            key += '\0';
+            key += stop;
+        }
+        return key;
+    }
+
+    /**
+     * @brief Check whether a request may be served from the cache
+     *
+     * Counts the request as bypassed when it is not.
+     */
+    bool cacheable(const CompletionParams& params)
+    {
+        if (params.temperature <= max_temperature_)
+        {
+            return true;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        bypassed_++;
+        return false;
+    }
+
+    /**
+     * @brief Look up a cached response
+     *
+     * @param key Key from make_key()
+     * @return Cached response, or std::nullopt on miss or expiry
+     */
+    std::optional<json> get(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = entries_.find(key);
+        if (it == entries_.end())
+        {
+            misses_++;
+            return std::nullopt;
+        }
+
+        if (ttl_.count() > 0 && Clock::now() > it->second.expires)
+        {
+            erase_locked(it);
+            expirations_++;
+            misses_++;
+            return std::nullopt;
+        }
+
+        lru_.splice(lru_.begin(), lru_, it->second.lru_pos);
+        hits_++;
+        return it->second.value;
+    }
+
+    /**
+     * @brief Store a response, evicting least recently used entries as needed
+     *
+     * Responses larger than the whole budget are not stored.
+     *
+     * @param key Key from make_key()
+     * @param value Response to cache
+     */
+    void put(const std::string& key, const json& value)
+    {
+        size_t bytes = key.size() + value.dump().size() + ENTRY_OVERHEAD;
+        if (bytes > max_bytes_)
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto existing = entries_.find(key);
+        if (existing != entries_.end())
+        {
+            erase_locked(existing);
+        }
+
+        while (!lru_.empty() && bytes_ + bytes > max_bytes_)
+        {
+            erase_locked(entries_.find(*lru_.back()));
+            evictions_++;
+        }
+
+        auto [it, inserted] = entries_.emplace(key, Entry{value, bytes, Clock::now() + ttl_, {}});
+        lru_.push_front(&it->first);
+        it->second.lru_pos = lru_.begin();
+        bytes_ += bytes;
+    }
+
+    /**
+     * @brief Drop all entries (counters are kept)
+     */
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+        lru_.clear();
+        bytes_ = 0;
+    }
+
+    /**
+     * @brief Hit/miss counters and memory usage
+     *
+     * @return JSON object suitable for a diagnostics endpoint
+     */
+    json stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        uint64_t lookups = hits_ + misses_;
+        return {
+            {"entries", entries_.size()},
+            {"bytes", bytes_},
+            {"max_bytes", max_bytes_},
+            {"ttl_seconds", ttl_.count()},
+            {"max_temperature", max_temperature_},
+            {"hits", hits_},
+            {"misses", misses_},
+            {"bypassed", bypassed_},
+            {"evictions", evictions_},
+            {"expirations", expirations_},
+            {"hit_ratio", lookups > 0 ? static_cast<double>(hits_) / static_cast<double>(lookups) : 0.0}
+        };
+    }
+};
+
+} // namespace app
+} // namespace llama
+} // namespace pooriayousefi
+
+#endif // POORIAYOUSEFI_LLAMA_APP_RESPONSE_CACHE_HPP
@@ -0,0 +1,689 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file response_compression.hpp
+ * @brief Negotiated gzip/zstd Compression of App-Server Responses
+ *
+ * AppServerBase installs apply() as the post-routing handler of its
+ * servers. A response is compressed when all of these hold:
+ *   - its body is at least min_bytes long
+ *   - its Content-Type is JSON, NDJSON or text (but not text/event-stream)
+ *   - the request's Accept-Encoding admits one of the configured encodings
+ *   - the compressed body is actually smaller
+ *
+ * Streamed replies have no body yet when apply() runs. The NDJSON results
+ * of /api/batch go through a StreamEncoder instead (see negotiate_stream()),
+ * which compresses each line and flushes it, so no result is held back.
+ * Token-by-token SSE streams are left alone: pieces that small do not
+ * shrink.
+ *
+ * Accept-Encoding q-values are honoured ("gzip;q=0" refuses gzip, "*"
+ * covers unlisted codings); among equally preferred encodings the order of
+ * the compression setting decides.
+ *
+ * The codecs are optional: build.py defines LLAMA_APP_ZLIB and
+ * LLAMA_APP_ZSTD (and links -lz / -lzstd) when the libraries are found.
+ * Without either, supported() is empty and apply() never compresses. httplib's
+ * own CPPHTTPLIB_ZLIB_SUPPORT is deliberately not used: it compresses every
+ * compressible reply regardless of size, before the post-routing handler.
+ *
+ * @author Pooria Yousefi
+ * @date October 6, 2025
+ */
+
+#ifndef POORIAYOUSEFI_LLAMA_APP_RESPONSE_COMPRESSION_HPP
+#define POORIAYOUSEFI_LLAMA_APP_RESPONSE_COMPRESSION_HPP
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+#include "httplib.h"
+#include "json.hpp"
+
+#ifdef LLAMA_APP_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef LLAMA_APP_ZSTD
+#include <zstd.h>
+#endif
+
+namespace pooriayousefi
+{
+namespace llama
+{
+namespace app
+{
+
+/**
+ * @class ResponseCompressor
+ * @brief Content-Encoding negotiation and the gzip/zstd codecs behind it
+ */
+class ResponseCompressor
+{
+private:
+    std::vector<std::string> encodings_;    ///< Enabled encodings, most preferred first
+    size_t min_bytes_;
+    int level_;                             ///< 0 = each library's default
+
+    std::atomic<uint64_t> compressed_{0};   ///< Responses sent compressed
+    std::atomic<uint64_t> bytes_in_{0};     ///< Their body bytes before compression
+    std::atomic<uint64_t> bytes_out_{0};    ///< ... and after
+
+    static std::string lower(std::string text)
+    {
+        for (auto& c : text)
+        {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        return text;
+    }
+
+    static std::string trim(const std::string& text)
+    {
+        size_t start = text.find_first_not_of(" \t");
+        size_t end = text.find_last_not_of(" \t");
+        return start == std::string::npos ? std::string() : text.substr(start, end - start + 1);
+    }
+
+    /**
+     * @brief Whether a Content-Type is worth compressing
+     */
+    static bool compressible(const std::string& content_type)
+    {
+        std::string type = lower(trim(content_type.substr(0, content_type.find(';'))));
+        if (type == "text/event-stream")
+        {
+            return false;
+        }
+        return type.compare(0, 5, "text/") == 0
+            || type == "application/json"
+            || type == "application/x-ndjson"
+            || type == "application/xml"
+            || type == "application/javascript";
+    }
+
+    /**
+     * @brief Replace every value of a header with one value
+     */
+    static void replace_header(httplib::Response& res, const char* name, const std::string& value)
+    {
+        res.headers.erase(name);
+        res.set_header(name, value);
+    }
+
+public:
+    /**
+     * @class StreamEncoder
+     * @brief Incremental gzip/zstd encoder for a streamed response
+     *
+     * Each write() is compressed and flushed (Z_SYNC_FLUSH, ZSTD_e_flush),
+     * so the client can decode every piece as soon as it arrives, while
+     * later pieces still refer back to earlier ones. finish() ends the
+     * stream with the gzip trailer or the last zstd frame block.
+     */
+    class StreamEncoder
+    {
+    private:
+        std::string encoding_;
+        uint64_t bytes_in_ = 0;
+        uint64_t bytes_out_ = 0;
+#ifdef LLAMA_APP_ZLIB
+        std::unique_ptr<z_stream> gzip_;
+#endif
+#ifdef LLAMA_APP_ZSTD
+        std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> zstd_{nullptr, ZSTD_freeCCtx};
+#endif
+
+        bool encode(const char* data, size_t size, bool last, std::string& output)
+        {
+            char buffer[16384];
+            output.clear();
+            bytes_in_ += size;
+#ifdef LLAMA_APP_ZLIB
+            if (gzip_)
+            {
+                gzip_->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+                gzip_->avail_in = static_cast<uInt>(size);
+                int result;
+                do
+                {
+                    gzip_->next_out = reinterpret_cast<Bytef*>(buffer);
+                    gzip_->avail_out = sizeof(buffer);
+                    result = deflate(gzip_.get(), last ? Z_FINISH : Z_SYNC_FLUSH);
+                    if (result == Z_STREAM_ERROR)
+                    {
+                        return false;
+                    }
+                    output.append(buffer, sizeof(buffer) - gzip_->avail_out);
+                } while (gzip_->avail_out == 0);
+                bytes_out_ += output.size();
+                return !last || result == Z_STREAM_END;
+            }
+#endif
+#ifdef LLAMA_APP_ZSTD
+            if (zstd_)
+            {
+                ZSTD_inBuffer in{data, size, 0};
+                size_t remaining;
+                do
+                {
+                    ZSTD_outBuffer out{buffer, sizeof(buffer), 0};
+                    remaining = ZSTD_compressStream2(zstd_.get(), &out, &in, last ? ZSTD_e_end : ZSTD_e_flush);
+                    if (ZSTD_isError(remaining))
+                    {
+                        return false;
+                    }
+                    output.append(buffer, out.pos);
+                } while (remaining != 0);
+                bytes_out_ += output.size();
+                return true;
+            }
+#endif
+            (void)buffer;
+            (void)data;
+            (void)last;
+            return false;
+        }
+
+    public:
+        /**
+         * @param encoding "gzip" or "zstd"
+         * @param level Compression level (0 = library default)
+         */
+        StreamEncoder(const std::string& encoding, int level)
+            : encoding_(encoding)
+        {
+#ifdef LLAMA_APP_ZLIB
+            if (encoding == "gzip")
+            {
+                gzip_ = std::make_unique<z_stream>();
+                if (deflateInit2(gzip_.get(), level > 0 ? std::min(level, 9) : Z_DEFAULT_COMPRESSION,
+                                 Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                {
+                    gzip_.reset();
+                }
+            }
+#endif
+#ifdef LLAMA_APP_ZSTD
+            if (encoding == "zstd")
+            {
+                zstd_.reset(ZSTD_createCCtx());
+                if (zstd_ && level > 0)
+                {
+                    ZSTD_CCtx_setParameter(zstd_.get(), ZSTD_c_compressionLevel, level);
+                }
+            }
+#endif
+            (void)level;
+        }
+
+        StreamEncoder(const StreamEncoder&) = delete;
+        StreamEncoder& operator=(const StreamEncoder&) = delete;
+
+        ~StreamEncoder()
+        {
+#ifdef LLAMA_APP_ZLIB
+            if (gzip_)
+            {
+                deflateEnd(gzip_.get());
+            }
+#endif
+        }
+
+        /**
+         * @brief Whether the encoding is compiled in and its codec started
+         */
+        bool valid() const
+        {
+#ifdef LLAMA_APP_ZLIB
+            if (gzip_)
+            {
+                return true;
+            }
+#endif
+#ifdef LLAMA_APP_ZSTD
+            if (zstd_)
+            {
+                return true;
+            }
+#endif
+            return false;
+        }
+
+        const std::string& encoding() const
+        {
+            return encoding_;
+        }
+
+        /**
+         * @brief Compress and flush one piece of the stream
+         *
+         * @param output Receives the bytes to send (replaced)
+         * @return false on a codec error
+         */
+        bool write(const char* data, size_t size, std::string& output)
+        {
+            return encode(data, size, false, output);
+        }
+
+        /**
+         * @brief End the stream
+         *
+         * @param output Receives the last bytes to send (replaced)
+         */
+        bool finish(std::string& output)
+        {
+            return encode(nullptr, 0, true, output);
+        }
+
+        uint64_t bytes_in() const
+        {
+            return bytes_in_;
+        }
+
+        uint64_t bytes_out() const
+        {
+            return bytes_out_;
+        }
+    };
+
+    /**
+     * @brief Create a compressor
+     *
+     * @param encodings Encodings to offer, most preferred first; names not
+     *                  compiled in are dropped
+     * @param min_bytes Smaller bodies are sent as they are
+     * @param level Compression level (0 = library default; gzip caps at 9)
+     */
+    ResponseCompressor(const std::vector<std::string>& encodings, size_t min_bytes, int level)
+        : min_bytes_(min_bytes)
+        , level_(level)
+    {
+        std::vector<std::string> available = supported();
+        for (const auto& encoding : encodings)
+        {
+            if (std::find(available.begin(), available.end(), encoding) != available.end())
+            {
+                encodings_.push_back(encoding);
+            }
+        }
+    }
+
+    /**
+     * @brief Encodings this build can produce and decode
+     */
+    static std::vector<std::string> supported()
+    {
+        std::vector<std::string> encodings;
+#ifdef LLAMA_APP_ZSTD
+        encodings.push_back("zstd");
+#endif
+#ifdef LLAMA_APP_ZLIB
+        encodings.push_back("gzip");
+#endif
+        return encodings;
+    }
+
+    /**
+     * @brief Accept-Encoding value for clients of this build ("" if none)
+     */
+    static std::string accept_encoding()
+    {
+        std::string value;
+        for (const auto& encoding : supported())
+        {
+            value += (value.empty() ? "" : ", ") + encoding;
+        }
+        return value;
+    }
+
+    /**
+     * @brief Enabled encodings, most preferred first
+     */
+    const std::vector<std::string>& encodings() const
+    {
+        return encodings_;
+    }
+
+    /**
+     * @brief Pick the encoding for a request's Accept-Encoding header
+     *
+     * @param accept_encoding Header value, e.g. "gzip;q=0.5, zstd"
+     * @return Chosen encoding, or "" to send the body as it is
+     */
+    std::string negotiate(const std::string& accept_encoding) const
+    {
+        std::vector<std::pair<std::string, double>> accepted;
+        size_t start = 0;
+        while (start <= accept_encoding.size())
+        {
+            size_t end = accept_encoding.find(',', start);
+            if (end == std::string::npos)
+            {
+                end = accept_encoding.size();
+            }
+            std::string item = accept_encoding.substr(start, end - start);
+            start = end + 1;
+
+            size_t semicolon = item.find(';');
+            std::string coding = lower(trim(item.substr(0, semicolon)));
+            if (coding.empty())
+            {
+                continue;
+            }
+
+            double q = 1.0;
+            if (semicolon != std::string::npos)
+            {
+                std::string param = lower(trim(item.substr(semicolon + 1)));
+                if (param.compare(0, 2, "q=") == 0)
+                {
+                    q = std::strtod(param.c_str() + 2, nullptr);
+                }
+            }
+            accepted.emplace_back(coding, q);
+        }
+
+        std::string best;
+        double best_q = 0.0;
+        for (const auto& encoding : encodings_)
+        {
+            double q = -1.0;
+            double wildcard = 0.0;
+            for (const auto& [coding, value] : accepted)
+            {
+                if (coding == encoding)
+                {
+                    q = value;
+                }
+                else if (coding == "*")
+                {
+                    wildcard = value;
+                }
+            }
+            if (q < 0.0)
+            {
+                q = wildcard;
+            }
+
+            // Strictly greater: ties go to the earlier (preferred) encoding
+            if (q > best_q)
+            {
+                best = encoding;
+                best_q = q;
+            }
+        }
+        return best;
+    }
+
+    /**
+     * @brief Compress a finished response in place if it qualifies
+     *
+     * Meant as httplib's post-routing handler, which runs after the
+     * Content-Length header is set and before the headers are written.
+     */
+    void apply(const httplib::Request& req, httplib::Response& res)
+    {
+        if (encodings_.empty() || res.body.size() < min_bytes_
+            || res.status == 206 || res.has_header("Content-Encoding")
+            || !compressible(res.get_header_value("Content-Type")))
+        {
+            return;
+        }
+
+        // The reply depends on Accept-Encoding whichever encoding is chosen
+        res.set_header("Vary", "Accept-Encoding");
+
+        std::string encoding = negotiate(req.get_header_value("Accept-Encoding"));
+        if (encoding.empty())
+        {
+            return;
+        }
+
+        std::string compressed;
+        if (!compress(encoding, res.body, compressed, level_) || compressed.size() >= res.body.size())
+        {
+            return;
+        }
+
+        count(res.body.size(), compressed.size());
+
+        res.body.swap(compressed);
+        res.set_header("Content-Encoding", encoding);
+        replace_header(res, "Content-Length", std::to_string(res.body.size()));
+    }
+
+    /**
+     * @brief Pick the encoding of a streamed response and set its headers
+     *
+     * Call before the stream starts (the headers go out first). Its length
+     * is unknown then, so min_bytes does not apply; SSE streams are never
+     * compressed (see the file comment).
+     *
+     * @param content_type Content-Type the stream is sent with
+     * @return Encoder for the stream's pieces, or nullptr to send them as they are
+     */
+    std::unique_ptr<StreamEncoder> negotiate_stream(const httplib::Request& req, httplib::Response& res,
+                                                    const std::string& content_type) const
+    {
+        if (encodings_.empty() || !compressible(content_type))
+        {
+            return nullptr;
+        }
+
+        res.set_header("Vary", "Accept-Encoding");
+
+        std::string encoding = negotiate(req.get_header_value("Accept-Encoding"));
+        if (encoding.empty())
+        {
+            return nullptr;
+        }
+
+        auto encoder = std::make_unique<StreamEncoder>(encoding, level_);
+        if (!encoder->valid())
+        {
+            return nullptr;
+        }
+        res.set_header("Content-Encoding", encoding);
+        return encoder;
+    }
+
+    /**
+     * @brief Count a compressed response in the stats
+     *
+     * @param bytes_in Body bytes before compression
+     * @param bytes_out ... and after
+     */
+    void count(uint64_t bytes_in, uint64_t bytes_out)
+    {
+        compressed_.fetch_add(1, std::memory_order_relaxed);
+        bytes_in_.fetch_add(bytes_in, std::memory_order_relaxed);
+        bytes_out_.fetch_add(bytes_out, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Compress data with one encoding
+     *
+     * @param encoding "gzip" or "zstd"
+     * @param input Data to compress
+     * @param output Receives the compressed data
+     * @param level Compression level (0 = library default)
+     * @return false if the encoding is not compiled in or compression failed
+     */
+    static bool compress(const std::string& encoding, const std::string& input, std::string& output, int level)
+    {
+#ifdef LLAMA_APP_ZLIB
+        if (encoding == "gzip")
+        {
+            z_stream stream{};
+            // windowBits 15 + 16 writes a gzip header and trailer
+            if (deflateInit2(&stream, level > 0 ? std::min(level, 9) : Z_DEFAULT_COMPRESSION,
+                             Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            {
+                return false;
+            }
+            output.resize(deflateBound(&stream, static_cast<uLong>(input.size())));
+            stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+            stream.avail_in = static_cast<uInt>(input.size());
+            stream.next_out = reinterpret_cast<Bytef*>(&output[0]);
+            stream.avail_out = static_cast<uInt>(output.size());
+            int result = deflate(&stream, Z_FINISH);
+            output.resize(stream.total_out);
+            deflateEnd(&stream);
+            return result == Z_STREAM_END;
+        }
+#endif
+#ifdef LLAMA_APP_ZSTD
+        if (encoding == "zstd")
+        {
+            // One context per thread: creating one costs more than compressing a small reply
+            thread_local std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> context(ZSTD_createCCtx(), ZSTD_freeCCtx);
+            if (!context)
+            {
+                return false;
+            }
+            output.resize(ZSTD_compressBound(input.size()));
+            size_t size = ZSTD_compressCCtx(context.get(), &output[0], output.size(),
+                                            input.data(), input.size(), level);
+            if (ZSTD_isError(size))
+            {
+                return false;
+            }
+            output.resize(size);
+            return true;
+        }
+#endif
+        (void)encoding;
+        (void)input;
+        (void)output;
+        (void)level;
+        return false;
+    }
+
+    /**
+     * @brief Decompress a body received with a Content-Encoding
+     *
+     * @param encoding Content-Encoding value ("", "identity", "gzip" or "zstd")
+     * @param input Received body
+     * @param output Receives the decoded body
+     * @return false if the encoding is unknown or the data is corrupt
+     */
+    static bool decompress(const std::string& encoding, const std::string& input, std::string& output)
+    {
+        if (encoding.empty() || encoding == "identity")
+        {
+            output = input;
+            return true;
+        }
+
+        char buffer[16384];
+#ifdef LLAMA_APP_ZLIB
+        if (encoding == "gzip")
+        {
+            z_stream stream{};
+            // windowBits 15 + 32 accepts gzip and zlib headers
+            if (inflateInit2(&stream, 15 + 32) != Z_OK)
+            {
+                return false;
+            }
+            output.clear();
+            stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+            stream.avail_in = static_cast<uInt>(input.size());
+            int result = Z_OK;
+            while (result == Z_OK)
+            {
+                stream.next_out = reinterpret_cast<Bytef*>(buffer);
+                stream.avail_out = sizeof(buffer);
+                result = inflate(&stream, Z_NO_FLUSH);
+                output.append(buffer, sizeof(buffer) - stream.avail_out);
+                if (result == Z_BUF_ERROR && stream.avail_in == 0)
+                {
+                    break;
+                }
+            }
+            inflateEnd(&stream);
+            return result == Z_STREAM_END;
+        }
+#endif
+#ifdef LLAMA_APP_ZSTD
+        if (encoding == "zstd")
+        {
+            std::unique_ptr<ZSTD_DStream, size_t (*)(ZSTD_DStream*)> stream(ZSTD_createDStream(), ZSTD_freeDStream);
+            if (!stream)
+            {
+                return false;
+            }
+            output.clear();
+            ZSTD_inBuffer in{input.data(), input.size(), 0};
+            size_t result = 1;
+            while (in.pos < in.size)
+            {
+                ZSTD_outBuffer out{buffer, sizeof(buffer), 0};
+                result = ZSTD_decompressStream(stream.get(), &out, &in);
+                if (ZSTD_isError(result))
+                {
+                    return false;
+                }
+                output.append(buffer, out.pos);
+            }
+            // Flush what the last call could not fit in the buffer
+            while (result != 0)
+            {
+                ZSTD_outBuffer out{buffer, sizeof(buffer), 0};
+                result = ZSTD_decompressStream(stream.get(), &out, &in);
+                if (ZSTD_isError(result) || out.pos == 0)
+                {
+                    return false;
+                }
+                output.append(buffer, out.pos);
+            }
+            return true;
+        }
+#endif
+        (void)buffer;
+        return false;
+    }
+
+    /**
+     * @brief Compression counters for /stats
+     */
+    nlohmann::json stats() const
+    {
+        uint64_t in = bytes_in_.load(std::memory_order_relaxed);
+        uint64_t out = bytes_out_.load(std::memory_order_relaxed);
+        return {
+            {"encodings", encodings_},
+            {"min_bytes", min_bytes_},
+            {"responses", compressed_.load(std::memory_order_relaxed)},
+            {"bytes_in", in},
+            {"bytes_out", out},
+            {"ratio", in > 0 ? static_cast<double>(out) / static_cast<double>(in) : 0.0}
+        };
+    }
+};
+
+} // namespace app
+} // namespace llama
+} // namespace pooriayousefi
+
+#endif // POORIAYOUSEFI_LLAMA_APP_RESPONSE_COMPRESSION_HPP
@@ -0,0 +1,461 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file session_store.hpp
+ * @brief Server-side Chat Session Store
+ *
+ * Keeps multi-turn chat history on the app-server so clients send only the
+ * new message each turn.
+ *
+ * Each ChatSession stores its messages already serialized as JSON objects
+ * in one contiguous arena string. Building the "messages" array for
+ * LlamaClient::chat_serialized() is then a single copy of the live part of
+ * the arena; nothing is re-parsed or re-serialized per turn. Old turns
+ * are dropped from the front of the window when the message or token
+ * budget is exceeded, and the arena is compacted once enough dead bytes
+ * accumulate.
+ *
+ * SessionStore maps session ids to sessions, evicting the least recently
+ * used session when full and sessions idle longer than the TTL.
+ *
+ * @author Pooria Yousefi
+ * @date October 6, 2025
+ */
+
+#ifndef POORIAYOUSEFI_LLAMA_APP_SESSION_STORE_HPP
+#define POORIAYOUSEFI_LLAMA_APP_SESSION_STORE_HPP
+
+#include <string>
+#include <deque>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include "json.hpp"
+
+namespace pooriayousefi
+{
+namespace llama
+{
+namespace app
+{
+
+using json = nlohmann::json;
+
+/**
+ * @struct SessionLimits
+ * @brief Per-session history budget
+ */
+struct SessionLimits
+{
+    size_t max_messages = 64;    ///< Messages kept in the window (system prompt excluded)
+    size_t max_tokens = 4096;    ///< Approximate history tokens kept in the window
+};
+
+/**
+ * @class ChatSession
+ * @brief Arena-backed message history for one conversation
+ *
+ * Not internally synchronized beyond mutex(); lock it for the duration of
+ * a turn so concurrent requests on one session are applied in order.
+ */
+class ChatSession
+{
+private:
+    struct Message
+    {
+        size_t offset;      ///< Start of ",{...}" in arena_
+        size_t length;
+        size_t tokens;
+        bool user;          ///< true for user turns (window starts at one)
+    };
+
+    SessionLimits limits_;
+    std::string system_json_;       ///< Serialized system message, if any
+    size_t system_tokens_ = 0;
+    std::string arena_;             ///< ",{msg},{msg}..." (leading comma per message)
+    std::deque<Message> messages_;
+    size_t begin_ = 0;              ///< Arena offset of the oldest live message
+    size_t tokens_ = 0;
+    std::mutex mutex_;
+
+    static constexpr size_t MESSAGE_OVERHEAD = 4;   ///< Chat template tokens per message
+
+    /**
+     * @brief Tokens of one message: the measured count, or ~4 bytes/token
+     */
+    static size_t message_tokens(const std::string& content, size_t content_tokens)
+    {
+        return (content_tokens > 0 ? content_tokens : (content.size() + 3) / 4) + MESSAGE_OVERHEAD;
+    }
+
+    /**
+     * @brief Serialize one message object
+     */
+    static std::string serialize(const std::string& role, const std::string& content)
+    {
+        return "{\"role\":" + json(role).dump() + ",\"content\":" + json(content).dump() + "}";
+    }
+
+    /**
+     * @brief Drop the oldest message
+     */
+    void drop_front()
+    {
+        const Message& front = messages_.front();
+        begin_ = front.offset + front.length;
+        tokens_ -= front.tokens;
+        messages_.pop_front();
+
+        // Reclaim dead space once it outweighs the live part
+        if (begin_ > arena_.size() - begin_ && begin_ > 4096)
+        {
+            arena_.erase(0, begin_);
+            for (auto& message : messages_)
+            {
+                message.offset -= begin_;
+            }
+            begin_ = 0;
+        }
+    }
+
+    /**
+     * @brief Drop turns from the front until the window fits both budgets
+     *
+     * The window always starts with a user message and the newest message
+     * is always kept.
+     */
+    void trim(size_t max_messages, size_t max_tokens)
+    {
+        while (messages_.size() > 1 && (messages_.size() > max_messages || tokens_ > max_tokens))
+        {
+            drop_front();
+        }
+
+        while (messages_.size() > 1 && !messages_.front().user)
+        {
+            drop_front();
+        }
+    }
+
+    /**
+     * @brief Enforce message and token budgets
+     */
+    void enforce_limits()
+    {
+        trim(limits_.max_messages, limits_.max_tokens);
+    }
+
+public:
+    explicit ChatSession(const SessionLimits& limits)
+        : limits_(limits)
+    {
+    }
+
+    /**
+     * @brief Mutex serializing turns on this session
+     */
+    std::mutex& mutex()
+    {
+        return mutex_;
+    }
+
+    /**
+     * @brief Set (or replace) the system prompt
+     *
+     * The system prompt is never evicted from the window.
+     *
+     * @param content System prompt text
+     * @param content_tokens Measured tokens of content, 0 = estimate
+     */
+    void set_system(const std::string& content, size_t content_tokens = 0)
+    {
+        system_json_ = content.empty() ? std::string() : serialize("system", content);
+        system_tokens_ = content.empty() ? 0 : message_tokens(content, content_tokens);
+    }
+
+    /**
+     * @brief Append a message and apply the window budgets
+     *
+     * @param role "user" or "assistant"
+     * @param content Message text
+     * @param content_tokens Measured tokens of content, 0 = estimate
+     */
+    void append(const std::string& role, const std::string& content, size_t content_tokens = 0)
+    {
+        std::string serialized = serialize(role, content);
+        size_t tokens = message_tokens(content, content_tokens);
+
+        Message message{arena_.size(), serialized.size() + 1, tokens, role == "user"};
+        arena_ += ',';
+        arena_ += serialized;
+        messages_.push_back(message);
+        tokens_ += tokens;
+
+        enforce_limits();
+    }
+
+    /**
+     * @brief Remove the newest message (e.g., after a failed LLM call)
+     */
+    void pop_back()
+    {
+        if (messages_.empty())
+        {
+            return;
+        }
+
+        const Message& back = messages_.back();
+        arena_.resize(back.offset);
+        tokens_ -= back.tokens;
+        messages_.pop_back();
+
+        if (messages_.empty())
+        {
+            arena_.clear();
+            begin_ = 0;
+        }
+    }
+
+    /**
+     * @brief Serialized "messages" array for the current window
+     *
+     * @return JSON array text, e.g. [{"role":"user","content":"..."}]
+     */
+    std::string messages_json() const
+    {
+        std::string out;
+        out.reserve(system_json_.size() + (arena_.size() - begin_) + 2);
+        out += '[';
+        out += system_json_;
+
+        if (!messages_.empty())
+        {
+            // Each message carries a leading comma; skip it if it comes first
+            size_t skip = system_json_.empty() ? 1 : 0;
+            out.append(arena_, begin_ + skip, std::string::npos);
+        }
+
+        out += ']';
+        return out;
+    }
+
+    /**
+     * @brief Messages currently in the window (system prompt excluded)
+     */
+    size_t size() const
+    {
+        return messages_.size();
+    }
+
+    /**
+     * @brief Approximate tokens currently in the window
+     */
+    size_t tokens() const
+    {
+        return tokens_;
+    }
+
+    /**
+     * @brief Tokens of the prompt built from the window (system prompt included)
+     */
+    size_t prompt_tokens() const
+    {
+        return system_tokens_ + tokens_;
+    }
+
+    /**
+     * @brief Shrink the window so the prompt fits a token budget
+     *
+     * Drops the oldest turns like the session budgets do; only the newest
+     * message and the system prompt are never dropped.
+     *
+     * @param max_tokens Prompt tokens allowed (system prompt included)
+     * @return Prompt tokens of the remaining window
+     */
+    size_t fit_tokens(size_t max_tokens)
+    {
+        size_t history = max_tokens > system_tokens_ ? max_tokens - system_tokens_ : 0;
+        trim(messages_.size(), history);
+        return prompt_tokens();
+    }
+
+    /**
+     * @brief Bytes held by the arena (live + not yet compacted)
+     */
+    size_t arena_bytes() const
+    {
+        return arena_.capacity() + system_json_.capacity();
+    }
+};
+
+/**
+ * @class SessionStore
+ * @brief Thread-safe map of session id to ChatSession with LRU/TTL eviction
+ */
+class SessionStore
+{
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+        std::shared_ptr<ChatSession> session;
+        Clock::time_point last_used;
+        std::list<const std::string*>::iterator lru_pos;
+    };
+
+    SessionLimits limits_;
+    size_t max_sessions_;
+    std::chrono::seconds ttl_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry> sessions_;
+    std::list<const std::string*> lru_;   ///< Most recent at front; points at map keys
+
+    uint64_t created_ = 0;
+    uint64_t evicted_ = 0;
+    uint64_t expired_ = 0;
+
+    /**
+     * @brief Remove a session (caller holds mutex_)
+     */
+    void erase_locked(std::unordered_map<std::string, Entry>::iterator it)
+    {
+        lru_.erase(it->second.lru_pos);
+        sessions_.erase(it);
+    }
+
+    /**
+     * @brief Drop sessions idle longer than the TTL (caller holds mutex_)
+     */
+    void expire_locked(Clock::time_point now)
+    {
+        while (ttl_.count() > 0 && !lru_.empty())
+        {
+            auto oldest = sessions_.find(*lru_.back());
+            if (now - oldest->second.last_used <= ttl_)
+            {
+                break;
+            }
+            erase_locked(oldest);
+            expired_++;
+        }
+    }
+
+public:
+    /**
+     * @brief Construct session store
+     *
+     * @param limits Per-session history budget
+     * @param max_sessions Sessions kept before LRU eviction (default: 1024)
+     * @param ttl_seconds Idle lifetime in seconds, 0 = no expiry (default: 1800)
+     */
+    SessionStore(const SessionLimits& limits, size_t max_sessions = 1024, int ttl_seconds = 1800)
+        : limits_(limits)
+        , max_sessions_(max_sessions > 0 ? max_sessions : 1)
+        , ttl_(ttl_seconds)
+    {
+    }
+
+    SessionStore(const SessionStore&) = delete;
+    SessionStore& operator=(const SessionStore&) = delete;
+
+    /**
+     * @brief Get a session, creating it if needed
+     *
+     * The returned pointer stays valid even if the session is evicted
+     * while a turn is in progress.
+     *
+     * @param id Session id
+     * @return Shared session handle
+     */
+    std::shared_ptr<ChatSession> open(const std::string& id)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = Clock::now();
+
+        expire_locked(now);
+
+        auto it = sessions_.find(id);
+        if (it != sessions_.end())
+        {
+            it->second.last_used = now;
+            lru_.splice(lru_.begin(), lru_, it->second.lru_pos);
+            return it->second.session;
+        }
+
+        if (sessions_.size() >= max_sessions_)
+        {
+            erase_locked(sessions_.find(*lru_.back()));
+            evicted_++;
+        }
+
+        auto session = std::make_shared<ChatSession>(limits_);
+        auto [inserted, ok] = sessions_.emplace(id, Entry{session, now, {}});
+        lru_.push_front(&inserted->first);
+        inserted->second.lru_pos = lru_.begin();
+        created_++;
+
+        return session;
+    }
+
+    /**
+     * @brief End a session
+     *
+     * @return true if the session existed
+     */
+    bool erase(const std::string& id)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = sessions_.find(id);
+        if (it == sessions_.end())
+        {
+            return false;
+        }
+
+        erase_locked(it);
+        return true;
+    }
+
+    /**
+     * @brief Session counts
+     *
+     * @return JSON object suitable for a diagnostics endpoint
+     */
+    json stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        return {
+            {"sessions", sessions_.size()},
+            {"max_sessions", max_sessions_},
+            {"created", created_},
+            {"evicted", evicted_},
+            {"expired", expired_}
+        };
+    }
+};
+
+} // namespace app
+} // namespace llama
+} // namespace pooriayousefi
+
+#endif // POORIAYOUSEFI_LLAMA_APP_SESSION_STORE_HPP
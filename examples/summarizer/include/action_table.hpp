@@ -0,0 +1,263 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file action_table.hpp
+ * @brief Compile-time Action Registry for AppServerBase
+ *
+ * A derived server lists its actions once:
+ *
+ *   static constexpr auto actions()
+ *   {
+ *       return std::array{
+ *           ActionRoute<MyApp>{"chat", &MyApp::handle_chat},
+ *           ActionRoute<MyApp>{"echo", &MyApp::handle_echo}
+ *       };
+ *   }
+ *
+ * and AppServerBase dispatches "action" through a hash table built by the
+ * compiler instead of a chain of string comparisons: one hash of the name,
+ * one comparison. The hash seed is searched at compile time so that every
+ * name gets its own slot (a perfect hash); if none is found, lookups fall
+ * back to linear probing, which is still correct. Duplicate or malformed
+ * names fail the build.
+ *
+ * @author Pooria Yousefi
+ * @date October 6, 2025
+ */
+
+#ifndef POORIAYOUSEFI_LLAMA_APP_ACTION_TABLE_HPP
+#define POORIAYOUSEFI_LLAMA_APP_ACTION_TABLE_HPP
+
+#include <array>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+#include "json.hpp"
+
+namespace pooriayousefi
+{
+namespace llama
+{
+namespace app
+{
+
+using json = nlohmann::json;
+
+/**
+ * @struct ActionRoute
+ * @brief One entry of a derived server's action table
+ */
+template<typename Derived>
+struct ActionRoute
+{
+    std::string_view name;                          ///< "action" value, also served as POST /api/<name>
+    json (Derived::*handler)(const json& request);  ///< Handler member function
+};
+
+/**
+ * @struct ActionHash
+ * @brief Hashing and sizing helpers for ActionIndex
+ */
+struct ActionHash
+{
+    /**
+     * @brief Seeded FNV-1a hash of an action name
+     */
+    static constexpr uint32_t of(std::string_view name, uint32_t seed)
+    {
+        uint32_t hash = 2166136261u + seed * 0x9E3779B9u;
+        for (char c : name)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief Power-of-two slot count with a load factor of at most 1/4
+     */
+    static constexpr size_t table_size(size_t count)
+    {
+        size_t size = 1;
+        while (size < count * 4)
+        {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    /**
+     * @brief Names must be usable as a route segment: [A-Za-z0-9_-]+, and
+     *        must not shadow /api/batch or /api/stream
+     */
+    static constexpr bool valid_name(std::string_view name)
+    {
+        if (name.empty() || name == "batch" || name == "stream")
+        {
+            return false;
+        }
+        for (char c : name)
+        {
+            bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+            if (!ok)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+/**
+ * @class ActionIndex
+ * @brief constexpr open-addressing hash table from action name to table index
+ *
+ * @tparam N Number of actions
+ */
+template<size_t N>
+class ActionIndex
+{
+public:
+    static constexpr size_t npos = N;   ///< find() result for unknown names
+
+private:
+    static constexpr size_t TABLE_SIZE = ActionHash::table_size(N);
+    static constexpr size_t MASK = TABLE_SIZE - 1;
+    static constexpr uint32_t MAX_SEEDS = 256;
+
+    std::array<std::string_view, N> names_{};
+    std::array<size_t, TABLE_SIZE> slots_{};    ///< Table index per slot, npos = empty
+    uint32_t seed_ = 0;
+    bool perfect_ = false;
+    bool valid_ = true;
+
+    constexpr bool collision_free(uint32_t seed) const
+    {
+        std::array<bool, TABLE_SIZE> used{};
+        for (std::string_view name : names_)
+        {
+            size_t slot = ActionHash::of(name, seed) & MASK;
+            if (used[slot])
+            {
+                return false;
+            }
+            used[slot] = true;
+        }
+        return true;
+    }
+
+public:
+    /**
+     * @brief Build the index from an action table
+     *
+     * @param routes Entries with a std::string_view name member
+     */
+    template<typename Route>
+    constexpr explicit ActionIndex(const std::array<Route, N>& routes)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            names_[i] = routes[i].name;
+            valid_ = valid_ && ActionHash::valid_name(names_[i]);
+            for (size_t j = 0; j < i; j++)
+            {
+                valid_ = valid_ && names_[j] != names_[i];
+            }
+        }
+
+        for (uint32_t seed = 0; seed < MAX_SEEDS && !perfect_; seed++)
+        {
+            if (collision_free(seed))
+            {
+                seed_ = seed;
+                perfect_ = true;
+            }
+        }
+
+        for (size_t& slot : slots_)
+        {
+            slot = npos;
+        }
+        for (size_t i = 0; i < N; i++)
+        {
+            size_t slot = ActionHash::of(names_[i], seed_) & MASK;
+            while (slots_[slot] != npos)
+            {
+                slot = (slot + 1) & MASK;
+            }
+            slots_[slot] = i;
+        }
+    }
+
+    /**
+     * @brief Table index of an action name
+     *
+     * @return Index into the action table, or npos
+     */
+    constexpr size_t find(std::string_view name) const
+    {
+        size_t slot = ActionHash::of(name, seed_) & MASK;
+        while (slots_[slot] != npos)
+        {
+            if (names_[slots_[slot]] == name)
+            {
+                return slots_[slot];
+            }
+            slot = (slot + 1) & MASK;
+        }
+        return npos;
+    }
+
+    /**
+     * @brief Whether every name is well-formed and unique
+     */
+    constexpr bool valid() const
+    {
+        return valid_;
+    }
+
+    /**
+     * @brief Whether every name hashes to its own slot
+     */
+    constexpr bool perfect() const
+    {
+        return perfect_;
+    }
+};
+
+/**
+ * @struct ActionTable
+ * @brief A derived server's actions() with their compile-time index
+ *
+ * Instantiated by AppServerBase once Derived is complete.
+ */
+template<typename Derived>
+struct ActionTable
+{
+    static constexpr auto routes = Derived::actions();
+    static constexpr ActionIndex<routes.size()> index{routes};
+
+    static_assert(index.valid(),
+                  "Action names must be unique, match [A-Za-z0-9_-]+ and not be \"batch\" or \"stream\"");
+};
+
+} // namespace app
+} // namespace llama
+} // namespace pooriayousefi
+
+#endif // POORIAYOUSEFI_LLAMA_APP_ACTION_TABLE_HPP
@@ -0,0 +1,432 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file embedding_matrix.hpp
+ * @brief Contiguous Embedding Storage and a SAX Reader for Embedding Replies
+ *
+ * EmbeddingMatrix keeps one embedding per row in a single row-major float
+ * buffer, ready for similarity code that walks it with SIMD loads.
+ *
+ * read_embeddings() parses a llama-server embedding reply with nlohmann's
+ * SAX interface and writes the numbers straight into matrix rows, so a
+ * reply holding thousands of vectors never becomes a DOM of per-number
+ * nodes. Every object with an "embedding" member is one row, placed by
+ * its "index" member (or in reply order without one). That covers the
+ * layouts llama-server has used, {"embedding": [...]},
+ * [{"index": 0, "embedding": [[...]]}] and the OpenAI-style
+ * {"data": [{"index": 0, "embedding": [...]}]}. Per-token embeddings
+ * (--pooling none) are mean-pooled into one row.
+ *
+ * @author Pooria Yousefi
+ * @date October 6, 2025
+ */
+
+#ifndef POORIAYOUSEFI_LLAMA_APP_EMBEDDING_MATRIX_HPP
+#define POORIAYOUSEFI_LLAMA_APP_EMBEDDING_MATRIX_HPP
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "json.hpp"
+
+namespace pooriayousefi
+{
+namespace llama
+{
+namespace app
+{
+
+using json = nlohmann::json;
+
+/**
+ * @struct EmbeddingMatrix
+ * @brief Embeddings of several inputs, one row each, in one float buffer
+ */
+struct EmbeddingMatrix
+{
+    size_t rows = 0;            ///< Number of embeddings
+    size_t dim = 0;             ///< Floats per embedding
+    std::vector<float> data;    ///< rows * dim values, row-major
+
+    /**
+     * @brief First value of row i
+     */
+    float* row(size_t i)
+    {
+        return data.data() + i * dim;
+    }
+
+    /**
+     * @brief First value of row i
+     */
+    const float* row(size_t i) const
+    {
+        return data.data() + i * dim;
+    }
+
+    /**
+     * @brief Scale every row to unit length, so dot products are cosines
+     *
+     * All-zero rows are left as they are.
+     */
+    void normalize()
+    {
+        for (size_t i = 0; i < rows; i++)
+        {
+            float* values = row(i);
+
+            double norm = 0.0;
+            for (size_t j = 0; j < dim; j++)
+            {
+                norm += static_cast<double>(values[j]) * values[j];
+            }
+            if (norm == 0.0)
+            {
+                continue;
+            }
+
+            float scale = static_cast<float>(1.0 / std::sqrt(norm));
+            for (size_t j = 0; j < dim; j++)
+            {
+                values[j] *= scale;
+            }
+        }
+    }
+};
+
+/**
+ * @class EmbeddingReader
+ * @brief SAX handler that writes embedding vectors into matrix rows
+ *
+ * Writes rows [first_row, first_row + rows) of the matrix. If the matrix
+ * has no storage yet, the first vector read fixes its dim and the buffer
+ * is allocated for all of its rows; otherwise every vector must match
+ * the existing dim.
+ */
+class EmbeddingReader
+{
+private:
+    EmbeddingMatrix& out_;
+    size_t first_row_;
+    size_t rows_;
+
+    size_t depth_ = 0;                  ///< Current nesting depth (root = 1)
+    size_t key_depth_ = 0;              ///< Depth of the object the last key belongs to
+    bool next_embedding_ = false;       ///< Next value is an "embedding" member
+    bool next_index_ = false;           ///< Next value is an "index" member
+
+    size_t vector_depth_ = 0;           ///< Depth of the embedding array being read (0 = none)
+    size_t owner_depth_ = 0;            ///< Depth of the object holding it
+    bool per_token_ = false;            ///< Embedding is an array of per-token arrays
+    size_t tokens_ = 0;                 ///< Per-token arrays summed so far
+    size_t width_ = 0;                  ///< Values read of the current per-token array
+    std::vector<float> values_;         ///< Vector, or per-token sum, being read
+    bool pending_ = false;              ///< A vector is complete, waiting for its object's end
+
+    int64_t index_ = -1;                ///< "index" seen in the owning object
+    size_t index_depth_ = 0;
+    size_t next_row_ = 0;               ///< Row of a vector without "index"
+    std::vector<char> filled_;
+    size_t filled_count_ = 0;
+
+    std::string error_;
+
+    bool fail(const std::string& message)
+    {
+        error_ = message;
+        return false;
+    }
+
+    bool number(double value)
+    {
+        if (vector_depth_ != 0)
+        {
+            if (!per_token_ && depth_ == vector_depth_)
+            {
+                values_.push_back(static_cast<float>(value));
+                return true;
+            }
+            if (per_token_ && depth_ == vector_depth_ + 1)
+            {
+                if (tokens_ == 0)
+                {
+                    values_.push_back(static_cast<float>(value));
+                }
+                else if (width_ < values_.size())
+                {
+                    values_[width_] += static_cast<float>(value);
+                }
+                else
+                {
+                    return fail("llama-server reply has ragged embeddings");
+                }
+                width_++;
+                return true;
+            }
+            return fail("llama-server reply has a malformed embedding");
+        }
+
+        if (next_index_ && depth_ == key_depth_ && value >= 0.0)
+        {
+            index_ = static_cast<int64_t>(value);
+            index_depth_ = depth_;
+        }
+        next_embedding_ = next_index_ = false;
+        return true;
+    }
+
+    bool other()
+    {
+        if (vector_depth_ != 0)
+        {
+            return fail("llama-server reply has a non-numeric embedding value");
+        }
+        next_embedding_ = next_index_ = false;
+        return true;
+    }
+
+    bool commit()
+    {
+        pending_ = false;
+
+        size_t row = (index_ >= 0 && index_depth_ == owner_depth_) ? static_cast<size_t>(index_) : next_row_;
+        next_row_ = row + 1;
+        index_ = -1;
+
+        if (row >= rows_)
+        {
+            return fail("llama-server reply has embedding index " + std::to_string(row)
+                        + " for " + std::to_string(rows_) + " inputs");
+        }
+        if (filled_[row])
+        {
+            return fail("llama-server reply has two embeddings for input " + std::to_string(row));
+        }
+        if (values_.empty() || (per_token_ && tokens_ == 0))
+        {
+            return fail("llama-server reply has an empty embedding");
+        }
+
+        if (per_token_)
+        {
+            float scale = 1.0f / static_cast<float>(tokens_);
+            for (float& value : values_)
+            {
+                value *= scale;
+            }
+        }
+
+        if (out_.data.empty())
+        {
+            out_.dim = values_.size();
+            out_.data.assign(out_.rows * out_.dim, 0.0f);
+        }
+        else if (values_.size() != out_.dim)
+        {
+            return fail("llama-server reply has embeddings of " + std::to_string(values_.size())
+                        + " values, expected " + std::to_string(out_.dim));
+        }
+
+        std::copy(values_.begin(), values_.end(), out_.row(first_row_ + row));
+        filled_[row] = 1;
+        filled_count_++;
+        return true;
+    }
+
+public:
+    EmbeddingReader(EmbeddingMatrix& out, size_t first_row, size_t rows)
+        : out_(out), first_row_(first_row), rows_(rows), filled_(rows, 0)
+    {
+    }
+
+    bool null()
+    {
+        return other();
+    }
+
+    bool boolean(bool)
+    {
+        return other();
+    }
+
+    bool number_integer(json::number_integer_t val)
+    {
+        return number(static_cast<double>(val));
+    }
+
+    bool number_unsigned(json::number_unsigned_t val)
+    {
+        return number(static_cast<double>(val));
+    }
+
+    bool number_float(json::number_float_t val, const json::string_t&)
+    {
+        return number(val);
+    }
+
+    bool string(json::string_t&)
+    {
+        return other();
+    }
+
+    bool binary(json::binary_t&)
+    {
+        return other();
+    }
+
+    bool start_object(std::size_t)
+    {
+        if (vector_depth_ != 0)
+        {
+            return fail("llama-server reply has a malformed embedding");
+        }
+        next_embedding_ = next_index_ = false;
+        depth_++;
+        return true;
+    }
+
+    bool end_object()
+    {
+        if (pending_ && depth_ == owner_depth_ && !commit())
+        {
+            return false;
+        }
+        depth_--;
+        return true;
+    }
+
+    bool start_array(std::size_t)
+    {
+        if (next_embedding_ && depth_ == key_depth_)
+        {
+            if (pending_)
+            {
+                return fail("llama-server reply has two embeddings in one object");
+            }
+            next_embedding_ = next_index_ = false;
+            owner_depth_ = depth_;
+            vector_depth_ = depth_ + 1;
+            per_token_ = false;
+            tokens_ = 0;
+            values_.clear();
+        }
+        else if (vector_depth_ != 0)
+        {
+            if (depth_ != vector_depth_ || (!per_token_ && !values_.empty()))
+            {
+                return fail("llama-server reply has a malformed embedding");
+            }
+            per_token_ = true;
+            width_ = 0;
+        }
+        else
+        {
+            next_embedding_ = next_index_ = false;
+        }
+
+        depth_++;
+        return true;
+    }
+
+    bool end_array()
+    {
+        depth_--;
+
+        if (vector_depth_ != 0)
+        {
+            if (depth_ == vector_depth_)
+            {
+                if (tokens_ > 0 && width_ != values_.size())
+                {
+                    return fail("llama-server reply has ragged embeddings");
+                }
+                tokens_++;
+            }
+            else if (depth_ + 1 == vector_depth_)
+            {
+                vector_depth_ = 0;
+                pending_ = true;
+            }
+        }
+        return true;
+    }
+
+    bool key(json::string_t& val)
+    {
+        key_depth_ = depth_;
+        next_embedding_ = val == "embedding";
+        next_index_ = val == "index";
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex)
+    {
+        error_ = ex.what();
+        return false;
+    }
+
+    /**
+     * @brief Rows written so far
+     */
+    size_t filled() const
+    {
+        return filled_count_;
+    }
+
+    /**
+     * @brief Parser or layout error message, empty on success
+     */
+    const std::string& error() const
+    {
+        return error_;
+    }
+};
+
+/**
+ * @brief Parse an embedding reply into rows of a matrix
+ *
+ * @param text llama-server reply body
+ * @param out Matrix with rows set; allocated on first use
+ * @param first_row First row the reply fills
+ * @param rows Number of inputs the reply answers
+ *
+ * @throws std::runtime_error if the reply is not valid JSON or does not
+ *         hold exactly one embedding per input
+ */
+inline void read_embeddings(const std::string& text, EmbeddingMatrix& out, size_t first_row, size_t rows)
+{
+    EmbeddingReader reader(out, first_row, rows);
+
+    if (!json::sax_parse(text, &reader) || !reader.error().empty())
+    {
+        throw std::runtime_error(reader.error().empty() ? "JSON parse error" : reader.error());
+    }
+    if (reader.filled() != rows)
+    {
+        throw std::runtime_error("llama-server reply has " + std::to_string(reader.filled())
+                                 + " embeddings for " + std::to_string(rows) + " inputs");
+    }
+}
+
+} // namespace app
+} // namespace llama
+} // namespace pooriayousefi
+
+#endif // POORIAYOUSEFI_LLAMA_APP_EMBEDDING_MATRIX_HPP
@@ -19,7 +19,29 @@
  * @brief HTTP Client Wrapper for llama.cpp Server
  * 
  * Internal HTTP client for communicating with llama-server.
- * Uses cpp-httplib for header-only HTTP support.
+ * Uses cpp-httplib for header-only HTTP support. Requests are sent over
+ * pooled keep-alive connections (see connection_pool.hpp) and balanced
+ * across one or more llama-server backends (see backend_pool.hpp). Calls
+ * honour the calling thread's deadline and cancellation (see
+ * request_context.hpp).
+ * 
+ * complete_async() and chat_async() return futures instead of blocking,
+ * so one request thread can have several llama-server calls in flight.
+ * They run on a small shared pool of I/O threads, sized to the number of
+ * pooled connections, which is all that can be in flight at once anyway.
+ * 
+ * Connection failures are retried with jittered backoff, and slow calls
+ * can be hedged on a second backend (see RetryPolicy).
+ * 
+ * count_tokens() and fit_prompt() measure prompts with llama-server's own
+ * tokenizer (/tokenize, cached per text segment) against the per-slot
+ * context size, so an oversized request is caught before any prompt is
+ * evaluated and n_predict can shrink to the room that is left.
+ * 
+ * embed_batch() and rerank() send many inputs per request, in chunks
+ * sized to llama-server's batch, with the chunks after the first in
+ * flight at once. Embeddings are read into one contiguous float buffer
+ * (see embedding_matrix.hpp).
  * 
  * @author Pooria Yousefi
  * @date October 6, 2025
@@ -29,10 +51,30 @@
 #define POORIAYOUSEFI_LLAMA_APP_LLAMA_CLIENT_HPP
 
 #include <string>
+#include <vector>
 #include <stdexcept>
 #include <chrono>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <deque>
+#include <map>
+#include <array>
+#include <random>
+#include <algorithm>
+#include <atomic>
 #include "httplib.h"
 #include "json.hpp"
+#include "connection_pool.hpp"
+#include "backend_pool.hpp"
+#include "metrics.hpp"
+#include "json_fields.hpp"
+#include "request_context.hpp"
+#include "token_count_cache.hpp"
+#include "embedding_matrix.hpp"
 
 namespace pooriayousefi
 {
@@ -43,24 +85,369 @@ namespace app
 
 using json = nlohmann::json;
 
+/**
+ * @brief Callback receiving each streamed token chunk
+ * 
+ * Return false to stop the stream (e.g., the downstream client went away);
+ * the upstream llama-server request is then cancelled.
+ */
+using TokenCallback = std::function<bool(const std::string& chunk)>;
+
+/**
+ * @brief Custom parser of a llama-server reply body
+ * 
+ * Lets a call read a large reply straight into its own storage (e.g.,
+ * embeddings into an EmbeddingMatrix) instead of building a JSON DOM.
+ * Runs only for the call whose reply is used, never for a hedged call
+ * that lost. Returns whatever small JSON the call hands back.
+ */
+using ReplyParser = std::function<json(const std::string& body)>;
+
+/**
+ * @struct SlotPin
+ * @brief llama-server slot a call is pinned to: a backend and a slot on it
+ */
+struct SlotPin
+{
+    int backend = -1;   ///< BackendPool index, -1 = not pinned
+    int slot = -1;      ///< id_slot on that backend
+    
+    bool pinned() const
+    {
+        return backend >= 0 && slot >= 0;
+    }
+};
+
+/**
+ * @struct CompletionParams
+ * @brief Sampling and prompt-cache parameters for llama-server requests
+ * 
+ * cache_prompt lets llama-server reuse the KV cache of a prompt prefix it
+ * has already evaluated in the chosen slot; id_slot pins the request to a
+ * specific slot (-1 lets llama-server pick one by prompt similarity).
+ * Slot ids are per llama-server: with backend set (see SlotAffinity),
+ * LlamaClient sends the request to that backend and adds id_slot there,
+ * or sends it unpinned to another backend if that one is unavailable.
+ * 
+ * The draft_* fields tune speculative decoding for one request when the
+ * llama-server runs a draft model (-md); left unset, its launch options
+ * apply. They change speed, not the generated text, so the response
+ * caches ignore them.
+ */
+struct CompletionParams
+{
+    int n_predict = 512;                                ///< Maximum tokens to generate
+    float temperature = 0.7f;                           ///< Sampling temperature
+    std::vector<std::string> stop = {"User:", "\n\n"};  ///< Stop sequences (/completion only)
+    bool cache_prompt = true;                           ///< Reuse KV cache for shared prefixes
+    int id_slot = -1;                                   ///< llama-server slot, -1 = any
+    int backend = -1;                                   ///< BackendPool index holding id_slot, -1 = any
+    int draft_max = -1;                                 ///< speculative.n_max, -1 = server setting
+    int draft_min = -1;                                 ///< speculative.n_min, -1 = server setting
+    float draft_p_min = -1.0f;                          ///< speculative.p_min, negative = server setting
+    
+    CompletionParams() = default;
+    
+    CompletionParams(int max_tokens, float temp)
+        : n_predict(max_tokens)
+        , temperature(temp)
+    {
+    }
+    
+    /**
+     * @brief Build the llama-server /completion request body
+     * 
+     * @param prompt Input text prompt
+     * @return JSON request body
+     */
+    json to_request(const std::string& prompt) const
+    {
+        json request = {
+            {"prompt", prompt},
+            {"n_predict", n_predict},
+            {"temperature", temperature},
+            {"stop", stop},
+            {"cache_prompt", cache_prompt}
+        };
+        
+        if (id_slot >= 0 && backend < 0)
+        {
+            request["id_slot"] = id_slot;
+        }
+        add_speculative(request);
+        
+        return request;
+    }
+    
+    /**
+     * @brief Backend and slot the request is pinned to
+     */
+    SlotPin pin() const
+    {
+        return backend >= 0 ? SlotPin{backend, id_slot} : SlotPin();
+    }
+    
+    /**
+     * @brief Add the draft_* overrides that are set to a request body
+     */
+    void add_speculative(json& request) const
+    {
+        if (draft_max >= 0)
+        {
+            request["speculative.n_max"] = draft_max;
+        }
+        if (draft_min >= 0)
+        {
+            request["speculative.n_min"] = draft_min;
+        }
+        if (draft_p_min >= 0.0f)
+        {
+            request["speculative.p_min"] = draft_p_min;
+        }
+    }
+    
+    /**
+     * @brief Build the /v1/chat/completions request body
+     * 
+     * The stop list is not sent; the model's chat template ends turns.
+     * 
+     * @param messages Array of message objects with "role" and "content"
+     * @return JSON request body
+     */
+    json to_chat_request(const json& messages) const
+    {
+        json request = {
+            {"messages", messages},
+            {"max_tokens", n_predict},
+            {"temperature", temperature},
+            {"cache_prompt", cache_prompt}
+        };
+        
+        if (id_slot >= 0 && backend < 0)
+        {
+            request["id_slot"] = id_slot;
+        }
+        add_speculative(request);
+        
+        return request;
+    }
+};
+
+/**
+ * @struct RetryPolicy
+ * @brief How LlamaClient retries and hedges llama-server calls
+ * 
+ * Only connection failures are retried (refused, reset, timed out), never
+ * error statuses or calls cancelled or past their deadline, and a stream
+ * only until its first event has been passed on. Retry n waits a random
+ * time between half and all of backoff_ms * 2^n, and is skipped if that
+ * would run past the request deadline.
+ * 
+ * With hedge set and more than one backend, a non-streamed call still
+ * running after the p95 latency of its endpoint (over its last 128 replies,
+ * at least hedge_min_ms) is sent again to another backend in rotation;
+ * the first reply wins and the other call is aborted. An endpoint is
+ * hedged once 20 of its calls have been timed.
+ */
+struct RetryPolicy
+{
+    int retries = 2;            ///< Retries after a connection failure
+    int backoff_ms = 100;       ///< Base delay of the exponential backoff
+    bool hedge = false;         ///< Duplicate slow calls on a second backend
+    int hedge_min_ms = 50;      ///< Shortest hedge delay
+};
+
+/**
+ * @brief Thrown when llama-server could not be reached or dropped the connection
+ */
+class ConnectionError : public std::runtime_error
+{
+public:
+    explicit ConnectionError(const std::string& message)
+        : std::runtime_error(message)
+    {
+    }
+};
+
+/**
+ * @brief Thrown when a prompt leaves too little of the context for an answer
+ */
+class ContextOverflow : public std::runtime_error
+{
+private:
+    size_t prompt_tokens_;
+    size_t context_size_;
+
+public:
+    ContextOverflow(size_t prompt_tokens, size_t context_size)
+        : std::runtime_error("Prompt of " + std::to_string(prompt_tokens)
+                             + " tokens does not fit the " + std::to_string(context_size) + "-token context")
+        , prompt_tokens_(prompt_tokens)
+        , context_size_(context_size)
+    {
+    }
+    
+    size_t prompt_tokens() const
+    {
+        return prompt_tokens_;
+    }
+    
+    size_t context_size() const
+    {
+        return context_size_;
+    }
+};
+
+/**
+ * @struct RerankResult
+ * @brief Relevance of one document to a query (llama-server /rerank)
+ */
+struct RerankResult
+{
+    size_t index;   ///< Position of the document in the input list
+    float score;    ///< Relevance score, higher is more relevant
+};
+
 /**
  * @class LlamaClient
  * @brief HTTP client for llama.cpp server communication
  * 
- * Provides a simple interface to communicate with a running llama-server instance.
- * All requests use JSON over HTTP protocol.
+ * Provides a simple interface to communicate with running llama-server instances.
+ * All requests use JSON over HTTP protocol. Methods are safe to call from
+ * many threads at once; each call leases its own pooled connection on the
+ * least loaded healthy backend.
  */
 class LlamaClient
 {
 private:
-    std::string host_;
-    int port_;
-    int timeout_seconds_;
+    std::unique_ptr<BackendPool> backends_; ///< llama-server instances and their connections
+    Metrics* metrics_ = nullptr;            ///< Optional stage timings sink (not owned)
+    RetryPolicy retry_;                     ///< Retries and hedging of llama-server calls
+    
+    /**
+     * @struct LatencyWindow
+     * @brief Recent latencies of one endpoint, for the hedge delay
+     */
+    struct LatencyWindow
+    {
+        static constexpr size_t SIZE = 128;         ///< Samples kept
+        static constexpr size_t MIN_SAMPLES = 20;   ///< Fewer give no estimate
+        
+        std::array<double, SIZE> samples{};
+        size_t count = 0;                           ///< Samples ever observed
+        double p95 = -1.0;                          ///< Refreshed every 8 samples, -1 = none yet
+        
+        void observe(double seconds)
+        {
+            samples[count % SIZE] = seconds;
+            count++;
+            
+            if (count >= MIN_SAMPLES && (count % 8 == 0 || count == MIN_SAMPLES))
+            {
+                size_t n = std::min(count, SIZE);
+                std::array<double, SIZE> sorted = samples;
+                auto nth = sorted.begin() + static_cast<std::ptrdiff_t>(std::min(n * 95 / 100, n - 1));
+                std::nth_element(sorted.begin(), nth, sorted.begin() + static_cast<std::ptrdiff_t>(n));
+                p95 = *nth;
+            }
+        }
+    };
+    
+    std::mutex latency_mutex_;
+    std::map<std::string, LatencyWindow, std::less<>> latencies_;   ///< Per endpoint (hedging only)
+    
+    TokenCountCache token_counts_;              ///< /tokenize results per text segment
+    std::atomic<int64_t> context_size_{-1};     ///< Per-slot n_ctx; -1 = not known yet, 0 = budgeting off
+    std::mutex props_mutex_;                    ///< Serializes /props queries
+    std::chrono::steady_clock::time_point props_retry_;  ///< No /props query before this
+    
+    size_t embedding_batch_size_ = 32;          ///< Inputs per /embedding or /rerank request
+    size_t embedding_batch_tokens_ = 2048;      ///< Estimated input tokens per request, 0 = no limit
+    
+    /**
+     * @struct HedgeRace
+     * @brief The two calls of a hedged request: the first success wins
+     * 
+     * The winner stops the other call's connection, which then fails and
+     * is dropped without counting against its backend.
+     */
+    struct HedgeRace
+    {
+        std::mutex mutex;
+        std::condition_variable primary_finished;
+        bool primary_done = false;
+        int winner = -1;                                    ///< Call that succeeded first
+        std::array<httplib::Client*, 2> clients{};          ///< Calls in flight
+        
+        /**
+         * @brief Register a call about to be sent
+         * 
+         * @return false if the other call has already won
+         */
+        bool enter(int call, httplib::Client* client)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (winner >= 0)
+            {
+                return false;
+            }
+            clients[call] = client;
+            return true;
+        }
+        
+        /**
+         * @brief Unregister a finished call, claiming the win on success
+         * 
+         * @return true if the other call won
+         */
+        bool leave(int call, bool succeeded)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            clients[call] = nullptr;
+            if (succeeded && winner < 0)
+            {
+                winner = call;
+                if (clients[1 - call])
+                {
+                    clients[1 - call]->stop();
+                }
+            }
+            return winner >= 0 && winner != call;
+        }
+    };
+    
+    /// Thrown by the call of a hedged request that lost the race
+    struct HedgeLost
+    {
+    };
+    
+    std::thread health_thread_;             ///< Periodic is_alive() probes (multi-backend only)
+    std::mutex health_mutex_;
+    std::condition_variable health_wake_;
+    bool stopping_ = false;
+    
+    /**
+     * @struct AsyncCall
+     * @brief Queued complete_async()/chat_async() call
+     */
+    struct AsyncCall
+    {
+        std::function<json(LlamaClient&)> call;
+        std::shared_ptr<std::promise<json>> promise;
+        std::shared_ptr<RequestContext> context;    ///< Submitter's deadline/cancellation
+    };
+    
+    std::vector<std::thread> async_workers_;  ///< Started on the first async call
+    size_t async_threads_ = 0;                ///< 0 = one per pooled connection
+    std::mutex async_mutex_;
+    std::condition_variable async_wake_;
+    std::deque<AsyncCall> async_queue_;
+    bool async_stopping_ = false;
     
     /**
      * @brief Parse URL into host and port
      */
-    void parse_url(const std::string& url)
+    static void parse_url(const std::string& url, std::string& host, int& port)
     {
         // Remove http:// or https:// prefix
         std::string clean_url = url;
@@ -77,167 +464,1735 @@ private:
         size_t colon_pos = clean_url.find(':');
         if (colon_pos != std::string::npos)
         {
-            host_ = clean_url.substr(0, colon_pos);
-            port_ = std::stoi(clean_url.substr(colon_pos + 1));
+            host = clean_url.substr(0, colon_pos);
+            port = std::stoi(clean_url.substr(colon_pos + 1));
         }
         else
         {
-            host_ = clean_url;
-            port_ = 8080; // Default port
+            host = clean_url;
+            port = 8080; // Default port
         }
     }
-
-public:
+    
     /**
-     * @brief Construct HTTP client for llama-server
+     * @brief Members of a /completion reply that callers use
      * 
-     * @param url Server URL (e.g., "http://localhost:8080")
-     * @param timeout Request timeout in seconds (default: 300)
+     * Everything else (notably the echoed "prompt" and the
+     * "generation_settings" block) is skipped while parsing.
      */
-    LlamaClient(const std::string& url, int timeout = 300)
-        : timeout_seconds_(timeout)
+    static const FieldList& completion_fields()
     {
-        parse_url(url);
+        static const FieldList fields = {
+            "content", "stop", "stopped_eos", "stopped_limit", "stopped_word",
+            "stopping_word", "tokens_predicted", "tokens_evaluated", "tokens_cached",
+            "truncated", "timings", "id_slot", "model", "completion_probabilities"
+        };
+        return fields;
     }
     
     /**
-     * @brief Generate text completion from prompt
+     * @brief Record generation metrics from a reply's "timings" block
      * 
-     * @param prompt Input text prompt
-     * @param max_tokens Maximum tokens to generate (default: 512)
-     * @param temperature Sampling temperature (default: 0.7)
-     * @return JSON response from llama-server
+     * Replies without timings (e.g., embeddings) are not generations and
+     * are skipped. For non-streamed replies the time to first token is
+     * estimated as wall time minus llama-server's token generation time.
      * 
-     * @throws std::runtime_error if request fails
+     * @param reply Parsed llama-server reply
+     * @param elapsed Wall time of the request in seconds
      */
-    json complete(const std::string& prompt, int max_tokens = 512, float temperature = 0.7)
+    void record_generation(const json& reply, double elapsed)
     {
-        json request = {
-            {"prompt", prompt},
-            {"n_predict", max_tokens},
-            {"temperature", temperature},
-            {"stop", json::array({"User:", "\n\n"})}
-        };
-        
-        httplib::Client client(host_, port_);
-        client.set_read_timeout(std::chrono::seconds(timeout_seconds_));
-        client.set_write_timeout(std::chrono::seconds(timeout_seconds_));
-        
-        std::string request_body = request.dump();
-        
-        auto res = client.Post("/completion", request_body, "application/json");
+        if (!metrics_)
+        {
+            return;
+        }
         
-        if (!res)
+        auto timings = reply.find("timings");
+        if (timings == reply.end() || !timings->is_object())
         {
-            throw std::runtime_error("HTTP request failed: connection error");
+            return;
         }
         
-        if (res->status != 200)
+        double predicted_seconds = timings->value("predicted_ms", 0.0) / 1000.0;
+        metrics_->generation.observe(elapsed);
+        metrics_->time_to_first_token.observe(std::max(elapsed - predicted_seconds, 0.0));
+        metrics_->observe_tokens_per_second(timings->value("predicted_per_second", 0.0));
+        metrics_->observe_draft(timings->value("draft_n", 0), timings->value("draft_n_accepted", 0));
+    }
+    
+    /**
+     * @brief Turn a failed transport call into the right exception
+     * 
+     * A call that failed because its request was cancelled or ran out of
+     * time is not the backend's fault, so the connection is only dropped.
+     */
+    [[noreturn]] static void throw_transport_error(BackendPool::Lease& client, const RequestContext* context)
+    {
+        if (context && context->cancelled())
         {
-            throw std::runtime_error("HTTP request failed with status: " + std::to_string(res->status));
+            client.discard();
+            throw RequestCancelled();
+        }
+        if (context && context->expired())
+        {
+            client.discard();
+            throw DeadlineExceeded();
         }
         
-        return json::parse(res->body);
+        client.fail();
+        throw ConnectionError("HTTP request failed: connection error");
     }
     
     /**
-     * @brief Chat completion (for instruction-tuned models)
+     * @brief Sleep before retry number attempt + 1
      * 
-     * @param messages Array of message objects with "role" and "content"
-     * @param max_tokens Maximum tokens to generate (default: 512)
-     * @param temperature Sampling temperature (default: 0.7)
-     * @return JSON response from llama-server
+     * Wakes up regularly to notice cancellation.
      * 
-     * @throws std::runtime_error if request fails
+     * @return false if the wait would run past the request deadline
+     * 
+     * @throws RequestCancelled if the request is cancelled while waiting
      */
-    json chat(const json& messages, int max_tokens = 512, float temperature = 0.7)
+    bool back_off(int attempt, const RequestContext* context)
     {
-        json request = {
-            {"messages", messages},
-            {"max_tokens", max_tokens},
-            {"temperature", temperature}
-        };
+        thread_local std::minstd_rand random(std::random_device{}());
         
-        httplib::Client client(host_, port_);
-        client.set_read_timeout(std::chrono::seconds(timeout_seconds_));
-        client.set_write_timeout(std::chrono::seconds(timeout_seconds_));
+        int64_t ceiling = static_cast<int64_t>(std::max(retry_.backoff_ms, 0)) << std::min(attempt, 10);
+        std::uniform_int_distribution<int64_t> jitter(ceiling / 2, ceiling);
+        auto delay = std::chrono::milliseconds(jitter(random));
         
-        std::string request_body = request.dump();
+        if (context && context->remaining() <= delay)
+        {
+            return false;
+        }
         
-        auto res = client.Post("/v1/chat/completions", request_body, "application/json");
+        if (metrics_)
+        {
+            metrics_->upstream_retries.fetch_add(1, std::memory_order_relaxed);
+        }
         
-        if (!res)
+        auto until = std::chrono::steady_clock::now() + delay;
+        for (auto now = std::chrono::steady_clock::now(); now < until; now = std::chrono::steady_clock::now())
         {
-            throw std::runtime_error("HTTP request failed: connection error");
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(until - now, RequestContext::POLL_INTERVAL));
+            if (context)
+            {
+                context->check();
+            }
         }
+        return true;
+    }
+    
+    /**
+     * @brief Time a call to path may run before it is hedged
+     * 
+     * @return Delay in seconds, or a negative value if there are too few samples
+     */
+    double hedge_delay(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(latency_mutex_);
         
-        if (res->status != 200)
+        auto it = latencies_.find(path);
+        if (it == latencies_.end() || it->second.p95 < 0.0)
         {
-            throw std::runtime_error("HTTP request failed with status: " + std::to_string(res->status));
+            return -1.0;
         }
+        return std::max(it->second.p95, retry_.hedge_min_ms / 1000.0);
+    }
+    
+    void observe_latency(const std::string& path, double seconds)
+    {
+        std::lock_guard<std::mutex> lock(latency_mutex_);
         
-        return json::parse(res->body);
+        auto it = latencies_.find(path);
+        if (it == latencies_.end())
+        {
+            it = latencies_.emplace(path, LatencyWindow()).first;
+        }
+        it->second.observe(seconds);
     }
     
     /**
-     * @brief Check if server is alive and responding
+     * @brief POST a JSON body over a pooled connection
      * 
-     * @return true if server responds to health check
+     * @param path Endpoint path (e.g., "/completion")
+     * @param request JSON request body
+     * @return Parsed JSON response
+     * 
+     * @throws std::runtime_error if request fails
      */
-    bool is_alive()
+    json post(const std::string& path, const json& request)
     {
-        try
+        return post(path, request.dump());
+    }
+    
+    /**
+     * @brief POST an already serialized JSON body over a pooled connection
+     * 
+     * Connection failures are retried and slow calls hedged per the
+     * RetryPolicy.
+     * 
+     * @param path Endpoint path (e.g., "/completion")
+     * @param request_body Serialized JSON request body
+     * @param fields If set, only these top-level members of the reply are
+     *               materialized (see json_fields.hpp)
+     * @param parser If set, parses the reply body instead of fields
+     * @param pin Backend slot to pin the call to (see acquire_for())
+     * @return Parsed JSON response
+     * 
+     * @throws std::runtime_error if request fails (ConnectionError once the
+     *         retries are used up); DeadlineExceeded or RequestCancelled per
+     *         the calling thread's RequestContext; BackendUnavailable if
+     *         every backend's circuit is open
+     */
+    json post(const std::string& path, const std::string& request_body, const FieldList* fields = nullptr,
+              const ReplyParser* parser = nullptr, const SlotPin& pin = SlotPin())
+    {
+        auto context = RequestContext::current();
+        
+        for (int attempt = 0; ; attempt++)
         {
-            httplib::Client client(host_, port_);
-            client.set_read_timeout(std::chrono::seconds(5));
-            client.set_write_timeout(std::chrono::seconds(5));
-            
-            auto res = client.Get("/health");
+            if (context)
+            {
+                context->check();
+            }
             
-            return (res && res->status == 200);
+            try
+            {
+                if (retry_.hedge && backends_->size() > 1)
+                {
+                    return post_hedged(path, request_body, fields, parser, context.get(), pin);
+                }
+                
+                std::string pinned_body;
+                auto client = acquire_for(pin, request_body, pinned_body);
+                return post_on(client, path, pinned_body.empty() ? request_body : pinned_body,
+                               fields, parser, context.get());
+            }
+            catch (const ConnectionError&)
+            {
+                if (attempt >= retry_.retries || !back_off(attempt, context.get()))
+                {
+                    throw;
+                }
+            }
         }
-        catch (...)
+    }
+    
+    /**
+     * @brief Lease a connection for a call, on its pinned backend if possible
+     * 
+     * The pinned backend serves the call while it is in rotation and its
+     * circuit admits it; pinned_body is then request_body with id_slot
+     * added. Otherwise the least loaded backend serves the call unpinned and
+     * pinned_body stays empty: the slot id means nothing on another
+     * llama-server.
+     */
+    BackendPool::Lease acquire_for(const SlotPin& pin, const std::string& request_body, std::string& pinned_body)
+    {
+        pinned_body.clear();
+        if (pin.pinned())
         {
-            return false;
+            if (auto lease = backends_->acquire_pinned(static_cast<size_t>(pin.backend)))
+            {
+                pinned_body.reserve(request_body.size() + 16);
+                pinned_body += "{\"id_slot\":";
+                pinned_body += std::to_string(pin.slot);
+                if (request_body.size() > 2)
+                {
+                    pinned_body += ',';
+                }
+                pinned_body.append(request_body, 1, std::string::npos);
+                return std::move(*lease);
+            }
         }
+        return backends_->acquire();
     }
     
     /**
-     * @brief Get available models from server
+     * @brief Send one POST on a leased connection
      * 
-     * @return JSON response containing model information
+     * @param race Hedged request this call is part of, or nullptr
+     * @param call Index of this call in the race (0 = primary)
      * 
-     * @throws std::runtime_error if request fails
+     * @throws HedgeLost if the other call of the race won
      */
-    json get_models()
+    json post_on(BackendPool::Lease& client, const std::string& path, const std::string& request_body,
+                 const FieldList* fields, const ReplyParser* parser, RequestContext* context,
+                 HedgeRace* race = nullptr, int call = 0)
     {
-        httplib::Client client(host_, port_);
-        client.set_read_timeout(std::chrono::seconds(timeout_seconds_));
-        client.set_write_timeout(std::chrono::seconds(timeout_seconds_));
+        auto start = Metrics::Clock::now();
         
-        auto res = client.Get("/v1/models");
+        httplib::Result res;
+        bool lost = false;
+        {
+            RequestContext::Upstream upstream(context, &*client);
+            if (race && !race->enter(call, &*client))
+            {
+                throw HedgeLost();
+            }
+            res = client->Post(path, request_body, "application/json");
+            lost = race && race->leave(call, res && res->status == 200);
+        }
+        
+        if (lost)
+        {
+            if (!res)
+            {
+                client.discard();
+            }
+            throw HedgeLost();
+        }
         
         if (!res)
         {
-            throw std::runtime_error("HTTP request failed: connection error");
+            throw_transport_error(client, context);
         }
         
         if (res->status != 200)
         {
-            throw std::runtime_error("Failed to get models, status: " + std::to_string(res->status));
+            throw std::runtime_error("HTTP request failed with status: " + std::to_string(res->status));
         }
         
-        return json::parse(res->body);
+        double elapsed = Metrics::seconds_since(start);
+        json reply = parser ? (*parser)(res->body)
+                   : fields ? extract_fields(res->body, *fields)
+                   : json::parse(res->body);
+        record_generation(reply, elapsed);
+        
+        // The call that answered, not the hedged total: totals already
+        // cut off at the hedge delay would drag the estimate upwards
+        if (retry_.hedge)
+        {
+            observe_latency(path, elapsed);
+        }
+        
+        return reply;
     }
     
     /**
-     * @brief Get server URL
+     * @brief POST with a duplicate on a second backend if the first is slow
      * 
-     * @return Server URL as string
+     * The primary call runs on the calling thread. A helper thread waits
+     * for the hedge delay and, if the primary has not finished by then,
+     * sends the same body to another backend. The first success is
+     * returned; the primary's error is thrown only if the duplicate (when
+     * sent) failed too. A pinned primary's duplicate goes out unpinned.
      */
-    std::string get_server_url() const
+    json post_hedged(const std::string& path, const std::string& request_body,
+                     const FieldList* fields, const ReplyParser* parser, RequestContext* context,
+                     const SlotPin& pin)
+    {
+        std::string pinned_body;
+        auto primary = acquire_for(pin, request_body, pinned_body);
+        const std::string& primary_body = pinned_body.empty() ? request_body : pinned_body;
+        
+        double delay = hedge_delay(path);
+        if (delay < 0.0)
+        {
+            return post_on(primary, path, primary_body, fields, parser, context);
+        }
+        
+        HedgeRace race;
+        json hedge_reply;
+        bool hedge_won = false;
+        std::exception_ptr hedge_error;
+        
+        std::thread hedger([&]
+        {
+            {
+                std::unique_lock<std::mutex> lock(race.mutex);
+                if (race.primary_finished.wait_for(lock, std::chrono::duration<double>(delay),
+                                                   [&race] { return race.primary_done; }))
+                {
+                    return;
+                }
+            }
+            
+            try
+            {
+                auto second = backends_->acquire_other(primary.backend());
+                if (!second)
+                {
+                    return;
+                }
+                
+                if (metrics_)
+                {
+                    metrics_->hedges_sent.fetch_add(1, std::memory_order_relaxed);
+                }
+                hedge_reply = post_on(*second, path, request_body, fields, parser, context, &race, 1);
+                hedge_won = true;
+            }
+            catch (const HedgeLost&)
+            {
+            }
+            catch (...)
+            {
+                hedge_error = std::current_exception();
+            }
+        });
+        
+        json reply;
+        std::exception_ptr error;
+        bool primary_lost = false;
+        try
+        {
+            reply = post_on(primary, path, primary_body, fields, parser, context, &race, 0);
+        }
+        catch (const HedgeLost&)
+        {
+            primary_lost = true;
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(race.mutex);
+            race.primary_done = true;
+        }
+        race.primary_finished.notify_all();
+        hedger.join();
+        
+        if (hedge_won)
+        {
+            if (metrics_)
+            {
+                metrics_->hedges_won.fetch_add(1, std::memory_order_relaxed);
+            }
+            reply = std::move(hedge_reply);
+        }
+        else if (error)
+        {
+            std::rethrow_exception(error);
+        }
+        else if (primary_lost)
+        {
+            // The duplicate answered first but its reply was unusable
+            std::rethrow_exception(hedge_error);
+        }
+        
+        return reply;
+    }
+
+    /**
+     * @brief POST a JSON body and consume a Server-Sent Events reply
+     * 
+     * Splits the response into "data: ..." events as bytes arrive and hands
+     * each decoded event to on_event. Stops at "data: [DONE]" or when
+     * on_event returns false. A connection failure before the first event
+     * is retried per the RetryPolicy; streams are never hedged.
+     * 
+     * @param path Endpoint path
+     * @param request JSON request body (must set "stream": true)
+     * @param on_event Called with each decoded event; return false to cancel
+     * @param pin Backend slot to pin the call to (see acquire_for())
+     * 
+     * @throws std::runtime_error if request fails or llama-server reports an error
+     */
+    void post_stream(const std::string& path, const json& request,
+                     const std::function<bool(const json&)>& on_event, const SlotPin& pin = SlotPin())
+    {
+        auto context = RequestContext::current();
+        std::string request_body = request.dump();
+        bool delivered = false;
+        
+        for (int attempt = 0; ; attempt++)
+        {
+            if (context)
+            {
+                context->check();
+            }
+            
+            try
+            {
+                post_stream_once(path, request_body, on_event, context.get(), delivered, pin);
+                return;
+            }
+            catch (const ConnectionError&)
+            {
+                // Tokens already passed on cannot be taken back
+                if (delivered || attempt >= retry_.retries || !back_off(attempt, context.get()))
+                {
+                    throw;
+                }
+            }
+        }
+    }
+    
+    /**
+     * @brief One attempt of post_stream()
+     * 
+     * @param delivered Set once an event has been passed to on_event
+     */
+    void post_stream_once(const std::string& path, const std::string& request_body,
+                          const std::function<bool(const json&)>& on_event,
+                          RequestContext* context, bool& delivered, const SlotPin& pin)
+    {
+        auto start = Metrics::Clock::now();
+        std::string pinned_body;
+        auto client = acquire_for(pin, request_body, pinned_body);
+        RequestContext::Upstream upstream(context, &*client);
+        
+        std::string buffer;
+        bool finished = false;
+        bool cancelled = false;
+        bool first_event = true;
+        double predicted_per_second = 0.0;
+        int64_t draft_n = 0;
+        int64_t draft_n_accepted = 0;
+        std::string stream_error;
+        
+        httplib::Headers headers = {{"Accept", "text/event-stream"}};
+        
+        auto res = client->Post(path, headers, pinned_body.empty() ? request_body : pinned_body, "application/json",
+            [&](const char* data, size_t length)
+            {
+                if (finished)
+                {
+                    return true;
+                }
+                
+                if (context && context->cancelled())
+                {
+                    return false;
+                }
+                
+                buffer.append(data, length);
+                
+                size_t line_start = 0;
+                size_t line_end;
+                while ((line_end = buffer.find('\n', line_start)) != std::string::npos)
+                {
+                    std::string line = buffer.substr(line_start, line_end - line_start);
+                    line_start = line_end + 1;
+                    
+                    if (!line.empty() && line.back() == '\r')
+                    {
+                        line.pop_back();
+                    }
+                    
+                    if (line.compare(0, 5, "data:") != 0)
+                    {
+                        continue;
+                    }
+                    
+                    std::string payload = line.substr(line.size() > 5 && line[5] == ' ' ? 6 : 5);
+                    if (payload == "[DONE]")
+                    {
+                        finished = true;
+                        break;
+                    }
+                    
+                    json event = json::parse(payload, nullptr, false);
+                    if (event.is_discarded())
+                    {
+                        continue;
+                    }
+                    
+                    if (event.contains("error"))
+                    {
+                        stream_error = event["error"].is_object()
+                            ? event["error"].value("message", event["error"].dump())
+                            : event["error"].dump();
+                        return false;
+                    }
+                    
+                    if (metrics_)
+                    {
+                        if (first_event)
+                        {
+                            first_event = false;
+                            metrics_->time_to_first_token.observe(Metrics::seconds_since(start));
+                        }
+                        
+                        auto timings = event.find("timings");
+                        if (timings != event.end() && timings->is_object())
+                        {
+                            predicted_per_second = timings->value("predicted_per_second", 0.0);
+                            draft_n = timings->value("draft_n", 0);
+                            draft_n_accepted = timings->value("draft_n_accepted", 0);
+                        }
+                    }
+                    
+                    delivered = true;
+                    if (!on_event(event))
+                    {
+                        cancelled = true;
+                        return false;
+                    }
+                }
+                
+                buffer.erase(0, line_start);
+                return true;
+            });
+        
+        if (!stream_error.empty())
+        {
+            client.discard();
+            throw std::runtime_error("llama-server stream error: " + stream_error);
+        }
+        
+        if (cancelled)
+        {
+            // Connection state is unknown after an aborted read
+            client.discard();
+            return;
+        }
+        
+        if (!res)
+        {
+            throw_transport_error(client, context);
+        }
+        
+        if (res->status != 200)
+        {
+            throw std::runtime_error("HTTP request failed with status: " + std::to_string(res->status));
+        }
+        
+        if (metrics_)
+        {
+            metrics_->generation.observe(Metrics::seconds_since(start));
+            metrics_->observe_tokens_per_second(predicted_per_second);
+            metrics_->observe_draft(draft_n, draft_n_accepted);
+        }
+    }
+    
+    /**
+     * @brief Probe every backend periodically until stopped
+     */
+    void health_loop(int interval_seconds)
+    {
+        std::unique_lock<std::mutex> lock(health_mutex_);
+        
+        while (!health_wake_.wait_for(lock, std::chrono::seconds(interval_seconds), [this] { return stopping_; }))
+        {
+            lock.unlock();
+            is_alive();
+            lock.lock();
+        }
+    }
+
+    /**
+     * @brief Run queued async calls until stopped
+     */
+    void async_loop()
+    {
+        std::unique_lock<std::mutex> lock(async_mutex_);
+        
+        while (true)
+        {
+            async_wake_.wait(lock, [this] { return async_stopping_ || !async_queue_.empty(); });
+            if (async_stopping_)
+            {
+                return;
+            }
+            
+            AsyncCall pending = std::move(async_queue_.front());
+            async_queue_.pop_front();
+            lock.unlock();
+            
+            try
+            {
+                // Calls whose request is already gone never reach llama-server
+                if (pending.context)
+                {
+                    pending.context->check();
+                }
+                RequestContext::Scope scope(std::move(pending.context));
+                pending.promise->set_value(pending.call(*this));
+            }
+            catch (...)
+            {
+                pending.promise->set_exception(std::current_exception());
+            }
+            
+            lock.lock();
+        }
+    }
+    
+    /**
+     * @brief Split inputs into [begin, end) chunks of one request each
+     * 
+     * A chunk ends at embedding_batch_size_ inputs or when its estimated
+     * tokens would pass embedding_batch_tokens_. The estimate is ~4 bytes
+     * per token: measuring each input with /tokenize would cost as many
+     * requests as batching saves. An input over the token limit gets a
+     * chunk of its own.
+     * 
+     * @param texts Inputs
+     * @param extra_bytes Bytes sent along with each input (e.g., the query)
+     */
+    std::vector<std::pair<size_t, size_t>> batch_ranges(const std::vector<std::string>& texts,
+                                                        size_t extra_bytes) const
+    {
+        std::vector<std::pair<size_t, size_t>> ranges;
+        size_t begin = 0;
+        size_t tokens = 0;
+        
+        for (size_t i = 0; i < texts.size(); i++)
+        {
+            size_t estimate = (texts[i].size() + extra_bytes) / 4 + 1;
+            bool full = i - begin >= embedding_batch_size_
+                        || (embedding_batch_tokens_ > 0 && tokens + estimate > embedding_batch_tokens_);
+            if (i > begin && full)
+            {
+                ranges.emplace_back(begin, i);
+                begin = i;
+                tokens = 0;
+            }
+            tokens += estimate;
+        }
+        ranges.emplace_back(begin, texts.size());
+        
+        return ranges;
+    }
+    
+    /**
+     * @brief Serialized /embedding request for a chunk of inputs
+     */
+    static std::string embedding_request(const std::vector<std::string>& texts, std::pair<size_t, size_t> range)
+    {
+        json content = json::array();
+        for (size_t i = range.first; i < range.second; i++)
+        {
+            content.push_back(texts[i]);
+        }
+        return json{{"content", std::move(content)}}.dump();
+    }
+    
+    /**
+     * @brief POST one /embedding chunk and read it into its matrix rows
+     */
+    void post_embeddings(const std::string& request_body, EmbeddingMatrix& out, std::pair<size_t, size_t> range)
+    {
+        ReplyParser parser = [&out, range](const std::string& body)
+        {
+            read_embeddings(body, out, range.first, range.second - range.first);
+            return json::object();
+        };
+        post("/embedding", request_body, nullptr, &parser);
+    }
+
+public:
+    /**
+     * @brief Construct HTTP client for a single llama-server
+     * 
+     * @param url Server URL (e.g., "http://localhost:8080")
+     * @param timeout Request timeout in seconds (default: 300)
+     * @param pool_size Maximum keep-alive connections (default: 8)
+     * @param pool_idle_timeout Seconds before an idle connection is closed (default: 60)
+     */
+    LlamaClient(const std::string& url, int timeout = 300,
+                size_t pool_size = 8, int pool_idle_timeout = 60)
+        : backends_(std::make_unique<BackendPool>(pool_size, pool_idle_timeout, timeout))
+    {
+        std::string host;
+        int port = 0;
+        parse_url(url, host, port);
+        backends_->add(host, port);
+    }
+    
+    /**
+     * @brief Construct HTTP client balancing over several llama-servers
+     * 
+     * With more than one backend, a background thread calls is_alive()
+     * every health_interval seconds to eject dead backends and re-admit
+     * recovered ones.
+     * 
+     * @param backends Registered backends (see BackendPool::add())
+     * @param health_interval Seconds between health probes, 0 disables (default: 5)
+     */
+    explicit LlamaClient(std::unique_ptr<BackendPool> backends, int health_interval = 5)
+        : backends_(std::move(backends))
+    {
+        if (backends_->size() == 0)
+        {
+            throw std::runtime_error("LlamaClient needs at least one backend");
+        }
+        
+        if (backends_->size() > 1 && health_interval > 0)
+        {
+            health_thread_ = std::thread([this, health_interval] { health_loop(health_interval); });
+        }
+    }
+    
+    LlamaClient(const LlamaClient&) = delete;
+    LlamaClient& operator=(const LlamaClient&) = delete;
+    
+    /**
+     * @brief Stop the health probe and async I/O threads
+     * 
+     * Async calls still queued fail with std::future_error (broken promise).
+     */
+    ~LlamaClient()
+    {
+        {
+            std::lock_guard<std::mutex> lock(health_mutex_);
+            stopping_ = true;
+        }
+        health_wake_.notify_all();
+        
+        if (health_thread_.joinable())
+        {
+            health_thread_.join();
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(async_mutex_);
+            async_stopping_ = true;
+            async_queue_.clear();
+        }
+        async_wake_.notify_all();
+        
+        for (auto& worker : async_workers_)
+        {
+            worker.join();
+        }
+    }
+    
+    /**
+     * @brief Generate text completion from prompt
+     * 
+     * @param prompt Input text prompt
+     * @param max_tokens Maximum tokens to generate (default: 512)
+     * @param temperature Sampling temperature (default: 0.7)
+     * @return JSON response from llama-server
+     * 
+     * @throws std::runtime_error if request fails
+     */
+    json complete(const std::string& prompt, int max_tokens = 512, float temperature = 0.7)
+    {
+        return complete(prompt, CompletionParams(max_tokens, temperature));
+    }
+    
+    /**
+     * @brief Generate text completion with explicit sampling parameters
+     * 
+     * The reply is parsed lazily: the echoed "prompt" and the
+     * "generation_settings" block are skipped, which matters for large
+     * inputs (see completion_fields()).
+     * 
+     * @param prompt Input text prompt
+     * @param params Sampling parameters
+     * @return JSON response from llama-server (selected fields)
+     * 
+     * @throws std::runtime_error if request fails
+     */
+    json complete(const std::string& prompt, const CompletionParams& params)
+    {
+        return post("/completion", params.to_request(prompt).dump(), &completion_fields(), nullptr, params.pin());
+    }
+    
+    /**
+     * @brief Chat completion (for instruction-tuned models)
+     * 
+     * @param messages Array of message objects with "role" and "content"
+     * @param max_tokens Maximum tokens to generate (default: 512)
+     * @param temperature Sampling temperature (default: 0.7)
+     * @return JSON response from llama-server
+     * 
+     * @throws std::runtime_error if request fails
+     */
+    json chat(const json& messages, int max_tokens = 512, float temperature = 0.7)
+    {
+        return chat(messages, CompletionParams(max_tokens, temperature));
+    }
+    
+    /**
+     * @brief Chat completion with explicit sampling parameters
+     * 
+     * @param messages Array of message objects with "role" and "content"
+     * @param params Sampling parameters (stop list is ignored)
+     * @return JSON response from llama-server
+     * 
+     * @throws std::runtime_error if request fails
+     */
+    json chat(const json& messages, const CompletionParams& params)
+    {
+        return post("/v1/chat/completions", params.to_chat_request(messages).dump(), nullptr, nullptr, params.pin());
+    }
+    
+    /**
+     * @brief Chat completion from a pre-serialized messages array
+     * 
+     * Splices messages_json into the request body as-is, so callers that
+     * keep history serialized (see session_store.hpp) avoid building a
+     * JSON DOM of the whole conversation every turn.
+     * 
+     * @param messages_json JSON array text of message objects
+     * @param params Sampling parameters (stop list is ignored)
+     * @return JSON response from llama-server
+     * 
+     * @throws std::runtime_error if request fails
+     */
+    json chat_serialized(const std::string& messages_json, const CompletionParams& params)
+    {
+        json request = params.to_chat_request(json::array());
+        request.erase("messages");
+        
+        std::string fields = request.dump();
+        std::string request_body;
+        request_body.reserve(messages_json.size() + fields.size() + 16);
+        request_body += "{\"messages\":";
+        request_body += messages_json;
+        request_body += ',';
+        request_body.append(fields, 1, std::string::npos);
+        
+        return post("/v1/chat/completions", request_body, nullptr, nullptr, params.pin());
+    }
+    
+    /**
+     * @brief Embeddings of many texts (llama-server /embedding)
+     * 
+     * Sends the texts in chunks of one request each (see
+     * set_embedding_batch()). The first chunk goes out alone and fixes the
+     * dimension; the others are then in flight at once on the async I/O
+     * threads and read straight into their rows of the result. The server
+     * must be started with --embeddings; per-token embeddings
+     * (--pooling none) are mean-pooled.
+     * 
+     * @param texts Input texts
+     * @param normalize Scale rows to unit length, so dot products are cosines
+     * @return One row per text, in input order
+     * 
+     * @throws std::runtime_error if a request fails or a reply does not hold
+     *         one embedding per input
+     */
+    EmbeddingMatrix embed_batch(const std::vector<std::string>& texts, bool normalize = false)
+    {
+        // Shared with the async calls, which may outlive a caller whose
+        // deadline ran out
+        auto out = std::make_shared<EmbeddingMatrix>();
+        out->rows = texts.size();
+        if (texts.empty())
+        {
+            return std::move(*out);
+        }
+        
+        auto ranges = batch_ranges(texts, 0);
+        post_embeddings(embedding_request(texts, ranges.front()), *out, ranges.front());
+        
+        std::vector<std::shared_future<json>> chunks;
+        chunks.reserve(ranges.size() - 1);
+        for (size_t i = 1; i < ranges.size(); i++)
+        {
+            auto range = ranges[i];
+            chunks.push_back(submit_async([out, range, body = embedding_request(texts, range)](LlamaClient& client)
+            {
+                client.post_embeddings(body, *out, range);
+                return json();
+            }));
+        }
+        wait_all(chunks);
+        
+        if (normalize)
+        {
+            out->normalize();
+        }
+        return std::move(*out);
+    }
+    
+    /**
+     * @brief Embedding vector of one text
+     * 
+     * @param text Input text
+     * @param normalize Scale to unit length
+     * @return Embedding, not normalized unless asked
+     * 
+     * @throws std::runtime_error if the request fails or the reply has no embedding
+     */
+    std::vector<float> embed(const std::string& text, bool normalize = false)
+    {
+        EmbeddingMatrix matrix = embed_batch({text}, normalize);
+        return std::move(matrix.data);
+    }
+    
+    /**
+     * @brief Embedding vector of a text (same as embed())
+     */
+    std::vector<float> embedding(const std::string& text)
+    {
+        return embed(text);
+    }
+    
+    /**
+     * @brief Rank documents by relevance to a query (llama-server /rerank)
+     * 
+     * Needs a reranking model and a server started with --reranking.
+     * Documents are sent in chunks like embed_batch(), each chunk with the
+     * query, and the scores merged.
+     * 
+     * @param query Query text
+     * @param documents Candidate documents
+     * @param top_n Best results kept, 0 = all
+     * @return Results, most relevant first
+     * 
+     * @throws std::runtime_error if a request fails or a reply has no results
+     */
+    std::vector<RerankResult> rerank(const std::string& query, const std::vector<std::string>& documents,
+                                     size_t top_n = 0)
+    {
+        static const FieldList fields = {"results"};
+        
+        std::vector<RerankResult> results;
+        if (documents.empty())
+        {
+            return results;
+        }
+        
+        auto ranges = batch_ranges(documents, query.size());
+        std::vector<std::string> bodies;
+        bodies.reserve(ranges.size());
+        for (const auto& range : ranges)
+        {
+            json request = {{"query", query}, {"documents", json::array()}};
+            for (size_t i = range.first; i < range.second; i++)
+            {
+                request["documents"].push_back(documents[i]);
+            }
+            // The overall best are among the best of each chunk
+            if (top_n > 0)
+            {
+                request["top_n"] = std::min(top_n, range.second - range.first);
+            }
+            bodies.push_back(request.dump());
+        }
+        
+        std::vector<json> replies;
+        if (bodies.size() == 1)
+        {
+            replies.push_back(post("/rerank", bodies.front(), &fields));
+        }
+        else
+        {
+            std::vector<std::shared_future<json>> chunks;
+            chunks.reserve(bodies.size());
+            for (auto& body : bodies)
+            {
+                chunks.push_back(submit_async([body = std::move(body)](LlamaClient& client)
+                {
+                    return client.post("/rerank", body, &fields);
+                }));
+            }
+            replies = wait_all(chunks);
+        }
+        
+        for (size_t chunk = 0; chunk < replies.size(); chunk++)
+        {
+            auto items = replies[chunk].find("results");
+            if (items == replies[chunk].end() || !items->is_array())
+            {
+                throw std::runtime_error("llama-server reply has no rerank results");
+            }
+            
+            size_t count = ranges[chunk].second - ranges[chunk].first;
+            for (const auto& item : *items)
+            {
+                size_t index = item.value("index", count);
+                if (index >= count)
+                {
+                    throw std::runtime_error("llama-server reply has rerank index out of range");
+                }
+                float score = item.contains("relevance_score") ? item.value("relevance_score", 0.0f)
+                                                               : item.value("score", 0.0f);
+                results.push_back({ranges[chunk].first + index, score});
+            }
+        }
+        
+        std::sort(results.begin(), results.end(), [](const RerankResult& a, const RerankResult& b)
+        {
+            return a.score != b.score ? a.score > b.score : a.index < b.index;
+        });
+        if (top_n > 0 && results.size() > top_n)
+        {
+            results.resize(top_n);
+        }
+        return results;
+    }
+    
+    /**
+     * @brief Set how inputs of embed_batch() and rerank() are chunked
+     * 
+     * Match llama-server's batch: with the default -b 2048 all inputs of
+     * a request are decoded together when they fit 2048 tokens.
+     * 
+     * @param inputs Inputs per request, at least 1 (default: 32)
+     * @param tokens Estimated input tokens per request, 0 = no limit (default: 2048)
+     */
+    void set_embedding_batch(size_t inputs, size_t tokens)
+    {
+        embedding_batch_size_ = std::max<size_t>(inputs, 1);
+        embedding_batch_tokens_ = tokens;
+    }
+    
+    /**
+     * @brief Tokenize text with the model's tokenizer (llama-server /tokenize)
+     * 
+     * @param text Input text
+     * @return Token ids, without BOS/EOS
+     * 
+     * @throws std::runtime_error if the request fails
+     */
+    std::vector<int32_t> tokenize(const std::string& text)
+    {
+        json reply = post("/tokenize", json{{"content", text}, {"add_special", false}});
+        
+        auto tokens = reply.find("tokens");
+        if (tokens == reply.end() || !tokens->is_array())
+        {
+            throw std::runtime_error("llama-server reply has no tokens");
+        }
+        return tokens->get<std::vector<int32_t>>();
+    }
+    
+    /**
+     * @brief Turn token ids back into text (llama-server /detokenize)
+     * 
+     * @throws std::runtime_error if the request fails
+     */
+    std::string detokenize(const std::vector<int32_t>& tokens)
+    {
+        json reply = post("/detokenize", json{{"tokens", tokens}});
+        return reply.value("content", "");
+    }
+    
+    /**
+     * @brief Number of tokens in a text segment
+     * 
+     * Each distinct segment is tokenized once; later calls are answered
+     * from the cache. Count the parts of a prompt that recur (system
+     * prompt, instructions, earlier turns) separately to benefit.
+     * 
+     * @param text Text segment
+     * @return Token count, without BOS/EOS
+     * 
+     * @throws std::runtime_error if the request fails
+     */
+    size_t count_tokens(const std::string& text)
+    {
+        if (text.empty())
+        {
+            return 0;
+        }
+        
+        if (auto cached = token_counts_.find(text))
+        {
+            return *cached;
+        }
+        
+        size_t tokens = tokenize(text).size();
+        token_counts_.insert(text, tokens);
+        return tokens;
+    }
+    
+    /**
+     * @brief Cut text to at most max_tokens tokens
+     * 
+     * @param text Input text
+     * @param max_tokens Tokens to keep
+     * @param keep_end Keep the last tokens instead of the first
+     * @return text itself if it fits, else the kept tokens detokenized
+     * 
+     * @throws std::runtime_error if a request fails
+     */
+    std::string truncate_to_tokens(const std::string& text, size_t max_tokens, bool keep_end = false)
+    {
+        if (count_tokens(text) <= max_tokens)
+        {
+            return text;
+        }
+        
+        std::vector<int32_t> ids = tokenize(text);
+        if (keep_end)
+        {
+            ids.erase(ids.begin(), ids.end() - static_cast<std::ptrdiff_t>(std::min(max_tokens, ids.size())));
+        }
+        else
+        {
+            ids.resize(std::min(max_tokens, ids.size()));
+        }
+        
+        std::string kept = detokenize(ids);
+        token_counts_.insert(kept, ids.size());
+        return kept;
+    }
+    
+    /**
+     * @brief Per-slot context size (n_ctx) of the llama-server
+     * 
+     * Read once from /props (default_generation_settings.n_ctx) unless set
+     * with set_context_size(); a failed query is retried at most every 30
+     * seconds. All backends are assumed to run the same configuration.
+     * 
+     * @return Tokens per slot, 0 if unknown or budgeting is off
+     */
+    size_t context_size()
+    {
+        int64_t known = context_size_.load(std::memory_order_relaxed);
+        if (known >= 0)
+        {
+            return static_cast<size_t>(known);
+        }
+        
+        std::lock_guard<std::mutex> lock(props_mutex_);
+        known = context_size_.load(std::memory_order_relaxed);
+        if (known >= 0 || std::chrono::steady_clock::now() < props_retry_)
+        {
+            return static_cast<size_t>(std::max<int64_t>(known, 0));
+        }
+        
+        int64_t n_ctx = 0;
+        try
+        {
+            auto client = backends_->acquire();
+            auto res = client->Get("/props");
+            
+            if (!res)
+            {
+                client.discard();
+            }
+            else if (res->status == 200)
+            {
+                json props = json::parse(res->body, nullptr, false);
+                auto settings = props.is_object() ? props.find("default_generation_settings") : props.end();
+                if (settings != props.end() && settings->is_object())
+                {
+                    n_ctx = settings->value("n_ctx", int64_t(0));
+                }
+                else if (props.is_object())
+                {
+                    n_ctx = props.value("n_ctx", int64_t(0));
+                }
+            }
+        }
+        catch (const std::exception&)
+        {
+            n_ctx = 0;
+        }
+        
+        if (n_ctx > 0)
+        {
+            context_size_.store(n_ctx, std::memory_order_relaxed);
+            return static_cast<size_t>(n_ctx);
+        }
+        
+        props_retry_ = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+        return 0;
+    }
+    
+    /**
+     * @brief Generation budget left by a prompt
+     * 
+     * @param prompt_tokens Tokens of the prompt as sent
+     * @param n_predict Requested maximum, negative = as many as fit
+     * @param min_predict Fewest tokens worth generating (default: 16)
+     * @return n_predict, lowered to the room left in the context (unchanged
+     *         while the context size is unknown)
+     * 
+     * @throws ContextOverflow if less than min_predict tokens would be left
+     */
+    int fit_n_predict(size_t prompt_tokens, int n_predict, int min_predict = 16)
+    {
+        size_t n_ctx = context_size();
+        if (n_ctx == 0)
+        {
+            return n_predict;
+        }
+        
+        size_t room = n_ctx > prompt_tokens ? n_ctx - prompt_tokens : 0;
+        if (room < static_cast<size_t>(std::max(min_predict, 1)))
+        {
+            throw ContextOverflow(prompt_tokens, n_ctx);
+        }
+        
+        size_t budget = n_predict < 0 ? room : std::min(room, static_cast<size_t>(n_predict));
+        return static_cast<int>(budget);
+    }
+    
+    /**
+     * @brief Fit a /completion prompt and its answer into the context
+     * 
+     * Counts the prompt (cached per text) and lowers params.n_predict to
+     * the room the context has left. A prompt too long to leave
+     * min_predict tokens is either cut at the end, keeping room for
+     * min(n_predict, n_ctx / 4) tokens of answer, or rejected. Does nothing
+     * while the context size is unknown.
+     * 
+     * @param prompt Prompt to send; shortened when truncate is set
+     * @param params Sampling parameters; n_predict is adjusted
+     * @param truncate Cut an oversized prompt instead of throwing
+     * @param min_predict Fewest tokens worth generating (default: 16)
+     * @return Prompt tokens (0 while the context size is unknown)
+     * 
+     * @throws ContextOverflow if the prompt does not fit and truncate is false
+     */
+    size_t fit_prompt(std::string& prompt, CompletionParams& params, bool truncate = false, int min_predict = 16)
+    {
+        size_t n_ctx = context_size();
+        if (n_ctx == 0)
+        {
+            return 0;
+        }
+        
+        // +1 for the BOS token llama-server adds to /completion prompts
+        size_t tokens = count_tokens(prompt) + 1;
+        try
+        {
+            params.n_predict = fit_n_predict(tokens, params.n_predict, min_predict);
+            return tokens;
+        }
+        catch (const ContextOverflow&)
+        {
+            if (!truncate)
+            {
+                throw;
+            }
+        }
+        
+        size_t answer = std::max<size_t>(static_cast<size_t>(std::max(min_predict, 1)),
+                                         params.n_predict < 0 ? n_ctx / 4
+                                         : std::min<size_t>(static_cast<size_t>(params.n_predict), n_ctx / 4));
+        if (answer + 1 >= n_ctx)
+        {
+            throw ContextOverflow(tokens, n_ctx);
+        }
+        
+        std::vector<int32_t> ids = tokenize(prompt);
+        ids.resize(std::min(ids.size(), n_ctx - answer - 1));
+        prompt = detokenize(ids);
+        token_counts_.insert(prompt, ids.size());
+        
+        params.n_predict = static_cast<int>(n_ctx - ids.size() - 1);
+        if (params.n_predict > static_cast<int>(answer))
+        {
+            params.n_predict = static_cast<int>(answer);
+        }
+        return ids.size() + 1;
+    }
+    
+    /**
+     * @brief Set the per-slot context size instead of asking /props
+     * 
+     * Call before serving requests.
+     * 
+     * @param tokens Tokens per slot, 0 = no prompt budgeting
+     */
+    void set_context_size(size_t tokens)
+    {
+        context_size_.store(static_cast<int64_t>(tokens), std::memory_order_relaxed);
+    }
+    
+    /**
+     * @brief Set how many text segments keep their token count
+     * 
+     * @param entries Segments cached, 0 = no caching (default: 16384)
+     */
+    void set_token_cache_size(size_t entries)
+    {
+        token_counts_.set_capacity(entries);
+    }
+    
+    /**
+     * @brief Context size and token count cache counters
+     * 
+     * @return JSON object suitable for a diagnostics endpoint
+     */
+    json tokenizer_stats()
+    {
+        json stats = token_counts_.stats();
+        stats["context_size"] = std::max<int64_t>(context_size_.load(std::memory_order_relaxed), 0);
+        return stats;
+    }
+    
+    /**
+     * @brief Set the number of async I/O threads
+     * 
+     * Call before the first async call; later calls have no effect.
+     * 
+     * @param threads Thread count, 0 = one per pooled connection (default)
+     */
+    void set_async_threads(size_t threads)
+    {
+        std::lock_guard<std::mutex> lock(async_mutex_);
+        async_threads_ = threads;
+    }
+    
+    /**
+     * @brief Run any call on the async I/O threads
+     * 
+     * The call runs under the submitting thread's RequestContext, so it
+     * honours the request's deadline and is skipped or aborted when the
+     * request is cancelled. Pass everything it needs by value: with a
+     * deadline, the caller may stop waiting before the call finishes.
+     * 
+     * @param call Work to run, e.g. [](LlamaClient& c) { return c.get_models(); }
+     * @return Future of the call's result (or exception)
+     */
+    std::shared_future<json> submit_async(std::function<json(LlamaClient&)> call)
+    {
+        auto promise = std::make_shared<std::promise<json>>();
+        std::shared_future<json> future = promise->get_future().share();
+        
+        {
+            std::lock_guard<std::mutex> lock(async_mutex_);
+            
+            if (async_workers_.empty())
+            {
+                size_t threads = async_threads_;
+                if (threads == 0)
+                {
+                    for (size_t i = 0; i < backends_->size(); i++)
+                    {
+                        threads += backends_->connection_pool(i).max_size();
+                    }
+                }
+                
+                async_workers_.reserve(threads);
+                for (size_t i = 0; i < threads; i++)
+                {
+                    async_workers_.emplace_back([this] { async_loop(); });
+                }
+            }
+            
+            async_queue_.push_back({std::move(call), std::move(promise), RequestContext::current()});
+        }
+        async_wake_.notify_one();
+        
+        return future;
+    }
+    
+    /**
+     * @brief Non-blocking text completion
+     * 
+     * @param prompt Input text prompt (copied)
+     * @param params Sampling parameters
+     * @return Future of the JSON response from llama-server
+     */
+    std::shared_future<json> complete_async(const std::string& prompt, const CompletionParams& params)
+    {
+        return submit_async([prompt, params](LlamaClient& client)
+        {
+            return client.complete(prompt, params);
+        });
+    }
+    
+    /**
+     * @brief Non-blocking text completion (convenience overload)
+     */
+    std::shared_future<json> complete_async(const std::string& prompt, int max_tokens = 512, float temperature = 0.7)
+    {
+        return complete_async(prompt, CompletionParams(max_tokens, temperature));
+    }
+    
+    /**
+     * @brief Non-blocking chat completion
+     * 
+     * @param messages Array of message objects (copied)
+     * @param params Sampling parameters (stop list is ignored)
+     * @return Future of the JSON response from llama-server
+     */
+    std::shared_future<json> chat_async(const json& messages, const CompletionParams& params)
+    {
+        return submit_async([messages, params](LlamaClient& client)
+        {
+            return client.chat(messages, params);
+        });
+    }
+    
+    /**
+     * @brief Non-blocking chat completion (convenience overload)
+     */
+    std::shared_future<json> chat_async(const json& messages, int max_tokens = 512, float temperature = 0.7)
+    {
+        return chat_async(messages, CompletionParams(max_tokens, temperature));
+    }
+    
+    /**
+     * @brief Wait for several async calls
+     * 
+     * Waits through RequestContext::wait(), so a disconnect or deadline
+     * ends the wait (and cancels the calls still running).
+     * 
+     * @param futures Futures from complete_async()/chat_async()/submit_async()
+     * @return Results in the order of futures
+     * 
+     * @throws The first failure, in the order of futures
+     */
+    static std::vector<json> wait_all(const std::vector<std::shared_future<json>>& futures)
+    {
+        std::vector<json> results;
+        results.reserve(futures.size());
+        for (const auto& future : futures)
+        {
+            results.push_back(RequestContext::wait(future));
+        }
+        return results;
+    }
+    
+    /**
+     * @brief Streaming text completion
+     * 
+     * Sends "stream": true and calls on_token with each content chunk as
+     * llama-server produces it.
+     * 
+     * @param prompt Input text prompt
+     * @param on_token Called per token chunk; return false to cancel
+     * @param max_tokens Maximum tokens to generate (default: 512)
+     * @param temperature Sampling temperature (default: 0.7)
+     * @return Final stream event with "content" holding the full text
+     * 
+     * @throws std::runtime_error if request fails
+     */
+    json complete_stream(const std::string& prompt, const TokenCallback& on_token,
+                         int max_tokens = 512, float temperature = 0.7)
+    {
+        return complete_stream(prompt, on_token, CompletionParams(max_tokens, temperature));
+    }
+    
+    /**
+     * @brief Streaming text completion with explicit sampling parameters
+     * 
+     * @param prompt Input text prompt
+     * @param on_token Called per token chunk; return false to cancel
+     * @param params Sampling parameters
+     * @return Final stream event with "content" holding the full text
+     * 
+     * @throws std::runtime_error if request fails
+     */
+    json complete_stream(const std::string& prompt, const TokenCallback& on_token,
+                         const CompletionParams& params)
+    {
+        json request = params.to_request(prompt);
+        request["stream"] = true;
+        
+        std::string content;
+        json final_event = json::object();
+        
+        post_stream("/completion", request, [&](const json& event)
+        {
+            std::string chunk = event.value("content", "");
+            content += chunk;
+            
+            if (event.value("stop", false))
+            {
+                final_event = event;
+            }
+            
+            return chunk.empty() || on_token(chunk);
+        }, params.pin());
+        
+        final_event["content"] = content;
+        return final_event;
+    }
+    
+    /**
+     * @brief Streaming chat completion
+     * 
+     * Sends "stream": true to the OpenAI-compatible endpoint and calls
+     * on_token with each delta as it arrives.
+     * 
+     * @param messages Array of message objects with "role" and "content"
+     * @param on_token Called per token chunk; return false to cancel
+     * @param max_tokens Maximum tokens to generate (default: 512)
+     * @param temperature Sampling temperature (default: 0.7)
+     * @return Response shaped like chat(), with the full assistant message
+     * 
+     * @throws std::runtime_error if request fails
+     */
+    json chat_stream(const json& messages, const TokenCallback& on_token,
+                     int max_tokens = 512, float temperature = 0.7)
+    {
+        return chat_stream(messages, on_token, CompletionParams(max_tokens, temperature));
+    }
+    
+    /**
+     * @brief Streaming chat completion with explicit sampling parameters
+     * 
+     * @param messages Array of message objects with "role" and "content"
+     * @param on_token Called per token chunk; return false to cancel
+     * @param params Sampling parameters (stop list is ignored)
+     * @return Response shaped like chat(), with the full assistant message
+     * 
+     * @throws std::runtime_error if request fails
+     */
+    json chat_stream(const json& messages, const TokenCallback& on_token,
+                     const CompletionParams& params)
+    {
+        json request = params.to_chat_request(messages);
+        request["stream"] = true;
+        
+        std::string content;
+        std::string finish_reason;
+        
+        post_stream("/v1/chat/completions", request, [&](const json& event)
+        {
+            if (!event.contains("choices") || event["choices"].empty())
+            {
+                return true;
+            }
+            
+            const json& choice = event["choices"][0];
+            if (choice.contains("finish_reason") && choice["finish_reason"].is_string())
+            {
+                finish_reason = choice["finish_reason"].get<std::string>();
+            }
+            
+            if (!choice.contains("delta") || !choice["delta"].contains("content")
+                || !choice["delta"]["content"].is_string())
+            {
+                return true;
+            }
+            
+            std::string chunk = choice["delta"]["content"].get<std::string>();
+            content += chunk;
+            
+            return chunk.empty() || on_token(chunk);
+        }, params.pin());
+        
+        return {
+            {"choices", json::array({
+                {
+                    {"index", 0},
+                    {"message", {{"role", "assistant"}, {"content", content}}},
+                    {"finish_reason", finish_reason}
+                }
+            })}
+        };
+    }
+    
+    /**
+     * @brief Check if any backend is alive and responding
+     * 
+     * Probes every backend and updates its health: failing backends are
+     * taken out of rotation and recovered ones are put back.
+     * 
+     * @return true if at least one backend responds to health check
+     */
+    bool is_alive()
+    {
+        bool any_alive = false;
+        for (size_t i = 0; i < backends_->size(); i++)
+        {
+            any_alive = is_alive(i) || any_alive;
+        }
+        return any_alive;
+    }
+    
+    /**
+     * @brief Probe one backend and update its health
+     * 
+     * @param index Backend index in registration order
+     * @return true if the backend responds to health check
+     */
+    bool is_alive(size_t index)
+    {
+        bool alive = false;
+        
+        try
+        {
+            auto client = backends_->acquire(index);
+            client->set_read_timeout(std::chrono::seconds(5));
+            client->set_write_timeout(std::chrono::seconds(5));
+            
+            auto res = client->Get("/health");
+            
+            if (!res)
+            {
+                client.discard();
+            }
+            
+            alive = (res && res->status == 200);
+        }
+        catch (...)
+        {
+            alive = false;
+        }
+        
+        backends_->set_health(index, alive);
+        return alive;
+    }
+    
+    /**
+     * @brief Get available models from server
+     * 
+     * @return JSON response containing model information
+     * 
+     * @throws std::runtime_error if request fails
+     */
+    json get_models()
+    {
+        auto client = backends_->acquire();
+        
+        auto res = client->Get("/v1/models");
+        
+        if (!res)
+        {
+            client.fail();
+            throw std::runtime_error("HTTP request failed: connection error");
+        }
+        
+        if (res->status != 200)
+        {
+            throw std::runtime_error("Failed to get models, status: " + std::to_string(res->status));
+        }
+        
+        return json::parse(res->body);
+    }
+    
+    /**
+     * @brief Get server URL
+     * 
+     * @return URL of the first backend
+     */
+    std::string get_server_url() const
+    {
+        return backends_->url(0);
+    }
+    
+    /**
+     * @brief Get connection pool of the first backend (for diagnostics)
+     * 
+     * @return Reference to the keep-alive connection pool
+     */
+    ConnectionPool& get_connection_pool()
+    {
+        return backends_->connection_pool(0);
+    }
+    
+    /**
+     * @brief Record llama-server stage timings into a metrics registry
+     * 
+     * Call before serving requests.
+     * 
+     * @param metrics Registry to use, or nullptr to disable (not owned)
+     */
+    void set_metrics(Metrics* metrics)
+    {
+        metrics_ = metrics;
+    }
+    
+    /**
+     * @brief Set how llama-server calls are retried and hedged
+     * 
+     * Call before serving requests.
+     * 
+     * @param policy Retry and hedging settings
+     */
+    void set_retry_policy(const RetryPolicy& policy)
+    {
+        retry_ = policy;
+    }
+    
+    /**
+     * @brief Get backend pool (for diagnostics)
+     * 
+     * @return Reference to the load-balanced backends
+     */
+    BackendPool& get_backends()
     {
-        return "http://" + host_ + ":" + std::to_string(port_);
+        return *backends_;
     }
 };
 
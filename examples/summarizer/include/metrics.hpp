@@ -0,0 +1,437 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file metrics.hpp
+ * @brief Lock-free Counters and Histograms with Prometheus Text Output
+ *
+ * Recording a sample is a few relaxed atomic operations, so it is cheap
+ * enough for every request. Metrics::render() produces the Prometheus
+ * text exposition format served on /metrics.
+ *
+ * Per-stage latencies covered:
+ *   request parse -> scheduler queue wait -> llama-server time to first
+ *   token / total generation (and tokens/s from its "timings") -> response
+ *   serialization
+ *
+ * plus request, error and in-flight counts per action, queue wait per
+ * scheduler priority class, llama-server call retries and hedges, and the
+ * draft acceptance of speculative decoding when llama-server runs a draft
+ * model.
+ *
+ * @author Pooria Yousefi
+ * @date October 6, 2025
+ */
+
+#ifndef POORIAYOUSEFI_LLAMA_APP_METRICS_HPP
+#define POORIAYOUSEFI_LLAMA_APP_METRICS_HPP
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <initializer_list>
+#include <cstdio>
+#include <cctype>
+
+namespace pooriayousefi
+{
+namespace llama
+{
+namespace app
+{
+
+/**
+ * @class Histogram
+ * @brief Fixed-bucket histogram with atomic counters
+ */
+class Histogram
+{
+private:
+    std::vector<double> bounds_;                        ///< Bucket upper bounds (sorted)
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets_;  ///< Per-bucket counts, last is +Inf
+    std::atomic<double> sum_{0.0};
+
+    static std::string format(double value)
+    {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.9g", value);
+        return text;
+    }
+
+public:
+    /**
+     * @brief Construct histogram
+     *
+     * @param bounds Bucket upper bounds in ascending order
+     */
+    explicit Histogram(std::initializer_list<double> bounds)
+        : bounds_(bounds)
+        , buckets_(new std::atomic<uint64_t>[bounds.size() + 1])
+    {
+        for (size_t i = 0; i <= bounds_.size(); i++)
+        {
+            buckets_[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+
+    /**
+     * @brief Record one sample
+     */
+    void observe(double value)
+    {
+        size_t index = static_cast<size_t>(
+            std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin());
+        buckets_[index].fetch_add(1, std::memory_order_relaxed);
+
+        double sum = sum_.load(std::memory_order_relaxed);
+        while (!sum_.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    /**
+     * @brief Append this histogram in Prometheus text format
+     *
+     * @param out Output buffer
+     * @param name Metric name
+     * @param help Help text
+     */
+    void render(std::string& out, const std::string& name, const std::string& help) const
+    {
+        out += "# HELP " + name + " " + help + "\n";
+        out += "# TYPE " + name + " histogram\n";
+        render_series(out, name, "");
+    }
+
+    /**
+     * @brief Append this histogram's samples without HELP/TYPE lines
+     *
+     * For one series of a labelled histogram family.
+     *
+     * @param out Output buffer
+     * @param name Metric name
+     * @param labels Label pairs, e.g. class="chat" (empty for none)
+     */
+    void render_series(std::string& out, const std::string& name, const std::string& labels) const
+    {
+        std::string prefix = labels.empty() ? std::string() : labels + ",";
+        std::string suffix = labels.empty() ? std::string() : "{" + labels + "}";
+
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < bounds_.size(); i++)
+        {
+            cumulative += buckets_[i].load(std::memory_order_relaxed);
+            out += name + "_bucket{" + prefix + "le=\"" + format(bounds_[i]) + "\"} " + std::to_string(cumulative) + "\n";
+        }
+        cumulative += buckets_[bounds_.size()].load(std::memory_order_relaxed);
+
+        out += name + "_bucket{" + prefix + "le=\"+Inf\"} " + std::to_string(cumulative) + "\n";
+        out += name + "_sum" + suffix + " " + format(sum_.load(std::memory_order_relaxed)) + "\n";
+        out += name + "_count" + suffix + " " + std::to_string(cumulative) + "\n";
+    }
+};
+
+/**
+ * @class Metrics
+ * @brief Application metrics registry
+ *
+ * Owned by AppServerBase and shared (by pointer) with LlamaClient and
+ * RequestScheduler, which record their own stages.
+ */
+class Metrics
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @struct ActionCounters
+     * @brief Per-action request counters
+     */
+    struct ActionCounters
+    {
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> errors{0};
+        std::atomic<int64_t> in_flight{0};
+    };
+
+    /**
+     * @class ActionScope
+     * @brief RAII in-flight tracker for one request
+     */
+    class ActionScope
+    {
+    private:
+        ActionCounters* counters_;
+
+    public:
+        explicit ActionScope(ActionCounters* counters)
+            : counters_(counters)
+        {
+            counters_->requests.fetch_add(1, std::memory_order_relaxed);
+            counters_->in_flight.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        ActionScope(ActionScope&& other) noexcept
+            : counters_(other.counters_)
+        {
+            other.counters_ = nullptr;
+        }
+
+        ActionScope(const ActionScope&) = delete;
+        ActionScope& operator=(const ActionScope&) = delete;
+        ActionScope& operator=(ActionScope&&) = delete;
+
+        ~ActionScope()
+        {
+            if (counters_)
+            {
+                counters_->in_flight.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+        /**
+         * @brief Count this request as failed
+         */
+        void fail()
+        {
+            counters_->errors.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+
+    /// Distinct action labels kept; later ones are reported as "other"
+    static constexpr size_t MAX_ACTIONS = 64;
+
+    Histogram request_parse{0.00001, 0.00005, 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1};
+    Histogram response_serialize{0.00001, 0.00005, 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1};
+    Histogram queue_wait{0.001, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30};
+    Histogram time_to_first_token{0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30};
+    Histogram generation{0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 120, 300};
+    Histogram tokens_per_second{1, 2, 5, 10, 20, 30, 50, 75, 100, 200, 500, 1000};
+    Histogram draft_acceptance{0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9, 0.95, 1};
+    std::atomic<uint64_t> draft_tokens{0};          ///< Tokens proposed by the draft model
+    std::atomic<uint64_t> draft_tokens_accepted{0}; ///< Of those, tokens the main model kept
+    std::atomic<uint64_t> upstream_retries{0};      ///< llama-server calls retried after a connection failure
+    std::atomic<uint64_t> hedges_sent{0};           ///< Duplicate calls sent to a second backend
+    std::atomic<uint64_t> hedges_won{0};            ///< Of those, calls the duplicate answered first
+
+private:
+    mutable std::mutex actions_mutex_;
+    std::map<std::string, std::unique_ptr<ActionCounters>> actions_;
+    std::map<std::string, std::unique_ptr<Histogram>> class_queue_waits_;  ///< Guarded by actions_mutex_
+
+    static void counter_line(std::string& out, const std::string& name, const std::string& action, uint64_t value)
+    {
+        out += name + "{action=\"" + action + "\"} " + std::to_string(value) + "\n";
+    }
+
+public:
+    Metrics() = default;
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    /**
+     * @brief Seconds elapsed since a start time
+     */
+    static double seconds_since(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    /**
+     * @brief Counters for an action, created on first use
+     */
+    ActionCounters& action(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(actions_mutex_);
+
+        auto it = actions_.find(name);
+        if (it == actions_.end())
+        {
+            // Action names come from clients: bound label cardinality and
+            // keep only characters that need no escaping
+            bool plain = !name.empty() && std::all_of(name.begin(), name.end(), [](char c)
+            {
+                return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '-' || c == '.' || c == ':';
+            });
+            const std::string key = (plain && actions_.size() < MAX_ACTIONS) ? name : std::string("other");
+            it = actions_.find(key);
+            if (it == actions_.end())
+            {
+                it = actions_.emplace(key, std::make_unique<ActionCounters>()).first;
+            }
+        }
+        return *it->second;
+    }
+
+    /**
+     * @brief Queue-wait histogram of a scheduler priority class
+     *
+     * Created on first use; class names come from the configuration, so
+     * they are few. The reference stays valid for the registry's lifetime.
+     */
+    Histogram& class_queue_wait(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(actions_mutex_);
+
+        auto& histogram = class_queue_waits_[name];
+        if (!histogram)
+        {
+            histogram = std::make_unique<Histogram>(
+                std::initializer_list<double>{0.001, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30});
+        }
+        return *histogram;
+    }
+
+    /**
+     * @brief Start tracking one request of an action
+     */
+    ActionScope track(const std::string& name)
+    {
+        return ActionScope(&action(name));
+    }
+
+    /**
+     * @brief Record llama-server's "timings" block from a reply
+     *
+     * @param predicted_per_second timings.predicted_per_second (tokens/s)
+     */
+    void observe_tokens_per_second(double predicted_per_second)
+    {
+        if (predicted_per_second > 0.0)
+        {
+            tokens_per_second.observe(predicted_per_second);
+        }
+    }
+
+    /**
+     * @brief Record the speculative decoding stats of one reply
+     *
+     * Replies generated without a draft model report no drafted tokens
+     * and are skipped.
+     *
+     * @param drafted timings.draft_n
+     * @param accepted timings.draft_n_accepted
+     */
+    void observe_draft(int64_t drafted, int64_t accepted)
+    {
+        if (drafted > 0)
+        {
+            accepted = std::clamp<int64_t>(accepted, 0, drafted);
+            draft_tokens.fetch_add(static_cast<uint64_t>(drafted), std::memory_order_relaxed);
+            draft_tokens_accepted.fetch_add(static_cast<uint64_t>(accepted), std::memory_order_relaxed);
+            draft_acceptance.observe(static_cast<double>(accepted) / static_cast<double>(drafted));
+        }
+    }
+
+    /**
+     * @brief Overall share of drafted tokens accepted, 0 if none were drafted
+     */
+    double draft_acceptance_rate() const
+    {
+        uint64_t drafted = draft_tokens.load(std::memory_order_relaxed);
+        return drafted == 0 ? 0.0
+            : static_cast<double>(draft_tokens_accepted.load(std::memory_order_relaxed)) / static_cast<double>(drafted);
+    }
+
+    /**
+     * @brief All metrics in Prometheus text exposition format
+     */
+    std::string render() const
+    {
+        std::string out;
+        out.reserve(8192);
+
+        request_parse.render(out, "app_request_parse_seconds", "Time to parse /api request bodies");
+        response_serialize.render(out, "app_response_serialize_seconds", "Time to serialize /api responses");
+        queue_wait.render(out, "app_queue_wait_seconds", "Time jobs wait in the scheduler queue");
+        time_to_first_token.render(out, "llama_time_to_first_token_seconds", "llama-server time to first token");
+        generation.render(out, "llama_generation_seconds", "Total llama-server request time");
+        tokens_per_second.render(out, "llama_tokens_per_second", "Generation speed reported by llama-server");
+
+        if (draft_tokens.load(std::memory_order_relaxed) > 0)
+        {
+            draft_acceptance.render(out, "llama_draft_acceptance_ratio", "Share of drafted tokens accepted per reply");
+            out += "# HELP llama_draft_tokens_total Tokens proposed by the draft model\n";
+            out += "# TYPE llama_draft_tokens_total counter\n";
+            out += "llama_draft_tokens_total " + std::to_string(draft_tokens.load(std::memory_order_relaxed)) + "\n";
+            out += "# HELP llama_draft_tokens_accepted_total Drafted tokens accepted by the main model\n";
+            out += "# TYPE llama_draft_tokens_accepted_total counter\n";
+            out += "llama_draft_tokens_accepted_total "
+                + std::to_string(draft_tokens_accepted.load(std::memory_order_relaxed)) + "\n";
+        }
+
+        out += "# HELP llama_upstream_retries_total llama-server calls retried after a connection failure\n";
+        out += "# TYPE llama_upstream_retries_total counter\n";
+        out += "llama_upstream_retries_total " + std::to_string(upstream_retries.load(std::memory_order_relaxed)) + "\n";
+        out += "# HELP llama_hedged_requests_total Duplicate llama-server calls sent to a second backend\n";
+        out += "# TYPE llama_hedged_requests_total counter\n";
+        out += "llama_hedged_requests_total " + std::to_string(hedges_sent.load(std::memory_order_relaxed)) + "\n";
+        out += "# HELP llama_hedge_wins_total Hedged calls answered first by the duplicate\n";
+        out += "# TYPE llama_hedge_wins_total counter\n";
+        out += "llama_hedge_wins_total " + std::to_string(hedges_won.load(std::memory_order_relaxed)) + "\n";
+
+        std::lock_guard<std::mutex> lock(actions_mutex_);
+
+        if (!class_queue_waits_.empty())
+        {
+            out += "# HELP app_class_queue_wait_seconds Time jobs wait in the scheduler queue per priority class\n";
+            out += "# TYPE app_class_queue_wait_seconds histogram\n";
+            for (const auto& [name, histogram] : class_queue_waits_)
+            {
+                histogram->render_series(out, "app_class_queue_wait_seconds", "class=\"" + name + "\"");
+            }
+        }
+
+        out += "# HELP app_requests_total Requests received per action\n";
+        out += "# TYPE app_requests_total counter\n";
+        for (const auto& [name, counters] : actions_)
+        {
+            counter_line(out, "app_requests_total", name, counters->requests.load(std::memory_order_relaxed));
+        }
+
+        out += "# HELP app_request_errors_total Failed requests per action\n";
+        out += "# TYPE app_request_errors_total counter\n";
+        for (const auto& [name, counters] : actions_)
+        {
+            counter_line(out, "app_request_errors_total", name, counters->errors.load(std::memory_order_relaxed));
+        }
+
+        out += "# HELP app_requests_in_flight Requests currently being processed per action\n";
+        out += "# TYPE app_requests_in_flight gauge\n";
+        for (const auto& [name, counters] : actions_)
+        {
+            int64_t in_flight = counters->in_flight.load(std::memory_order_relaxed);
+            counter_line(out, "app_requests_in_flight", name, static_cast<uint64_t>(std::max<int64_t>(in_flight, 0)));
+        }
+
+        return out;
+    }
+};
+
+} // namespace app
+} // namespace llama
+} // namespace pooriayousefi
+
+#endif // POORIAYOUSEFI_LLAMA_APP_METRICS_HPP
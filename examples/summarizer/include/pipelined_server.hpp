@@ -0,0 +1,345 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file pipelined_server.hpp
+ * @brief httplib Server that Keeps One Read Buffer per Connection
+ *
+ * httplib::Server reads each request of a keep-alive connection through a
+ * fresh SocketStream. Bytes its read buffer took in beyond the current
+ * request (the next request of a client that pipelines) are dropped with
+ * it, and the idle wait between requests only watches the socket, so such a
+ * client waits for replies that never come.
+ *
+ * PipelinedServer overrides Server::process_and_close_socket() and serves
+ * the whole connection through one ConnectionStream: a request already in
+ * its buffer is handled at once, and the keep-alive wait only starts once
+ * the buffer is empty. Everything else (routing, keep-alive limits,
+ * timeouts, socket options) is httplib's own, so the vendored httplib.h
+ * stays unmodified.
+ *
+ * The stream is built on POSIX poll()/recv()/send(). On Windows,
+ * PipelinedServer is plain httplib::Server and pipelined requests are
+ * served as httplib serves them.
+ *
+ * @author Pooria Yousefi
+ * @date October 6, 2025
+ */
+
+#ifndef POORIAYOUSEFI_LLAMA_APP_PIPELINED_SERVER_HPP
+#define POORIAYOUSEFI_LLAMA_APP_PIPELINED_SERVER_HPP
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#ifndef _WIN32
+#include <poll.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+#include "httplib.h"
+
+namespace pooriayousefi
+{
+namespace llama
+{
+namespace app
+{
+
+#ifndef _WIN32
+
+/**
+ * @class ConnectionStream
+ * @brief Buffered httplib::Stream over a client socket, for all its requests
+ *
+ * Behaves like httplib's SocketStream (same read buffer size, timeouts and
+ * liveness check), but outlives a single request.
+ */
+class ConnectionStream : public httplib::Stream
+{
+private:
+    static constexpr size_t BUFFER_SIZE = 4096;
+
+    socket_t sock_;
+    int read_timeout_ms_;
+    int write_timeout_ms_;
+    std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+
+    std::vector<char> buffer_ = std::vector<char>(BUFFER_SIZE);
+    size_t offset_ = 0;     ///< Next unread byte in buffer_
+    size_t size_ = 0;       ///< Bytes in buffer_
+
+    static int to_ms(time_t sec, time_t usec)
+    {
+        return static_cast<int>(sec * 1000 + usec / 1000);
+    }
+
+    /**
+     * @brief poll() the socket for one event, retrying on EINTR
+     *
+     * @return > 0 if ready, 0 on timeout, < 0 on error
+     */
+    int wait_for(short events, int timeout_ms) const
+    {
+        pollfd pfd{sock_, events, 0};
+        int ret;
+        do
+        {
+            ret = ::poll(&pfd, 1, timeout_ms);
+        } while (ret < 0 && errno == EINTR);
+        return ret;
+    }
+
+    static void address_of(const sockaddr_storage& addr, socklen_t len, std::string& ip, int& port)
+    {
+        char host[NI_MAXHOST] = {};
+        if (getnameinfo(reinterpret_cast<const sockaddr*>(&addr), len, host, sizeof(host),
+                        nullptr, 0, NI_NUMERICHOST) == 0)
+        {
+            ip = host;
+        }
+
+        if (addr.ss_family == AF_INET)
+        {
+            port = ntohs(reinterpret_cast<const sockaddr_in&>(addr).sin_port);
+        }
+        else if (addr.ss_family == AF_INET6)
+        {
+            port = ntohs(reinterpret_cast<const sockaddr_in6&>(addr).sin6_port);
+        }
+    }
+
+public:
+    ConnectionStream(socket_t sock, time_t read_timeout_sec, time_t read_timeout_usec,
+                     time_t write_timeout_sec, time_t write_timeout_usec)
+        : sock_(sock)
+        , read_timeout_ms_(to_ms(read_timeout_sec, read_timeout_usec))
+        , write_timeout_ms_(to_ms(write_timeout_sec, write_timeout_usec))
+    {
+    }
+
+    /**
+     * @brief Whether bytes already read from the socket are waiting
+     */
+    bool is_readable() const override
+    {
+        return offset_ < size_;
+    }
+
+    bool wait_readable() const override
+    {
+        return wait_for(POLLIN, read_timeout_ms_) > 0;
+    }
+
+    bool wait_writable() const override
+    {
+        return wait_for(POLLOUT, write_timeout_ms_) > 0 && alive();
+    }
+
+    /**
+     * @brief Whether the peer has not closed the connection
+     */
+    bool alive() const
+    {
+        int ready = wait_for(POLLIN, 0);
+        if (ready == 0)
+        {
+            return true;
+        }
+        char byte;
+        return ready > 0 && ::recv(sock_, &byte, 1, MSG_PEEK | MSG_DONTWAIT) > 0;
+    }
+
+    ssize_t read(char* ptr, size_t size) override
+    {
+        if (offset_ < size_)
+        {
+            size = std::min(size, size_ - offset_);
+            std::memcpy(ptr, buffer_.data() + offset_, size);
+            offset_ += size;
+            return static_cast<ssize_t>(size);
+        }
+
+        if (!wait_readable())
+        {
+            return -1;
+        }
+
+        offset_ = 0;
+        size_ = 0;
+
+        // Large reads go straight to the caller, as in SocketStream
+        char* target = size < BUFFER_SIZE ? buffer_.data() : ptr;
+        size_t capacity = size < BUFFER_SIZE ? BUFFER_SIZE : size;
+        ssize_t n;
+        do
+        {
+            n = ::recv(sock_, target, capacity, 0);
+        } while (n < 0 && errno == EINTR);
+
+        if (n <= 0 || target == ptr)
+        {
+            return n;
+        }
+
+        size_t taken = std::min(size, static_cast<size_t>(n));
+        std::memcpy(ptr, buffer_.data(), taken);
+        offset_ = taken;
+        size_ = static_cast<size_t>(n);
+        return static_cast<ssize_t>(taken);
+    }
+
+    ssize_t write(const char* ptr, size_t size) override
+    {
+        if (!wait_writable())
+        {
+            return -1;
+        }
+
+        ssize_t n;
+        do
+        {
+            n = ::send(sock_, ptr, size, MSG_NOSIGNAL);
+        } while (n < 0 && errno == EINTR);
+        return n;
+    }
+
+    void get_remote_ip_and_port(std::string& ip, int& port) const override
+    {
+        sockaddr_storage addr{};
+        socklen_t len = sizeof(addr);
+        if (getpeername(sock_, reinterpret_cast<sockaddr*>(&addr), &len) == 0)
+        {
+            address_of(addr, len, ip, port);
+        }
+    }
+
+    void get_local_ip_and_port(std::string& ip, int& port) const override
+    {
+        sockaddr_storage addr{};
+        socklen_t len = sizeof(addr);
+        if (getsockname(sock_, reinterpret_cast<sockaddr*>(&addr), &len) == 0)
+        {
+            address_of(addr, len, ip, port);
+        }
+    }
+
+    socket_t socket() const override
+    {
+        return sock_;
+    }
+
+    time_t duration() const override
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start_).count();
+    }
+};
+
+/**
+ * @class PipelinedServer
+ * @brief httplib::Server serving each connection through one ConnectionStream
+ */
+class PipelinedServer : public httplib::Server
+{
+private:
+    /**
+     * @brief Wait up to the keep-alive timeout for the next request's bytes
+     *
+     * Gives up early once the server stops listening, like httplib.
+     */
+    bool wait_for_request(const ConnectionStream& strm) const
+    {
+        using namespace std::chrono;
+
+        const int interval_ms = std::max(1, CPPHTTPLIB_KEEPALIVE_TIMEOUT_CHECK_INTERVAL_USECOND / 1000);
+        const auto deadline = steady_clock::now() + seconds(keep_alive_timeout_sec_);
+
+        while (svr_sock_ != INVALID_SOCKET)
+        {
+            pollfd pfd{strm.socket(), POLLIN, 0};
+            int ready = ::poll(&pfd, 1, interval_ms);
+            if (ready > 0)
+            {
+                return true;
+            }
+            if ((ready < 0 && errno != EINTR) || steady_clock::now() >= deadline)
+            {
+                break;
+            }
+        }
+        return false;
+    }
+
+    bool process_and_close_socket(socket_t sock) override
+    {
+        ConnectionStream strm(sock, read_timeout_sec_, read_timeout_usec_,
+                              write_timeout_sec_, write_timeout_usec_);
+
+        std::string remote_addr;
+        int remote_port = 0;
+        strm.get_remote_ip_and_port(remote_addr, remote_port);
+
+        std::string local_addr;
+        int local_port = 0;
+        strm.get_local_ip_and_port(local_addr, local_port);
+
+        bool ret = false;
+        for (size_t count = keep_alive_max_count_; count > 0; --count)
+        {
+            // A pipelined request already buffered does not wake poll()
+            if (!strm.is_readable() && !wait_for_request(strm))
+            {
+                break;
+            }
+
+            bool connection_closed = false;
+            ret = process_request(strm, remote_addr, remote_port, local_addr, local_port,
+                                  count == 1, connection_closed, nullptr);
+            if (!ret || connection_closed)
+            {
+                break;
+            }
+        }
+
+        ::shutdown(sock, SHUT_RDWR);
+        ::close(sock);
+        return ret;
+    }
+};
+
+#else
+
+/**
+ * @class PipelinedServer
+ * @brief httplib::Server as is (ConnectionStream needs POSIX sockets)
+ */
+class PipelinedServer : public httplib::Server
+{
+};
+
+#endif
+
+} // namespace app
+} // namespace llama
+} // namespace pooriayousefi
+
+#endif // POORIAYOUSEFI_LLAMA_APP_PIPELINED_SERVER_HPP
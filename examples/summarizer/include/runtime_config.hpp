@@ -18,14 +18,118 @@
  * @file runtime_config.hpp
  * @brief Configuration Parser for llama.cpp Applications
  * 
- * Parses config.txt to extract runtime paths and ports.
+ * Parses config.txt to extract runtime paths, ports and tuning settings.
  * 
- * Config Format (config.txt):
+ * Config Format (config.txt), either the classic four lines:
  *   Line 1: /path/to/llama.cpp/build/bin
  *   Line 2: /path/to/model.gguf
  *   Line 3: port_x (llama-server port)
  *   Line 4: port_y (app-server port)
  * 
+ * or the same four values as keys, in any order:
+ *   llama_bin_path = /path/to/llama.cpp/build/bin
+ *   model_path = /path/to/model.gguf
+ *   llama_server_port = 8080            (alias: port_x)
+ *   app_server_port = 8081              (alias: port_y)
+ * 
+ * Optional settings follow, one "key = value" per line; blank lines and
+ * lines starting with # are ignored. Every key can also be set through the
+ * environment as LLAMA_APP_<KEY> (e.g., LLAMA_APP_LLAMA_SLOTS=8), which
+ * overrides the file; LLAMA_APP_BACKEND takes a comma-separated list.
+ * 
+ * Supported keys:
+ *   llama_pool_size          Keep-alive connections to llama-server (default: 8)
+ *   llama_pool_idle_timeout  Seconds before an idle connection is closed (default: 60)
+ *   llama_slots              Concurrent llama-server requests, match --parallel (default: 4)
+ *   scheduler_window_ms      Coalescing window for queued jobs, 0 disables (default: 2)
+ *   server_threads           App-server worker threads, 0 = httplib default (default: 0)
+ *   server_max_queued        Accepted connections waiting for a worker, 0 = unbounded (default: 0)
+ *   keep_alive_max_count     Requests served per client connection (default: 100)
+ *   keep_alive_timeout       Seconds an idle client connection stays open (default: 5)
+ *   tcp_nodelay              1 = disable Nagle's algorithm on client connections (default: 1)
+ *   compression              Response encodings offered, preferred first: zstd, gzip
+ *                            or off (default: zstd,gzip; only those compiled in are used)
+ *   compression_min_bytes    Smaller response bodies are sent uncompressed (default: 1024)
+ *   compression_level        gzip 1-9 / zstd 1-19, 0 = library default (default: 0)
+ *   admin_port               Port for /health and /stats on their own pool, 0 = off (default: 0)
+ *   admin_threads            Worker threads for the admin port (default: 2)
+ *   response_cache_mb        Exact-match completion cache budget in MiB, 0 = off (default: 0)
+ *   response_cache_ttl       Cache entry lifetime in seconds, 0 = no expiry (default: 300)
+ *   response_cache_max_temperature  Higher temperatures bypass the cache (default: 0.3)
+ *   semantic_cache_mb        Similarity cache budget in MiB, 0 = off (default: 0)
+ *   semantic_cache_threshold Cosine similarity a cached answer needs (default: 0.95)
+ *   semantic_cache_ttl       Similarity cache entry lifetime in seconds, 0 = no expiry (default: 300)
+ *   semantic_cache_max_prompt  Longer prompts (bytes) bypass the similarity cache (default: 2048)
+ *   semantic_cache_backend   llama-server --embeddings instance: host:port
+ *                            (default: the completion backends)
+ *   openai_proxy             1 = forward /v1/... to the llama-server backends (default: 0)
+ *   session_max_messages     Chat history messages kept per session (default: 64)
+ *   session_max_tokens       Approximate history tokens kept per session (default: 4096)
+ *   session_max_count        Sessions kept before LRU eviction (default: 1024)
+ *   session_ttl              Idle session lifetime in seconds, 0 = no expiry (default: 1800)
+ *   backend                  llama-server to balance over: host:port [weight] (repeatable;
+ *                            replaces the default localhost:port_x backend)
+ *   backend_health_interval  Seconds between backend health probes, 0 = off (default: 5)
+ *   backend_max_failures     Consecutive connection failures that open a backend's
+ *                            circuit breaker (default: 2)
+ *   backend_circuit_cooldown Seconds an open circuit gets no requests before a trial (default: 5)
+ *   log_level                debug, info, warn, error or off (default: info)
+ *   batch_max_jobs           Jobs accepted per /api/batch request (default: 1024)
+ *   batch_concurrency        Jobs of one batch run at once, 0 = llama_slots (default: 0)
+ *   summarize_chunk_tokens   Approximate input tokens per summarize prompt (default: 1024)
+ *   summarize_overlap_tokens Tokens repeated between neighbouring chunks (default: 64)
+ *   llama_timeout            Seconds before a llama-server call is abandoned (default: 300)
+ *   llama_retries            Retries of a llama-server call after a connection failure (default: 2)
+ *   llama_retry_backoff_ms   Base of the jittered exponential retry backoff (default: 100)
+ *   llama_hedge              1 = repeat calls slower than their p95 on a second backend (default: 0)
+ *   llama_hedge_min_ms       Shortest wait before a call is hedged (default: 50)
+ *   llama_n_ctx              Per-slot context size for prompt budgeting, 0 = ask
+ *                            /props, off = no budgeting (default: 0)
+ *   token_cache_entries      Text segments whose token count is cached (default: 16384)
+ *   embedding_batch_size     Inputs per /embedding or /rerank request (default: 32)
+ *   embedding_batch_tokens   Estimated input tokens per such request, 0 = no limit;
+ *                            match llama-server's -b (default: 2048)
+ *   llama_async_threads      I/O threads for async LlamaClient calls, 0 = one per
+ *                            pooled connection (default: 0)
+ *   max_in_flight            Requests served at once before 503s, 0 = unlimited (default: 0)
+ *   action_max_in_flight     Per-action in-flight limit before 429s: action count (repeatable)
+ *   priority_class           Scheduler class: name weight [max_slots]; classes share the
+ *                            slots by weight while they compete (repeatable)
+ *   action_priority          Priority class of an action: action class (repeatable)
+ *   tenant                   Requests whose X-API-Key is api_key belong to the tenant, and
+ *                            to its class if given: name api_key [class] (repeatable)
+ *   tenant_max_in_flight     Per-tenant in-flight quota before 429s: name count (repeatable)
+ *   scheduler_max_queue      Queued llama-server jobs before 503s, 0 = unlimited (default: 0)
+ *   retry_after              Retry-After seconds sent with 429/503 (default: 1)
+ *   default_deadline_ms      Deadline for requests that set none, 0 = none (default: 0)
+ *   llama_spawn              llama-server instances to launch and supervise on
+ *                            port_x, port_x+1, ...; 0 = connect to a running one (default: 0);
+ *                            POSIX only
+ *   llama_threads            -t for launched instances, 0 = llama-server default (default: 0)
+ *   llama_ctx_size           -c for launched instances, 0 = model default (default: 0)
+ *   llama_parallel           -np per instance: launch option, and the slot count slot pinning
+ *                            assumes per backend; 0 = llama_slots split evenly (default: 0)
+ *   llama_gpu_layers         -ngl for launched instances (default: llama-server default)
+ *   llama_mmap               0 adds --no-mmap (default: 1)
+ *   llama_mlock              1 adds --mlock (default: 0)
+ *   llama_extra_args         Further llama-server arguments, space separated
+ *   llama_log_dir            Directory for llama-server-<port>.log, empty = discard (default: empty)
+ *   llama_startup_timeout    Seconds to wait for a launched model to load (default: 300)
+ *   llama_warmup_prompt      Prompt sent once before serving, empty = none (default: Hello)
+ *   llama_draft_model        Draft .gguf for speculative decoding (-md), empty = off (default: empty)
+ *   llama_draft_max          --draft-max: tokens drafted per step, 0 = llama-server default (default: 0)
+ *   llama_draft_min          --draft-min: fewest drafted tokens worth checking, 0 = default (default: 0)
+ *   llama_draft_p_min        --draft-p-min: stop drafting below this probability,
+ *                            negative = llama-server default (default: -1)
+ *   llama_draft_gpu_layers   -ngld for the draft model (default: llama-server default)
+ *   action_max_tokens        Default max tokens of an action: action count (repeatable)
+ *   action_temperature       Default temperature of an action: action value (repeatable)
+ * 
+ * apply_reloadable() takes over log_level, default_deadline_ms,
+ * batch_max_jobs, batch_concurrency, action_max_tokens and
+ * action_temperature from a re-read file (see AppServerBase's SIGHUP
+ * reload); every other setting needs a restart.
+ * 
  * @author Pooria Yousefi
  * @date October 6, 2025
  */
@@ -38,8 +142,20 @@
 #include <stdexcept>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#ifdef _WIN32
+#include <io.h>
+#else
 #include <unistd.h>
 #include <wordexp.h>
+extern char** environ;
+#endif
+#include "logger.hpp"
 
 namespace pooriayousefi
 {
@@ -48,6 +164,47 @@ namespace llama
 namespace app
 {
 
+/**
+ * @struct BackendAddress
+ * @brief One llama-server instance from a "backend" config line
+ */
+struct BackendAddress
+{
+    std::string host;
+    int port = 0;
+    int weight = 1;     ///< Relative capacity for load balancing
+};
+
+/**
+ * @struct ActionDefaults
+ * @brief Sampling defaults of one action from action_* config lines
+ */
+struct ActionDefaults
+{
+    int max_tokens = -1;        ///< -1 = the action's built-in default
+    float temperature = -1.0f;  ///< Below 0 = the action's built-in default
+};
+
+/**
+ * @struct PriorityClassConfig
+ * @brief Scheduler share of one class from a priority_class line
+ */
+struct PriorityClassConfig
+{
+    unsigned weight = 1;        ///< Relative share of dispatches while classes compete
+    size_t max_slots = 0;       ///< llama-server slots the class may hold at once (0 = all)
+};
+
+/**
+ * @struct TenantConfig
+ * @brief One tenant line: API key and priority class of a tenant
+ */
+struct TenantConfig
+{
+    std::string api_key;
+    std::string priority_class; ///< Empty = the class of each request's action
+};
+
 /**
  * @struct RuntimeConfig
  * @brief Runtime configuration for llama.cpp-based applications
@@ -58,41 +215,812 @@ struct RuntimeConfig
 {
     std::string llama_bin_path;      ///< Path to llama.cpp/build-cpu/bin
     std::string model_path;          ///< Path to .gguf model file
-    int llama_server_port;           ///< port_x: llama-server port
-    int app_server_port;             ///< port_y: application server port
+    int llama_server_port = 0;       ///< port_x: llama-server port
+    int app_server_port = 0;         ///< port_y: application server port
+    std::string source_path;         ///< File this config was read from (for reloads)
+    
+    size_t llama_pool_size = 8;          ///< Keep-alive connections to llama-server
+    int llama_pool_idle_timeout = 60;    ///< Idle connection lifetime in seconds
+    size_t llama_slots = 4;              ///< Concurrent llama-server requests (scheduler workers)
+    int scheduler_window_ms = 2;         ///< Coalescing window for queued jobs
+    size_t server_threads = 0;           ///< App-server worker threads (0 = httplib default)
+    size_t server_max_queued = 0;        ///< Connections queued for a worker (0 = unbounded)
+    size_t keep_alive_max_count = 100;   ///< Requests per client keep-alive connection
+    int keep_alive_timeout = 5;          ///< Idle client keep-alive timeout in seconds
+    bool tcp_nodelay = true;             ///< TCP_NODELAY on client connections
+    std::vector<std::string> compression = {"zstd", "gzip"}; ///< Response encodings, preferred first
+    size_t compression_min_bytes = 1024; ///< Smallest response body worth compressing
+    int compression_level = 0;           ///< Codec level (0 = library default)
+    int admin_port = 0;                  ///< Separate port for cheap routes (0 = disabled)
+    size_t admin_threads = 2;            ///< Worker threads for the admin port
+    size_t response_cache_mb = 0;        ///< Completion cache budget in MiB (0 = disabled)
+    int response_cache_ttl = 300;        ///< Completion cache TTL in seconds
+    float response_cache_max_temperature = 0.3f; ///< Cache bypass threshold (both caches)
+    size_t semantic_cache_mb = 0;        ///< Similarity cache budget in MiB (0 = disabled)
+    float semantic_cache_threshold = 0.95f; ///< Minimum cosine similarity of a hit
+    int semantic_cache_ttl = 300;        ///< Similarity cache TTL in seconds
+    size_t semantic_cache_max_prompt = 2048; ///< Longest prompt embedded, in bytes
+    BackendAddress semantic_cache_backend; ///< Embedding server (port 0 = completion backends)
+    bool openai_proxy = false;           ///< Pass /v1/... through to llama-server
+    size_t session_max_messages = 64;    ///< History window per chat session (messages)
+    size_t session_max_tokens = 4096;    ///< History window per chat session (tokens)
+    size_t session_max_count = 1024;     ///< Concurrent chat sessions kept
+    int session_ttl = 1800;              ///< Idle chat session lifetime in seconds
+    std::vector<BackendAddress> backends; ///< Load-balanced llama-servers (empty = localhost:port_x)
+    int backend_health_interval = 5;     ///< Seconds between backend health probes
+    size_t backend_max_failures = 2;     ///< Connection failures that open a backend's circuit
+    int backend_circuit_cooldown = 5;    ///< Seconds before an open circuit lets a trial through
+    LogLevel log_level = LogLevel::Info; ///< Minimum level written by Logger
+    size_t batch_max_jobs = 1024;        ///< Jobs accepted per /api/batch request
+    size_t batch_concurrency = 0;        ///< Jobs of one batch in flight (0 = llama_slots)
+    size_t summarize_chunk_tokens = 1024;  ///< Map-reduce summarization chunk size
+    size_t summarize_overlap_tokens = 64;  ///< Overlap between summarization chunks
+    int llama_timeout = 300;             ///< llama-server call timeout in seconds
+    int llama_retries = 2;               ///< Retries after a llama-server connection failure
+    int llama_retry_backoff_ms = 100;    ///< Base retry backoff in milliseconds
+    bool llama_hedge = false;            ///< Hedge slow calls on a second backend
+    int llama_hedge_min_ms = 50;         ///< Minimum hedge delay in milliseconds
+    int llama_n_ctx = 0;                 ///< Prompt budget context (0 = /props, -1 = off)
+    size_t token_cache_entries = 16384;  ///< Cached per-segment token counts
+    size_t embedding_batch_size = 32;    ///< Inputs per embedding/rerank request
+    size_t embedding_batch_tokens = 2048;  ///< Estimated tokens per embedding/rerank request
+    size_t llama_async_threads = 0;      ///< Async I/O threads (0 = one per pooled connection)
+    size_t max_in_flight = 0;            ///< Total in-flight requests (0 = unlimited)
+    std::map<std::string, size_t> action_max_in_flight; ///< In-flight limit per action
+    std::map<std::string, PriorityClassConfig> priority_classes; ///< Scheduler classes by name
+    std::map<std::string, std::string> action_priority;   ///< Action -> priority class
+    std::map<std::string, TenantConfig> tenants;          ///< Tenants by name
+    std::map<std::string, size_t> tenant_max_in_flight;   ///< In-flight quota per tenant name
+    size_t scheduler_max_queue = 0;      ///< Queue depth that sheds new requests (0 = unlimited)
+    int retry_after = 1;                 ///< Retry-After hint for shed requests (seconds)
+    int default_deadline_ms = 0;         ///< Deadline when a request sets none (0 = none)
+    size_t llama_spawn = 0;              ///< Supervised llama-server instances (0 = external)
+    int llama_threads = 0;               ///< -t (0 = llama-server default)
+    int llama_ctx_size = 0;              ///< -c (0 = model default)
+    int llama_parallel = 0;              ///< -np per instance (0 = llama_slots split over the backends)
+    int llama_gpu_layers = -1;           ///< -ngl (-1 = llama-server default)
+    bool llama_mmap = true;              ///< false adds --no-mmap
+    bool llama_mlock = false;            ///< true adds --mlock
+    std::vector<std::string> llama_extra_args; ///< Appended to the llama-server command line
+    std::string llama_log_dir;           ///< Where launched instances log (empty = discard)
+    int llama_startup_timeout = 300;     ///< Seconds for a launched model to load
+    std::string llama_warmup_prompt = "Hello"; ///< Sent before serving (empty = none)
+    std::string llama_draft_model;       ///< -md draft model (empty = no speculative decoding)
+    int llama_draft_max = 0;             ///< --draft-max (0 = llama-server default)
+    int llama_draft_min = 0;             ///< --draft-min (0 = llama-server default)
+    float llama_draft_p_min = -1.0f;     ///< --draft-p-min (negative = llama-server default)
+    int llama_draft_gpu_layers = -1;     ///< -ngld (-1 = llama-server default)
+    std::map<std::string, ActionDefaults> action_defaults; ///< Per-action sampling defaults
+    
+    /// Values applied per key, in order, from the file and environment
+    std::map<std::string, std::vector<std::string>> raw_settings;
+    
+    /**
+     * @brief Expand shell patterns like ~ and environment variables
+     * 
+     * @param path Path string potentially containing shell patterns
+     * @return Expanded absolute path
+     */
+    static std::string expand_path(const std::string& path)
+    {
+#ifdef _WIN32
+        // No wordexp(): only a leading ~ is expanded, to %USERPROFILE%
+        const char* home = std::getenv("USERPROFILE");
+        if (home && !path.empty() && path[0] == '~' && (path.size() == 1 || path[1] == '/' || path[1] == '\\'))
+        {
+            return home + path.substr(1);
+        }
+        return path;
+#else
+        wordexp_t exp_result;
+        wordexp(path.c_str(), &exp_result, 0);
+        std::string expanded = exp_result.we_wordc > 0 ? exp_result.we_wordv[0] : path;
+        wordfree(&exp_result);
+        return expanded;
+#endif
+    }
+    
+    /**
+     * @brief Whether a file exists and can be read, or executed
+     * 
+     * Windows has no execute permission bit, so there executable files
+     * are only checked for readability.
+     */
+    static bool accessible(const std::string& path, bool executable)
+    {
+#ifdef _WIN32
+        (void)executable;
+        return _access(path.c_str(), 4) == 0;
+#else
+        return access(path.c_str(), executable ? X_OK : R_OK) == 0;
+#endif
+    }
+    
+    /**
+     * @brief Trim whitespace from string
+     * 
+     * @param str Input string
+     * @return Trimmed string
+     */
+    static std::string trim(const std::string& str)
+    {
+        size_t start = str.find_first_not_of(" \t\r\n");
+        size_t end = str.find_last_not_of(" \t\r\n");
+        
+        if (start == std::string::npos)
+        {
+            return "";
+        }
+        
+        return str.substr(start, end - start + 1);
+    }
+    
+    /**
+     * @brief Parse a non-negative integer setting value
+     * 
+     * @param key Setting name (for error messages)
+     * @param value Setting value
+     * @return Parsed integer
+     * 
+     * @throws std::runtime_error if value is not a non-negative integer
+     */
+    static int parse_int_setting(const std::string& key, const std::string& value)
+    {
+        std::stringstream ss(value);
+        int result = 0;
+        ss >> result;
+        if (ss.fail() || !ss.eof() || result < 0)
+        {
+            throw std::runtime_error("Invalid value for " + key + ": " + value);
+        }
+        return result;
+    }
+    
+    /**
+     * @brief Parse a non-negative floating-point setting value
+     * 
+     * @param key Setting name (for error messages)
+     * @param value Setting value
+     * @return Parsed value
+     * 
+     * @throws std::runtime_error if value is not a non-negative number
+     */
+    static float parse_float_setting(const std::string& key, const std::string& value)
+    {
+        std::stringstream ss(value);
+        float result = 0.0f;
+        ss >> result;
+        if (ss.fail() || !ss.eof() || result < 0.0f)
+        {
+            throw std::runtime_error("Invalid value for " + key + ": " + value);
+        }
+        return result;
+    }
+    
+    /**
+     * @brief Parse a "host:port [weight]" backend value
+     * 
+     * @param value Setting value
+     * @return Parsed backend address
+     * 
+     * @throws std::runtime_error if value is malformed
+     */
+    static BackendAddress parse_backend(const std::string& value)
+    {
+        std::stringstream ss(value);
+        std::string address;
+        ss >> address;
+        
+        BackendAddress backend;
+        size_t colon_pos = address.rfind(':');
+        if (colon_pos == std::string::npos || colon_pos == 0)
+        {
+            throw std::runtime_error("Invalid backend (expected host:port [weight]): " + value);
+        }
+        
+        backend.host = address.substr(0, colon_pos);
+        backend.port = parse_int_setting("backend port", address.substr(colon_pos + 1));
+        
+        std::string weight;
+        if (ss >> weight)
+        {
+            backend.weight = parse_int_setting("backend weight", weight);
+        }
+        
+        std::string extra;
+        if (ss >> extra)
+        {
+            throw std::runtime_error("Invalid backend (expected host:port [weight]): " + value);
+        }
+        
+        return backend;
+    }
+    
+    /**
+     * @brief Parse a "zstd,gzip" encoding list ("off" or "0" = none)
+     * 
+     * @throws std::runtime_error on an unknown or repeated encoding
+     */
+    static std::vector<std::string> parse_compression(const std::string& value)
+    {
+        std::vector<std::string> encodings;
+        if (value == "off" || value == "0")
+        {
+            return encodings;
+        }
+        
+        std::string list = value;
+        std::replace(list.begin(), list.end(), ',', ' ');
+        std::stringstream ss(list);
+        std::string encoding;
+        while (ss >> encoding)
+        {
+            if (encoding != "zstd" && encoding != "gzip")
+            {
+                throw std::runtime_error("Unknown compression encoding (expected zstd, gzip or off): " + encoding);
+            }
+            if (std::find(encodings.begin(), encodings.end(), encoding) != encodings.end())
+            {
+                throw std::runtime_error("compression lists " + encoding + " twice");
+            }
+            encodings.push_back(encoding);
+        }
+        return encodings;
+    }
+    
+    /**
+     * @brief Whether a name is safe as a metrics label value
+     */
+    static bool is_label(const std::string& name)
+    {
+        return !name.empty() && std::all_of(name.begin(), name.end(), [](unsigned char c)
+        {
+            return std::isalnum(c) || c == '_' || c == '-';
+        });
+    }
+    
+    /**
+     * @brief Split an "action value" setting
+     * 
+     * @throws std::runtime_error if either part is missing
+     */
+    static std::pair<std::string, std::string> parse_action_setting(const std::string& key, const std::string& value)
+    {
+        std::stringstream ss(value);
+        std::string action;
+        std::string setting;
+        ss >> action >> setting;
+        if (action.empty() || setting.empty())
+        {
+            throw std::runtime_error(key + " expects: action value");
+        }
+        return {action, setting};
+    }
+    
+    /**
+     * @brief Apply a single "key = value" tuning setting
+     * 
+     * @param key Setting name
+     * @param value Setting value
+     * 
+     * @throws std::runtime_error if key is unknown or value is invalid
+     */
+    void apply_setting(const std::string& key, const std::string& value)
+    {
+        if (key == "llama_bin_path")
+        {
+            llama_bin_path = expand_path(value);
+        }
+        else if (key == "model_path")
+        {
+            model_path = expand_path(value);
+        }
+        else if (key == "llama_server_port" || key == "port_x")
+        {
+            llama_server_port = parse_int_setting(key, value);
+        }
+        else if (key == "app_server_port" || key == "port_y")
+        {
+            app_server_port = parse_int_setting(key, value);
+        }
+        else if (key == "llama_pool_size")
+        {
+            llama_pool_size = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "llama_pool_idle_timeout")
+        {
+            llama_pool_idle_timeout = parse_int_setting(key, value);
+        }
+        else if (key == "llama_slots")
+        {
+            llama_slots = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "scheduler_window_ms")
+        {
+            scheduler_window_ms = parse_int_setting(key, value);
+        }
+        else if (key == "server_threads")
+        {
+            server_threads = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "server_max_queued")
+        {
+            server_max_queued = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "keep_alive_max_count")
+        {
+            keep_alive_max_count = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "keep_alive_timeout")
+        {
+            keep_alive_timeout = parse_int_setting(key, value);
+        }
+        else if (key == "tcp_nodelay")
+        {
+            tcp_nodelay = parse_int_setting(key, value) != 0;
+        }
+        else if (key == "compression")
+        {
+            compression = parse_compression(value);
+        }
+        else if (key == "compression_min_bytes")
+        {
+            compression_min_bytes = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "compression_level")
+        {
+            compression_level = parse_int_setting(key, value);
+        }
+        else if (key == "admin_port")
+        {
+            admin_port = parse_int_setting(key, value);
+        }
+        else if (key == "admin_threads")
+        {
+            admin_threads = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "response_cache_mb")
+        {
+            response_cache_mb = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "response_cache_ttl")
+        {
+            response_cache_ttl = parse_int_setting(key, value);
+        }
+        else if (key == "response_cache_max_temperature")
+        {
+            response_cache_max_temperature = parse_float_setting(key, value);
+        }
+        else if (key == "semantic_cache_mb")
+        {
+            semantic_cache_mb = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "semantic_cache_threshold")
+        {
+            semantic_cache_threshold = parse_float_setting(key, value);
+        }
+        else if (key == "semantic_cache_ttl")
+        {
+            semantic_cache_ttl = parse_int_setting(key, value);
+        }
+        else if (key == "semantic_cache_max_prompt")
+        {
+            semantic_cache_max_prompt = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "semantic_cache_backend")
+        {
+            semantic_cache_backend = parse_backend(value);
+        }
+        else if (key == "openai_proxy")
+        {
+            openai_proxy = parse_int_setting(key, value) != 0;
+        }
+        else if (key == "session_max_messages")
+        {
+            session_max_messages = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "session_max_tokens")
+        {
+            session_max_tokens = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "session_max_count")
+        {
+            session_max_count = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "session_ttl")
+        {
+            session_ttl = parse_int_setting(key, value);
+        }
+        else if (key == "backend")
+        {
+            backends.push_back(parse_backend(value));
+        }
+        else if (key == "backend_health_interval")
+        {
+            backend_health_interval = parse_int_setting(key, value);
+        }
+        else if (key == "backend_max_failures")
+        {
+            backend_max_failures = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "backend_circuit_cooldown")
+        {
+            backend_circuit_cooldown = parse_int_setting(key, value);
+        }
+        else if (key == "log_level")
+        {
+            log_level = Logger::parse_level(value);
+        }
+        else if (key == "batch_max_jobs")
+        {
+            batch_max_jobs = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "batch_concurrency")
+        {
+            batch_concurrency = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "summarize_chunk_tokens")
+        {
+            summarize_chunk_tokens = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "summarize_overlap_tokens")
+        {
+            summarize_overlap_tokens = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "llama_timeout")
+        {
+            llama_timeout = parse_int_setting(key, value);
+        }
+        else if (key == "llama_retries")
+        {
+            llama_retries = parse_int_setting(key, value);
+        }
+        else if (key == "llama_retry_backoff_ms")
+        {
+            llama_retry_backoff_ms = parse_int_setting(key, value);
+        }
+        else if (key == "llama_hedge")
+        {
+            llama_hedge = parse_int_setting(key, value) != 0;
+        }
+        else if (key == "llama_hedge_min_ms")
+        {
+            llama_hedge_min_ms = parse_int_setting(key, value);
+        }
+        else if (key == "llama_n_ctx")
+        {
+            llama_n_ctx = value == "off" ? -1 : parse_int_setting(key, value);
+        }
+        else if (key == "token_cache_entries")
+        {
+            token_cache_entries = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "embedding_batch_size")
+        {
+            embedding_batch_size = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "embedding_batch_tokens")
+        {
+            embedding_batch_tokens = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "llama_async_threads")
+        {
+            llama_async_threads = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "max_in_flight")
+        {
+            max_in_flight = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "action_max_in_flight")
+        {
+            auto [action, count] = parse_action_setting(key, value);
+            action_max_in_flight[action] = static_cast<size_t>(parse_int_setting(key, count));
+        }
+        else if (key == "priority_class")
+        {
+            std::stringstream ss(value);
+            std::string name;
+            std::string weight;
+            std::string max_slots;
+            std::string extra;
+            ss >> name >> weight >> max_slots >> extra;
+            if (name.empty() || weight.empty() || !extra.empty())
+            {
+                throw std::runtime_error(key + " expects: name weight [max_slots]");
+            }
+            if (!is_label(name))
+            {
+                throw std::runtime_error(key + " name may only use letters, digits, '_' and '-': " + name);
+            }
+            
+            PriorityClassConfig priority;
+            priority.weight = static_cast<unsigned>(parse_int_setting(key, weight));
+            if (!max_slots.empty())
+            {
+                priority.max_slots = static_cast<size_t>(parse_int_setting(key, max_slots));
+            }
+            priority_classes[name] = priority;
+        }
+        else if (key == "action_priority")
+        {
+            auto [action, name] = parse_action_setting(key, value);
+            action_priority[action] = name;
+        }
+        else if (key == "tenant")
+        {
+            std::stringstream ss(value);
+            std::string name;
+            std::string extra;
+            TenantConfig tenant;
+            ss >> name >> tenant.api_key >> tenant.priority_class >> extra;
+            if (name.empty() || tenant.api_key.empty() || !extra.empty())
+            {
+                throw std::runtime_error(key + " expects: name api_key [class]");
+            }
+            if (!is_label(name))
+            {
+                throw std::runtime_error(key + " name may only use letters, digits, '_' and '-': " + name);
+            }
+            tenants[name] = tenant;
+        }
+        else if (key == "tenant_max_in_flight")
+        {
+            auto [name, count] = parse_action_setting(key, value);
+            tenant_max_in_flight[name] = static_cast<size_t>(parse_int_setting(key, count));
+        }
+        else if (key == "action_max_tokens")
+        {
+            auto [action, count] = parse_action_setting(key, value);
+            action_defaults[action].max_tokens = parse_int_setting(key, count);
+        }
+        else if (key == "action_temperature")
+        {
+            auto [action, temperature] = parse_action_setting(key, value);
+            action_defaults[action].temperature = parse_float_setting(key, temperature);
+        }
+        else if (key == "scheduler_max_queue")
+        {
+            scheduler_max_queue = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "retry_after")
+        {
+            retry_after = parse_int_setting(key, value);
+        }
+        else if (key == "default_deadline_ms")
+        {
+            default_deadline_ms = parse_int_setting(key, value);
+        }
+        else if (key == "llama_spawn")
+        {
+            llama_spawn = static_cast<size_t>(parse_int_setting(key, value));
+        }
+        else if (key == "llama_threads")
+        {
+            llama_threads = parse_int_setting(key, value);
+        }
+        else if (key == "llama_ctx_size")
+        {
+            llama_ctx_size = parse_int_setting(key, value);
+        }
+        else if (key == "llama_parallel")
+        {
+            llama_parallel = parse_int_setting(key, value);
+        }
+        else if (key == "llama_gpu_layers")
+        {
+            llama_gpu_layers = parse_int_setting(key, value);
+        }
+        else if (key == "llama_mmap")
+        {
+            llama_mmap = parse_int_setting(key, value) != 0;
+        }
+        else if (key == "llama_mlock")
+        {
+            llama_mlock = parse_int_setting(key, value) != 0;
+        }
+        else if (key == "llama_extra_args")
+        {
+            std::stringstream ss(value);
+            std::string arg;
+            while (ss >> arg)
+            {
+                llama_extra_args.push_back(arg);
+            }
+        }
+        else if (key == "llama_log_dir")
+        {
+            llama_log_dir = expand_path(value);
+        }
+        else if (key == "llama_startup_timeout")
+        {
+            llama_startup_timeout = parse_int_setting(key, value);
+        }
+        else if (key == "llama_warmup_prompt")
+        {
+            llama_warmup_prompt = value;
+        }
+        else if (key == "llama_draft_model")
+        {
+            llama_draft_model = value.empty() ? value : expand_path(value);
+        }
+        else if (key == "llama_draft_max")
+        {
+            llama_draft_max = parse_int_setting(key, value);
+        }
+        else if (key == "llama_draft_min")
+        {
+            llama_draft_min = parse_int_setting(key, value);
+        }
+        else if (key == "llama_draft_p_min")
+        {
+            llama_draft_p_min = parse_float_setting(key, value);
+        }
+        else if (key == "llama_draft_gpu_layers")
+        {
+            llama_draft_gpu_layers = parse_int_setting(key, value);
+        }
+        else
+        {
+            throw std::runtime_error("Unknown config setting: " + key);
+        }
+        
+        // Aliases are recorded under their canonical names
+        std::string name = (key == "port_x") ? "llama_server_port" : (key == "port_y") ? "app_server_port" : key;
+        raw_settings[name].push_back(value);
+    }
     
     /**
-     * @brief Expand shell patterns like ~ and environment variables
+     * @brief Apply LLAMA_APP_<KEY> environment variables over the file
      * 
-     * @param path Path string potentially containing shell patterns
-     * @return Expanded absolute path
+     * backend and llama_extra_args replace the file's values instead of
+     * adding to them.
+     * 
+     * @throws std::runtime_error if a variable names an unknown key or has an invalid value
      */
-    static std::string expand_path(const std::string& path)
+    void apply_env_overrides()
     {
-        wordexp_t exp_result;
-        wordexp(path.c_str(), &exp_result, 0);
-        std::string expanded = exp_result.we_wordc > 0 ? exp_result.we_wordv[0] : path;
-        wordfree(&exp_result);
-        return expanded;
+        static const std::string prefix = "LLAMA_APP_";
+        
+#ifdef _WIN32
+        char** entries = _environ;
+#else
+        char** entries = environ;
+#endif
+        for (char** env = entries; env && *env; env++)
+        {
+            std::string entry(*env);
+            size_t eq_pos = entry.find('=');
+            if (entry.compare(0, prefix.size(), prefix) != 0 || eq_pos == std::string::npos)
+            {
+                continue;
+            }
+            
+            std::string key = entry.substr(prefix.size(), eq_pos - prefix.size());
+            std::transform(key.begin(), key.end(), key.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            std::string value = trim(entry.substr(eq_pos + 1));
+            
+            try
+            {
+                if (key == "backend")
+                {
+                    backends.clear();
+                    raw_settings.erase(key);
+                    
+                    std::stringstream ss(value);
+                    std::string backend;
+                    while (std::getline(ss, backend, ','))
+                    {
+                        apply_setting(key, trim(backend));
+                    }
+                    continue;
+                }
+                if (key == "llama_extra_args")
+                {
+                    llama_extra_args.clear();
+                    raw_settings.erase(key);
+                }
+                
+                apply_setting(key, value);
+            }
+            catch (const std::exception& e)
+            {
+                throw std::runtime_error(entry.substr(0, eq_pos) + ": " + e.what());
+            }
+        }
     }
     
     /**
-     * @brief Trim whitespace from string
+     * @brief Whether apply_reloadable() takes over a key
+     */
+    static bool is_reloadable(const std::string& key)
+    {
+        static const std::set<std::string> keys = {
+            "log_level", "default_deadline_ms", "batch_max_jobs", "batch_concurrency",
+            "action_max_tokens", "action_temperature"
+        };
+        return keys.count(key) > 0;
+    }
+    
+    /**
+     * @brief Take over the reloadable settings of a freshly read config
      * 
-     * @param str Input string
-     * @return Trimmed string
+     * @param next Config re-read from the same source (already validated)
+     * @return Changed keys that were not applied because they need a restart
      */
-    static std::string trim(const std::string& str)
+    std::vector<std::string> apply_reloadable(const RuntimeConfig& next)
     {
-        size_t start = str.find_first_not_of(" \t\r\n");
-        size_t end = str.find_last_not_of(" \t\r\n");
+        std::set<std::string> keys;
+        for (const auto& [key, values] : raw_settings)
+        {
+            keys.insert(key);
+        }
+        for (const auto& [key, values] : next.raw_settings)
+        {
+            keys.insert(key);
+        }
         
-        if (start == std::string::npos)
+        std::vector<std::string> restart_needed;
+        for (const auto& key : keys)
         {
-            return "";
+            auto current = raw_settings.find(key);
+            auto updated = next.raw_settings.find(key);
+            bool same = (current == raw_settings.end() || updated == next.raw_settings.end())
+                ? current == raw_settings.end() && updated == next.raw_settings.end()
+                : current->second == updated->second;
+            
+            if (same)
+            {
+                continue;
+            }
+            if (!is_reloadable(key))
+            {
+                restart_needed.push_back(key);
+            }
+            else if (updated == next.raw_settings.end())
+            {
+                raw_settings.erase(key);
+            }
+            else
+            {
+                raw_settings[key] = updated->second;
+            }
         }
         
-        return str.substr(start, end - start + 1);
+        log_level = next.log_level;
+        default_deadline_ms = next.default_deadline_ms;
+        batch_max_jobs = next.batch_max_jobs;
+        batch_concurrency = next.batch_concurrency;
+        action_defaults = next.action_defaults;
+        
+        return restart_needed;
+    }
+    
+    /**
+     * @brief Sampling defaults of an action
+     * 
+     * @param action Action name
+     * @param max_tokens Built-in default used unless configured
+     * @param temperature Built-in default used unless configured
+     * @return Configured values where set, the built-in ones elsewhere
+     */
+    ActionDefaults get_action_defaults(const std::string& action, int max_tokens, float temperature) const
+    {
+        ActionDefaults defaults{max_tokens, temperature};
+        
+        auto it = action_defaults.find(action);
+        if (it != action_defaults.end())
+        {
+            if (it->second.max_tokens >= 0)
+            {
+                defaults.max_tokens = it->second.max_tokens;
+            }
+            if (it->second.temperature >= 0.0f)
+            {
+                defaults.temperature = it->second.temperature;
+            }
+        }
+        return defaults;
     }
     
     /**
@@ -111,87 +1039,74 @@ struct RuntimeConfig
             throw std::runtime_error("Failed to open config file: " + config_path);
         }
         
+        static const char* const positional_keys[] = {
+            "llama_bin_path", "model_path", "llama_server_port", "app_server_port"
+        };
+        
         RuntimeConfig config;
+        config.source_path = config_path;
         std::string line;
         int line_num = 0;
+        size_t positional = 0;
+        bool keyed = false;
         
-        // Line 1: llama bin path
-        if (std::getline(file, line))
+        while (std::getline(file, line))
         {
             line_num++;
             line = trim(line);
             if (line.empty() || line[0] == '#')
             {
-                throw std::runtime_error("Line 1: llama bin path is required");
+                continue;
             }
-            config.llama_bin_path = expand_path(line);
-        }
-        else
-        {
-            throw std::runtime_error("Config file is empty");
-        }
-        
-        // Line 2: model path
-        if (std::getline(file, line))
-        {
-            line_num++;
-            line = trim(line);
-            if (line.empty() || line[0] == '#')
+            
+            try
             {
-                throw std::runtime_error("Line 2: model path is required");
+                size_t eq_pos = line.find('=');
+                std::string key = (eq_pos == std::string::npos) ? "" : trim(line.substr(0, eq_pos));
+                bool is_key = !key.empty() && std::all_of(key.begin(), key.end(),
+                    [](unsigned char c) { return std::isalnum(c) || c == '_'; });
+                
+                if (!is_key)
+                {
+                    // Classic layout: four bare values before any key = value line
+                    if (keyed || positional >= 4)
+                    {
+                        throw std::runtime_error("expected key = value");
+                    }
+                    config.apply_setting(positional_keys[positional++], line);
+                    continue;
+                }
+                
+                keyed = true;
+                config.apply_setting(key, trim(line.substr(eq_pos + 1)));
+            }
+            catch (const std::exception& e)
+            {
+                throw std::runtime_error("Line " + std::to_string(line_num) + ": " + e.what());
             }
-            config.model_path = expand_path(line);
-        }
-        else
-        {
-            throw std::runtime_error("Missing model path in config");
         }
         
-        // Line 3: llama-server port (port_x)
-        if (std::getline(file, line))
+        file.close();
+        config.apply_env_overrides();
+        
+        // The four core values are required, in either layout
+        if (config.llama_bin_path.empty())
         {
-            line_num++;
-            line = trim(line);
-            if (line.empty() || line[0] == '#')
-            {
-                throw std::runtime_error("Line 3: llama-server port is required");
-            }
-            
-            std::stringstream ss(line);
-            ss >> config.llama_server_port;
-            if (ss.fail())
-            {
-                throw std::runtime_error("Line 3: Invalid port number");
-            }
+            throw std::runtime_error("Missing llama bin path (line 1 or llama_bin_path)");
         }
-        else
+        if (config.model_path.empty())
         {
-            throw std::runtime_error("Missing llama-server port in config");
+            throw std::runtime_error("Missing model path (line 2 or model_path)");
         }
-        
-        // Line 4: app-server port (port_y)
-        if (std::getline(file, line))
+        if (config.llama_server_port == 0)
         {
-            line_num++;
-            line = trim(line);
-            if (line.empty() || line[0] == '#')
-            {
-                throw std::runtime_error("Line 4: app-server port is required");
-            }
-            
-            std::stringstream ss(line);
-            ss >> config.app_server_port;
-            if (ss.fail())
-            {
-                throw std::runtime_error("Line 4: Invalid port number");
-            }
+            throw std::runtime_error("Missing llama-server port (line 3 or llama_server_port)");
         }
-        else
+        if (config.app_server_port == 0)
         {
-            throw std::runtime_error("Missing app-server port in config");
+            throw std::runtime_error("Missing app-server port (line 4 or app_server_port)");
         }
         
-        file.close();
         return config;
     }
     
@@ -202,7 +1117,11 @@ struct RuntimeConfig
      */
     std::string get_llama_server_path() const
     {
+#ifdef _WIN32
+        return llama_bin_path + "/llama-server.exe";
+#else
         return llama_bin_path + "/llama-server";
+#endif
     }
     
     /**
@@ -215,6 +1134,48 @@ struct RuntimeConfig
         return "http://localhost:" + std::to_string(llama_server_port);
     }
     
+    /**
+     * @brief Get the llama-servers to balance requests over
+     * 
+     * @return Configured backends; the launched instances with llama_spawn;
+     *         else localhost:port_x
+     */
+    std::vector<BackendAddress> get_backends() const
+    {
+        if (!backends.empty())
+        {
+            return backends;
+        }
+        
+        if (llama_spawn > 0)
+        {
+            std::vector<BackendAddress> spawned;
+            for (size_t i = 0; i < llama_spawn; i++)
+            {
+                spawned.push_back(BackendAddress{"127.0.0.1", llama_server_port + static_cast<int>(i), 1});
+            }
+            return spawned;
+        }
+        
+        return {BackendAddress{"localhost", llama_server_port, 1}};
+    }
+    
+    /**
+     * @brief Slots of each llama-server instance (its -np)
+     * 
+     * llama_parallel if set, else llama_slots split evenly over the
+     * backends, rounded up.
+     */
+    size_t slots_per_backend() const
+    {
+        if (llama_parallel > 0)
+        {
+            return static_cast<size_t>(llama_parallel);
+        }
+        size_t count = get_backends().size();
+        return (llama_slots + count - 1) / count;
+    }
+    
     /**
      * @brief Validate configuration
      * 
@@ -230,13 +1191,13 @@ struct RuntimeConfig
     {
         // Check if llama-server exists
         std::string server_path = get_llama_server_path();
-        if (access(server_path.c_str(), X_OK) != 0)
+        if (!accessible(server_path, true))
         {
             throw std::runtime_error("llama-server not found or not executable: " + server_path);
         }
         
         // Check if model exists
-        if (access(model_path.c_str(), R_OK) != 0)
+        if (!accessible(model_path, false))
         {
             throw std::runtime_error("Model file not found or not readable: " + model_path);
         }
@@ -256,6 +1217,187 @@ struct RuntimeConfig
         {
             throw std::runtime_error("llama-server and app-server ports must be different");
         }
+        
+        if (llama_pool_size == 0)
+        {
+            throw std::runtime_error("llama_pool_size must be at least 1");
+        }
+        
+        if (llama_slots == 0)
+        {
+            throw std::runtime_error("llama_slots must be at least 1");
+        }
+        
+        if (batch_max_jobs == 0)
+        {
+            throw std::runtime_error("batch_max_jobs must be at least 1");
+        }
+        
+        if (llama_spawn > 0)
+        {
+#ifdef _WIN32
+            throw std::runtime_error("llama_spawn is not supported on Windows; start llama-server yourself");
+#endif
+            if (!backends.empty())
+            {
+                throw std::runtime_error("llama_spawn and backend lines cannot be combined");
+            }
+            
+            int last_port = llama_server_port + static_cast<int>(llama_spawn) - 1;
+            if (last_port > 65535)
+            {
+                throw std::runtime_error("llama_spawn ports run past 65535");
+            }
+            
+            for (int port : {app_server_port, admin_port})
+            {
+                if (port >= llama_server_port && port <= last_port)
+                {
+                    throw std::runtime_error("Port " + std::to_string(port) + " collides with a launched llama-server");
+                }
+            }
+            
+            if (llama_startup_timeout < 1)
+            {
+                throw std::runtime_error("llama_startup_timeout must be at least 1");
+            }
+        }
+        
+        if (!llama_draft_model.empty())
+        {
+            // An external llama-server needs -md on its own command line
+            if (llama_spawn == 0)
+            {
+                throw std::runtime_error("llama_draft_model applies to launched servers (set llama_spawn)");
+            }
+            if (!accessible(llama_draft_model, false))
+            {
+                throw std::runtime_error("Draft model file not found or not readable: " + llama_draft_model);
+            }
+            if (llama_draft_max < 0 || llama_draft_min < 0 || (llama_draft_max > 0 && llama_draft_min > llama_draft_max))
+            {
+                throw std::runtime_error("llama_draft_min and llama_draft_max must satisfy 0 <= min <= max");
+            }
+            if (llama_draft_p_min > 1.0f)
+            {
+                throw std::runtime_error("llama_draft_p_min must be at most 1");
+            }
+        }
+        
+        if (llama_timeout < 1)
+        {
+            throw std::runtime_error("llama_timeout must be at least 1");
+        }
+        
+        if (llama_retries < 0 || llama_retry_backoff_ms < 0)
+        {
+            throw std::runtime_error("llama_retries and llama_retry_backoff_ms must not be negative");
+        }
+        
+        if (llama_hedge_min_ms < 0)
+        {
+            throw std::runtime_error("llama_hedge_min_ms must not be negative");
+        }
+        
+        if (backend_circuit_cooldown < 1)
+        {
+            throw std::runtime_error("backend_circuit_cooldown must be at least 1");
+        }
+        
+        for (const auto& [name, priority] : priority_classes)
+        {
+            if (priority.weight < 1)
+            {
+                throw std::runtime_error("priority_class " + name + ": weight must be at least 1");
+            }
+        }
+        auto check_class = [this](const std::string& name, const std::string& user)
+        {
+            if (!name.empty() && name != "default" && priority_classes.count(name) == 0)
+            {
+                throw std::runtime_error("Unknown priority class " + name + " for " + user);
+            }
+        };
+        for (const auto& [action, name] : action_priority)
+        {
+            check_class(name, "action " + action);
+        }
+        for (const auto& [tenant, settings] : tenants)
+        {
+            check_class(settings.priority_class, "tenant " + tenant);
+        }
+        for (const auto& [tenant, count] : tenant_max_in_flight)
+        {
+            if (tenants.count(tenant) == 0)
+            {
+                throw std::runtime_error("tenant_max_in_flight names unknown tenant " + tenant);
+            }
+        }
+        
+        if (summarize_chunk_tokens < 16)
+        {
+            throw std::runtime_error("summarize_chunk_tokens must be at least 16");
+        }
+        
+        if (summarize_overlap_tokens * 2 > summarize_chunk_tokens)
+        {
+            throw std::runtime_error("summarize_overlap_tokens must be at most half of summarize_chunk_tokens");
+        }
+        
+        if (compression_level > 19)
+        {
+            throw std::runtime_error("compression_level must be at most 19");
+        }
+        
+        if (embedding_batch_size == 0)
+        {
+            throw std::runtime_error("embedding_batch_size must be at least 1");
+        }
+        
+        for (const auto& backend : backends)
+        {
+            if (backend.port < 1 || backend.port > 65535)
+            {
+                throw std::runtime_error("Invalid backend port: " + backend.host + ":" + std::to_string(backend.port));
+            }
+            
+            if (backend.weight < 1)
+            {
+                throw std::runtime_error("Backend weight must be at least 1: " + backend.host);
+            }
+        }
+        
+        if (semantic_cache_mb > 0)
+        {
+            if (semantic_cache_threshold <= 0.0f || semantic_cache_threshold > 1.0f)
+            {
+                throw std::runtime_error("semantic_cache_threshold must be in (0, 1]");
+            }
+            
+            if (!semantic_cache_backend.host.empty()
+                && (semantic_cache_backend.port < 1 || semantic_cache_backend.port > 65535))
+            {
+                throw std::runtime_error("Invalid semantic_cache_backend port: " + std::to_string(semantic_cache_backend.port));
+            }
+        }
+        
+        if (admin_port != 0)
+        {
+            if (admin_port < 1024 || admin_port > 65535)
+            {
+                throw std::runtime_error("Invalid admin port: " + std::to_string(admin_port));
+            }
+            
+            if (admin_port == app_server_port || admin_port == llama_server_port)
+            {
+                throw std::runtime_error("admin_port must differ from llama-server and app-server ports");
+            }
+            
+            if (admin_threads == 0)
+            {
+                throw std::runtime_error("admin_threads must be at least 1");
+            }
+        }
     }
     
     /**
@@ -271,6 +1413,110 @@ struct RuntimeConfig
         std::cout << "  Llama Server Port: " << llama_server_port << " (port_x)" << std::endl;
         std::cout << "  App Server Port:   " << app_server_port << " (port_y)" << std::endl;
         std::cout << "  Llama Server URL:  " << get_llama_server_url() << std::endl;
+        std::cout << "  Connection Pool:   " << llama_pool_size << " (idle timeout "
+                  << llama_pool_idle_timeout << "s)" << std::endl;
+        std::cout << "  Retries:           " << llama_retries << " (backoff "
+                  << llama_retry_backoff_ms << "ms, hedging "
+                  << (llama_hedge ? "after p95, min " + std::to_string(llama_hedge_min_ms) + "ms" : std::string("off"))
+                  << ")" << std::endl;
+        std::cout << "  Prompt Budget:     "
+                  << (llama_n_ctx < 0 ? std::string("off")
+                      : llama_n_ctx == 0 ? std::string("n_ctx from /props")
+                      : "n_ctx " + std::to_string(llama_n_ctx))
+                  << " (" << token_cache_entries << " cached counts)" << std::endl;
+        if (!backends.empty())
+        {
+            std::cout << "  Backends:          " << backends.size() << " (health every "
+                      << backend_health_interval << "s, circuit opens after "
+                      << backend_max_failures << " failures for "
+                      << backend_circuit_cooldown << "s)" << std::endl;
+            for (const auto& backend : backends)
+            {
+                std::cout << "    " << backend.host << ":" << backend.port
+                          << " (weight " << backend.weight << ")" << std::endl;
+            }
+        }
+        std::cout << "  Llama Slots:       " << llama_slots << " (window "
+                  << scheduler_window_ms << "ms)" << std::endl;
+        std::cout << "  Server Threads:    "
+                  << (server_threads > 0 ? std::to_string(server_threads) : std::string("default"))
+                  << " (max queued " << server_max_queued << ")" << std::endl;
+        std::cout << "  Keep-Alive:        " << keep_alive_max_count << " requests, "
+                  << keep_alive_timeout << "s idle, TCP_NODELAY " << (tcp_nodelay ? "on" : "off") << std::endl;
+        if (!compression.empty())
+        {
+            std::cout << "  Compression:       ";
+            for (size_t i = 0; i < compression.size(); i++)
+            {
+                std::cout << (i > 0 ? "," : "") << compression[i];
+            }
+            std::cout << " (>= " << compression_min_bytes << " bytes, level "
+                      << (compression_level > 0 ? std::to_string(compression_level) : std::string("default"))
+                      << ")" << std::endl;
+        }
+        if (admin_port != 0)
+        {
+            std::cout << "  Admin Port:        " << admin_port << " (" << admin_threads << " threads)" << std::endl;
+        }
+        if (max_in_flight > 0 || scheduler_max_queue > 0 || !action_max_in_flight.empty()
+            || !tenant_max_in_flight.empty())
+        {
+            std::cout << "  Admission:         max in flight " << max_in_flight
+                      << ", max queue " << scheduler_max_queue
+                      << ", " << action_max_in_flight.size() << " action limits, "
+                      << tenant_max_in_flight.size() << " tenant quotas" << std::endl;
+        }
+        if (!priority_classes.empty())
+        {
+            std::cout << "  Priority Classes:  ";
+            for (const auto& [name, priority] : priority_classes)
+            {
+                std::cout << name << " (weight " << priority.weight;
+                if (priority.max_slots > 0)
+                {
+                    std::cout << ", max " << priority.max_slots << " slots";
+                }
+                std::cout << ") ";
+            }
+            std::cout << "- " << action_priority.size() << " actions mapped, "
+                      << tenants.size() << " tenants" << std::endl;
+        }
+        if (llama_spawn > 0)
+        {
+            std::cout << "  Launched Servers:  " << llama_spawn << " on ports " << llama_server_port
+                      << "-" << (llama_server_port + static_cast<int>(llama_spawn) - 1) << std::endl;
+        }
+        if (!llama_draft_model.empty())
+        {
+            std::cout << "  Draft Model:       " << llama_draft_model;
+            if (llama_draft_max > 0)
+            {
+                std::cout << " (draft " << llama_draft_min << "-" << llama_draft_max << " tokens)";
+            }
+            std::cout << std::endl;
+        }
+        if (default_deadline_ms > 0)
+        {
+            std::cout << "  Default Deadline:  " << default_deadline_ms << "ms" << std::endl;
+        }
+        if (response_cache_mb > 0)
+        {
+            std::cout << "  Response Cache:    " << response_cache_mb << " MiB (ttl "
+                      << response_cache_ttl << "s, temperature <= "
+                      << response_cache_max_temperature << ")" << std::endl;
+        }
+        if (semantic_cache_mb > 0)
+        {
+            std::cout << "  Semantic Cache:    " << semantic_cache_mb << " MiB (similarity >= "
+                      << semantic_cache_threshold << ", ttl " << semantic_cache_ttl << "s, embeddings from "
+                      << (semantic_cache_backend.port > 0
+                          ? semantic_cache_backend.host + ":" + std::to_string(semantic_cache_backend.port)
+                          : std::string("completion backends")) << ")" << std::endl;
+        }
+        if (openai_proxy)
+        {
+            std::cout << "  OpenAI Proxy:      /v1/* -> llama-server" << std::endl;
+        }
     }
 };
 
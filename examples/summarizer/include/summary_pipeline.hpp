@@ -0,0 +1,460 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file summary_pipeline.hpp
+ * @brief Map-reduce Summarization for Documents Larger than One Prompt
+ *
+ *   split:  text -> chunks of ~chunk_tokens with overlap_tokens of overlap,
+ *           cut at paragraph, sentence or word boundaries
+ *   map:    summarize every chunk in parallel on the RequestScheduler
+ *   reduce: merge summaries in groups that fit one chunk, level by level,
+ *           until a single summary is left
+ *
+ * Chunks are std::string_views into the caller's text, and each prompt is
+ * built inside its scheduler job, so only the prompts currently running
+ * exist at once. Token counts are estimated at ~4 bytes per token, the
+ * same estimate SessionStore uses, unless the llama-server context size is
+ * known: then the bytes per token of the text are measured on its first
+ * chunk with /tokenize, chunks shrink to what the context can hold next to
+ * the instruction and the answer, and every prompt is fitted (cut if it
+ * is still too long) before it is sent.
+ *
+ * @author Pooria Yousefi
+ * @date October 6, 2025
+ */
+
+#ifndef POORIAYOUSEFI_LLAMA_APP_SUMMARY_PIPELINE_HPP
+#define POORIAYOUSEFI_LLAMA_APP_SUMMARY_PIPELINE_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <future>
+#include <chrono>
+#include <exception>
+#include <algorithm>
+#include "json.hpp"
+#include "llama_client.hpp"
+#include "request_scheduler.hpp"
+
+namespace pooriayousefi
+{
+namespace llama
+{
+namespace app
+{
+
+using json = nlohmann::json;
+
+/**
+ * @struct SummaryOptions
+ * @brief Chunking and prompt settings for SummaryPipeline
+ */
+struct SummaryOptions
+{
+    size_t chunk_tokens = 1024;         ///< Approximate input tokens per prompt
+    size_t overlap_tokens = 64;         ///< Approximate tokens repeated between neighbouring chunks
+    CompletionParams params{256, 0.5f}; ///< Sampling for every call (id_slot is set per run)
+    std::string map_instruction = "Summarize the following text concisely:\n\n";
+    std::string reduce_instruction = "Combine these partial summaries of one document into a single concise summary:\n\n";
+};
+
+/**
+ * @struct SummaryResult
+ * @brief Final summary plus per-stage counts and timings
+ */
+struct SummaryResult
+{
+    std::string summary;
+    size_t chunks = 0;                  ///< Map-stage prompts
+    size_t reduce_levels = 0;           ///< Reduce rounds (0 for single-chunk texts)
+    size_t llm_calls = 0;
+    size_t chunk_tokens = 0;            ///< Chunk size used (after fitting the context)
+    double bytes_per_token = 0.0;       ///< Measured, or the BYTES_PER_TOKEN estimate
+    double split_ms = 0.0;
+    double map_ms = 0.0;
+    double reduce_ms = 0.0;
+    double total_ms = 0.0;
+
+    /**
+     * @brief Counts and timings as JSON (for API responses)
+     */
+    json stats() const
+    {
+        return {
+            {"chunks", chunks},
+            {"reduce_levels", reduce_levels},
+            {"llm_calls", llm_calls},
+            {"chunk_tokens", chunk_tokens},
+            {"bytes_per_token", bytes_per_token},
+            {"split_ms", split_ms},
+            {"map_ms", map_ms},
+            {"reduce_ms", reduce_ms},
+            {"total_ms", total_ms}
+        };
+    }
+};
+
+/**
+ * @class SummaryPipeline
+ * @brief Chunked, parallel, hierarchical summarizer on top of RequestScheduler
+ */
+class SummaryPipeline
+{
+public:
+    static constexpr size_t BYTES_PER_TOKEN = 4;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    RequestScheduler& scheduler_;
+    SummaryOptions options_;
+
+    static double ms_since(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    /**
+     * @brief Best cut position in (min, limit], preferring larger boundaries
+     */
+    static size_t boundary_before(std::string_view text, size_t limit, size_t min)
+    {
+        static const std::string_view separators[] = {"\n\n", "\n", ". ", "? ", "! ", " "};
+
+        // Search only the window, so splitting stays linear in the text size
+        std::string_view window = text.substr(min, limit - min);
+
+        for (std::string_view separator : separators)
+        {
+            size_t found = window.rfind(separator);
+            if (found != std::string_view::npos)
+            {
+                return min + found + separator.size();
+            }
+        }
+
+        // No whitespace at all: hard cut, but not inside a UTF-8 sequence
+        while (limit > min + 1 && (static_cast<unsigned char>(text[limit]) & 0xC0) == 0x80)
+        {
+            limit--;
+        }
+        return limit;
+    }
+
+    /**
+     * @brief Wait for every future, then rethrow the first failure
+     *
+     * Jobs hold views into the caller's text, so none may still be running
+     * when an exception leaves run(). Waiting honours the current
+     * RequestContext (see RequestScheduler::wait()).
+     */
+    static std::vector<std::string> collect(std::vector<std::shared_future<json>>& futures)
+    {
+        std::vector<std::string> contents;
+        contents.reserve(futures.size());
+        std::exception_ptr failure;
+
+        for (auto& future : futures)
+        {
+            try
+            {
+                json reply = RequestScheduler::wait(future);
+                auto content = reply.find("content");
+                contents.push_back(content != reply.end() && content->is_string()
+                                   ? std::move(content->get_ref<std::string&>()) : std::string());
+            }
+            catch (...)
+            {
+                if (!failure)
+                {
+                    failure = std::current_exception();
+                }
+                contents.emplace_back();
+            }
+        }
+
+        if (failure)
+        {
+            // wait() gives up early on disconnect or deadline; the cancelled
+            // jobs still finish quickly, and must before views go away
+            for (auto& future : futures)
+            {
+                future.wait();
+            }
+            std::rethrow_exception(failure);
+        }
+        return contents;
+    }
+
+    /**
+     * @brief Queue one completion whose prompt is instruction + the joined parts
+     */
+    std::shared_future<json> submit(const std::string& instruction, const std::string_view* parts,
+                                    size_t count, const CompletionParams& params)
+    {
+        return scheduler_.submit([&instruction, parts, count, params](LlamaClient& client)
+        {
+            size_t size = instruction.size();
+            for (size_t i = 0; i < count; i++)
+            {
+                size += parts[i].size() + 2;
+            }
+
+            std::string prompt;
+            prompt.reserve(size);
+            prompt += instruction;
+            for (size_t i = 0; i < count; i++)
+            {
+                if (i > 0)
+                {
+                    prompt += "\n\n";
+                }
+                prompt += parts[i];
+            }
+
+            CompletionParams fitted = params;
+            client.fit_prompt(prompt, fitted, true);
+            return client.complete(prompt, fitted);
+        });
+    }
+
+    /**
+     * @brief Fit chunk size and bytes per token to the llama-server context
+     *
+     * @param text Input text
+     * @param params Sampling for every call
+     * @param[out] result Receives chunk_tokens and bytes_per_token
+     */
+    void measure(std::string_view text, const CompletionParams& params, SummaryResult& result)
+    {
+        result.chunk_tokens = options_.chunk_tokens;
+        result.bytes_per_token = static_cast<double>(BYTES_PER_TOKEN);
+
+        LlamaClient& client = scheduler_.client();
+        size_t n_ctx = client.context_size();
+        if (n_ctx == 0 || text.empty())
+        {
+            return;
+        }
+
+        // Room for a chunk next to the longer instruction and the answer
+        size_t instruction = std::max(client.count_tokens(options_.map_instruction),
+                                      client.count_tokens(options_.reduce_instruction)) + 1;
+        size_t answer = params.n_predict < 0 ? n_ctx / 4
+                        : std::min(static_cast<size_t>(params.n_predict), n_ctx / 2);
+        if (n_ctx > instruction + answer + 16)
+        {
+            result.chunk_tokens = std::min(result.chunk_tokens, n_ctx - instruction - answer);
+        }
+        else
+        {
+            result.chunk_tokens = 16;
+        }
+
+        // Sample what would be the first chunk at the default estimate
+        size_t length = std::min(text.size(), result.chunk_tokens * BYTES_PER_TOKEN);
+        while (length < text.size() && length > 0 && (static_cast<unsigned char>(text[length]) & 0xC0) == 0x80)
+        {
+            length--;
+        }
+        size_t tokens = client.count_tokens(std::string(text.substr(0, length)));
+        if (tokens > 0)
+        {
+            // Stay a little under the sample's density, which varies along the text
+            result.bytes_per_token = std::clamp(0.9 * static_cast<double>(length) / static_cast<double>(tokens),
+                                                1.0, static_cast<double>(BYTES_PER_TOKEN) * 2);
+        }
+    }
+
+public:
+    /**
+     * @brief Construct pipeline
+     *
+     * @param scheduler Scheduler that runs (and slot-limits) every call
+     * @param options Chunking and prompt settings
+     */
+    SummaryPipeline(RequestScheduler& scheduler, SummaryOptions options = SummaryOptions())
+        : scheduler_(scheduler)
+        , options_(std::move(options))
+    {
+        options_.chunk_tokens = std::max<size_t>(options_.chunk_tokens, 16);
+        options_.overlap_tokens = std::min(options_.overlap_tokens, options_.chunk_tokens / 2);
+    }
+
+    /**
+     * @brief Split text into overlapping chunks at natural boundaries
+     *
+     * @param text Input text (must outlive the returned views)
+     * @param chunk_tokens Approximate tokens per chunk
+     * @param overlap_tokens Approximate tokens shared with the previous chunk
+     * @param bytes_per_token Bytes per token of this text (default: BYTES_PER_TOKEN)
+     * @return Views into text, in order
+     */
+    static std::vector<std::string_view> split(std::string_view text, size_t chunk_tokens, size_t overlap_tokens,
+                                               double bytes_per_token = BYTES_PER_TOKEN)
+    {
+        size_t chunk_bytes = std::max<size_t>(static_cast<size_t>(chunk_tokens * bytes_per_token), 2);
+        size_t overlap_bytes = std::min(static_cast<size_t>(overlap_tokens * bytes_per_token), chunk_bytes / 2);
+
+        std::vector<std::string_view> chunks;
+        chunks.reserve(text.size() / std::max<size_t>(chunk_bytes - overlap_bytes, 1) + 1);
+
+        size_t start = 0;
+        while (start < text.size())
+        {
+            if (text.size() - start <= chunk_bytes)
+            {
+                chunks.push_back(text.substr(start));
+                break;
+            }
+
+            // Never cut in the first half of the chunk, so chunks stay close to budget
+            size_t end = boundary_before(text, start + chunk_bytes, start + chunk_bytes / 2);
+            chunks.push_back(text.substr(start, end - start));
+
+            // Back up by the overlap, then move forward to the start of a word
+            size_t next = end - std::min(overlap_bytes, end - start - 1);
+            if (next < end)
+            {
+                size_t word = text.find_first_of(" \n", next);
+                next = (word != std::string_view::npos && word + 1 < end) ? word + 1 : end;
+            }
+            start = std::max(next, start + 1);
+        }
+
+        return chunks;
+    }
+
+    /**
+     * @brief Summarize a document of any length
+     *
+     * @param text Input text (not copied)
+     * @param id_slot llama-server slot to pin to when the text fits in one
+     *                chunk; parallel calls always let llama-server choose
+     * @return Summary with per-stage timings
+     *
+     * @throws std::exception from llama-server calls, after all started calls finish
+     */
+    SummaryResult run(std::string_view text, int id_slot = -1)
+    {
+        CompletionParams params = options_.params;
+        params.id_slot = id_slot;
+        return run(text, params);
+    }
+
+    /**
+     * @brief Summarize a document with explicit sampling parameters
+     *
+     * @param text Input text (not copied)
+     * @param params Sampling for every call; id_slot (and backend) apply
+     *               only when the text fits in one chunk
+     * @return Summary with per-stage timings
+     *
+     * @throws std::exception from llama-server calls, after all started calls finish
+     */
+    SummaryResult run(std::string_view text, CompletionParams params)
+    {
+        SummaryResult result;
+        auto start = Clock::now();
+
+        measure(text, params, result);
+        std::vector<std::string_view> chunks = split(text, result.chunk_tokens,
+                                                     std::min(options_.overlap_tokens, result.chunk_tokens / 2),
+                                                     result.bytes_per_token);
+        result.chunks = chunks.size();
+        result.split_ms = ms_since(start);
+
+        // Pin to a slot only when there is a single call; parallel calls
+        // must spread across slots
+        if (chunks.size() > 1)
+        {
+            params.id_slot = -1;
+            params.backend = -1;
+        }
+
+        auto map_start = Clock::now();
+        std::vector<std::shared_future<json>> futures;
+        futures.reserve(chunks.size());
+        for (const auto& chunk : chunks)
+        {
+            futures.push_back(submit(options_.map_instruction, &chunk, 1, params));
+        }
+        std::vector<std::string> summaries = collect(futures);
+        result.llm_calls += chunks.size();
+        result.map_ms = ms_since(map_start);
+
+        auto reduce_start = Clock::now();
+        size_t budget = static_cast<size_t>(result.chunk_tokens * result.bytes_per_token);
+
+        while (summaries.size() > 1)
+        {
+            std::vector<std::string_view> parts(summaries.begin(), summaries.end());
+
+            // Consecutive groups that fit one prompt; at least two summaries
+            // per group, so every level at least halves the count
+            std::vector<std::pair<size_t, size_t>> groups;     // [first, last)
+            size_t first = 0;
+            size_t bytes = 0;
+            for (size_t i = 0; i < parts.size(); i++)
+            {
+                if (i - first >= 2 && bytes + parts[i].size() > budget)
+                {
+                    groups.emplace_back(first, i);
+                    first = i;
+                    bytes = 0;
+                }
+                bytes += parts[i].size() + 2;
+            }
+            groups.emplace_back(first, parts.size());
+
+            futures.clear();
+            for (const auto& [begin, end] : groups)
+            {
+                futures.push_back(submit(options_.reduce_instruction, parts.data() + begin, end - begin, params));
+            }
+
+            // parts views into summaries, so collect before replacing it
+            std::vector<std::string> merged = collect(futures);
+            summaries = std::move(merged);
+            result.llm_calls += groups.size();
+            result.reduce_levels++;
+        }
+        result.reduce_ms = ms_since(reduce_start);
+
+        if (!summaries.empty())
+        {
+            result.summary = std::move(summaries.front());
+        }
+        result.total_ms = ms_since(start);
+        return result;
+    }
+
+    /**
+     * @brief Current options
+     */
+    const SummaryOptions& options() const
+    {
+        return options_;
+    }
+};
+
+} // namespace app
+} // namespace llama
+} // namespace pooriayousefi
+
+#endif // POORIAYOUSEFI_LLAMA_APP_SUMMARY_PIPELINE_HPP
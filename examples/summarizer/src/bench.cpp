@@ -0,0 +1,928 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file bench.cpp
+ * @brief Load Generator and Latency Benchmark for {{PROJECT_NAME}} Server
+ *
+ * Drives the app-server's /api (and /api/stream) endpoints with a
+ * configurable request mix and reports latency percentiles, time to first
+ * token and throughput as JSON on stdout. Progress goes to stderr.
+ *
+ * Arrival patterns:
+ *  - closed loop: N workers each send the next request as soon as the
+ *    previous one returns (measures capacity)
+ *  - open loop: requests arrive as a Poisson process at a fixed rate,
+ *    whether or not earlier ones finished; latency is measured from the
+ *    scheduled arrival, so server queueing is not hidden
+ *
+ * With --mock, a built-in fake llama-server answers on port_x so the
+ * app-server's own overhead can be measured without a model. --check
+ * instead sends malformed requests and verifies the server survives them.
+ *
+ * @example Usage
+ * @code
+ *   ./bench --concurrency 16 --requests 1000 --mix echo=1
+ *   ./bench --mode open --rate 50 --requests 500 --mix complete=3,stream=1 --mock
+ *   ./bench --mock-only                      # fake llama-server until Ctrl+C
+ *   ./bench --check                          # malformed requests must not crash the server
+ * @endcode
+ *
+ * Generated by llama-app-generator on {{DATE}}
+ *
+ * @author Pooria Yousefi
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "httplib.h"
+#include "json.hpp"
+#include "runtime_config.hpp"
+
+using json = nlohmann::json;
+using namespace pooriayousefi::llama::app;
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @struct BenchOptions
+ * @brief Command-line options
+ */
+struct BenchOptions
+{
+    std::string config_path = "config.txt";
+    std::string host = "localhost";
+    std::string mode = "closed";        ///< "closed" or "open"
+    size_t concurrency = 8;             ///< Workers (closed) or connections (open)
+    size_t requests = 200;              ///< Measured requests
+    size_t warmup = 0;                  ///< Unmeasured requests sent first
+    double rate = 10.0;                 ///< Arrivals per second (open loop)
+    std::map<std::string, double> mix = {{"echo", 1.0}};
+    size_t prompt_bytes = 64;           ///< Size of generated prompts/texts
+    int timeout_seconds = 300;
+    std::string output;                 ///< JSON output file (default: stdout)
+    uint32_t seed = 42;
+
+    bool mock = false;                  ///< Run a fake llama-server during the run
+    bool mock_only = false;             ///< Only run the fake llama-server
+    bool check = false;                 ///< Send malformed requests instead of a load
+    int mock_delay_ms = 50;             ///< Fake generation time per request
+    int mock_tokens = 16;               ///< Fake tokens per reply
+};
+
+/**
+ * @struct Sample
+ * @brief Outcome of one request
+ */
+struct Sample
+{
+    std::string kind;
+    double latency_ms = 0.0;
+    double ttft_ms = -1.0;              ///< Streamed requests only
+    bool ok = false;
+};
+
+/**
+ * @brief Print usage information
+ */
+void print_usage(const char* program_name)
+{
+    std::cerr << "{{PROJECT_NAME}} Benchmark" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "Usage: " << program_name << " [options] [config_file]" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --mode closed|open       Arrival pattern (default: closed)" << std::endl;
+    std::cerr << "  --concurrency N          Concurrent connections (default: 8)" << std::endl;
+    std::cerr << "  --requests N             Measured requests (default: 200)" << std::endl;
+    std::cerr << "  --warmup N               Unmeasured requests sent first (default: 0)" << std::endl;
+    std::cerr << "  --rate R                 Open-loop arrivals per second (default: 10)" << std::endl;
+    std::cerr << "  --mix kind=w,...         Weighted request mix of echo, complete, chat," << std::endl;
+    std::cerr << "                           summarize, stream (default: echo=1)" << std::endl;
+    std::cerr << "  --prompt-bytes N         Prompt/text size in bytes (default: 64)" << std::endl;
+    std::cerr << "  --host HOST              App-server host (default: localhost)" << std::endl;
+    std::cerr << "  --timeout S              Per-request timeout in seconds (default: 300)" << std::endl;
+    std::cerr << "  --output FILE            Write JSON results to FILE (default: stdout)" << std::endl;
+    std::cerr << "  --seed N                 Random seed for mix and arrivals (default: 42)" << std::endl;
+    std::cerr << "  --mock                   Serve a fake llama-server on port_x during the run" << std::endl;
+    std::cerr << "  --mock-only              Only serve the fake llama-server (until Ctrl+C)" << std::endl;
+    std::cerr << "  --mock-delay-ms N        Fake generation time per request (default: 50)" << std::endl;
+    std::cerr << "  --mock-tokens N          Fake tokens per reply (default: 16)" << std::endl;
+    std::cerr << "  --check                  Send malformed requests; fail if the server stops answering" << std::endl;
+    std::cerr << std::endl;
+}
+
+/**
+ * @brief Parse "kind=weight,kind=weight" into a request mix
+ *
+ * @throws std::runtime_error for unknown kinds or bad weights
+ */
+std::map<std::string, double> parse_mix(const std::string& text)
+{
+    static const std::vector<std::string> kinds = {"echo", "complete", "chat", "summarize", "stream"};
+
+    std::map<std::string, double> mix;
+    std::stringstream ss(text);
+    std::string item;
+
+    while (std::getline(ss, item, ','))
+    {
+        size_t eq = item.find('=');
+        std::string kind = item.substr(0, eq);
+        double weight = (eq == std::string::npos) ? 1.0 : std::stod(item.substr(eq + 1));
+
+        if (std::find(kinds.begin(), kinds.end(), kind) == kinds.end())
+        {
+            throw std::runtime_error("Unknown request kind in --mix: " + kind);
+        }
+        if (weight < 0.0)
+        {
+            throw std::runtime_error("Negative weight in --mix: " + item);
+        }
+
+        mix[kind] = weight;
+    }
+
+    if (mix.empty())
+    {
+        throw std::runtime_error("--mix is empty");
+    }
+
+    return mix;
+}
+
+/**
+ * @brief Parse command-line arguments
+ *
+ * @throws std::runtime_error for unknown or malformed options
+ */
+BenchOptions parse_args(int argc, char* argv[])
+{
+    BenchOptions options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        auto next = [&]() -> std::string
+        {
+            if (i + 1 >= argc)
+            {
+                throw std::runtime_error("Missing value for " + arg);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--mode") options.mode = next();
+        else if (arg == "--concurrency") options.concurrency = std::stoul(next());
+        else if (arg == "--requests") options.requests = std::stoul(next());
+        else if (arg == "--warmup") options.warmup = std::stoul(next());
+        else if (arg == "--rate") options.rate = std::stod(next());
+        else if (arg == "--mix") options.mix = parse_mix(next());
+        else if (arg == "--prompt-bytes") options.prompt_bytes = std::stoul(next());
+        else if (arg == "--host") options.host = next();
+        else if (arg == "--timeout") options.timeout_seconds = std::stoi(next());
+        else if (arg == "--output") options.output = next();
+        else if (arg == "--seed") options.seed = static_cast<uint32_t>(std::stoul(next()));
+        else if (arg == "--mock") options.mock = true;
+        else if (arg == "--mock-only") options.mock_only = true;
+        else if (arg == "--mock-delay-ms") options.mock_delay_ms = std::stoi(next());
+        else if (arg == "--mock-tokens") options.mock_tokens = std::stoi(next());
+        else if (arg == "--check") options.check = true;
+        else if (arg == "--help" || arg == "-h") throw std::invalid_argument("help");
+        else if (arg.rfind("--", 0) == 0) throw std::runtime_error("Unknown option: " + arg);
+        else options.config_path = arg;
+    }
+
+    if (options.mode != "closed" && options.mode != "open")
+    {
+        throw std::runtime_error("--mode must be closed or open");
+    }
+    if (options.concurrency == 0)
+    {
+        throw std::runtime_error("--concurrency must be at least 1");
+    }
+    if (options.mode == "open" && options.rate <= 0.0)
+    {
+        throw std::runtime_error("--rate must be positive");
+    }
+    if (options.mock_tokens < 1)
+    {
+        throw std::runtime_error("--mock-tokens must be at least 1");
+    }
+
+    return options;
+}
+
+/**
+ * @class MockLlamaServer
+ * @brief Minimal fake llama-server for measuring app-server overhead
+ *
+ * Implements /health, /v1/models, /completion and /v1/chat/completions
+ * (plain and streamed). Each reply takes delay_ms, spread evenly over
+ * the tokens when streaming, and echoes a slice of the prompt.
+ */
+class MockLlamaServer
+{
+private:
+    httplib::Server server_;
+    std::thread thread_;
+    int port_;
+    int delay_ms_;
+    int tokens_;
+
+    json timings() const
+    {
+        double seconds = std::max(delay_ms_, 1) / 1000.0;
+        return {
+            {"prompt_n", 8},
+            {"prompt_ms", 1.0},
+            {"predicted_n", tokens_},
+            {"predicted_ms", delay_ms_},
+            {"predicted_per_second", tokens_ / seconds}
+        };
+    }
+
+    std::chrono::microseconds token_delay() const
+    {
+        return std::chrono::microseconds(static_cast<int64_t>(delay_ms_) * 1000 / tokens_);
+    }
+
+    /**
+     * @brief Stream tokens as SSE events built by make_event
+     */
+    template<typename MakeEvent>
+    void stream(httplib::Response& res, MakeEvent make_event, bool chat)
+    {
+        res.set_chunked_content_provider("text/event-stream",
+            [this, make_event, chat](size_t, httplib::DataSink& sink)
+            {
+                for (int i = 0; i < tokens_; i++)
+                {
+                    std::this_thread::sleep_for(token_delay());
+                    std::string frame = "data: " + make_event(i).dump() + "\n\n";
+                    if (!sink.write(frame.data(), frame.size()))
+                    {
+                        return false;
+                    }
+                }
+
+                std::string done = chat ? "data: [DONE]\n\n" : "";
+                if (!done.empty())
+                {
+                    sink.write(done.data(), done.size());
+                }
+                sink.done();
+                return true;
+            });
+    }
+
+public:
+    MockLlamaServer(int port, int delay_ms, int tokens)
+        : port_(port)
+        , delay_ms_(delay_ms)
+        , tokens_(tokens)
+    {
+        server_.new_task_queue = [] { return new httplib::ThreadPool(64); };
+
+        server_.Get("/health", [](const httplib::Request&, httplib::Response& res)
+        {
+            res.set_content(R"({"status":"ok"})", "application/json");
+        });
+
+        server_.Get("/v1/models", [](const httplib::Request&, httplib::Response& res)
+        {
+            res.set_content(R"({"data":[{"id":"mock"}]})", "application/json");
+        });
+
+        server_.Post("/completion", [this](const httplib::Request& req, httplib::Response& res)
+        {
+            json request = json::parse(req.body, nullptr, false);
+            std::string prompt = request.is_object() ? request.value("prompt", "") : "";
+            std::string content = "mock:" + prompt.substr(0, 32);
+
+            if (request.is_object() && request.value("stream", false))
+            {
+                stream(res, [this](int i)
+                {
+                    bool last = (i + 1 == tokens_);
+                    json event = {{"content", last ? "" : " tok"}, {"stop", last}};
+                    if (last)
+                    {
+                        event["timings"] = timings();
+                    }
+                    return event;
+                }, false);
+                return;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms_));
+            json reply = {
+                {"content", content},
+                {"stop", true},
+                {"tokens_predicted", tokens_},
+                {"timings", timings()}
+            };
+            res.set_content(reply.dump(), "application/json");
+        });
+
+        server_.Post("/v1/chat/completions", [this](const httplib::Request& req, httplib::Response& res)
+        {
+            json request = json::parse(req.body, nullptr, false);
+
+            if (request.is_object() && request.value("stream", false))
+            {
+                stream(res, [this](int i)
+                {
+                    bool last = (i + 1 == tokens_);
+                    json choice = {{"index", 0}, {"delta", {{"content", last ? "" : " tok"}}}};
+                    choice["finish_reason"] = last ? json("stop") : json(nullptr);
+                    json event = {{"choices", json::array({choice})}};
+                    if (last)
+                    {
+                        event["timings"] = timings();
+                    }
+                    return event;
+                }, true);
+                return;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms_));
+            json reply = {
+                {"choices", json::array({{
+                    {"index", 0},
+                    {"message", {{"role", "assistant"}, {"content", "mock reply"}}},
+                    {"finish_reason", "stop"}
+                }})},
+                {"timings", timings()}
+            };
+            res.set_content(reply.dump(), "application/json");
+        });
+    }
+
+    ~MockLlamaServer()
+    {
+        stop();
+    }
+
+    /**
+     * @brief Start listening on a background thread
+     *
+     * @throws std::runtime_error if the port cannot be bound
+     */
+    void start()
+    {
+        if (!server_.bind_to_port("0.0.0.0", port_))
+        {
+            throw std::runtime_error("Mock llama-server failed to bind port " + std::to_string(port_));
+        }
+        thread_ = std::thread([this] { server_.listen_after_bind(); });
+    }
+
+    /**
+     * @brief Block until the server stops
+     */
+    void wait()
+    {
+        if (thread_.joinable())
+        {
+            thread_.join();
+        }
+    }
+
+    void stop()
+    {
+        server_.stop();
+        wait();
+    }
+};
+
+/**
+ * @brief Build the /api request body for a request kind
+ */
+json make_request(const std::string& kind, const std::string& text)
+{
+    if (kind == "echo")
+    {
+        return {{"action", "echo"}, {"message", text}};
+    }
+    if (kind == "chat")
+    {
+        return {{"action", "chat"}, {"message", text}};
+    }
+    if (kind == "summarize")
+    {
+        return {{"action", "summarize"}, {"text", text}};
+    }
+    return {{"action", "complete"}, {"prompt", text}};  // complete, stream
+}
+
+/**
+ * @brief Send one request on a worker's keep-alive connection
+ */
+Sample send_request(httplib::Client& client, const std::string& kind, const std::string& body,
+                    Clock::time_point start)
+{
+    Sample sample;
+    sample.kind = kind;
+
+    if (kind == "stream")
+    {
+        bool first = true;
+        bool success = false;
+        std::string buffer;
+
+        auto res = client.Post("/api/stream", httplib::Headers{}, body, "application/json",
+            [&](const char* data, size_t length)
+            {
+                buffer.append(data, length);
+
+                size_t pos;
+                while ((pos = buffer.find("\n\n")) != std::string::npos)
+                {
+                    std::string frame = buffer.substr(0, pos);
+                    buffer.erase(0, pos + 2);
+
+                    if (first && frame.find("\"token\"") != std::string::npos)
+                    {
+                        first = false;
+                        sample.ttft_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+                    }
+                    if (frame.find("\"status\":\"success\"") != std::string::npos)
+                    {
+                        success = true;
+                    }
+                }
+                return true;
+            });
+
+        sample.ok = res && res->status == 200 && success;
+    }
+    else
+    {
+        auto res = client.Post("/api", body, "application/json");
+        sample.ok = res && res->status == 200
+                    && res->body.find("\"status\":\"success\"") != std::string::npos;
+    }
+
+    sample.latency_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    return sample;
+}
+
+/**
+ * @brief Send malformed requests and check the server keeps answering
+ *
+ * Each case needs an HTTP reply (any status) followed by a /health reply:
+ * a handler that throws outside its error handling takes the whole
+ * process down, which fails that case and every one after it.
+ *
+ * @return Number of failed cases
+ */
+size_t run_checks(const std::string& host, int port, int timeout_seconds)
+{
+    struct Case
+    {
+        const char* name;
+        const char* path;
+        const char* body;
+    };
+
+    static const Case cases[] = {
+        {"/api non-string action", "/api", R"({"action": 1, "message": "x"})"},
+        {"/api/stream non-string action", "/api/stream", R"({"action": 1, "prompt": "x"})"},
+        {"/api/stream null action", "/api/stream", R"({"action": null, "prompt": "x"})"},
+        {"/api/stream array action", "/api/stream", R"({"action": ["complete"]})"},
+        {"/api/stream non-string prompt", "/api/stream", R"({"action": "complete", "prompt": 1})"},
+        {"/api invalid JSON", "/api", "{"},
+        {"/api/stream invalid JSON", "/api/stream", "{"}
+    };
+
+    size_t failures = 0;
+    for (const auto& test : cases)
+    {
+        httplib::Client client(host, port);
+        client.set_read_timeout(timeout_seconds, 0);
+
+        auto res = client.Post(test.path, test.body, "application/json");
+        auto health = client.Get("/health");
+
+        if (res && health)
+        {
+            std::cerr << "  ✓ " << test.name << " (" << res->status << ")" << std::endl;
+        }
+        else
+        {
+            std::cerr << "  ✗ " << test.name << ": "
+                      << (res ? "server stopped answering" : httplib::to_string(res.error())) << std::endl;
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+/**
+ * @brief Latency summary (nearest-rank percentiles) in milliseconds
+ */
+json summarize_latencies(std::vector<double> values)
+{
+    if (values.empty())
+    {
+        return {{"count", 0}};
+    }
+
+    std::sort(values.begin(), values.end());
+
+    auto percentile = [&](double p)
+    {
+        size_t rank = static_cast<size_t>(p / 100.0 * static_cast<double>(values.size()) + 0.5);
+        return values[std::min(values.size() - 1, rank > 0 ? rank - 1 : 0)];
+    };
+
+    double sum = 0.0;
+    for (double value : values)
+    {
+        sum += value;
+    }
+
+    return {
+        {"count", values.size()},
+        {"mean", sum / static_cast<double>(values.size())},
+        {"p50", percentile(50)},
+        {"p95", percentile(95)},
+        {"p99", percentile(99)},
+        {"max", values.back()}
+    };
+}
+
+/**
+ * @class Bench
+ * @brief Request generator and result collector
+ */
+class Bench
+{
+private:
+    const BenchOptions& options_;
+    int port_;
+
+    std::vector<std::string> kinds_;
+    std::discrete_distribution<size_t> pick_kind_;
+    std::string text_;
+
+    std::mutex samples_mutex_;
+    std::vector<Sample> samples_;
+
+    std::unique_ptr<httplib::Client> make_client() const
+    {
+        auto client = std::make_unique<httplib::Client>(options_.host, port_);
+        client->set_keep_alive(true);
+        client->set_read_timeout(std::chrono::seconds(options_.timeout_seconds));
+        client->set_write_timeout(std::chrono::seconds(options_.timeout_seconds));
+        return client;
+    }
+
+    void record(Sample sample)
+    {
+        std::lock_guard<std::mutex> lock(samples_mutex_);
+        samples_.push_back(std::move(sample));
+    }
+
+    /**
+     * @brief Request kinds for all warmup + measured requests, in order
+     */
+    std::vector<size_t> plan(size_t count)
+    {
+        std::mt19937 rng(options_.seed);
+        std::vector<size_t> order(count);
+        for (auto& kind : order)
+        {
+            kind = pick_kind_(rng);
+        }
+        return order;
+    }
+
+    void run_closed(const std::vector<size_t>& order, const std::vector<std::string>& bodies)
+    {
+        std::atomic<size_t> next{0};
+        std::vector<std::thread> workers;
+
+        for (size_t w = 0; w < options_.concurrency; w++)
+        {
+            workers.emplace_back([&]
+            {
+                auto client = make_client();
+                size_t i;
+                while ((i = next.fetch_add(1)) < order.size())
+                {
+                    const std::string& kind = kinds_[order[i]];
+                    Sample sample = send_request(*client, kind, bodies[order[i]], Clock::now());
+                    if (i >= options_.warmup)
+                    {
+                        record(std::move(sample));
+                    }
+                }
+            });
+        }
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    void run_open(const std::vector<size_t>& order, const std::vector<std::string>& bodies)
+    {
+        struct Arrival
+        {
+            size_t index;
+            Clock::time_point scheduled;
+        };
+
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<Arrival> arrivals;
+        bool done = false;
+
+        std::vector<std::thread> workers;
+        for (size_t w = 0; w < options_.concurrency; w++)
+        {
+            workers.emplace_back([&]
+            {
+                auto client = make_client();
+                while (true)
+                {
+                    Arrival arrival;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        ready.wait(lock, [&] { return done || !arrivals.empty(); });
+                        if (arrivals.empty())
+                        {
+                            return;
+                        }
+                        arrival = arrivals.front();
+                        arrivals.pop_front();
+                    }
+
+                    // Latency counts from the scheduled arrival, including
+                    // any time spent waiting for a free connection
+                    const std::string& kind = kinds_[order[arrival.index]];
+                    Sample sample = send_request(*client, kind, bodies[order[arrival.index]], arrival.scheduled);
+                    if (arrival.index >= options_.warmup)
+                    {
+                        record(std::move(sample));
+                    }
+                }
+            });
+        }
+
+        std::mt19937 rng(options_.seed + 1);
+        std::exponential_distribution<double> gap(options_.rate);
+        auto when = Clock::now();
+
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            std::this_thread::sleep_until(when);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                arrivals.push_back({i, when});
+            }
+            ready.notify_one();
+
+            when += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(gap(rng)));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+        }
+        ready.notify_all();
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+public:
+    Bench(const BenchOptions& options, int port)
+        : options_(options)
+        , port_(port)
+    {
+        std::vector<double> weights;
+        for (const auto& [kind, weight] : options_.mix)
+        {
+            kinds_.push_back(kind);
+            weights.push_back(weight);
+        }
+        pick_kind_ = std::discrete_distribution<size_t>(weights.begin(), weights.end());
+
+        std::string word = "benchmark ";
+        while (text_.size() < options_.prompt_bytes)
+        {
+            text_ += word;
+        }
+        text_.resize(options_.prompt_bytes);
+    }
+
+    /**
+     * @brief Run warmup and measured requests
+     *
+     * @return Results as JSON
+     */
+    json run()
+    {
+        std::vector<std::string> bodies;
+        for (const auto& kind : kinds_)
+        {
+            bodies.push_back(make_request(kind, text_).dump());
+        }
+
+        std::vector<size_t> order = plan(options_.warmup + options_.requests);
+        samples_.reserve(options_.requests);
+
+        auto start = Clock::now();
+        if (options_.mode == "closed")
+        {
+            run_closed(order, bodies);
+        }
+        else
+        {
+            run_open(order, bodies);
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        return report(seconds);
+    }
+
+    json report(double seconds)
+    {
+        std::vector<double> latencies;
+        std::vector<double> ttfts;
+        std::map<std::string, std::vector<double>> by_kind;
+        std::map<std::string, size_t> errors_by_kind;
+        size_t errors = 0;
+
+        for (const auto& sample : samples_)
+        {
+            if (!sample.ok)
+            {
+                errors++;
+                errors_by_kind[sample.kind]++;
+                continue;
+            }
+
+            latencies.push_back(sample.latency_ms);
+            by_kind[sample.kind].push_back(sample.latency_ms);
+            if (sample.ttft_ms >= 0.0)
+            {
+                ttfts.push_back(sample.ttft_ms);
+            }
+        }
+
+        json actions = json::object();
+        for (const auto& kind : kinds_)
+        {
+            actions[kind] = {
+                {"errors", errors_by_kind[kind]},
+                {"latency_ms", summarize_latencies(by_kind[kind])}
+            };
+        }
+
+        // Warmup requests are not measured, so scale the window by share
+        double measured = static_cast<double>(samples_.size());
+        double total = static_cast<double>(options_.warmup + options_.requests);
+        double measured_seconds = total > 0.0 ? seconds * measured / total : seconds;
+
+        return {
+            {"mode", options_.mode},
+            {"concurrency", options_.concurrency},
+            {"rate", options_.mode == "open" ? json(options_.rate) : json(nullptr)},
+            {"requests", samples_.size()},
+            {"warmup", options_.warmup},
+            {"errors", errors},
+            {"duration_s", measured_seconds},
+            {"requests_per_second", measured_seconds > 0.0
+                ? static_cast<double>(latencies.size()) / measured_seconds : 0.0},
+            {"latency_ms", summarize_latencies(latencies)},
+            {"ttft_ms", summarize_latencies(ttfts)},
+            {"actions", actions},
+            {"prompt_bytes", options_.prompt_bytes},
+            {"mock", options_.mock}
+        };
+    }
+};
+
+/**
+ * @brief Main entry point
+ */
+int main(int argc, char* argv[])
+{
+    BenchOptions options;
+
+    try
+    {
+        options = parse_args(argc, argv);
+    }
+    catch (const std::invalid_argument&)
+    {
+        print_usage(argv[0]);
+        return 0;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "✗ Error: " << e.what() << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        RuntimeConfig config = RuntimeConfig::from_file(options.config_path);
+
+        std::unique_ptr<MockLlamaServer> mock;
+        if (options.mock || options.mock_only)
+        {
+            mock = std::make_unique<MockLlamaServer>(
+                config.llama_server_port, options.mock_delay_ms, options.mock_tokens);
+            mock->start();
+            std::cerr << "Mock llama-server on port " << config.llama_server_port
+                      << " (" << options.mock_delay_ms << "ms, " << options.mock_tokens
+                      << " tokens per reply)" << std::endl;
+
+            if (options.mock_only)
+            {
+                mock->wait();
+                return 0;
+            }
+        }
+
+        if (options.check)
+        {
+            std::cerr << "Checking " << options.host << ":" << config.app_server_port
+                      << " with malformed requests..." << std::endl;
+            size_t failures = run_checks(options.host, config.app_server_port, options.timeout_seconds);
+            std::cerr << (failures == 0 ? "✓ " : "✗ ") << failures << " checks failed" << std::endl;
+            return failures == 0 ? 0 : 2;
+        }
+
+        std::cerr << "Benchmarking " << options.host << ":" << config.app_server_port
+                  << " (" << options.mode << " loop, concurrency " << options.concurrency
+                  << ", " << options.requests << " requests)..." << std::endl;
+
+        Bench bench(options, config.app_server_port);
+        json results = bench.run();
+
+        if (options.output.empty())
+        {
+            std::cout << results.dump(2) << std::endl;
+        }
+        else
+        {
+            std::ofstream out(options.output);
+            if (!out)
+            {
+                throw std::runtime_error("Failed to open output file: " + options.output);
+            }
+            out << results.dump(2) << std::endl;
+            std::cerr << "Results written to " << options.output << std::endl;
+        }
+
+        std::cerr << "✓ " << results["requests_per_second"].get<double>() << " req/s, p50 "
+                  << results["latency_ms"].value("p50", 0.0) << "ms, p99 "
+                  << results["latency_ms"].value("p99", 0.0) << "ms, "
+                  << results["errors"] << " errors" << std::endl;
+
+        return results["errors"].get<size_t>() == 0 ? 0 : 2;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "✗ Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -27,6 +27,9 @@
  *   ./client complete "What is the meaning of life?"
  *   ./client chat "Tell me a joke"
  *   ./client summarize "Long text here..."
+ *   ./client stream "Write a haiku about C++"
+ *   ./client batch jobs.jsonl > results.jsonl
+ *   ./client repl chat              (one request per stdin line, one connection)
  * @endcode
  * 
  * Generated by llama-app-generator on {{DATE}}
@@ -35,10 +38,20 @@
  */
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <string>
+#include <chrono>
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
 #include "httplib.h"
 #include "json.hpp"
 #include "runtime_config.hpp"
+#include "response_compression.hpp"
 
 using json = nlohmann::json;
 using namespace pooriayousefi::llama::app;
@@ -53,6 +66,73 @@ namespace color
     const std::string CYAN = "\033[36m";
 }
 
+/**
+ * @class ServerConnection
+ * @brief Keep-alive connection to the app-server
+ * 
+ * Every call goes over the same TCP connection while the server keeps it
+ * open (keep_alive_max_count requests, keep_alive_timeout seconds idle);
+ * httplib reconnects transparently after that. Replies are requested
+ * compressed with whatever codecs this build has.
+ */
+class ServerConnection
+{
+private:
+    httplib::Client client_;
+    httplib::Headers headers_;
+    
+public:
+    ServerConnection(const std::string& host, int port)
+        : client_(host, port)
+    {
+        client_.set_keep_alive(true);
+        client_.set_tcp_nodelay(true);
+        client_.set_read_timeout(std::chrono::seconds(300));
+        client_.set_write_timeout(std::chrono::seconds(300));
+        // httplib would reject encoded bodies without its own codec macros;
+        // call() decodes them with ResponseCompressor instead
+        client_.set_decompress(false);
+        
+        std::string accept_encoding = ResponseCompressor::accept_encoding();
+        if (!accept_encoding.empty())
+        {
+            headers_.emplace("Accept-Encoding", accept_encoding);
+        }
+    }
+    
+    /**
+     * @brief Send JSON request to /api
+     * 
+     * @param request JSON request object
+     * @return JSON response
+     * 
+     * @throws std::runtime_error if request fails
+     */
+    json call(const json& request)
+    {
+        auto res = client_.Post("/api", headers_, request.dump(), "application/json");
+        
+        if (!res)
+        {
+            throw std::runtime_error("HTTP request failed: connection error");
+        }
+        
+        if (res->status != 200)
+        {
+            throw std::runtime_error("HTTP request failed with status: " + std::to_string(res->status));
+        }
+        
+        std::string body;
+        if (!ResponseCompressor::decompress(res->get_header_value("Content-Encoding"), res->body, body))
+        {
+            throw std::runtime_error("Cannot decode response (Content-Encoding: "
+                                     + res->get_header_value("Content-Encoding") + ")");
+        }
+        
+        return json::parse(body);
+    }
+};
+
 /**
  * @brief Send HTTP POST request to app-server
  * 
@@ -64,14 +144,63 @@ namespace color
  * @throws std::runtime_error if request fails
  */
 json call_server(const std::string& host, int port, const json& request)
+{
+    ServerConnection connection(host, port);
+    return connection.call(request);
+}
+
+/**
+ * @brief Send HTTP POST request to /api/stream and print tokens as they arrive
+ * 
+ * @param host Server hostname
+ * @param port Server port
+ * @param request JSON request object
+ * @return Final SSE event (carries "status")
+ * 
+ * @throws std::runtime_error if request fails
+ */
+json stream_server(const std::string& host, int port, const json& request)
 {
     httplib::Client client(host, port);
     client.set_read_timeout(std::chrono::seconds(300));
     client.set_write_timeout(std::chrono::seconds(300));
     
-    std::string request_body = request.dump();
+    std::string buffer;
+    json last_event = json::object();
     
-    auto res = client.Post("/api", request_body, "application/json");
+    auto res = client.Post("/api/stream", httplib::Headers{}, request.dump(), "application/json",
+        [&](const char* data, size_t length)
+        {
+            buffer.append(data, length);
+            
+            size_t pos;
+            while ((pos = buffer.find("\n\n")) != std::string::npos)
+            {
+                std::string frame = buffer.substr(0, pos);
+                buffer.erase(0, pos + 2);
+                
+                if (frame.compare(0, 6, "data: ") != 0)
+                {
+                    continue;
+                }
+                
+                json event = json::parse(frame.substr(6), nullptr, false);
+                if (event.is_discarded())
+                {
+                    continue;
+                }
+                
+                if (event.contains("token"))
+                {
+                    std::cout << event["token"].get<std::string>() << std::flush;
+                }
+                else
+                {
+                    last_event = event;
+                }
+            }
+            return true;
+        });
     
     if (!res)
     {
@@ -83,7 +212,277 @@ json call_server(const std::string& host, int port, const json& request)
         throw std::runtime_error("HTTP request failed with status: " + std::to_string(res->status));
     }
     
-    return json::parse(res->body);
+    std::cout << std::endl;
+    return last_event;
+}
+
+/**
+ * @brief Read batch jobs from a file
+ * 
+ * Accepts either a JSON array of /api requests or JSON Lines (one request
+ * per line; blank lines are skipped).
+ * 
+ * @param path Jobs file
+ * @return JSON array of jobs
+ * 
+ * @throws std::runtime_error if the file cannot be read or parsed
+ */
+json read_jobs(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        throw std::runtime_error("Cannot open jobs file: " + path);
+    }
+    
+    std::stringstream content;
+    content << file.rdbuf();
+    std::string text = content.str();
+    
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first != std::string::npos && text[first] == '[')
+    {
+        return json::parse(text);
+    }
+    
+    json jobs = json::array();
+    std::istringstream lines(text);
+    std::string line;
+    size_t line_number = 0;
+    
+    while (std::getline(lines, line))
+    {
+        line_number++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+        {
+            continue;
+        }
+        
+        json job = json::parse(line, nullptr, false);
+        if (job.is_discarded())
+        {
+            throw std::runtime_error(path + ":" + std::to_string(line_number) + ": invalid JSON");
+        }
+        jobs.push_back(std::move(job));
+    }
+    
+    return jobs;
+}
+
+/**
+ * @brief Send jobs to /api/batch and print each result line as it arrives
+ * 
+ * Result lines go to stdout unchanged (NDJSON, in completion order), so the
+ * output can be redirected to a file.
+ * 
+ * @param host Server hostname
+ * @param port Server port
+ * @param jobs JSON array of /api requests
+ * @return Final summary line ({"done": true, ...})
+ * 
+ * @throws std::runtime_error if request fails
+ */
+json batch_server(const std::string& host, int port, const json& jobs)
+{
+    httplib::Client client(host, port);
+    client.set_read_timeout(std::chrono::seconds(300));
+    client.set_write_timeout(std::chrono::seconds(300));
+    
+    std::string buffer;
+    std::string error_body;
+    json summary = json::object();
+    
+    json request = {{"jobs", jobs}};
+    
+    auto res = client.Post("/api/batch", httplib::Headers{}, request.dump(), "application/json",
+        [&](const char* data, size_t length)
+        {
+            buffer.append(data, length);
+            
+            size_t pos;
+            while ((pos = buffer.find('\n')) != std::string::npos)
+            {
+                std::string line = buffer.substr(0, pos);
+                buffer.erase(0, pos + 1);
+                
+                json result = json::parse(line, nullptr, false);
+                if (result.is_object() && result.contains("done"))
+                {
+                    summary = std::move(result);
+                    continue;
+                }
+                
+                std::cout << line << std::endl;
+            }
+            return true;
+        });
+    
+    if (!res)
+    {
+        throw std::runtime_error("HTTP request failed: connection error");
+    }
+    
+    if (res->status != 200)
+    {
+        throw std::runtime_error("HTTP request failed with status: " + std::to_string(res->status)
+                                 + (buffer.empty() ? "" : " (" + buffer + ")"));
+    }
+    
+    return summary;
+}
+
+/**
+ * @brief Build the /api request of a CLI action
+ * 
+ * @param action CLI action (stream sends a complete request)
+ * @param argument Message, prompt or text
+ * @return JSON request, or null for an unknown action
+ */
+json build_request(const std::string& action, const std::string& argument)
+{
+    if (action == "echo")
+    {
+        return {
+            {"action", "echo"},
+            {"message", argument}
+        };
+    }
+    else if (action == "complete" || action == "stream")
+    {
+        return {
+            {"action", "complete"},
+            {"prompt", argument}
+        };
+    }
+    else if (action == "chat")
+    {
+        return {
+            {"action", "chat"},
+            {"message", argument}
+        };
+    }
+    else if (action == "summarize")
+    {
+        return {
+            {"action", "summarize"},
+            {"text", argument}
+        };
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Print a response
+ * 
+ * @param response JSON response
+ * @return Exit code: 0 on success, 1 on failure
+ */
+int print_response(const json& response)
+{
+    std::string status = response.value("status", "unknown");
+    
+    if (status == "success")
+    {
+        std::cout << color::GREEN << "✓ Success" << color::RESET << std::endl;
+        std::cout << std::endl;
+        
+        // Print relevant response fields
+        if (response.contains("completion"))
+        {
+            std::cout << color::CYAN << "Completion:" << color::RESET << std::endl;
+            std::cout << response["completion"] << std::endl;
+        }
+        else if (response.contains("ai_response"))
+        {
+            std::cout << color::CYAN << "AI Response:" << color::RESET << std::endl;
+            std::cout << response["ai_response"] << std::endl;
+        }
+        else if (response.contains("summary"))
+        {
+            std::cout << color::CYAN << "Summary:" << color::RESET << std::endl;
+            std::cout << response["summary"] << std::endl;
+        }
+        else if (response.contains("message"))
+        {
+            std::cout << color::CYAN << "Message:" << color::RESET << std::endl;
+            std::cout << response["message"] << std::endl;
+        }
+        else
+        {
+            std::cout << color::CYAN << "Full Response:" << color::RESET << std::endl;
+            std::cout << response.dump(2) << std::endl;
+        }
+        
+        return 0;
+    }
+    
+    std::cout << color::RED << "✗ Request failed" << color::RESET << std::endl;
+    std::cout << std::endl;
+    
+    if (response.contains("message"))
+    {
+        std::cout << color::RED << "Error: " << response["message"] << color::RESET << std::endl;
+    }
+    else
+    {
+        std::cout << color::RED << "Full Response:" << color::RESET << std::endl;
+        std::cout << response.dump(2) << std::endl;
+    }
+    
+    return 1;
+}
+
+/**
+ * @brief Send one request per stdin line over a single keep-alive connection
+ * 
+ * Each line is the argument of action. chat lines share one server-side
+ * session, so the conversation carries over from line to line.
+ * 
+ * @param connection Connection to the app-server
+ * @param action echo, complete, chat or summarize
+ * @return Exit code: 0 if every request succeeded
+ */
+int repl(ServerConnection& connection, const std::string& action)
+{
+    std::string session_id = "cli-" + std::to_string(getpid());
+    int exit_code = 0;
+    size_t count = 0;
+    std::string line;
+    
+    std::cerr << color::BLUE << "One " << action << " request per line; end with Ctrl-D" << color::RESET << std::endl;
+    
+    while (std::getline(std::cin, line))
+    {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+        {
+            continue;
+        }
+        
+        json request = build_request(action, line);
+        if (action == "chat")
+        {
+            request["session_id"] = session_id;
+        }
+        
+        auto start = std::chrono::steady_clock::now();
+        try
+        {
+            json response = connection.call(request);
+            exit_code |= print_response(response);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << color::RED << "✗ Error: " << e.what() << color::RESET << std::endl;
+            exit_code = 1;
+        }
+        
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << color::BLUE << "  (" << elapsed << "ms)" << color::RESET << std::endl << std::endl;
+        count++;
+    }
+    
+    std::cerr << color::BLUE << count << " requests sent" << color::RESET << std::endl;
+    return exit_code;
 }
 
 /**
@@ -101,6 +500,10 @@ void print_usage(const char* program_name)
     std::cout << "  complete <prompt>        - LLM text completion" << std::endl;
     std::cout << "  chat <message>           - Chat with LLM" << std::endl;
     std::cout << "  summarize <text>         - Text summarization" << std::endl;
+    std::cout << "  stream <prompt>          - LLM completion, streamed token by token" << std::endl;
+    std::cout << "  batch <jobs_file>        - Run /api requests from a JSON Lines or JSON array file" << std::endl;
+    std::cout << "  repl <action>            - Send one request of action per stdin line over one" << std::endl;
+    std::cout << "                             connection (chat keeps one session)" << std::endl;
     std::cout << std::endl;
     std::cout << color::YELLOW << "Arguments:" << color::RESET << std::endl;
     std::cout << "  config_file              - Path to config.txt (default: config.txt)" << std::endl;
@@ -110,6 +513,9 @@ void print_usage(const char* program_name)
     std::cout << "  " << program_name << " complete \"Explain quantum computing\"" << std::endl;
     std::cout << "  " << program_name << " chat \"Tell me a joke\"" << std::endl;
     std::cout << "  " << program_name << " summarize \"Long text...\"" << std::endl;
+    std::cout << "  " << program_name << " stream \"Write a haiku\"" << std::endl;
+    std::cout << "  " << program_name << " batch jobs.jsonl > results.jsonl" << std::endl;
+    std::cout << "  " << program_name << " repl chat" << std::endl;
     std::cout << std::endl;
 }
 
@@ -133,38 +539,46 @@ int main(int argc, char* argv[])
         // Load configuration to get app-server port
         RuntimeConfig config = RuntimeConfig::from_file(config_path);
         
-        // Build request
-        json request;
-        
-        if (action == "echo")
+        if (action == "batch")
         {
-            request = {
-                {"action", "echo"},
-                {"message", argument}
-            };
-        }
-        else if (action == "complete")
-        {
-            request = {
-                {"action", "complete"},
-                {"prompt", argument}
-            };
-        }
-        else if (action == "chat")
-        {
-            request = {
-                {"action", "chat"},
-                {"message", argument}
-            };
+            json jobs = read_jobs(argument);
+            
+            std::cerr << color::BLUE << "Sending " << jobs.size() << " jobs to localhost:"
+                      << config.app_server_port << "/api/batch..." << color::RESET << std::endl;
+            
+            json summary = batch_server("localhost", config.app_server_port, jobs);
+            
+            if (!summary.value("done", false))
+            {
+                std::cerr << color::RED << "✗ Batch ended without a summary" << color::RESET << std::endl;
+                return 1;
+            }
+            
+            size_t failed = summary.value("failed", static_cast<size_t>(0));
+            std::cerr << (failed == 0 ? color::GREEN + "✓ " : color::YELLOW + "! ")
+                      << summary.value("completed", static_cast<size_t>(0)) << " jobs, "
+                      << failed << " failed, " << summary.value("elapsed_ms", 0.0) << "ms"
+                      << color::RESET << std::endl;
+            
+            return failed == 0 ? 0 : 1;
         }
-        else if (action == "summarize")
+        
+        if (action == "repl")
         {
-            request = {
-                {"action", "summarize"},
-                {"text", argument}
-            };
+            if (argument == "stream" || build_request(argument, "").is_null())
+            {
+                std::cerr << color::RED << "✗ repl needs echo, complete, chat or summarize" << color::RESET << std::endl;
+                return 1;
+            }
+            
+            ServerConnection connection("localhost", config.app_server_port);
+            return repl(connection, argument);
         }
-        else
+        
+        // Build request
+        json request = build_request(action, argument);
+        
+        if (request.is_null())
         {
             std::cerr << color::RED << "✗ Unknown action: " << action << color::RESET << std::endl;
             print_usage(argv[0]);
@@ -177,62 +591,12 @@ int main(int argc, char* argv[])
         std::cout << "  Server: localhost:" << config.app_server_port << std::endl;
         std::cout << std::endl;
         
-        json response = call_server("localhost", config.app_server_port, request);
+        json response = (action == "stream")
+            ? stream_server("localhost", config.app_server_port, request)
+            : call_server("localhost", config.app_server_port, request);
         
         // Display response
-        std::string status = response.value("status", "unknown");
-        
-        if (status == "success")
-        {
-            std::cout << color::GREEN << "✓ Success" << color::RESET << std::endl;
-            std::cout << std::endl;
-            
-            // Print relevant response fields
-            if (response.contains("completion"))
-            {
-                std::cout << color::CYAN << "Completion:" << color::RESET << std::endl;
-                std::cout << response["completion"] << std::endl;
-            }
-            else if (response.contains("ai_response"))
-            {
-                std::cout << color::CYAN << "AI Response:" << color::RESET << std::endl;
-                std::cout << response["ai_response"] << std::endl;
-            }
-            else if (response.contains("summary"))
-            {
-                std::cout << color::CYAN << "Summary:" << color::RESET << std::endl;
-                std::cout << response["summary"] << std::endl;
-            }
-            else if (response.contains("message"))
-            {
-                std::cout << color::CYAN << "Message:" << color::RESET << std::endl;
-                std::cout << response["message"] << std::endl;
-            }
-            else
-            {
-                std::cout << color::CYAN << "Full Response:" << color::RESET << std::endl;
-                std::cout << response.dump(2) << std::endl;
-            }
-        }
-        else
-        {
-            std::cout << color::RED << "✗ Request failed" << color::RESET << std::endl;
-            std::cout << std::endl;
-            
-            if (response.contains("message"))
-            {
-                std::cout << color::RED << "Error: " << response["message"] << color::RESET << std::endl;
-            }
-            else
-            {
-                std::cout << color::RED << "Full Response:" << color::RESET << std::endl;
-                std::cout << response.dump(2) << std::endl;
-            }
-            
-            return 1;
-        }
-        
-        return 0;
+        return print_response(response);
     }
     catch (const std::exception& e)
     {
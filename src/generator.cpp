@@ -33,11 +33,31 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <exception>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <cstdint>
 #include <cstdlib>
+#include <cctype>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <ctime>
 #include <filesystem>
+#include "json.hpp"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
 
 namespace fs = std::filesystem;
 
@@ -59,17 +79,330 @@ namespace llama
 namespace app
 {
 
+/**
+ * @struct GeneratorOptions
+ * @brief Command-line switches of the generator
+ */
+struct GeneratorOptions
+{
+    bool update = false;        ///< Refresh an existing project from changed templates
+    bool link_vendored = false; ///< Hard-link json.hpp and httplib.h instead of copying
+    size_t jobs = 0;            ///< File workers (0 = hardware concurrency)
+    bool quiet = false;         ///< No progress output (batch mode reports one line per project)
+    fs::path vendor_dir;        ///< Shared store for json.hpp and httplib.h (empty = copy into each project)
+};
+
+/**
+ * @brief Read entire file into string (one allocation, one read)
+ */
+inline std::string read_file(const fs::path& filepath)
+{
+    std::ifstream file(filepath, std::ios::binary | std::ios::ate);
+    
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Failed to read file: " + filepath.string());
+    }
+    
+    std::string content(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0);
+    file.read(content.data(), static_cast<std::streamsize>(content.size()));
+    
+    return content;
+}
+
+/**
+ * @brief 64-bit FNV-1a over a buffer
+ */
+inline uint64_t fnv1a(std::string_view data)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : data)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * @brief Modification time as an integer, for the manifest
+ */
+inline int64_t mtime_of(const fs::path& filepath)
+{
+    return static_cast<int64_t>(fs::last_write_time(filepath).time_since_epoch().count());
+}
+
+/**
+ * @struct ProjectExtras
+ * @brief Per-project additions from a batch manifest
+ */
+struct ProjectExtras
+{
+    std::vector<std::pair<std::string, std::string>> config;        ///< "key = value" lines appended to config.txt
+    std::map<std::string, std::string, std::less<>> placeholders;   ///< Extra {{NAME}} values
+};
+
+/**
+ * @class TemplateStore
+ * @brief Template tree read into memory once, shared by many generators
+ * 
+ * Batch generation renders every project from the same bytes instead of
+ * re-reading the template directory per project. The vendored libraries
+ * stay on disk: they are cloned or linked, never read. Read-only after
+ * construction, so concurrent generators need no locking.
+ */
+class TemplateStore
+{
+public:
+    /**
+     * @struct Entry
+     * @brief One template file and its stamps
+     */
+    struct Entry
+    {
+        std::string content;
+        int64_t mtime = 0;
+        uintmax_t size = 0;
+        uint64_t hash = 0;          ///< FNV-1a of content
+    };
+    
+    /// Files under the template root that are not held in memory
+    static constexpr const char* STREAMED[] = {"include/json.hpp", "include/httplib.h"};
+
+private:
+    std::map<std::string, Entry> files_;
+    std::map<std::string, uint64_t> streamed_hashes_;   ///< FNV-1a of the files not held
+
+public:
+    /**
+     * @brief Load every template file under root
+     * 
+     * @param root Template directory
+     * @param extra Further files to load (e.g., the shared config.txt)
+     * 
+     * @throws std::runtime_error if the directory or a file cannot be read
+     */
+    TemplateStore(const fs::path& root, const std::vector<fs::path>& extra = {})
+    {
+        if (!fs::is_directory(root))
+        {
+            throw std::runtime_error("Template directory not found: " + root.string());
+        }
+        
+        for (const auto& item : fs::recursive_directory_iterator(root))
+        {
+            if (!item.is_regular_file())
+            {
+                continue;
+            }
+            
+            std::string relative = item.path().lexically_relative(root).generic_string();
+            bool streamed = std::any_of(std::begin(STREAMED), std::end(STREAMED),
+                                        [&relative](const char* name) { return relative == name; });
+            if (!streamed)
+            {
+                load(item.path());
+            }
+            else
+            {
+                streamed_hashes_[item.path().generic_string()] = fnv1a(read_file(item.path()));
+            }
+        }
+        
+        for (const auto& file : extra)
+        {
+            load(file);
+        }
+    }
+    
+    /**
+     * @brief A loaded file, or nullptr
+     * 
+     * @param path Path as the generator builds it (template root / relative)
+     */
+    const Entry* find(const fs::path& path) const
+    {
+        auto it = files_.find(path.generic_string());
+        return it == files_.end() ? nullptr : &it->second;
+    }
+    
+    /**
+     * @brief FNV-1a of any file under the root (held or streamed), 0 if unknown
+     */
+    uint64_t content_hash(const fs::path& path) const
+    {
+        if (const Entry* entry = find(path))
+        {
+            return entry->hash;
+        }
+        auto it = streamed_hashes_.find(path.generic_string());
+        return it == streamed_hashes_.end() ? 0 : it->second;
+    }
+    
+    size_t size() const
+    {
+        return files_.size();
+    }
+
+private:
+    void load(const fs::path& path)
+    {
+        Entry entry;
+        entry.content = read_file(path);
+        entry.mtime = mtime_of(path);
+        entry.size = entry.content.size();
+        entry.hash = fnv1a(entry.content);
+        files_[path.generic_string()] = std::move(entry);
+    }
+};
+
 /**
  * @class ProjectGenerator
  * @brief Generates llama.cpp-based C++ projects from templates
+ * 
+ * Generation first plans every output file, then writes them on a few
+ * worker threads:
+ *   - Vendored libraries (json.hpp, httplib.h) are cloned (reflink where the
+ *     filesystem supports it), hard-linked with --link, or copied by the OS
+ *   - Headers and legal files are copied byte for byte
+ *   - Sources, build.py and README.md get {{PROJECT_NAME}} and {{DATE}}
+ *     substituted in a single pass
+ * 
+ * Each project records what was written in .generator-manifest. With
+ * --update, a file is rewritten only if its template changed since; a file
+ * that was also edited in the project is left alone and the new version is
+ * written next to it as <file>.new.
  */
 class ProjectGenerator
 {
 private:
+    enum class FileKind
+    {
+        Vendored,   ///< Large third-party header, never modified
+        Copy,       ///< Copied byte for byte
+        Template,   ///< Placeholders substituted
+        Config,     ///< config.txt plus the project's overrides
+        Generated   ///< Written by the generator itself (no template)
+    };
+    
+    enum class Outcome
+    {
+        Written,
+        Unchanged,
+        Conflict    ///< Edited in the project: new version written as <file>.new
+    };
+    
+    /**
+     * @struct PlannedFile
+     * @brief One output file and how to produce it
+     */
+    struct PlannedFile
+    {
+        int step;                   ///< Progress step it is reported under
+        fs::path source;
+        fs::path dest;              ///< Relative to the project directory
+        FileKind kind;
+        std::string message;        ///< Reported on success
+        bool executable = false;
+        std::string content;        ///< FileKind::Generated: the bytes to write
+        
+        Outcome outcome = Outcome::Unchanged;
+        uint64_t hash = 0;          ///< FNV-1a of the written content
+        std::exception_ptr error;
+    };
+    
+    /**
+     * @struct ManifestEntry
+     * @brief What was generated for one file
+     */
+    struct ManifestEntry
+    {
+        int64_t template_mtime = 0;
+        uintmax_t template_size = 0;
+        uint64_t hash = 0;
+    };
+    
+    /**
+     * @struct HeaderInfo
+     * @brief A template header and its line in the project tree
+     */
+    struct HeaderInfo
+    {
+        const char* name;
+        const char* description;
+    };
+
+public:
+    /**
+     * @struct Tally
+     * @brief What one run did to the project's files
+     */
+    struct Tally
+    {
+        size_t written = 0;
+        size_t unchanged = 0;
+        size_t conflicts = 0;
+    };
+
+private:
+    
+    static constexpr const char* MANIFEST = ".generator-manifest";
+    
+    /// Template headers copied into include/, in project-tree order
+    static constexpr HeaderInfo HEADERS[] = {
+        {"llama_client.hpp", "LLM HTTP client"},
+        {"connection_pool.hpp", "Keep-alive connection pool"},
+        {"backend_pool.hpp", "Multi-backend load balancer"},
+        {"request_scheduler.hpp", "Slot-limited job queue"},
+        {"response_cache.hpp", "Completion LRU cache"},
+        {"semantic_cache.hpp", "Embedding-similarity cache"},
+        {"slot_affinity.hpp", "KV-cache slot pinning"},
+        {"session_store.hpp", "Server-side chat history"},
+        {"token_count_cache.hpp", "Per-segment token counts"},
+        {"embedding_matrix.hpp", "Contiguous embedding rows and reply reader"},
+        {"json_fields.hpp", "Lazy JSON field extraction"},
+        {"metrics.hpp", "Prometheus histograms"},
+        {"logger.hpp", "Async level-gated logger"},
+        {"summary_pipeline.hpp", "Map-reduce summarization"},
+        {"request_context.hpp", "Deadlines and cancellation"},
+        {"admission_control.hpp", "429/503 load shedding"},
+        {"action_table.hpp", "Compile-time action dispatch"},
+        {"proxy_stream.hpp", "/v1 pass-through relay"},
+        {"response_compression.hpp", "gzip/zstd response encoding"},
+        {"pipelined_server.hpp", "Per-connection read buffer"},
+        {"llama_supervisor.hpp", "llama-server launcher"},
+        {"runtime_config.hpp", "Config parser"},
+        {"app_server_base.hpp", "CRTP base class"}
+    };
+    
+    static constexpr const char* STEPS[] = {
+        "",
+        "Creating project structure...",
+        "Copying configuration...",
+        "Copying header-only libraries...",
+        "Copying template files...",
+        "Creating example sources...",
+        "Creating build scripts...",
+        "Copying legal files...",
+        "Writing manifest..."
+    };
+    
     std::string project_name_;
     fs::path project_path_;
     fs::path template_dir_;
     fs::path config_path_;
+    GeneratorOptions options_;
+    std::string date_;                  ///< {{DATE}}, fixed for the whole run
+    ProjectExtras extras_;
+    const TemplateStore* templates_;    ///< Preloaded templates, or nullptr to read from disk
+    std::vector<PlannedFile> plan_;
+    std::map<std::string, ManifestEntry> manifest_;
+    Tally tally_;
+    fs::path vendor_path_;              ///< Shared json.hpp/httplib.h directory, if any
+    
+    std::ostream discard_{nullptr};     ///< Swallows output in quiet mode
+    std::ostream& out_;
     
     /**
      * @brief Check if directory exists
@@ -92,59 +425,77 @@ private:
      */
     bool execute_command(const std::string& command) const
     {
-        std::cout << color::BLUE << "  $ " << command << color::RESET << std::endl;
+        out_ << color::BLUE << "  $ " << command << color::RESET << std::endl;
         return (system(command.c_str()) == 0);
     }
     
     /**
-     * @brief Read entire file into string
+     * @brief Write string content to file
      */
-    std::string read_file(const fs::path& filepath) const
+    static void write_file(const fs::path& filepath, const std::string& content)
     {
-        std::ifstream file(filepath);
-        
+        std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
         if (!file.is_open())
         {
-            throw std::runtime_error("Failed to read file: " + filepath.string());
+            throw std::runtime_error("Failed to create file: " + filepath.string());
         }
-        
-        std::string content;
-        std::string line;
-        while (std::getline(file, line))
+        file.write(content.data(), static_cast<std::streamsize>(content.size()));
+        if (!file)
         {
-            content += line + "\n";
+            throw std::runtime_error("Failed to write file: " + filepath.string());
         }
-        file.close();
-        
-        return content;
     }
     
     /**
-     * @brief Write string content to file
+     * @brief Share the source's data blocks (reflink), where supported
+     * 
+     * @return false if the filesystem cannot clone (dest may then be partial)
      */
-    void write_file(const fs::path& filepath, const std::string& content) const
+    static bool clone_file(const fs::path& src, const fs::path& dest)
     {
-        std::ofstream file(filepath);
-        if (!file.is_open())
+        #if defined(__linux__) && defined(FICLONE)
+        int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+        if (in < 0)
         {
-            throw std::runtime_error("Failed to create file: " + filepath.string());
+            return false;
+        }
+        int out = ::open(dest.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        bool cloned = out >= 0 && ::ioctl(out, FICLONE, in) == 0;
+        if (out >= 0)
+        {
+            ::close(out);
         }
-        file << content;
-        file.close();
+        ::close(in);
+        if (cloned)
+        {
+            fs::permissions(dest, fs::status(src).permissions());
+        }
+        return cloned;
+        #else
+        (void)src;
+        (void)dest;
+        return false;
+        #endif
     }
     
     /**
      * @brief Copy file from source to destination
+     * 
+     * Tries a reflink first; otherwise the OS copies the bytes
+     * (copy_file_range/sendfile), without passing them through this process.
      */
-    void copy_file(const fs::path& src, const fs::path& dest) const
+    static void copy_file(const fs::path& src, const fs::path& dest)
     {
-        fs::copy_file(src, dest, fs::copy_options::overwrite_existing);
+        if (!clone_file(src, dest))
+        {
+            fs::copy_file(src, dest, fs::copy_options::overwrite_existing);
+        }
     }
     
     /**
      * @brief Make file executable (Unix-like systems)
      */
-    void make_executable(const fs::path& filepath) const
+    static void make_executable(const fs::path& filepath)
     {
         #ifndef _WIN32
         chmod(filepath.c_str(), 0755);
@@ -154,7 +505,7 @@ private:
     /**
      * @brief Get current date in human-readable format
      */
-    std::string get_current_date() const
+    static std::string get_current_date()
     {
         time_t now = time(nullptr);
         char buf[80];
@@ -162,35 +513,361 @@ private:
         return std::string(buf);
     }
     
+    /**
+     * @brief Hash of a file's content, or 0 if it cannot be read
+     */
+    static uint64_t hash_file(const fs::path& filepath)
+    {
+        try
+        {
+            return fnv1a(read_file(filepath));
+        }
+        catch (const std::exception&)
+        {
+            return 0;
+        }
+    }
+    
     /**
      * @brief Replace placeholders in template content
      * 
      * Supported placeholders:
      *   {{PROJECT_NAME}} - Name of the generated project
      *   {{DATE}} - Current date
+     *   {{NAME}} - Any extra placeholder given for the project (batch mode)
+     * 
+     * One scan over the content; anything else between braces (e.g., JSON
+     * initializer lists in C++) is kept as it is.
      */
     std::string replace_placeholders(const std::string& content) const
     {
-        std::string result = content;
+        std::string result;
+        result.reserve(content.size() + 64);
+        
+        size_t start = 0;
+        size_t pos;
+        while ((pos = content.find("{{", start)) != std::string::npos)
+        {
+            result.append(content, start, pos - start);
+            
+            // A name is [A-Z0-9_]+ followed directly by "}}"
+            size_t end = pos + 2;
+            while (end < content.size() && (std::isupper(static_cast<unsigned char>(content[end]))
+                   || std::isdigit(static_cast<unsigned char>(content[end])) || content[end] == '_'))
+            {
+                end++;
+            }
+            
+            const std::string* value = nullptr;
+            if (end > pos + 2 && content.compare(end, 2, "}}") == 0)
+            {
+                std::string_view name(content.data() + pos + 2, end - pos - 2);
+                if (name == "PROJECT_NAME")
+                {
+                    value = &project_name_;
+                }
+                else if (name == "DATE")
+                {
+                    value = &date_;
+                }
+                else if (auto extra = extras_.placeholders.find(name); extra != extras_.placeholders.end())
+                {
+                    value = &extra->second;
+                }
+            }
+            
+            if (value)
+            {
+                result += *value;
+                start = end + 2;
+            }
+            else
+            {
+                result += '{';
+                start = pos + 1;
+            }
+        }
+        result.append(content, start, std::string::npos);
+        
+        return result;
+    }
+    
+    /**
+     * @brief Template identity recorded in the manifest: mtime and size
+     * 
+     * Generated files have no template; their content hash stands in.
+     */
+    std::pair<int64_t, uintmax_t> stamp_of(const PlannedFile& file) const
+    {
+        if (file.kind == FileKind::Generated)
+        {
+            return {static_cast<int64_t>(fnv1a(file.content)), file.content.size()};
+        }
+        if (const TemplateStore::Entry* cached = templates_ ? templates_->find(file.source) : nullptr)
+        {
+            return {cached->mtime, cached->size};
+        }
+        return {mtime_of(file.source), fs::file_size(file.source)};
+    }
+    
+    /**
+     * @brief Content hash of a template, from the store if one was given
+     */
+    uint64_t template_hash(const fs::path& source) const
+    {
+        uint64_t hash = templates_ ? templates_->content_hash(source) : 0;
+        return hash != 0 ? hash : hash_file(source);
+    }
+    
+    /**
+     * @brief config.txt with the project's overrides appended
+     * 
+     * Later keys win when the app server parses config.txt, so appending
+     * overrides works with both the classic and the keyed layout.
+     */
+    std::string render_config(const std::string& base) const
+    {
+        if (extras_.config.empty())
+        {
+            return base;
+        }
+        
+        std::string content = base;
+        if (!content.empty() && content.back() != '\n')
+        {
+            content += '\n';
+        }
+        content += "\n# Project overrides (llama-app-generator --batch)\n";
+        for (const auto& [key, value] : extras_.config)
+        {
+            content += key + " = " + value + "\n";
+        }
+        return content;
+    }
+    
+    /**
+     * @brief Add a file to the plan (skipped if the template is optional and absent)
+     */
+    void plan(int step, const fs::path& source, const fs::path& dest, FileKind kind,
+              const std::string& message, bool executable = false)
+    {
+        PlannedFile file;
+        file.step = step;
+        file.source = source;
+        file.dest = dest;
+        file.kind = kind;
+        file.message = message;
+        file.executable = executable;
+        plan_.push_back(std::move(file));
+    }
+    
+    /**
+     * @brief Produce one planned file
+     * 
+     * Runs on a worker thread; touches only its own PlannedFile.
+     */
+    void produce(PlannedFile& file) const
+    {
+        fs::path dest = project_path_ / file.dest;
+        const std::string key = file.dest.generic_string();
         
-        // Replace {{PROJECT_NAME}}
-        size_t pos = 0;
-        while ((pos = result.find("{{PROJECT_NAME}}", pos)) != std::string::npos)
+        auto recorded = manifest_.find(key);
+        bool exists = file_exists(dest);
+        const TemplateStore::Entry* cached = templates_ ? templates_->find(file.source) : nullptr;
+        
+        if (options_.update && recorded != manifest_.end() && exists
+            && std::make_pair(recorded->second.template_mtime, recorded->second.template_size) == stamp_of(file))
+        {
+            file.outcome = Outcome::Unchanged;
+            file.hash = recorded->second.hash;
+            return;
+        }
+        
+        // The hash tells --update whether the project copy was edited
+        // later. Vendored libraries are not read at all on a fresh
+        // generation (hash 0: assumed unedited).
+        std::string content;
+        if (file.kind == FileKind::Template)
+        {
+            content = cached ? replace_placeholders(cached->content) : replace_placeholders(read_file(file.source));
+            file.hash = fnv1a(content);
+        }
+        else if (file.kind == FileKind::Config)
+        {
+            content = cached ? render_config(cached->content) : render_config(read_file(file.source));
+            file.hash = fnv1a(content);
+        }
+        else if (file.kind == FileKind::Generated)
+        {
+            content = file.content;
+            file.hash = fnv1a(content);
+        }
+        else if (cached)
+        {
+            file.hash = cached->hash;
+        }
+        else if (options_.update || file.kind == FileKind::Copy)
+        {
+            file.hash = template_hash(file.source);
+        }
+        
+        if (options_.update && exists)
+        {
+            uint64_t current = hash_file(dest);
+            if (current == file.hash)
+            {
+                file.outcome = Outcome::Unchanged;
+                return;
+            }
+            
+            // Edited in the project since it was generated: keep the edits
+            bool edited = recorded == manifest_.end()
+                || (recorded->second.hash != 0 && current != recorded->second.hash);
+            if (edited)
+            {
+                dest += ".new";
+                file.outcome = Outcome::Conflict;
+            }
+        }
+        
+        if (file.outcome != Outcome::Conflict)
+        {
+            file.outcome = Outcome::Written;
+        }
+        
+        fs::remove(dest);
+        if (file.kind == FileKind::Template || file.kind == FileKind::Config || file.kind == FileKind::Generated)
+        {
+            write_file(dest, content);
+        }
+        else if (cached)
+        {
+            write_file(dest, cached->content);
+        }
+        else if (file.kind == FileKind::Vendored && options_.link_vendored)
+        {
+            std::error_code error;
+            fs::create_hard_link(file.source, dest, error);
+            if (error)
+            {
+                // e.g., the project is on another filesystem
+                copy_file(file.source, dest);
+            }
+        }
+        else
+        {
+            copy_file(file.source, dest);
+        }
+        
+        if (file.executable)
         {
-            result.replace(pos, 16, project_name_);
-            pos += project_name_.length();
+            make_executable(dest);
         }
+    }
+    
+    /**
+     * @brief Produce every planned file on a pool of worker threads
+     * 
+     * @throws std::runtime_error naming the first file that failed
+     */
+    void run_plan()
+    {
+        size_t workers = options_.jobs > 0 ? options_.jobs : std::max(1u, std::thread::hardware_concurrency());
+        workers = std::min(workers, plan_.size());
+        
+        std::atomic<size_t> next{0};
+        auto work = [this, &next]()
+        {
+            for (size_t i = next++; i < plan_.size(); i = next++)
+            {
+                try
+                {
+                    produce(plan_[i]);
+                }
+                catch (...)
+                {
+                    plan_[i].error = std::current_exception();
+                }
+            }
+        };
+        
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < workers; i++)
+        {
+            threads.emplace_back(work);
+        }
+        work();
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        
+        for (const auto& file : plan_)
+        {
+            if (file.error)
+            {
+                try
+                {
+                    std::rethrow_exception(file.error);
+                }
+                catch (const std::exception& e)
+                {
+                    throw std::runtime_error(file.dest.generic_string() + ": " + e.what());
+                }
+            }
+        }
+    }
+    
+    /**
+     * @brief Load .generator-manifest (empty if the project has none)
+     */
+    void load_manifest()
+    {
+        std::ifstream file(project_path_ / MANIFEST);
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            
+            std::istringstream fields(line);
+            std::string path;
+            ManifestEntry entry;
+            if (fields >> std::quoted(path) >> entry.template_mtime >> entry.template_size >> std::hex >> entry.hash)
+            {
+                manifest_[path] = entry;
+            }
+        }
+    }
+    
+    /**
+     * @brief Record template stamps and written hashes for --update
+     */
+    void write_manifest()
+    {
+        std::ostringstream out;
+        out << "# Written by llama-app-generator; used by --update. Do not edit.\n";
         
-        // Replace {{DATE}}
-        std::string date = get_current_date();
-        pos = 0;
-        while ((pos = result.find("{{DATE}}", pos)) != std::string::npos)
+        for (const auto& file : plan_)
         {
-            result.replace(pos, 8, date);
-            pos += date.length();
+            const std::string key = file.dest.generic_string();
+            uint64_t hash = file.hash;
+            
+            // A conflict leaves the project's version in place: keep the
+            // old record so the file still counts as edited next time
+            auto recorded = manifest_.find(key);
+            if (file.outcome == Outcome::Conflict && recorded != manifest_.end())
+            {
+                hash = recorded->second.hash;
+            }
+            
+            auto [mtime, size] = stamp_of(file);
+            out << std::quoted(key) << ' ' << mtime << ' ' << size << ' ' << std::hex << hash << std::dec << '\n';
         }
         
-        return result;
+        write_file(project_path_ / MANIFEST, out.str());
     }
 
 public:
@@ -201,17 +878,29 @@ public:
      * @param output_dir Output directory for generated project
      * @param templates Template directory path
      * @param config Configuration file path (config.txt)
+     * @param options Update mode, vendored-file linking and parallelism
+     * @param extras Config overrides and extra placeholders
+     * @param store Templates already in memory (must outlive the generator),
+     *              or nullptr to read them from template_dir
      */
     ProjectGenerator(
         const std::string& name,
         const fs::path& output_dir,
         const fs::path& templates,
-        const fs::path& config
+        const fs::path& config,
+        const GeneratorOptions& options = GeneratorOptions(),
+        const ProjectExtras& extras = ProjectExtras(),
+        const TemplateStore* store = nullptr
     )
         : project_name_(name)
         , project_path_(output_dir / name)
         , template_dir_(templates)
         , config_path_(config)
+        , options_(options)
+        , date_(get_current_date())
+        , extras_(extras)
+        , templates_(store)
+        , out_(options.quiet ? discard_ : std::cout)
     {
     }
     
@@ -219,6 +908,7 @@ public:
      * @brief Generate complete project structure
      * 
      * Creates directories, copies templates, and sets up build environment.
+     * In update mode, refreshes an existing project instead.
      * 
      * @throws std::runtime_error if generation fails
      */
@@ -228,6 +918,11 @@ public:
         validate_preconditions();
         
         create_project_structure();
+        if (options_.update)
+        {
+            load_manifest();
+        }
+        
         copy_configuration();
         copy_libraries();
         copy_template_headers();
@@ -235,199 +930,724 @@ public:
         create_build_scripts();
         copy_legal_files();
         
+        run_plan();
+        report();
+        write_manifest();
+        
         print_success();
     }
+    
+    /**
+     * @brief File counts of the last generate()
+     */
+    const Tally& tally() const
+    {
+        return tally_;
+    }
+    
+    const fs::path& project_path() const
+    {
+        return project_path_;
+    }
 
 private:
     void print_header() const
     {
-        std::cout << color::CYAN << "================================================" << color::RESET << std::endl;
-        std::cout << color::CYAN << "  llama-app-generator v1.0.0" << color::RESET << std::endl;
-        std::cout << color::CYAN << "  namespace: pooriayousefi::llama::app" << color::RESET << std::endl;
-        std::cout << color::CYAN << "================================================" << color::RESET << std::endl;
-        std::cout << std::endl;
+        out_ << color::CYAN << "================================================" << color::RESET << std::endl;
+        out_ << color::CYAN << "  llama-app-generator v1.0.0" << color::RESET << std::endl;
+        out_ << color::CYAN << "  namespace: pooriayousefi::llama::app" << color::RESET << std::endl;
+        out_ << color::CYAN << "================================================" << color::RESET << std::endl;
+        out_ << std::endl;
         
-        std::cout << color::YELLOW << "Project:     " << project_name_ << color::RESET << std::endl;
-        std::cout << color::YELLOW << "Path:        " << project_path_ << color::RESET << std::endl;
-        std::cout << color::YELLOW << "Templates:   " << template_dir_ << color::RESET << std::endl;
-        std::cout << color::YELLOW << "Config:      " << config_path_ << color::RESET << std::endl;
-        std::cout << std::endl;
+        out_ << color::YELLOW << "Project:     " << project_name_ << color::RESET << std::endl;
+        out_ << color::YELLOW << "Path:        " << project_path_ << color::RESET << std::endl;
+        out_ << color::YELLOW << "Templates:   " << template_dir_ << color::RESET << std::endl;
+        if (!options_.update)
+        {
+            out_ << color::YELLOW << "Config:      " << config_path_ << color::RESET << std::endl;
+        }
+        else
+        {
+            out_ << color::YELLOW << "Mode:        update" << color::RESET << std::endl;
+        }
+        out_ << std::endl;
     }
     
     void validate_preconditions() const
     {
-        // Check if project already exists
-        if (directory_exists(project_path_))
+        if (options_.update)
         {
-            std::cout << color::RED << "✗ Error: Project directory already exists!" << color::RESET << std::endl;
-            throw std::runtime_error("Project already exists: " + project_path_.string());
+            // Update needs the project, not config.txt
+            if (!directory_exists(project_path_))
+            {
+                out_ << color::RED << "✗ Error: Project directory does not exist!" << color::RESET << std::endl;
+                throw std::runtime_error("Nothing to update: " + project_path_.string());
+            }
         }
-        
-        // Validate config.txt exists
-        if (!file_exists(config_path_))
+        else
         {
-            std::cout << color::RED << "✗ Error: config.txt not found at: " << config_path_ << color::RESET << std::endl;
-            throw std::runtime_error("config.txt not found");
+            // Check if project already exists
+            if (directory_exists(project_path_))
+            {
+                out_ << color::RED << "✗ Error: Project directory already exists! (use --update)" << color::RESET << std::endl;
+                throw std::runtime_error("Project already exists: " + project_path_.string());
+            }
+            
+            // Validate config.txt exists
+            if (!file_exists(config_path_))
+            {
+                out_ << color::RED << "✗ Error: config.txt not found at: " << config_path_ << color::RESET << std::endl;
+                throw std::runtime_error("config.txt not found");
+            }
         }
         
-        // Validate template directory
-        if (!directory_exists(template_dir_))
+        // Validate template directory (a preloaded store already did)
+        if (!templates_ && !directory_exists(template_dir_))
         {
-            std::cout << color::RED << "✗ Error: Template directory not found: " << template_dir_ << color::RESET << std::endl;
+            out_ << color::RED << "✗ Error: Template directory not found: " << template_dir_ << color::RESET << std::endl;
             throw std::runtime_error("Template directory not found");
         }
     }
     
     void create_project_structure()
     {
-        std::cout << color::YELLOW << "[1/8] Creating project structure..." << color::RESET << std::endl;
+        out_ << color::YELLOW << "[1/8] " << STEPS[1] << color::RESET << std::endl;
         
         fs::create_directories(project_path_ / "src");
         fs::create_directories(project_path_ / "include");
         fs::create_directories(project_path_ / "bin");
         fs::create_directories(project_path_ / "docs");
         
-        std::cout << color::GREEN << "  ✓ Created directories" << color::RESET << std::endl;
-        std::cout << std::endl;
+        out_ << color::GREEN << "  ✓ Created directories" << color::RESET << std::endl;
+        out_ << std::endl;
     }
     
     void copy_configuration()
     {
-        std::cout << color::YELLOW << "[2/8] Copying configuration..." << color::RESET << std::endl;
-        
-        copy_file(config_path_, project_path_ / "config.txt");
-        
-        std::cout << color::GREEN << "  ✓ Copied config.txt" << color::RESET << std::endl;
-        std::cout << std::endl;
+        // The project's config.txt is the user's own after generation
+        if (!options_.update)
+        {
+            plan(2, config_path_, "config.txt", FileKind::Config,
+                 extras_.config.empty() ? "Copied config.txt" : "Created config.txt (with overrides)");
+        }
     }
     
+    /**
+     * @brief Plan json.hpp and httplib.h, or reference them in the vendor directory
+     * 
+     * With --vendor-dir the two headers are stored once under
+     * <vendor-dir>/<content hash>/ and the project only gets vendor.txt
+     * naming that directory. Projects generated from the same templates
+     * then share one include path, and with it ccache entries and the
+     * libhttplib.a and precompiled header that build.py keeps there.
+     */
     void copy_libraries()
     {
-        std::cout << color::YELLOW << "[3/8] Copying header-only libraries..." << color::RESET << std::endl;
+        const fs::path json_source = template_dir_ / "include" / "json.hpp";
+        const fs::path httplib_source = template_dir_ / "include" / "httplib.h";
+        
+        if (options_.vendor_dir.empty())
+        {
+            plan(3, json_source, fs::path("include") / "json.hpp",
+                 FileKind::Vendored, "Copied json.hpp (nlohmann/json)");
+            plan(3, httplib_source, fs::path("include") / "httplib.h",
+                 FileKind::Vendored, "Copied httplib.h (cpp-httplib)");
+            return;
+        }
         
-        copy_file(template_dir_ / "include" / "json.hpp", project_path_ / "include" / "json.hpp");
-        copy_file(template_dir_ / "include" / "httplib.h", project_path_ / "include" / "httplib.h");
+        std::ostringstream key;
+        key << std::hex << std::setfill('0') << std::setw(16) << template_hash(json_source)
+            << std::setw(16) << template_hash(httplib_source);
+        std::ostringstream name;
+        name << std::hex << std::setfill('0') << std::setw(16) << fnv1a(key.str());
         
-        std::cout << color::GREEN << "  ✓ Copied json.hpp (nlohmann/json)" << color::RESET << std::endl;
-        std::cout << color::GREEN << "  ✓ Copied httplib.h (cpp-httplib)" << color::RESET << std::endl;
-        std::cout << std::endl;
+        vendor_path_ = (fs::absolute(options_.vendor_dir) / name.str()).lexically_normal();
+        publish_vendor(vendor_path_, {json_source, httplib_source});
+        
+        // Copies left from before the switch would shadow the shared ones
+        // ("json.hpp" is looked up next to the including header first)
+        std::string message = "Created vendor.txt (json.hpp, httplib.h in " + vendor_path_.string() + ")";
+        if (options_.update)
+        {
+            bool removed = fs::remove(project_path_ / "include" / "json.hpp");
+            removed = fs::remove(project_path_ / "include" / "httplib.h") || removed;
+            if (removed)
+            {
+                message += "; removed the project's copies";
+            }
+        }
+        
+        plan(3, fs::path(), "vendor.txt", FileKind::Generated, message);
+        plan_.back().content = vendor_path_.generic_string() + "\n";
     }
     
-    void copy_template_headers()
+    /**
+     * @brief Store the vendored headers in a vendor directory entry, once
+     * 
+     * The entry is assembled under a private name and renamed into place,
+     * so concurrent generators (batch mode, other processes) either publish
+     * it or find it complete. Published files are read-only: every project
+     * using the entry shares them.
+     */
+    static void publish_vendor(const fs::path& target, const std::vector<fs::path>& sources)
     {
-        std::cout << color::YELLOW << "[4/8] Copying template files..." << color::RESET << std::endl;
+        auto complete = [&target, &sources]()
+        {
+            return std::all_of(sources.begin(), sources.end(), [&target](const fs::path& source)
+            {
+                return fs::is_regular_file(target / source.filename());
+            });
+        };
+        if (complete())
+        {
+            return;
+        }
         
-        copy_file(template_dir_ / "include" / "llama_client.hpp", project_path_ / "include" / "llama_client.hpp");
-        copy_file(template_dir_ / "include" / "runtime_config.hpp", project_path_ / "include" / "runtime_config.hpp");
-        copy_file(template_dir_ / "include" / "app_server_base.hpp", project_path_ / "include" / "app_server_base.hpp");
+        fs::path staging = target;
+        staging += ".tmp-" + std::to_string(::getpid()) + "-"
+            + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        fs::remove_all(staging);
+        fs::create_directories(staging);
+        for (const auto& source : sources)
+        {
+            copy_file(source, staging / source.filename());
+            fs::permissions(staging / source.filename(),
+                            fs::perms::owner_read | fs::perms::group_read | fs::perms::others_read);
+        }
         
-        std::cout << color::GREEN << "  ✓ Copied llama_client.hpp" << color::RESET << std::endl;
-        std::cout << color::GREEN << "  ✓ Copied runtime_config.hpp" << color::RESET << std::endl;
-        std::cout << color::GREEN << "  ✓ Copied app_server_base.hpp (CRTP)" << color::RESET << std::endl;
-        std::cout << std::endl;
+        std::error_code error;
+        fs::rename(staging, target, error);
+        if (error)
+        {
+            fs::remove_all(staging);
+            if (!complete())
+            {
+                throw std::runtime_error("Cannot publish vendored headers to " + target.string() + ": " + error.message());
+            }
+        }
+    }
+    
+    void copy_template_headers()
+    {
+        for (const auto& header : HEADERS)
+        {
+            std::string message = std::string("Copied ") + header.name;
+            if (std::string_view(header.name) == "app_server_base.hpp")
+            {
+                message += " (CRTP)";
+            }
+            plan(4, template_dir_ / "include" / header.name, fs::path("include") / header.name,
+                 FileKind::Copy, message);
+        }
     }
     
     void copy_example_sources()
     {
-        std::cout << color::YELLOW << "[5/8] Creating example sources..." << color::RESET << std::endl;
-        
-        copy_file(template_dir_ / "src" / "example_app.cpp", project_path_ / "src" / "server.cpp");
-        copy_file(template_dir_ / "src" / "example_client.cpp", project_path_ / "src" / "client.cpp");
-        
-        std::cout << color::GREEN << "  ✓ Created src/server.cpp (example application)" << color::RESET << std::endl;
-        std::cout << color::GREEN << "  ✓ Created src/client.cpp (CLI client)" << color::RESET << std::endl;
-        std::cout << std::endl;
+        plan(5, template_dir_ / "src" / "example_app.cpp", fs::path("src") / "server.cpp",
+             FileKind::Template, "Created src/server.cpp (example application)");
+        plan(5, template_dir_ / "src" / "example_client.cpp", fs::path("src") / "client.cpp",
+             FileKind::Template, "Created src/client.cpp (CLI client)");
+        plan(5, template_dir_ / "src" / "example_bench.cpp", fs::path("src") / "bench.cpp",
+             FileKind::Template, "Created src/bench.cpp (load generator)");
     }
     
     void create_build_scripts()
     {
-        std::cout << color::YELLOW << "[6/8] Creating build scripts..." << color::RESET << std::endl;
-        
-        copy_file(template_dir_ / "scripts" / "build.py", project_path_ / "build.py");
-        make_executable(project_path_ / "build.py");
+        plan(6, template_dir_ / "scripts" / "build.py", "build.py",
+             FileKind::Template, "Created build.py (cross-platform)", true);
         
         // Process README with placeholders
         if (file_exists(template_dir_ / "docs" / "README.md"))
         {
-            std::string readme_content = read_file(template_dir_ / "docs" / "README.md");
-            readme_content = replace_placeholders(readme_content);
-            write_file(project_path_ / "README.md", readme_content);
-            
-            std::cout << color::GREEN << "  ✓ Created README.md" << color::RESET << std::endl;
+            plan(6, template_dir_ / "docs" / "README.md", "README.md", FileKind::Template, "Created README.md");
         }
-        
-        std::cout << color::GREEN << "  ✓ Created build.py (cross-platform)" << color::RESET << std::endl;
-        std::cout << std::endl;
     }
     
     void copy_legal_files()
     {
-        std::cout << color::YELLOW << "[7/8] Copying legal files..." << color::RESET << std::endl;
-        
         if (file_exists(template_dir_ / "legal" / "LICENSE"))
         {
-            copy_file(template_dir_ / "legal" / "LICENSE", project_path_ / "LICENSE");
-            std::cout << color::GREEN << "  ✓ Copied LICENSE (Apache 2.0)" << color::RESET << std::endl;
+            plan(7, template_dir_ / "legal" / "LICENSE", "LICENSE", FileKind::Copy, "Copied LICENSE (Apache 2.0)");
         }
         
         if (file_exists(template_dir_ / "legal" / "NOTICE"))
         {
-            copy_file(template_dir_ / "legal" / "NOTICE", project_path_ / "NOTICE");
-            std::cout << color::GREEN << "  ✓ Copied NOTICE (namespace protection)" << color::RESET << std::endl;
+            plan(7, template_dir_ / "legal" / "NOTICE", "NOTICE", FileKind::Copy, "Copied NOTICE (namespace protection)");
         }
+    }
+    
+    /**
+     * @brief Print what was produced, step by step
+     */
+    void report()
+    {
+        size_t& written = tally_.written;
+        size_t& unchanged = tally_.unchanged;
+        size_t& conflicts = tally_.conflicts;
         
-        std::cout << std::endl;
+        for (int step = 2; step <= 7; step++)
+        {
+            // An update lists only what it wrote
+            bool shown = std::any_of(plan_.begin(), plan_.end(), [this, step](const PlannedFile& file)
+            {
+                return file.step == step && (!options_.update || file.outcome != Outcome::Unchanged);
+            });
+            if (!shown)
+            {
+                for (const auto& file : plan_)
+                {
+                    unchanged += file.step == step;
+                }
+                continue;
+            }
+            
+            out_ << color::YELLOW << "[" << step << "/8] " << STEPS[step] << color::RESET << std::endl;
+            for (const auto& file : plan_)
+            {
+                if (file.step != step)
+                {
+                    continue;
+                }
+                
+                switch (file.outcome)
+                {
+                    case Outcome::Written:
+                        written++;
+                        out_ << color::GREEN << "  ✓ " << (options_.update ? "Updated " + file.dest.generic_string() : file.message)
+                                  << color::RESET << std::endl;
+                        break;
+                    case Outcome::Unchanged:
+                        unchanged++;
+                        break;
+                    case Outcome::Conflict:
+                        conflicts++;
+                        out_ << color::RED << "  ! " << file.dest.generic_string() << " was edited; new version in "
+                                  << file.dest.generic_string() << ".new" << color::RESET << std::endl;
+                        break;
+                }
+            }
+            out_ << std::endl;
+        }
+        
+        out_ << color::YELLOW << "[8/8] " << STEPS[8] << color::RESET << std::endl;
+        if (options_.update)
+        {
+            out_ << color::GREEN << "  ✓ " << written << " updated, " << unchanged << " unchanged, "
+                      << conflicts << " kept with .new" << color::RESET << std::endl;
+        }
+        else
+        {
+            out_ << color::GREEN << "  ✓ " << written << " files in " << MANIFEST << color::RESET << std::endl;
+        }
+        out_ << std::endl;
     }
     
     void print_success() const
     {
-        std::cout << color::GREEN << "================================================" << color::RESET << std::endl;
-        std::cout << color::GREEN << "  ✓ Project Created Successfully!" << color::RESET << std::endl;
-        std::cout << color::GREEN << "================================================" << color::RESET << std::endl;
-        std::cout << std::endl;
+        if (options_.update)
+        {
+            out_ << color::GREEN << "✓ Project updated: " << project_path_ << color::RESET << std::endl;
+            out_ << std::endl;
+            return;
+        }
         
-        std::cout << color::CYAN << "Project Structure:" << color::RESET << std::endl;
-        std::cout << "  " << project_path_ << "/" << std::endl;
-        std::cout << "  ├── LICENSE                 # Apache License 2.0" << std::endl;
-        std::cout << "  ├── NOTICE                  # Namespace protection notice" << std::endl;
-        std::cout << "  ├── README.md               # Documentation" << std::endl;
-        std::cout << "  ├── config.txt              # Runtime configuration" << std::endl;
-        std::cout << "  ├── build.py                # Build script (Python)" << std::endl;
-        std::cout << "  ├── include/                # Headers and templates" << std::endl;
-        std::cout << "  │   ├── llama_client.hpp    # LLM HTTP client" << std::endl;
-        std::cout << "  │   ├── runtime_config.hpp  # Config parser" << std::endl;
-        std::cout << "  │   ├── app_server_base.hpp # CRTP base class" << std::endl;
-        std::cout << "  │   ├── json.hpp            # nlohmann/json" << std::endl;
-        std::cout << "  │   └── httplib.h           # cpp-httplib" << std::endl;
-        std::cout << "  ├── src/" << std::endl;
-        std::cout << "  │   ├── server.cpp          # Application server (EDIT THIS)" << std::endl;
-        std::cout << "  │   └── client.cpp          # CLI client (EDIT THIS)" << std::endl;
-        std::cout << "  └── bin/                    # Compiled binaries" << std::endl;
-        std::cout << std::endl;
+        out_ << color::GREEN << "================================================" << color::RESET << std::endl;
+        out_ << color::GREEN << "  ✓ Project Created Successfully!" << color::RESET << std::endl;
+        out_ << color::GREEN << "================================================" << color::RESET << std::endl;
+        out_ << std::endl;
         
-        std::cout << color::YELLOW << "Next steps:" << color::RESET << std::endl;
-        std::cout << "  cd " << project_path_ << std::endl;
-        std::cout << "  cat README.md               # Read the documentation" << std::endl;
-        std::cout << "  python3 build.py            # Build the project" << std::endl;
-        std::cout << "  ./bin/server                # Start the server" << std::endl;
-        std::cout << "  ./bin/client complete \"Hi\" # Test the client" << std::endl;
-        std::cout << std::endl;
+        out_ << color::CYAN << "Project Structure:" << color::RESET << std::endl;
+        out_ << "  " << project_path_ << "/" << std::endl;
+        out_ << "  ├── LICENSE                 # Apache License 2.0" << std::endl;
+        out_ << "  ├── NOTICE                  # Namespace protection notice" << std::endl;
+        out_ << "  ├── README.md               # Documentation" << std::endl;
+        out_ << "  ├── config.txt              # Runtime configuration" << std::endl;
+        out_ << "  ├── build.py                # Build script (Python)" << std::endl;
+        out_ << "  ├── include/                # Headers and templates" << std::endl;
+        for (const auto& header : HEADERS)
+        {
+            std::string name = header.name;
+            name.resize(std::max<size_t>(name.size() + 1, 20), ' ');
+            out_ << "  │   ├── " << name << "# " << header.description << std::endl;
+        }
+        if (vendor_path_.empty())
+        {
+            out_ << "  │   ├── json.hpp            # nlohmann/json" << std::endl;
+            out_ << "  │   └── httplib.h           # cpp-httplib" << std::endl;
+        }
+        else
+        {
+            out_ << "  │   └── (json.hpp, httplib.h: see vendor.txt)" << std::endl;
+            out_ << "  ├── vendor.txt              # " << vendor_path_.string() << std::endl;
+        }
+        out_ << "  ├── src/" << std::endl;
+        out_ << "  │   ├── server.cpp          # Application server (EDIT THIS)" << std::endl;
+        out_ << "  │   ├── client.cpp          # CLI client (EDIT THIS)" << std::endl;
+        out_ << "  │   └── bench.cpp           # Load generator / benchmark" << std::endl;
+        out_ << "  └── bin/                    # Compiled binaries" << std::endl;
+        out_ << std::endl;
         
-        std::cout << color::BLUE << "Architecture:" << color::RESET << std::endl;
-        std::cout << "  llama-server (port_x) ←→ AppServer (LlamaClient + Logic)" << std::endl;
-        std::cout << "  AppServer (port_y) ←→ CLI/GUI Client" << std::endl;
-        std::cout << std::endl;
+        out_ << color::YELLOW << "Next steps:" << color::RESET << std::endl;
+        out_ << "  cd " << project_path_ << std::endl;
+        out_ << "  cat README.md               # Read the documentation" << std::endl;
+        out_ << "  python3 build.py            # Build the project" << std::endl;
+        out_ << "  ./bin/server                # Start the server" << std::endl;
+        out_ << "  ./bin/client complete \"Hi\" # Test the client" << std::endl;
+        out_ << "  ./bin/bench --mix echo=1    # Benchmark the server" << std::endl;
+        out_ << std::endl;
+        
+        out_ << color::BLUE << "Architecture:" << color::RESET << std::endl;
+        out_ << "  llama-server (port_x) ←→ AppServer (LlamaClient + Logic)" << std::endl;
+        out_ << "  AppServer (port_y) ←→ CLI/GUI Client" << std::endl;
+        out_ << std::endl;
+        
+        out_ << color::BLUE << "Namespace:" << color::RESET << std::endl;
+        out_ << "  All code uses: pooriayousefi::llama::app" << std::endl;
+        out_ << "  This namespace MUST be preserved (see NOTICE file)" << std::endl;
+        out_ << std::endl;
+        
+        out_ << color::BLUE << "To customize:" << color::RESET << std::endl;
+        out_ << "  1. Edit src/server.cpp - list your handlers in actions()" << std::endl;
+        out_ << "  2. Edit src/client.cpp - add new actions or build GUI" << std::endl;
+        out_ << "  3. See README.md for full API reference" << std::endl;
+        out_ << "  4. After upgrading the generator: llama-app-generator --update " << project_name_ << std::endl;
+        out_ << std::endl;
+    }
+};
+
+/**
+ * @class BatchGenerator
+ * @brief Generates every project listed in a JSON manifest
+ * 
+ * Manifest format:
+ *   {
+ *     "defaults": {
+ *       "output": "tenants",
+ *       "config_file": "config.txt",
+ *       "config": {"log_level": "warn"},
+ *       "placeholders": {"REGION": "eu-west"}
+ *     },
+ *     "projects": [
+ *       {"name": "acme", "config": {"app_server_port": 9001}, "placeholders": {"TENANT": "Acme"}},
+ *       {"name": "globex", "output": "vip", "config": {"backend": ["10.0.0.5:8080", "10.0.0.6:8080 2"]}}
+ *     ]
+ *   }
+ * 
+ * A bare array of projects works too. A project's "config" and
+ * "placeholders" are merged over the defaults key by key; config values
+ * are appended to the project's config.txt (an array gives one line per
+ * element, for repeatable keys such as backend). Paths are relative to the
+ * current directory; output directories are created as needed.
+ * 
+ * The template tree is read once into a TemplateStore and projects are
+ * generated concurrently, one worker each, with a line per project as it
+ * finishes. A failed project does not stop the others.
+ */
+class BatchGenerator
+{
+private:
+    /**
+     * @struct Project
+     * @brief One manifest entry, resolved against the defaults
+     */
+    struct Project
+    {
+        std::string name;
+        fs::path output;
+        fs::path config_file;
+        ProjectExtras extras;
+    };
+    
+    fs::path manifest_path_;
+    fs::path template_dir_;
+    GeneratorOptions options_;
+    std::vector<Project> projects_;
+    std::mutex print_mutex_;
+    
+    static bool is_name(const std::string& name, bool upper_only)
+    {
+        return !name.empty() && std::all_of(name.begin(), name.end(), [upper_only](unsigned char c)
+        {
+            return (upper_only ? (std::isupper(c) || std::isdigit(c)) : std::isalnum(c)) || c == '_';
+        });
+    }
+    
+    /**
+     * @brief A manifest value as config.txt text
+     */
+    static std::string config_value(const std::string& key, const nlohmann::json& value)
+    {
+        if (value.is_string())
+        {
+            return value.get<std::string>();
+        }
+        if (value.is_boolean())
+        {
+            return value.get<bool>() ? "1" : "0";
+        }
+        if (value.is_number())
+        {
+            return value.dump();
+        }
+        throw std::runtime_error("config." + key + " must be a string, number or boolean");
+    }
+    
+    /**
+     * @brief Resolve one manifest entry against the defaults
+     */
+    static Project parse_project(const nlohmann::json& entry, const nlohmann::json& defaults)
+    {
+        if (!entry.is_object() || !entry.contains("name") || !entry["name"].is_string())
+        {
+            throw std::runtime_error("every project needs a \"name\" string");
+        }
+        
+        Project project;
+        project.name = entry["name"].get<std::string>();
+        if (project.name.empty() || project.name[0] == '-' || project.name[0] == '.'
+            || project.name.find_first_of("/\\") != std::string::npos)
+        {
+            throw std::runtime_error("invalid project name: \"" + project.name + "\"");
+        }
+        
+        project.output = entry.value("output", defaults.value("output", std::string(".")));
+        project.config_file = entry.value("config_file", defaults.value("config_file", std::string("config.txt")));
+        
+        nlohmann::json config = defaults.value("config", nlohmann::json::object());
+        config.update(entry.value("config", nlohmann::json::object()));
+        for (const auto& [key, value] : config.items())
+        {
+            if (!is_name(key, false))
+            {
+                throw std::runtime_error(project.name + ": invalid config key: \"" + key + "\"");
+            }
+            if (value.is_array())
+            {
+                for (const auto& element : value)
+                {
+                    project.extras.config.emplace_back(key, config_value(key, element));
+                }
+            }
+            else
+            {
+                project.extras.config.emplace_back(key, config_value(key, value));
+            }
+        }
+        
+        nlohmann::json placeholders = defaults.value("placeholders", nlohmann::json::object());
+        placeholders.update(entry.value("placeholders", nlohmann::json::object()));
+        for (const auto& [name, value] : placeholders.items())
+        {
+            if (!is_name(name, true) || name == "PROJECT_NAME" || name == "DATE")
+            {
+                throw std::runtime_error(project.name + ": invalid placeholder name: \"" + name
+                                         + "\" (use [A-Z0-9_]+, not PROJECT_NAME or DATE)");
+            }
+            project.extras.placeholders[name] = value.is_string() ? value.get<std::string>() : value.dump();
+        }
+        
+        return project;
+    }
+    
+    /**
+     * @brief Read and validate the whole manifest before anything is written
+     */
+    void load_manifest()
+    {
+        nlohmann::json manifest;
+        try
+        {
+            manifest = nlohmann::json::parse(read_file(manifest_path_));
+        }
+        catch (const nlohmann::json::exception& e)
+        {
+            throw std::runtime_error(manifest_path_.string() + ": " + e.what());
+        }
+        
+        nlohmann::json defaults = nlohmann::json::object();
+        nlohmann::json projects = manifest;
+        if (manifest.is_object())
+        {
+            defaults = manifest.value("defaults", nlohmann::json::object());
+            projects = manifest.value("projects", nlohmann::json::array());
+        }
+        if (!projects.is_array() || projects.empty() || !defaults.is_object())
+        {
+            throw std::runtime_error(manifest_path_.string() + ": expected a non-empty \"projects\" array");
+        }
+        
+        std::map<std::string, std::string> targets;
+        for (const auto& entry : projects)
+        {
+            Project project;
+            try
+            {
+                project = parse_project(entry, defaults);
+            }
+            catch (const std::exception& e)
+            {
+                throw std::runtime_error(manifest_path_.string() + ": " + e.what());
+            }
+            
+            std::string target = (project.output / project.name).lexically_normal().generic_string();
+            if (!targets.emplace(target, project.name).second)
+            {
+                throw std::runtime_error(manifest_path_.string() + ": two projects generate " + target);
+            }
+            projects_.push_back(std::move(project));
+        }
+    }
+    
+    /**
+     * @brief Print one finished project
+     */
+    void print_result(const Project& project, const ProjectGenerator::Tally* tally,
+                      const std::string& error, double milliseconds)
+    {
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(1);
+        if (tally)
+        {
+            line << color::GREEN << "  ✓ " << (project.output / project.name).generic_string() << "  ";
+            if (options_.update)
+            {
+                line << tally->written << " updated, " << tally->unchanged << " unchanged, "
+                     << tally->conflicts << " kept with .new";
+            }
+            else
+            {
+                line << tally->written << " files";
+            }
+        }
+        else
+        {
+            line << color::RED << "  ✗ " << (project.output / project.name).generic_string() << "  " << error;
+        }
+        line << "  (" << milliseconds << " ms)" << color::RESET << '\n';
+        
+        std::lock_guard<std::mutex> lock(print_mutex_);
+        std::cout << line.str() << std::flush;
+    }
+
+public:
+    /**
+     * @brief Construct batch generator
+     * 
+     * @param manifest JSON manifest path
+     * @param templates Template directory path
+     * @param options Update mode, vendored-file linking and parallelism
+     *                (jobs = projects generated at once)
+     */
+    BatchGenerator(const fs::path& manifest, const fs::path& templates, const GeneratorOptions& options)
+        : manifest_path_(manifest)
+        , template_dir_(templates)
+        , options_(options)
+    {
+    }
+    
+    /**
+     * @brief Generate (or update) every project in the manifest
+     * 
+     * @return Number of projects that failed
+     * 
+     * @throws std::runtime_error if the manifest or the templates cannot be loaded
+     */
+    size_t generate()
+    {
+        using clock = std::chrono::steady_clock;
+        auto started = clock::now();
+        
+        load_manifest();
+        
+        // config.txt files are shared by many projects; load each once. A
+        // missing one fails only the projects that use it.
+        std::vector<fs::path> configs;
+        if (!options_.update)
+        {
+            for (const auto& project : projects_)
+            {
+                if (fs::is_regular_file(project.config_file)
+                    && std::find(configs.begin(), configs.end(), project.config_file) == configs.end())
+                {
+                    configs.push_back(project.config_file);
+                }
+            }
+        }
+        TemplateStore store(template_dir_, configs);
+        
+        for (const auto& project : projects_)
+        {
+            fs::create_directories(project.output);
+        }
         
-        std::cout << color::BLUE << "Namespace:" << color::RESET << std::endl;
-        std::cout << "  All code uses: pooriayousefi::llama::app" << std::endl;
-        std::cout << "  This namespace MUST be preserved (see NOTICE file)" << std::endl;
+        size_t workers = options_.jobs > 0 ? options_.jobs : std::max(1u, std::thread::hardware_concurrency());
+        workers = std::min(workers, projects_.size());
+        
+        auto elapsed_ms = [](clock::time_point since)
+        {
+            return std::chrono::duration<double, std::milli>(clock::now() - since).count();
+        };
+        
+        std::cout << color::CYAN << "llama-app-generator batch: " << projects_.size() << " projects from "
+                  << manifest_path_ << color::RESET << std::endl;
+        std::cout << color::YELLOW << "Templates:   " << template_dir_ << " (" << store.size()
+                  << " files in memory, " << std::fixed << std::setprecision(1) << elapsed_ms(started)
+                  << " ms)" << color::RESET << std::endl;
+        std::cout << color::YELLOW << "Workers:     " << workers << color::RESET << std::endl;
         std::cout << std::endl;
         
-        std::cout << color::BLUE << "To customize:" << color::RESET << std::endl;
-        std::cout << "  1. Edit src/server.cpp - implement process_request()" << std::endl;
-        std::cout << "  2. Edit src/client.cpp - add new actions or build GUI" << std::endl;
-        std::cout << "  3. See README.md for full API reference" << std::endl;
+        // Parallelism is across projects; each project writes its files in turn
+        GeneratorOptions project_options = options_;
+        project_options.jobs = 1;
+        project_options.quiet = true;
+        
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> failed{0};
+        auto work = [&]()
+        {
+            for (size_t i = next++; i < projects_.size(); i = next++)
+            {
+                const Project& project = projects_[i];
+                auto project_started = clock::now();
+                try
+                {
+                    ProjectGenerator generator(project.name, project.output, template_dir_, project.config_file,
+                                               project_options, project.extras, &store);
+                    generator.generate();
+                    print_result(project, &generator.tally(), "", elapsed_ms(project_started));
+                }
+                catch (const std::exception& e)
+                {
+                    failed++;
+                    print_result(project, nullptr, e.what(), elapsed_ms(project_started));
+                }
+            }
+        };
+        
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < workers; i++)
+        {
+            threads.emplace_back(work);
+        }
+        work();
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        
         std::cout << std::endl;
+        if (failed == 0)
+        {
+            std::cout << color::GREEN << "✓ " << projects_.size() << " projects in " << std::fixed
+                      << std::setprecision(1) << elapsed_ms(started) << " ms" << color::RESET << std::endl;
+        }
+        else
+        {
+            std::cout << color::RED << "✗ " << failed << " of " << projects_.size() << " projects failed ("
+                      << std::fixed << std::setprecision(1) << elapsed_ms(started) << " ms)" << color::RESET << std::endl;
+        }
+        
+        return failed;
     }
 };
 
@@ -444,12 +1664,24 @@ void print_usage()
     
     std::cout << CYAN << "llama-app-generator" << RESET << " - Template-based llama.cpp Project Generator" << std::endl;
     std::cout << std::endl;
-    std::cout << "Usage: llama-app-generator <project_name> [output_directory]" << std::endl;
+    std::cout << "Usage: llama-app-generator [options] <project_name> [output_directory]" << std::endl;
+    std::cout << "       llama-app-generator [options] --batch <manifest.json>" << std::endl;
     std::cout << std::endl;
     std::cout << YELLOW << "Arguments:" << RESET << std::endl;
     std::cout << "  project_name       Name of the project to generate" << std::endl;
     std::cout << "  output_directory   Directory where project will be created (default: current directory)" << std::endl;
     std::cout << std::endl;
+    std::cout << YELLOW << "Options:" << RESET << std::endl;
+    std::cout << "  --update           Refresh an existing project: rewrite only files whose template" << std::endl;
+    std::cout << "                     changed; files edited in the project get a .new copy instead" << std::endl;
+    std::cout << "  --link             Hard-link json.hpp and httplib.h to the templates (read-only use)" << std::endl;
+    std::cout << "  --vendor-dir DIR   Keep json.hpp and httplib.h once in DIR/<content hash>/ and point" << std::endl;
+    std::cout << "                     the project there (vendor.txt) instead of copying them" << std::endl;
+    std::cout << "  --jobs N           Files written in parallel (default: CPU count);" << std::endl;
+    std::cout << "                     with --batch, projects generated in parallel" << std::endl;
+    std::cout << "  --batch FILE       Generate every project listed in a JSON manifest, with" << std::endl;
+    std::cout << "                     per-project config.txt overrides and extra {{PLACEHOLDERS}}" << std::endl;
+    std::cout << std::endl;
     std::cout << YELLOW << "Description:" << RESET << std::endl;
     std::cout << "  Creates a templatized llama-powered C++ application using:" << std::endl;
     std::cout << "    • CRTP pattern for zero-overhead extensibility" << std::endl;
@@ -472,6 +1704,12 @@ void print_usage()
     std::cout << "  llama-app-generator chatbot ~/projects" << std::endl;
     std::cout << "    Creates: ~/projects/chatbot/" << std::endl;
     std::cout << std::endl;
+    std::cout << "  llama-app-generator --update chatbot ~/projects" << std::endl;
+    std::cout << "    Updates: ~/projects/chatbot/ from newer templates" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  llama-app-generator --batch tenants.json" << std::endl;
+    std::cout << "    Creates: every project in tenants.json (see README.md for the format)" << std::endl;
+    std::cout << std::endl;
     std::cout << YELLOW << "Requirements:" << RESET << std::endl;
     std::cout << "  • config.txt in current directory with:" << std::endl;
     std::cout << "      Line 1: /path/to/llama.cpp/build-cpu/bin" << std::endl;
@@ -485,6 +1723,23 @@ void print_usage()
     std::cout << std::endl;
 }
 
+/**
+ * @brief Template directory, relative to the executable (bin/../templates)
+ */
+fs::path template_directory()
+{
+    char exe_path[1024];
+    ssize_t len = readlink("/proc/self/exe", exe_path, sizeof(exe_path) - 1);
+    if (len == -1)
+    {
+        throw std::runtime_error("Failed to get executable path");
+    }
+    exe_path[len] = '\0';
+    
+    fs::path exe_dir = fs::path(exe_path).parent_path();
+    return exe_dir.parent_path() / "templates";
+}
+
 /**
  * @brief Main entry point
  */
@@ -493,13 +1748,78 @@ int main(int argc, char* argv[])
     using namespace pooriayousefi::llama::app;
     using namespace color;
     
-    if (argc < 2 || argc > 3)
+    GeneratorOptions options;
+    std::vector<std::string> positional;
+    fs::path batch_manifest;
+    
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        
+        if (arg == "--update")
+        {
+            options.update = true;
+        }
+        else if (arg == "--link")
+        {
+            options.link_vendored = true;
+        }
+        else if (arg == "--jobs" && i + 1 < argc)
+        {
+            options.jobs = static_cast<size_t>(std::max(0, std::atoi(argv[++i])));
+        }
+        else if (arg == "--batch" && i + 1 < argc)
+        {
+            batch_manifest = argv[++i];
+        }
+        else if (arg == "--vendor-dir" && i + 1 < argc)
+        {
+            options.vendor_dir = argv[++i];
+        }
+        else if (arg == "-h" || arg == "--help")
+        {
+            print_usage();
+            return 0;
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            std::cerr << RED << "✗ Error: Unknown option: " << arg << RESET << std::endl;
+            print_usage();
+            return 1;
+        }
+        else
+        {
+            positional.push_back(arg);
+        }
+    }
+    
+    if (!batch_manifest.empty())
+    {
+        if (!positional.empty())
+        {
+            std::cerr << RED << "✗ Error: --batch takes no project name (the manifest lists them)" << RESET << std::endl;
+            return 1;
+        }
+        
+        try
+        {
+            BatchGenerator batch(batch_manifest, template_directory(), options);
+            return batch.generate() == 0 ? 0 : 1;
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << RED << "✗ Error: " << e.what() << RESET << std::endl;
+            return 1;
+        }
+    }
+    
+    if (positional.empty() || positional.size() > 2)
     {
         print_usage();
         return 1;
     }
     
-    std::string project_name = argv[1];
+    std::string project_name = positional[0];
     
     // Validate project name
     if (project_name.empty() || project_name[0] == '-')
@@ -511,9 +1831,9 @@ int main(int argc, char* argv[])
     
     // Get output directory (default: current directory)
     fs::path output_dir = ".";
-    if (argc == 3)
+    if (positional.size() == 2)
     {
-        output_dir = argv[2];
+        output_dir = positional[1];
         
         if (!fs::exists(output_dir))
         {
@@ -530,21 +1850,11 @@ int main(int argc, char* argv[])
     
     try
     {
-        // Get template directory (relative to executable)
-        char exe_path[1024];
-        ssize_t len = readlink("/proc/self/exe", exe_path, sizeof(exe_path) - 1);
-        if (len == -1)
-        {
-            throw std::runtime_error("Failed to get executable path");
-        }
-        exe_path[len] = '\0';
-        
-        fs::path exe_dir = fs::path(exe_path).parent_path();
-        fs::path template_dir = exe_dir.parent_path() / "templates";
+        fs::path template_dir = template_directory();
         fs::path config_path = "config.txt";
         
-        // Check if config.txt exists in current directory
-        if (!fs::exists(config_path))
+        // Check if config.txt exists in current directory (an update keeps the project's own)
+        if (!options.update && !fs::exists(config_path))
         {
             std::cerr << RED << "✗ Error: config.txt not found in current directory" << RESET << std::endl;
             std::cerr << std::endl;
@@ -557,7 +1867,7 @@ int main(int argc, char* argv[])
             return 1;
         }
         
-        ProjectGenerator generator(project_name, output_dir, template_dir, config_path);
+        ProjectGenerator generator(project_name, output_dir, template_dir, config_path, options);
         generator.generate();
         return 0;
     }
@@ -20,8 +20,16 @@
  * 
  * This is the core templatized server that integrates:
  * 1. LlamaClient (internal wrapper to llama-server on port_x)
+ *    behind a RequestScheduler that caps concurrent llama-server calls
  * 2. HTTP server (exposes YOUR API on port_y)
- * 3. Business logic interface (you implement process_request())
+ * 3. Business logic interface (you implement process_request(), or list
+ *    handlers in actions() for compile-time dispatch and /api/<action> routes)
+ * 4. Optional streaming interface (you implement process_stream_request())
+ * 5. Admission control (429/503 with Retry-After) and per-request deadlines
+ * 6. Optional llama-server supervision (llama_spawn): launch, warm up, restart
+ * 7. Hot reload of the reloadable settings on request_reload() (e.g., SIGHUP)
+ * 8. Optional /v1/... pass-through to llama-server (openai_proxy)
+ * 9. Negotiated gzip/zstd compression of large responses (compression)
  * 
  * Architecture:
  *   GUI/CLI Client --[port_y]--> AppServer --[port_x]--> llama-server
@@ -55,12 +63,43 @@
 #ifndef POORIAYOUSEFI_LLAMA_APP_APP_SERVER_BASE_HPP
 #define POORIAYOUSEFI_LLAMA_APP_APP_SERVER_BASE_HPP
 
+// httplib's default listen backlog of 5 drops connection bursts; this must
+// be defined before httplib.h is first included.
+#ifndef CPPHTTPLIB_LISTEN_BACKLOG
+#define CPPHTTPLIB_LISTEN_BACKLOG 128
+#endif
+
 #include <string>
 #include <iostream>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
 #include "json.hpp"
 #include "httplib.h"
 #include "llama_client.hpp"
+#include "llama_supervisor.hpp"
+#include "request_scheduler.hpp"
+#include "request_context.hpp"
+#include "admission_control.hpp"
+#include "action_table.hpp"
+#include "proxy_stream.hpp"
+#include "response_compression.hpp"
+#include "pipelined_server.hpp"
+#include "response_cache.hpp"
+#include "semantic_cache.hpp"
+#include "slot_affinity.hpp"
+#include "session_store.hpp"
+#include "json_fields.hpp"
+#include "metrics.hpp"
+#include "logger.hpp"
 #include "runtime_config.hpp"
 
 namespace pooriayousefi
@@ -81,12 +120,146 @@ namespace color
     const std::string BLUE = "\033[34m";
 }
 
+/**
+ * @class StreamWriter
+ * @brief Server-Sent Events writer handed to process_stream_request()
+ * 
+ * Each send() writes one "data: <json>" event and flushes it to the client
+ * immediately over a chunked response.
+ */
+class StreamWriter
+{
+private:
+    httplib::DataSink& sink_;
+    bool open_ = true;
+
+public:
+    explicit StreamWriter(httplib::DataSink& sink)
+        : sink_(sink)
+    {
+    }
+    
+    /**
+     * @brief Send one JSON event to the client
+     * 
+     * @param event JSON payload
+     * @return false if the client has disconnected
+     */
+    bool send(const json& event)
+    {
+        if (!open_)
+        {
+            return false;
+        }
+        
+        std::string frame = "data: " + event.dump() + "\n\n";
+        open_ = sink_.write(frame.data(), frame.size());
+        return open_;
+    }
+    
+    /**
+     * @brief Check whether the client is still connected
+     */
+    bool is_open() const
+    {
+        return open_;
+    }
+};
+
+/**
+ * @brief Detects whether Derived implements process_stream_request()
+ */
+template<typename T, typename = void>
+struct has_process_stream_request : std::false_type {};
+
+template<typename T>
+struct has_process_stream_request<T, std::void_t<decltype(
+    std::declval<T&>().process_stream_request(std::declval<const json&>(), std::declval<StreamWriter&>()))>>
+    : std::true_type {};
+
+/**
+ * @brief Detects whether Derived implements process_raw_request()
+ */
+template<typename T, typename = void>
+struct has_process_raw_request : std::false_type {};
+
+template<typename T>
+struct has_process_raw_request<T, std::void_t<decltype(
+    std::declval<T&>().process_raw_request(std::declval<const std::string&>(), std::declval<std::string&>()))>>
+    : std::true_type {};
+
+/**
+ * @brief Detects whether Derived implements process_request()
+ */
+template<typename T, typename = void>
+struct has_process_request : std::false_type {};
+
+template<typename T>
+struct has_process_request<T, std::void_t<decltype(
+    std::declval<T&>().process_request(std::declval<const json&>()))>>
+    : std::true_type {};
+
+/**
+ * @brief Detects whether Derived declares a static constexpr actions() table
+ */
+template<typename T, typename = void>
+struct has_actions : std::false_type {};
+
+template<typename T>
+struct has_actions<T, std::void_t<decltype(T::actions())>> : std::true_type {};
+
+/**
+ * @brief Detects whether Derived implements rewrite_proxy_request()
+ */
+template<typename T, typename = void>
+struct has_rewrite_proxy_request : std::false_type {};
+
+template<typename T>
+struct has_rewrite_proxy_request<T, std::void_t<decltype(
+    std::declval<T&>().rewrite_proxy_request(std::declval<ProxyRequest&>()))>>
+    : std::true_type {};
+
+/**
+ * @brief Detects whether Derived implements rewrite_proxy_response()
+ */
+template<typename T, typename = void>
+struct has_rewrite_proxy_response : std::false_type {};
+
+template<typename T>
+struct has_rewrite_proxy_response<T, std::void_t<decltype(
+    std::declval<T&>().rewrite_proxy_response(std::declval<int&>(), std::declval<httplib::Headers&>()))>>
+    : std::true_type {};
+
 /**
  * @class AppServerBase
  * @brief CRTP base class for llama.cpp-based HTTP servers
  * 
  * Provides template method pattern using CRTP for compile-time polymorphism.
- * Derived classes must implement process_request() to handle business logic.
+ * Derived classes implement process_request() to handle business logic,
+ * or declare `static constexpr auto actions()` returning a std::array of
+ * ActionRoute<Derived> (see action_table.hpp). Listed actions are
+ * dispatched through a compile-time hash table, each also gets its own
+ * POST /api/<action> route that needs no "action" field, and a handler
+ * that throws answers {"status": "error", "message": "LLM error: ..."}, so
+ * handlers need no try/catch of their own. With both, actions missing from
+ * the table go to process_request().
+ * 
+ * Derived classes may also implement
+ * process_stream_request(const json&, StreamWriter&) to enable /api/stream,
+ * and bool process_raw_request(const std::string& body, std::string& out)
+ * to serve /api requests straight from the request text. The raw hook runs
+ * first; returning false falls back to process_request() with a parsed DOM,
+ * so it can cover just the hot actions (e.g., using extract_fields()).
+ * 
+ * Every request runs under a RequestContext: its deadline comes from the
+ * X-Deadline-Ms header, a "deadline_ms" field or default_deadline_ms, and a
+ * client disconnect cancels it. Both reach llama-server calls made through
+ * the scheduler, so abandoned work stops instead of holding a slot.
+ * 
+ * With openai_proxy, /v1/... is forwarded to llama-server untouched except
+ * for two optional hooks: void rewrite_proxy_request(ProxyRequest&) before
+ * sending, and void rewrite_proxy_response(int& status, httplib::Headers&)
+ * before answering.
  * 
  * @tparam Derived The derived class type (CRTP pattern)
  */
@@ -94,9 +267,110 @@ template<typename Derived>
 class AppServerBase
 {
 protected:
-    RuntimeConfig config_;              ///< Runtime configuration
+    RuntimeConfig config_;              ///< Runtime configuration as started
+    std::shared_ptr<const RuntimeConfig> live_config_; ///< config_ plus reloaded settings
+    std::unique_ptr<LlamaSupervisor> supervisor_; ///< Launched llama-servers (llama_spawn only)
+    std::unique_ptr<Metrics> metrics_;  ///< Stage latency histograms and per-action counters
     std::unique_ptr<LlamaClient> llama_client_;  ///< HTTP client for llama-server
-    httplib::Server server_;            ///< HTTP server for client API
+    std::unique_ptr<ResponseCache> response_cache_; ///< Optional exact-match completion cache
+    std::unique_ptr<LlamaClient> embedding_client_; ///< semantic_cache_backend, if set
+    std::unique_ptr<SemanticCache> semantic_cache_; ///< Optional similarity completion cache
+    std::unique_ptr<RequestScheduler> scheduler_; ///< Slot-limited queue in front of llama_client_
+    std::unique_ptr<SlotAffinity> slot_affinity_; ///< Session/template -> llama-server slot
+    std::unique_ptr<SessionStore> session_store_; ///< Server-side chat history
+    std::unique_ptr<AdmissionControl> admission_; ///< In-flight and queue-depth limits
+    std::unique_ptr<ResponseCompressor> compressor_; ///< Content-Encoding of finished responses
+    std::atomic<uint64_t> deadlines_exceeded_{0}; ///< Requests answered with 504
+    std::atomic<uint64_t> requests_cancelled_{0}; ///< Requests whose client went away
+    PipelinedServer server_;            ///< HTTP server for client API
+    PipelinedServer admin_server_;      ///< Optional server for cheap routes (admin_port)
+    std::thread admin_thread_;          ///< Runs admin_server_ when enabled
+    
+    inline static std::atomic<bool> reload_requested_{false}; ///< Set by request_reload()
+    std::thread reload_thread_;         ///< Applies requested reloads
+    std::mutex reload_mutex_;
+    std::condition_variable reload_wake_;
+    bool reload_stopping_ = false;
+    
+    /**
+     * @brief Build the LlamaClient over every configured backend
+     * 
+     * Each backend gets its own pool of llama_pool_size connections.
+     */
+    static std::unique_ptr<LlamaClient> make_llama_client(const RuntimeConfig& config)
+    {
+        auto backends = std::make_unique<BackendPool>(
+            config.llama_pool_size, config.llama_pool_idle_timeout, config.llama_timeout,
+            config.backend_max_failures, config.backend_circuit_cooldown);
+        
+        for (const auto& backend : config.get_backends())
+        {
+            backends->add(backend.host, backend.port, backend.weight);
+        }
+        
+        auto client = std::make_unique<LlamaClient>(std::move(backends), config.backend_health_interval);
+        client->set_async_threads(config.llama_async_threads);
+        client->set_retry_policy(retry_policy(config));
+        client->set_token_cache_size(config.token_cache_entries);
+        client->set_embedding_batch(config.embedding_batch_size, config.embedding_batch_tokens);
+        if (config.llama_n_ctx != 0)
+        {
+            client->set_context_size(static_cast<size_t>(std::max(config.llama_n_ctx, 0)));
+        }
+        return client;
+    }
+    
+    /**
+     * @brief Retry and hedging settings of llama-server calls
+     */
+    static RetryPolicy retry_policy(const RuntimeConfig& config)
+    {
+        RetryPolicy policy;
+        policy.retries = config.llama_retries;
+        policy.backoff_ms = config.llama_retry_backoff_ms;
+        policy.hedge = config.llama_hedge;
+        policy.hedge_min_ms = config.llama_hedge_min_ms;
+        return policy;
+    }
+    
+    /**
+     * @brief Build the supervisor for llama_spawn instances, or nullptr
+     * 
+     * llama_slots is the total across instances, so each one gets an even
+     * share as -np unless llama_parallel is set (see slots_per_backend()).
+     */
+    static std::unique_ptr<LlamaSupervisor> make_supervisor(const RuntimeConfig& config)
+    {
+        if (config.llama_spawn == 0)
+        {
+            return nullptr;
+        }
+        
+        LlamaServerOptions options;
+        options.executable = config.get_llama_server_path();
+        options.model_path = config.model_path;
+        for (const auto& backend : config.get_backends())
+        {
+            options.ports.push_back(backend.port);
+        }
+        options.threads = config.llama_threads;
+        options.ctx_size = config.llama_ctx_size;
+        options.parallel = static_cast<int>(config.slots_per_backend());
+        options.gpu_layers = config.llama_gpu_layers;
+        options.mmap = config.llama_mmap;
+        options.mlock = config.llama_mlock;
+        options.draft_model_path = config.llama_draft_model;
+        options.draft_max = config.llama_draft_max;
+        options.draft_min = config.llama_draft_min;
+        options.draft_p_min = config.llama_draft_p_min;
+        options.draft_gpu_layers = config.llama_draft_gpu_layers;
+        options.extra_args = config.llama_extra_args;
+        options.log_dir = config.llama_log_dir;
+        options.startup_timeout = config.llama_startup_timeout;
+        options.warmup_prompt = config.llama_warmup_prompt;
+        
+        return std::make_unique<LlamaSupervisor>(std::move(options));
+    }
     
     /**
      * @brief Construct application server
@@ -105,9 +379,129 @@ protected:
      */
     AppServerBase(const RuntimeConfig& cfg) 
         : config_(cfg)
-        , llama_client_(std::make_unique<LlamaClient>(config_.get_llama_server_url()))
+        , live_config_(std::make_shared<const RuntimeConfig>(cfg))
+        , supervisor_(make_supervisor(config_))
+        , metrics_(std::make_unique<Metrics>())
+        , llama_client_(make_llama_client(config_))
+        , scheduler_(std::make_unique<RequestScheduler>(
+              *llama_client_, config_.llama_slots, config_.scheduler_window_ms))
+        , slot_affinity_(std::make_unique<SlotAffinity>(
+              config_.get_backends().size(), config_.slots_per_backend()))
+        , session_store_(std::make_unique<SessionStore>(
+              SessionLimits{config_.session_max_messages, config_.session_max_tokens},
+              config_.session_max_count, config_.session_ttl))
+        , admission_(std::make_unique<AdmissionControl>(
+              config_.max_in_flight, config_.action_max_in_flight, config_.scheduler_max_queue,
+              config_.retry_after, [this] { return scheduler_->queue_depth(); }))
+        , compressor_(std::make_unique<ResponseCompressor>(
+              config_.compression, config_.compression_min_bytes, config_.compression_level))
     {
+        if (config_.response_cache_mb > 0)
+        {
+            response_cache_ = std::make_unique<ResponseCache>(
+                config_.response_cache_mb * 1024 * 1024,
+                config_.response_cache_ttl,
+                config_.response_cache_max_temperature);
+            scheduler_->set_response_cache(response_cache_.get());
+        }
+        
+        if (config_.semantic_cache_mb > 0)
+        {
+            if (config_.semantic_cache_backend.port > 0)
+            {
+                embedding_client_ = std::make_unique<LlamaClient>(
+                    "http://" + config_.semantic_cache_backend.host + ":" + std::to_string(config_.semantic_cache_backend.port),
+                    config_.llama_timeout, config_.llama_pool_size, config_.llama_pool_idle_timeout);
+                embedding_client_->set_retry_policy(retry_policy(config_));
+            }
+            
+            semantic_cache_ = std::make_unique<SemanticCache>(
+                embedding_client_ ? *embedding_client_ : *llama_client_,
+                config_.semantic_cache_mb * 1024 * 1024,
+                config_.semantic_cache_threshold,
+                config_.semantic_cache_ttl,
+                config_.response_cache_max_temperature,
+                config_.semantic_cache_max_prompt);
+            scheduler_->set_semantic_cache(semantic_cache_.get());
+        }
+        
+        for (const auto& [name, priority] : config_.priority_classes)
+        {
+            scheduler_->add_class(name, priority.weight, priority.max_slots);
+        }
+        for (const auto& [action, name] : config_.action_priority)
+        {
+            admission_->set_action_class(action, scheduler_->find_class(name));
+        }
+        for (const auto& [name, tenant] : config_.tenants)
+        {
+            auto quota = config_.tenant_max_in_flight.find(name);
+            admission_->add_tenant(name, tenant.api_key,
+                                   tenant.priority_class.empty() ? RequestContext::NO_CLASS
+                                   : scheduler_->find_class(tenant.priority_class),
+                                   quota != config_.tenant_max_in_flight.end() ? quota->second : 0);
+        }
+        
+        Logger::instance().set_level(config_.log_level);
+        llama_client_->set_metrics(metrics_.get());
+        scheduler_->set_metrics(metrics_.get());
+        
         setup_routes();
+        configure_server();
+    }
+    
+    /**
+     * @brief Stop the admin listener, reload thread and launched llama-servers
+     */
+    ~AppServerBase()
+    {
+        admin_server_.stop();
+        if (admin_thread_.joinable())
+        {
+            admin_thread_.join();
+        }
+        
+        stop_reload_thread();
+        
+        if (supervisor_)
+        {
+            supervisor_->stop();
+        }
+    }
+    
+    /**
+     * @brief Poll for reload requests until stopped
+     * 
+     * request_reload() may run in a signal handler, so it only sets a flag;
+     * the reload itself happens here.
+     */
+    void reload_loop()
+    {
+        std::unique_lock<std::mutex> lock(reload_mutex_);
+        
+        while (!reload_wake_.wait_for(lock, std::chrono::milliseconds(250), [this] { return reload_stopping_; }))
+        {
+            if (reload_requested_.exchange(false))
+            {
+                lock.unlock();
+                reload_config();
+                lock.lock();
+            }
+        }
+    }
+    
+    void stop_reload_thread()
+    {
+        {
+            std::lock_guard<std::mutex> lock(reload_mutex_);
+            reload_stopping_ = true;
+        }
+        reload_wake_.notify_all();
+        
+        if (reload_thread_.joinable())
+        {
+            reload_thread_.join();
+        }
     }
     
     /**
@@ -131,15 +525,66 @@ protected:
     }
     
     /**
-     * @brief Setup HTTP routes
+     * @brief Install worker pools, keep-alive limits and compression from RuntimeConfig
+     * 
+     * Replaces httplib's compile-time CPPHTTPLIB_THREAD_POOL_COUNT with
+     * server_threads and bounds the accepted-connection queue with
+     * server_max_queued. With admin_port set, /health, /stats and /metrics are
+     * also served by a separate small pool so long LLM calls cannot starve them.
      * 
-     * Configures /health and /api endpoints. The /api endpoint
-     * delegates to derived class's process_request() method using CRTP.
+     * A keep-alive connection serves its requests in order, including
+     * pipelined ones already buffered behind the current request (see
+     * PipelinedServer). With
+     * tcp_nodelay, small replies on such connections are not held back by
+     * Nagle's algorithm waiting for the client's delayed ACK.
      */
-    void setup_routes()
+    void configure_server()
+    {
+        size_t threads = config_.server_threads > 0 ? config_.server_threads : CPPHTTPLIB_THREAD_POOL_COUNT;
+        size_t max_queued = config_.server_max_queued;
+        
+        server_.new_task_queue = [threads, max_queued]
+        {
+            return new httplib::ThreadPool(threads, max_queued);
+        };
+        server_.set_keep_alive_max_count(config_.keep_alive_max_count);
+        server_.set_keep_alive_timeout(config_.keep_alive_timeout);
+        server_.set_tcp_nodelay(config_.tcp_nodelay);
+        
+        if (!config_.compression.empty() && compressor_->encodings().empty())
+        {
+            Logger::instance().warn("compression is set but this build has neither zlib nor zstd; responses go out uncompressed");
+        }
+        auto compress = [this](const httplib::Request& req, httplib::Response& res)
+        {
+            compressor_->apply(req, res);
+        };
+        server_.set_post_routing_handler(compress);
+        
+        if (config_.admin_port != 0)
+        {
+            size_t admin_threads = config_.admin_threads;
+            admin_server_.new_task_queue = [admin_threads]
+            {
+                return new httplib::ThreadPool(admin_threads);
+            };
+            admin_server_.set_tcp_nodelay(config_.tcp_nodelay);
+            admin_server_.set_post_routing_handler(compress);
+            setup_admin_routes(admin_server_);
+        }
+    }
+    
+    /**
+     * @brief Register cheap diagnostic routes (/health, /stats, /metrics)
+     * 
+     * Used for both the main server and the optional admin server.
+     * 
+     * @param server Server to register routes on
+     */
+    void setup_admin_routes(httplib::Server& server)
     {
         // Health check endpoint
-        server_.Get("/health", [](const httplib::Request&, httplib::Response& res)
+        server.Get("/health", [](const httplib::Request&, httplib::Response& res)
         {
             json response = {
                 {"status", "ok"},
@@ -148,87 +593,1302 @@ protected:
             res.set_content(response.dump(), "application/json");
         });
         
-        // Main API endpoint - delegates to derived class's process_request()
-        // CRTP magic: calls Derived::process_request() at compile-time!
-        server_.Post("/api", [this](const httplib::Request& req, httplib::Response& res)
+        // Prometheus metrics: stage histograms, per-action counters, gauges
+        server.Get("/metrics", [this](const httplib::Request&, httplib::Response& res)
         {
-            try
+            std::string body = metrics_->render();
+            
+            json scheduler = scheduler_->stats();
+            body += "# HELP app_scheduler_queue_depth Jobs waiting for a llama-server slot\n";
+            body += "# TYPE app_scheduler_queue_depth gauge\n";
+            body += "app_scheduler_queue_depth " + scheduler["queue_depth"].dump() + "\n";
+            body += "# HELP app_scheduler_in_flight Jobs running on llama-server slots\n";
+            body += "# TYPE app_scheduler_in_flight gauge\n";
+            body += "app_scheduler_in_flight " + scheduler["in_flight"].dump() + "\n";
+            body += "# HELP app_class_queue_depth Jobs waiting for a llama-server slot per priority class\n";
+            body += "# TYPE app_class_queue_depth gauge\n";
+            for (const auto& job_class : scheduler["classes"])
             {
-                json request = json::parse(req.body);
-                
-                // Call derived class's business logic (CRTP compile-time polymorphism!)
-                json response = derived().process_request(request);
-                
-                res.set_content(response.dump(), "application/json");
+                body += "app_class_queue_depth{class=" + job_class["name"].dump() + "} "
+                      + job_class["queue_depth"].dump() + "\n";
             }
-            catch (const std::exception& e)
+            body += "# HELP app_class_in_flight Jobs running on llama-server slots per priority class\n";
+            body += "# TYPE app_class_in_flight gauge\n";
+            for (const auto& job_class : scheduler["classes"])
+            {
+                body += "app_class_in_flight{class=" + job_class["name"].dump() + "} "
+                      + job_class["in_flight"].dump() + "\n";
+            }
+            
+            json backends = llama_client_->get_backends().stats();
+            body += "# HELP llama_backend_healthy Whether a backend is in rotation\n";
+            body += "# TYPE llama_backend_healthy gauge\n";
+            for (const auto& backend : backends)
+            {
+                body += "llama_backend_healthy{backend=" + backend["url"].dump() + "} "
+                      + (backend["healthy"].get<bool>() ? "1" : "0") + "\n";
+            }
+            body += "# HELP llama_backend_outstanding Requests in flight per backend\n";
+            body += "# TYPE llama_backend_outstanding gauge\n";
+            for (const auto& backend : backends)
+            {
+                body += "llama_backend_outstanding{backend=" + backend["url"].dump() + "} "
+                      + backend["outstanding"].dump() + "\n";
+            }
+            body += "# HELP llama_backend_circuit_state Circuit breaker per backend: 0 closed, 1 half-open, 2 open\n";
+            body += "# TYPE llama_backend_circuit_state gauge\n";
+            for (const auto& backend : backends)
             {
-                json error = {
-                    {"error", e.what()},
-                    {"status", "failed"}
+                const std::string circuit = backend["circuit"];
+                body += "llama_backend_circuit_state{backend=" + backend["url"].dump() + "} "
+                      + (circuit == "open" ? "2" : circuit == "half_open" ? "1" : "0") + "\n";
+            }
+            body += "# HELP llama_backend_circuit_opens_total Times a backend's circuit breaker opened\n";
+            body += "# TYPE llama_backend_circuit_opens_total counter\n";
+            for (const auto& backend : backends)
+            {
+                body += "llama_backend_circuit_opens_total{backend=" + backend["url"].dump() + "} "
+                      + backend["circuit_opens"].dump() + "\n";
+            }
+            
+            json admission = admission_->stats();
+            body += "# HELP app_admission_rejected_total Requests shed before running\n";
+            body += "# TYPE app_admission_rejected_total counter\n";
+            body += "app_admission_rejected_total{reason=\"queue_full\"} " + admission["rejected_queue_full"].dump() + "\n";
+            body += "app_admission_rejected_total{reason=\"in_flight\"} " + admission["rejected_in_flight"].dump() + "\n";
+            for (const auto& [action, limit] : admission["actions"].items())
+            {
+                body += "app_admission_rejected_total{reason=\"action\",action=\"" + action + "\"} "
+                      + limit["rejected"].dump() + "\n";
+            }
+            for (const auto& [tenant, limit] : admission["tenants"].items())
+            {
+                body += "app_admission_rejected_total{reason=\"tenant\",tenant=\"" + tenant + "\"} "
+                      + limit["rejected"].dump() + "\n";
+            }
+            body += "# HELP app_admitted_in_flight Requests admitted and being served\n";
+            body += "# TYPE app_admitted_in_flight gauge\n";
+            body += "app_admitted_in_flight " + admission["in_flight"].dump() + "\n";
+            body += "# HELP app_deadline_exceeded_total Requests answered with 504\n";
+            body += "# TYPE app_deadline_exceeded_total counter\n";
+            body += "app_deadline_exceeded_total " + std::to_string(deadlines_exceeded_.load()) + "\n";
+            body += "# HELP app_requests_cancelled_total Requests abandoned by the client\n";
+            body += "# TYPE app_requests_cancelled_total counter\n";
+            body += "app_requests_cancelled_total " + std::to_string(requests_cancelled_.load()) + "\n";
+            
+            json compression = compressor_->stats();
+            body += "# HELP app_compressed_responses_total Responses sent with a Content-Encoding\n";
+            body += "# TYPE app_compressed_responses_total counter\n";
+            body += "app_compressed_responses_total " + compression["responses"].dump() + "\n";
+            body += "# HELP app_compression_bytes_total Body bytes of compressed responses before and after compression\n";
+            body += "# TYPE app_compression_bytes_total counter\n";
+            body += "app_compression_bytes_total{stage=\"in\"} " + compression["bytes_in"].dump() + "\n";
+            body += "app_compression_bytes_total{stage=\"out\"} " + compression["bytes_out"].dump() + "\n";
+            
+            if (semantic_cache_)
+            {
+                json semantic = semantic_cache_->stats();
+                body += "# HELP app_semantic_cache_lookups_total Similarity cache lookups by outcome\n";
+                body += "# TYPE app_semantic_cache_lookups_total counter\n";
+                body += "app_semantic_cache_lookups_total{result=\"hit\"} " + semantic["hits"].dump() + "\n";
+                body += "app_semantic_cache_lookups_total{result=\"miss\"} " + semantic["misses"].dump() + "\n";
+                body += "app_semantic_cache_lookups_total{result=\"bypass\"} " + semantic["bypassed"].dump() + "\n";
+                body += "app_semantic_cache_lookups_total{result=\"embed_error\"} " + semantic["embed_failures"].dump() + "\n";
+                body += "# HELP app_semantic_cache_entries Cached responses in the similarity index\n";
+                body += "# TYPE app_semantic_cache_entries gauge\n";
+                body += "app_semantic_cache_entries " + semantic["entries"].dump() + "\n";
+                body += "# HELP app_semantic_cache_bytes Approximate memory used by the similarity cache\n";
+                body += "# TYPE app_semantic_cache_bytes gauge\n";
+                body += "app_semantic_cache_bytes " + semantic["bytes"].dump() + "\n";
+            }
+            
+            res.set_content(std::move(body), "text/plain; version=0.0.4");
+        });
+        
+        // Scheduler diagnostics: queue depth, in-flight jobs, wait times
+        server.Get("/stats", [this](const httplib::Request&, httplib::Response& res)
+        {
+            json response = {
+                {"scheduler", scheduler_->stats()},
+                {"slot_affinity", slot_affinity_->stats()},
+                {"sessions", session_store_->stats()},
+                {"backends", llama_client_->get_backends().stats()},
+                {"tokenizer", llama_client_->tokenizer_stats()},
+                {"admission", admission_->stats()},
+                {"compression", compressor_->stats()}
+            };
+            response["admission"]["deadline_exceeded"] = deadlines_exceeded_.load();
+            response["admission"]["cancelled"] = requests_cancelled_.load();
+            if (response_cache_)
+            {
+                response["response_cache"] = response_cache_->stats();
+            }
+            if (semantic_cache_)
+            {
+                response["semantic_cache"] = semantic_cache_->stats();
+            }
+            if (supervisor_)
+            {
+                response["llama_servers"] = supervisor_->stats();
+            }
+            if (uint64_t drafted = metrics_->draft_tokens.load(std::memory_order_relaxed); drafted > 0)
+            {
+                response["speculative"] = {
+                    {"drafted", drafted},
+                    {"accepted", metrics_->draft_tokens_accepted.load(std::memory_order_relaxed)},
+                    {"acceptance_rate", metrics_->draft_acceptance_rate()}
                 };
-                res.status = 500;
-                res.set_content(error.dump(), "application/json");
             }
+            res.set_content(response.dump(), "application/json");
         });
     }
-
-public:
+    
     /**
-     * @brief Start the HTTP server
+     * @brief Create the RequestContext of one client request
      * 
-     * Binds to configured port and begins listening for requests.
-     * This is a blocking call.
+     * The deadline is the X-Deadline-Ms header if present (and valid),
+     * else default_deadline_ms. Disconnects are detected by probing the
+     * request's socket.
      * 
-     * @throws std::runtime_error if server fails to start
+     * @param req Incoming request
+     * @return New context (not yet installed on any thread)
      */
-    void start()
+    std::shared_ptr<RequestContext> make_request_context(const httplib::Request& req)
     {
-        std::string host = "0.0.0.0";
-        int port = config_.app_server_port;
-        
-        std::cout << color::GREEN << "Server listening on " << host << ":" << port << color::RESET << std::endl;
-        std::cout << color::BLUE << "Endpoints:" << color::RESET << std::endl;
-        std::cout << "  GET  /health - Health check" << std::endl;
-        std::cout << "  POST /api    - Main API endpoint" << std::endl;
-        std::cout << std::endl;
+        auto context = std::make_shared<RequestContext>(req.is_connection_closed);
         
-        if (!server_.listen(host, port))
+        int64_t deadline_ms = get_live_config()->default_deadline_ms;
+        if (req.has_header("X-Deadline-Ms"))
         {
-            throw std::runtime_error("Failed to start server on port " + std::to_string(port));
+            try
+            {
+                deadline_ms = std::stoll(req.get_header_value("X-Deadline-Ms"));
+            }
+            catch (const std::exception&)
+            {
+                Logger::instance().warn("Ignoring invalid X-Deadline-Ms header: ", req.get_header_value("X-Deadline-Ms"));
+            }
         }
+        
+        context->set_timeout(deadline_ms);
+        return context;
     }
     
     /**
-     * @brief Stop the HTTP server
+     * @brief Apply a request's "deadline_ms" field to the current context
      * 
-     * Gracefully shuts down the server.
+     * The field overrides the header, counting from now (the request has
+     * just been parsed).
+     * 
+     * @param request Parsed request (or a DOM from extract_fields())
      */
-    void stop()
+    static void apply_deadline(const json& request)
     {
-        server_.stop();
+        auto context = RequestContext::current();
+        auto deadline = request.find("deadline_ms");
+        if (context && deadline != request.end() && deadline->is_number_integer())
+        {
+            context->set_timeout(deadline->get<int64_t>());
+        }
     }
     
     /**
-     * @brief Get LlamaClient for derived classes to use
-     * 
-     * Provides access to llama-server client for LLM operations.
-     * 
-     * @return Pointer to LlamaClient instance
+     * @brief Action name of a parsed request ("unknown" if absent)
      */
-    LlamaClient* get_llama_client()
+    static const std::string& action_of(const json& request)
     {
-        return llama_client_.get();
+        static const std::string unknown = "unknown";
+        auto action = request.find("action");
+        return action != request.end() && action->is_string() ? action->get_ref<const std::string&>() : unknown;
     }
     
     /**
-     * @brief Get runtime configuration
+     * @brief API key of a request: X-API-Key, else an Authorization bearer token
+     */
+    static std::string api_key_of(const httplib::Request& req)
+    {
+        if (req.has_header("X-API-Key"))
+        {
+            return req.get_header_value("X-API-Key");
+        }
+        
+        static const std::string bearer = "Bearer ";
+        const std::string& authorization = req.get_header_value("Authorization");
+        return authorization.compare(0, bearer.size(), bearer) == 0 ? authorization.substr(bearer.size()) : std::string();
+    }
+    
+    /**
+     * @brief Write a JSON error body
+     */
+    static void send_error(httplib::Response& res, int status, const std::string& message)
+    {
+        json error = {
+            {"error", message},
+            {"status", "failed"}
+        };
+        res.status = status;
+        res.set_content(error.dump(), "application/json");
+    }
+    
+    /**
+     * @brief Write a 429/503 with its Retry-After header
+     */
+    static void send_rejection(httplib::Response& res, const AdmissionError& e)
+    {
+        res.set_header("Retry-After", std::to_string(e.retry_after()));
+        send_error(res, e.status(), e.what());
+    }
+    
+    /**
+     * @brief Setup HTTP routes
      * 
-     * @return Reference to RuntimeConfig
+     * Configures /health, /stats, /metrics and /api endpoints. The /api endpoint
+     * delegates to the derived class's actions() table or process_request()
+     * using CRTP, and every table action also gets POST /api/<action>.
+     * /api/stream is registered only if the derived class implements
+     * process_stream_request(), and /v1/... only with openai_proxy.
+     * 
+     * /api admits each request in steps: against the global limits and its
+     * tenant's quota before anything is parsed, so shedding costs no
+     * parsing, and against its action's limit once the action is known.
+     * Admission also picks the priority class its scheduler jobs queue in:
+     * the tenant's if it has one, else the action's. A request that ran past its
+     * deadline is answered with 504; one whose client went away gets no body.
      */
-    const RuntimeConfig& get_config() const
+    void setup_routes()
     {
-        return config_;
+        setup_admin_routes(server_);
+        
+        // Main API endpoint - delegates to derived class's business logic
+        // CRTP magic: resolved at compile-time, no virtual calls!
+        server_.Post("/api", [this](const httplib::Request& req, httplib::Response& res)
+        {
+            serve_api(req, res, nullptr);
+        });
+        
+        // One route per table action: the path names the action
+        if constexpr (has_actions<Derived>::value)
+        {
+            for (const auto& route : ActionTable<Derived>::routes)
+            {
+                std::string action(route.name);
+                server_.Post("/api/" + action, [this, action](const httplib::Request& req, httplib::Response& res)
+                {
+                    serve_api(req, res, &action);
+                });
+            }
+        }
+        
+        setup_batch_route();
+        
+        if constexpr (has_process_stream_request<Derived>::value)
+        {
+            setup_stream_route();
+        }
+        
+        if (config_.openai_proxy)
+        {
+            setup_proxy_routes();
+        }
+    }
+    
+    /**
+     * @brief Serve one /api or /api/<action> request
+     * 
+     * @param action Action named by the route, or nullptr for /api (the
+     *               raw hook runs first and the body's "action" decides)
+     */
+    void serve_api(const httplib::Request& req, httplib::Response& res, const std::string* action)
+    {
+        auto context = make_request_context(req);
+        RequestContext::Scope context_scope(context);
+        
+        try
+        {
+            AdmissionControl::Ticket ticket = admission_->admit();
+            AdmissionControl::Ticket tenant_ticket = admission_->admit_tenant(api_key_of(req));
+            
+            // Fast path: derived class handles the raw body without a DOM
+            if constexpr (has_process_raw_request<Derived>::value)
+            {
+                std::string response_body;
+                if (!action && derived().process_raw_request(req.body, response_body))
+                {
+                    if (!finish_request(*context, res))
+                    {
+                        res.set_content(std::move(response_body), "application/json");
+                    }
+                    return;
+                }
+            }
+            
+            auto parse_start = Metrics::Clock::now();
+            json request = json::parse(req.body);
+            metrics_->request_parse.observe(Metrics::seconds_since(parse_start));
+            
+            apply_deadline(request);
+            const std::string& name = action ? *action : action_of(request);
+            AdmissionControl::Ticket action_ticket = admission_->admit(name);
+            
+            // Call derived class's business logic (CRTP compile-time polymorphism!)
+            json response = run_action(name, request);
+            if (finish_request(*context, res))
+            {
+                return;
+            }
+            
+            auto serialize_start = Metrics::Clock::now();
+            std::string body = response.dump();
+            metrics_->response_serialize.observe(Metrics::seconds_since(serialize_start));
+            
+            res.set_content(std::move(body), "application/json");
+        }
+        catch (const AdmissionError& e)
+        {
+            send_rejection(res, e);
+        }
+        catch (const DeadlineExceeded& e)
+        {
+            deadlines_exceeded_++;
+            send_error(res, 504, e.what());
+        }
+        catch (const RequestCancelled&)
+        {
+            requests_cancelled_++;
+        }
+        catch (const std::exception& e)
+        {
+            Logger::instance().warn("/api request failed: ", e.what());
+            send_error(res, 500, e.what());
+        }
+    }
+    
+    /**
+     * @brief Answer for a request that was cancelled or ran out of time
+     * 
+     * Handlers commonly turn LLM failures into {"status": "error"}
+     * responses, so the context, not the response, says what happened.
+     * 
+     * @return true if the response was decided here (504, or none at all)
+     */
+    bool finish_request(const RequestContext& context, httplib::Response& res)
+    {
+        if (context.cancelled())
+        {
+            requests_cancelled_++;
+            return true;
+        }
+        if (context.expired())
+        {
+            deadlines_exceeded_++;
+            send_error(res, 504, DeadlineExceeded().what());
+            return true;
+        }
+        return false;
+    }
+    
+    /**
+     * @brief Run one parsed /api request, dispatching on its "action"
+     */
+    json run_request(const json& request)
+    {
+        return run_action(action_of(request), request);
+    }
+    
+    /**
+     * @brief Run one parsed request as the given action
+     * 
+     * Counts the request under its action and records it as failed when it
+     * throws (the exception is rethrown) or answers with status "error".
+     * 
+     * @param action Action name
+     * @param request Parsed request
+     * @return Derived class's response
+     */
+    json run_action(const std::string& action, const json& request)
+    {
+        Metrics::ActionScope scope = metrics_->track(action);
+        
+        json response;
+        try
+        {
+            response = dispatch(action, request);
+        }
+        catch (...)
+        {
+            scope.fail();
+            throw;
+        }
+        
+        auto status = response.find("status");
+        if (status != response.end() && *status == "error")
+        {
+            scope.fail();
+        }
+        
+        return response;
+    }
+    
+    /**
+     * @brief Call the handler of an action
+     * 
+     * Table actions are found with one hash and one comparison; anything
+     * else goes to process_request() if there is one.
+     */
+    json dispatch(const std::string& action, const json& request)
+    {
+        static_assert(has_actions<Derived>::value || has_process_request<Derived>::value,
+                      "Derived must implement process_request() or declare actions()");
+        
+        // Asynchronous and level-gated: free unless log_level = debug
+        Logger::instance().debug("Processing request: ", action);
+        
+        if constexpr (has_actions<Derived>::value)
+        {
+            using Table = ActionTable<Derived>;
+            
+            size_t index = Table::index.find(action);
+            if (index != Table::index.npos)
+            {
+                try
+                {
+                    return (derived().*Table::routes[index].handler)(request);
+                }
+                catch (const std::exception& e)
+                {
+                    return {
+                        {"status", "error"},
+                        {"message", std::string("LLM error: ") + e.what()}
+                    };
+                }
+            }
+        }
+        
+        if constexpr (has_process_request<Derived>::value)
+        {
+            return derived().process_request(request);
+        }
+        else
+        {
+            return {
+                {"status", "error"},
+                {"message", "Unknown action: " + action}
+            };
+        }
+    }
+    
+    /**
+     * @brief Setup the /api/batch endpoint
+     * 
+     * Accepts {"jobs": [request, ...]}, where each job is a request /api
+     * would accept. Up to batch_concurrency jobs (default: llama_slots) run
+     * at once, which keeps every scheduler slot busy without queueing the
+     * whole batch ahead of other clients. Each result is streamed as one
+     * NDJSON line, {"index": i, "response": {...}}, as soon as it finishes,
+     * so results arrive in completion order rather than job order. A final
+     * {"done": true, ...} line carries totals. If the client disconnects,
+     * jobs not yet started are skipped and running ones are cancelled.
+     * With compression on, the stream is encoded as Accept-Encoding allows,
+     * each line flushed as it is written.
+     * 
+     * A batch is admitted once, as the "batch" action, plus one unit of the
+     * global in-flight limit and its tenant's quota; its jobs are bounded by batch_concurrency
+     * rather than admitted one by one. The deadline covers the whole batch.
+     */
+    void setup_batch_route()
+    {
+        server_.Post("/api/batch", [this](const httplib::Request& req, httplib::Response& res)
+        {
+            auto reject = [&res](const std::string& message)
+            {
+                send_error(res, 400, message);
+            };
+            
+            auto context = make_request_context(req);
+            auto tickets = std::make_shared<std::vector<AdmissionControl::Ticket>>();
+            try
+            {
+                RequestContext::Scope context_scope(context);
+                tickets->push_back(admission_->admit());
+                tickets->push_back(admission_->admit_tenant(api_key_of(req)));
+                tickets->push_back(admission_->admit("batch"));
+            }
+            catch (const AdmissionError& e)
+            {
+                send_rejection(res, e);
+                return;
+            }
+            
+            auto parse_start = Metrics::Clock::now();
+            json request = json::parse(req.body, nullptr, false);
+            metrics_->request_parse.observe(Metrics::seconds_since(parse_start));
+            
+            if (!request.is_object() || !request.contains("jobs") || !request["jobs"].is_array())
+            {
+                reject("Batch request must be an object with a \"jobs\" array");
+                return;
+            }
+            
+            auto jobs = std::make_shared<json>(std::move(request["jobs"]));
+            size_t max_jobs = get_live_config()->batch_max_jobs;
+            if (jobs->size() > max_jobs)
+            {
+                reject("Batch has " + std::to_string(jobs->size()) + " jobs; batch_max_jobs is "
+                       + std::to_string(max_jobs));
+                return;
+            }
+            
+            {
+                RequestContext::Scope context_scope(context);
+                apply_deadline(request);
+            }
+            
+            res.set_header("Cache-Control", "no-cache");
+            std::shared_ptr<ResponseCompressor::StreamEncoder> encoder =
+                compressor_->negotiate_stream(req, res, "application/x-ndjson");
+            res.set_chunked_content_provider("application/x-ndjson",
+                [this, jobs, context, tickets, encoder](size_t, httplib::DataSink& sink)
+                {
+                    run_batch(*jobs, sink, context, encoder.get());
+                    sink.done();
+                    return true;
+                });
+        });
+    }
+    
+    /**
+     * @brief Run batch jobs concurrently and write NDJSON results in completion order
+     * 
+     * @param jobs Array of /api requests
+     * @param sink Chunked response sink
+     * @param context Context of the batch request, shared by every job
+     * @param encoder Content-Encoding of the stream, or nullptr
+     */
+    void run_batch(json& jobs, httplib::DataSink& sink, const std::shared_ptr<RequestContext>& context,
+                   ResponseCompressor::StreamEncoder* encoder)
+    {
+        Metrics::ActionScope batch_scope = metrics_->track("batch");
+        auto start = Metrics::Clock::now();
+        
+        size_t batch_concurrency = get_live_config()->batch_concurrency;
+        size_t concurrency = batch_concurrency > 0 ? batch_concurrency : config_.llama_slots;
+        size_t worker_count = std::min(concurrency, jobs.size());
+        
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<std::string> lines;      // Finished results not yet written
+        size_t next_job = 0;
+        size_t failed = 0;
+        size_t running_workers = worker_count;
+        bool cancelled = false;
+        
+        auto worker = [&]
+        {
+            RequestContext::Scope context_scope(context);
+            
+            while (true)
+            {
+                size_t index;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (cancelled || next_job >= jobs.size())
+                    {
+                        break;
+                    }
+                    index = next_job++;
+                }
+                
+                json response;
+                if (!jobs[index].is_object())
+                {
+                    response = {{"error", "Batch job must be an object"}, {"status", "failed"}};
+                }
+                else
+                {
+                    try
+                    {
+                        response = run_request(jobs[index]);
+                    }
+                    catch (const std::exception& e)
+                    {
+                        Logger::instance().warn("/api/batch job ", index, " failed: ", e.what());
+                        response = {{"error", e.what()}, {"status", "failed"}};
+                    }
+                }
+                jobs[index] = nullptr;  // Release the job's text early
+                
+                bool ok = response.is_object() && response.value("status", "") == "success";
+                std::string line = json{{"index", index}, {"response", std::move(response)}}.dump();
+                line += '\n';
+                
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    lines.push_back(std::move(line));
+                    failed += ok ? 0 : 1;
+                }
+                ready.notify_one();
+            }
+            
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                running_workers--;
+            }
+            ready.notify_one();
+        };
+        
+        std::vector<std::thread> workers;
+        workers.reserve(worker_count);
+        for (size_t i = 0; i < worker_count; i++)
+        {
+            workers.emplace_back(worker);
+        }
+        
+        size_t completed = 0;
+        bool open = true;
+        std::deque<std::string> pending;
+        std::string encoded;
+        
+        auto send = [&](const std::string& text)
+        {
+            if (!encoder)
+            {
+                return sink.write(text.data(), text.size());
+            }
+            return encoder->write(text.data(), text.size(), encoded)
+                && sink.write(encoded.data(), encoded.size());
+        };
+        
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                bool woken = ready.wait_for(lock, RequestContext::POLL_INTERVAL,
+                                            [&] { return !lines.empty() || running_workers == 0; });
+                if (!woken)
+                {
+                    // Nothing finished yet: notice a disconnect without waiting for a write
+                    if (open && !context->check_connection())
+                    {
+                        open = false;
+                        cancelled = true;
+                    }
+                    continue;
+                }
+                if (lines.empty())
+                {
+                    break;
+                }
+                pending.swap(lines);
+            }
+            
+            for (const auto& line : pending)
+            {
+                completed++;
+                if (open && !send(line))
+                {
+                    open = false;
+                    context->cancel();
+                    std::lock_guard<std::mutex> lock(mutex);
+                    cancelled = true;
+                }
+            }
+            pending.clear();
+        }
+        
+        for (auto& thread : workers)
+        {
+            thread.join();
+        }
+        
+        if (!open)
+        {
+            requests_cancelled_++;
+            batch_scope.fail();
+            Logger::instance().info("/api/batch client disconnected after ", completed, " of ", jobs.size(), " jobs");
+            return;
+        }
+        if (failed > 0)
+        {
+            batch_scope.fail();
+        }
+        
+        std::string summary = json{
+            {"done", true},
+            {"jobs", jobs.size()},
+            {"completed", completed},
+            {"failed", failed},
+            {"elapsed_ms", Metrics::seconds_since(start) * 1000.0}
+        }.dump();
+        summary += '\n';
+        if (send(summary) && encoder && encoder->finish(encoded) && sink.write(encoded.data(), encoded.size()))
+        {
+            compressor_->count(encoder->bytes_in(), encoder->bytes_out());
+        }
+    }
+    
+    /**
+     * @brief Setup the streaming /api/stream endpoint
+     * 
+     * Parses the request up front, then runs the derived class's
+     * process_stream_request() inside a chunked content provider so each
+     * event reaches the client as soon as it is written. Admission happens
+     * before the stream opens, so shed requests get a plain 429/503; a
+     * deadline hit mid-stream ends it with an error event.
+     */
+    void setup_stream_route()
+    {
+        server_.Post("/api/stream", [this](const httplib::Request& req, httplib::Response& res)
+        {
+            auto context = make_request_context(req);
+            auto tickets = std::make_shared<std::vector<AdmissionControl::Ticket>>();
+            
+            json request;
+            try
+            {
+                RequestContext::Scope context_scope(context);
+                tickets->push_back(admission_->admit());
+                tickets->push_back(admission_->admit_tenant(api_key_of(req)));
+                request = json::parse(req.body);
+                tickets->push_back(admission_->admit(action_of(request)));
+            }
+            catch (const AdmissionError& e)
+            {
+                send_rejection(res, e);
+                return;
+            }
+            catch (const std::exception& e)
+            {
+                send_error(res, 500, e.what());
+                return;
+            }
+            
+            {
+                RequestContext::Scope context_scope(context);
+                apply_deadline(request);
+            }
+            
+            res.set_header("Cache-Control", "no-cache");
+            res.set_chunked_content_provider("text/event-stream",
+                [this, request = std::move(request), context, tickets](size_t, httplib::DataSink& sink)
+                {
+                    RequestContext::Scope context_scope(context);
+                    StreamWriter writer(sink);
+                    Metrics::ActionScope scope = metrics_->track("stream:" + action_of(request));
+                    
+                    try
+                    {
+                        derived().process_stream_request(request, writer);
+                    }
+                    catch (const RequestCancelled&)
+                    {
+                        scope.fail();
+                        requests_cancelled_++;
+                    }
+                    catch (const std::exception& e)
+                    {
+                        scope.fail();
+                        if (context->expired())
+                        {
+                            deadlines_exceeded_++;
+                        }
+                        Logger::instance().warn("/api/stream request failed: ", e.what());
+                        writer.send({
+                            {"error", e.what()},
+                            {"status", "failed"}
+                        });
+                    }
+                    
+                    sink.done();
+                    return true;
+                });
+        });
+    }
+    
+    /**
+     * @brief Metrics label of a proxied path
+     * 
+     * Known llama-server endpoints get their own label; anything else is
+     * "proxy:other", so clients cannot mint labels.
+     */
+    static std::string proxy_label(const std::string& path)
+    {
+        static const std::pair<const char*, const char*> known[] = {
+            {"/v1/chat/completions", "proxy:chat_completions"},
+            {"/v1/completions", "proxy:completions"},
+            {"/v1/embeddings", "proxy:embeddings"},
+            {"/v1/models", "proxy:models"}
+        };
+        for (const auto& [endpoint, label] : known)
+        {
+            if (path == endpoint)
+            {
+                return label;
+            }
+        }
+        return "proxy:other";
+    }
+    
+    /**
+     * @brief Setup the /v1/... pass-through routes
+     */
+    void setup_proxy_routes()
+    {
+        auto handler = [this](const httplib::Request& req, httplib::Response& res)
+        {
+            serve_proxy(req, res);
+        };
+        server_.Get(R"(/v1/.*)", handler);
+        server_.Post(R"(/v1/.*)", handler);
+    }
+    
+    /**
+     * @brief Forward one /v1/... request and relay the reply as it arrives
+     * 
+     * The upstream call runs as a scheduler job, so it takes a llama-server
+     * slot, counts in the queue metrics and leases a backend from the pool
+     * like any completion. This thread waits for the reply headers (polling
+     * for disconnect and deadline), answers with them, then writes body
+     * chunks as the job hands them over through a ProxyStream. Admission
+     * tickets are held until the reply has been written.
+     */
+    void serve_proxy(const httplib::Request& req, httplib::Response& res)
+    {
+        auto context = make_request_context(req);
+        auto tickets = std::make_shared<std::vector<AdmissionControl::Ticket>>();
+        auto stream = std::make_shared<ProxyStream>();
+        
+        try
+        {
+            {
+                RequestContext::Scope context_scope(context);
+                tickets->push_back(admission_->admit());
+                tickets->push_back(admission_->admit_tenant(api_key_of(req)));
+                tickets->push_back(admission_->admit("proxy"));
+            }
+            
+            ProxyRequest request = ProxyStream::make_request(req);
+            if constexpr (has_rewrite_proxy_request<Derived>::value)
+            {
+                derived().rewrite_proxy_request(request);
+            }
+            
+            std::shared_future<json> done;
+            {
+                RequestContext::Scope context_scope(context);
+                done = scheduler_->submit([this, stream, request = std::move(request),
+                                           label = proxy_label(req.path)](LlamaClient& client) mutable
+                {
+                    Metrics::ActionScope scope = metrics_->track(label);
+                    try
+                    {
+                        stream->run(client.get_backends(), request);
+                    }
+                    catch (...)
+                    {
+                        scope.fail();
+                        throw;
+                    }
+                    if (stream->status() >= 400 || stream->failed())
+                    {
+                        scope.fail();
+                    }
+                    return json();
+                });
+            }
+            
+            // A job dropped while queued never touches the stream, so watch
+            // its future too
+            while (!stream->wait_headers(RequestContext::POLL_INTERVAL))
+            {
+                if (done.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+                {
+                    break;
+                }
+                if (!context->check_connection())
+                {
+                    throw RequestCancelled();
+                }
+                if (context->expired())
+                {
+                    context->cancel();
+                    throw DeadlineExceeded();
+                }
+            }
+            
+            if (!stream->has_headers())
+            {
+                std::string error = stream->error();
+                try
+                {
+                    done.get();
+                }
+                catch (const std::exception& e)
+                {
+                    error = e.what();
+                }
+                
+                if (!finish_request(*context, res))
+                {
+                    send_error(res, 502, error.empty() ? "No reply from llama-server" : error);
+                }
+                return;
+            }
+        }
+        catch (const AdmissionError& e)
+        {
+            send_rejection(res, e);
+            return;
+        }
+        catch (const DeadlineExceeded& e)
+        {
+            stream->close();
+            deadlines_exceeded_++;
+            send_error(res, 504, e.what());
+            return;
+        }
+        catch (const RequestCancelled&)
+        {
+            stream->close();
+            requests_cancelled_++;
+            return;
+        }
+        catch (const std::exception& e)
+        {
+            stream->close();
+            send_error(res, 500, e.what());
+            return;
+        }
+        
+        int status = stream->status();
+        httplib::Headers headers = stream->headers();
+        if constexpr (has_rewrite_proxy_response<Derived>::value)
+        {
+            derived().rewrite_proxy_response(status, headers);
+        }
+        
+        // set_content_provider() writes Content-Type itself
+        std::string content_type = "application/octet-stream";
+        auto type = headers.find("Content-Type");
+        if (type != headers.end())
+        {
+            content_type = type->second;
+            headers.erase(type);
+        }
+        
+        res.status = status;
+        for (const auto& [name, value] : headers)
+        {
+            res.set_header(name, value);
+        }
+        
+        auto relay = [stream](httplib::DataSink& sink)
+        {
+            std::string chunk;
+            while (stream->next(chunk))
+            {
+                if (!sink.write(chunk.data(), chunk.size()))
+                {
+                    stream->close();
+                    return false;
+                }
+            }
+            return !stream->failed();
+        };
+        auto release = [stream, context, tickets](bool success)
+        {
+            if (!success)
+            {
+                stream->close();
+                context->cancel();
+            }
+        };
+        
+        // Keep llama-server's framing: sized replies stay sized, streamed
+        // ones are relayed chunked
+        int64_t length = stream->content_length();
+        if (status == 204 || status == 304)
+        {
+            return;
+        }
+        if (length >= 0)
+        {
+            // relay() writes the whole body; being called again means
+            // llama-server sent less than it announced
+            res.set_content_provider(static_cast<size_t>(length), content_type,
+                [relay, relayed = false](size_t, size_t, httplib::DataSink& sink) mutable
+                {
+                    if (relayed)
+                    {
+                        return false;
+                    }
+                    relayed = true;
+                    return relay(sink);
+                },
+                release);
+        }
+        else
+        {
+            res.set_chunked_content_provider(content_type,
+                [relay](size_t, httplib::DataSink& sink)
+                {
+                    if (!relay(sink))
+                    {
+                        return false;
+                    }
+                    sink.done();
+                    return true;
+                },
+                release);
+        }
+    }
+
+public:
+    /**
+     * @brief Start the HTTP server
+     * 
+     * Binds to configured port and begins listening for requests.
+     * This is a blocking call. With llama_spawn, the llama-servers are
+     * launched first, and the port opens only once every one of them has
+     * loaded the model and answered a warm-up prompt.
+     * 
+     * @throws std::runtime_error if server fails to start
+     */
+    void start()
+    {
+        std::string host = "0.0.0.0";
+        int port = config_.app_server_port;
+        
+        if (supervisor_)
+        {
+            std::cout << color::YELLOW << "Launching " << config_.llama_spawn
+                      << " llama-server instance(s)..." << color::RESET << std::endl;
+            supervisor_->start();
+        }
+        
+        std::cout << color::GREEN << "Server listening on " << host << ":" << port << color::RESET << std::endl;
+        std::cout << color::BLUE << "Endpoints:" << color::RESET << std::endl;
+        std::cout << "  GET  /health - Health check" << std::endl;
+        std::cout << "  GET  /stats  - Scheduler statistics" << std::endl;
+        std::cout << "  GET  /metrics - Prometheus metrics" << std::endl;
+        std::cout << "  POST /api    - Main API endpoint" << std::endl;
+        if constexpr (has_actions<Derived>::value)
+        {
+            for (const auto& route : ActionTable<Derived>::routes)
+            {
+                std::cout << "  POST /api/" << route.name << std::endl;
+            }
+        }
+        std::cout << "  POST /api/batch - Batch API endpoint (NDJSON)" << std::endl;
+        if constexpr (has_process_stream_request<Derived>::value)
+        {
+            std::cout << "  POST /api/stream - Streaming API endpoint (SSE)" << std::endl;
+        }
+        if (config_.openai_proxy)
+        {
+            std::cout << "  GET|POST /v1/* - Pass-through to llama-server" << std::endl;
+        }
+        std::cout << std::endl;
+        
+        if (config_.admin_port != 0)
+        {
+            int admin_port = config_.admin_port;
+            
+            if (!admin_server_.bind_to_port(host, admin_port))
+            {
+                throw std::runtime_error("Failed to start admin server on port " + std::to_string(admin_port));
+            }
+            
+            std::cout << color::GREEN << "Admin listening on " << host << ":" << admin_port
+                      << " (/health, /stats, /metrics)" << color::RESET << std::endl;
+            
+            admin_thread_ = std::thread([this] { admin_server_.listen_after_bind(); });
+        }
+        
+        reload_thread_ = std::thread([this] { reload_loop(); });
+        
+        if (!server_.listen(host, port))
+        {
+            throw std::runtime_error("Failed to start server on port " + std::to_string(port));
+        }
+    }
+    
+    /**
+     * @brief Stop the HTTP server
+     * 
+     * Gracefully shuts down the server (and the admin server and launched
+     * llama-servers, if any).
+     */
+    void stop()
+    {
+        server_.stop();
+        admin_server_.stop();
+        stop_reload_thread();
+        if (supervisor_)
+        {
+            supervisor_->stop();
+        }
+    }
+    
+    /**
+     * @brief Get LlamaClient for derived classes to use
+     * 
+     * Provides access to llama-server client for LLM operations.
+     * 
+     * @return Pointer to LlamaClient instance
+     */
+    LlamaClient* get_llama_client()
+    {
+        return llama_client_.get();
+    }
+    
+    /**
+     * @brief Get RequestScheduler for derived classes to use
+     * 
+     * Preferred entry point for LLM calls: queues work so that at most
+     * llama_slots requests reach llama-server at once.
+     * 
+     * @return Pointer to RequestScheduler instance
+     */
+    RequestScheduler* get_scheduler()
+    {
+        return scheduler_.get();
+    }
+    
+    /**
+     * @brief Get SlotAffinity table for derived classes to use
+     * 
+     * Acquire a lease per request and send its backend() and id() as
+     * CompletionParams::backend and id_slot so that requests sharing a
+     * prompt prefix reuse the KV cache of the llama-server holding it.
+     * 
+     * @return Pointer to SlotAffinity instance
+     */
+    SlotAffinity* get_slot_affinity()
+    {
+        return slot_affinity_.get();
+    }
+    
+    /**
+     * @brief Get SessionStore for derived classes to use
+     * 
+     * Holds multi-turn chat history so clients only send the new message.
+     * 
+     * @return Pointer to SessionStore instance
+     */
+    SessionStore* get_session_store()
+    {
+        return session_store_.get();
+    }
+    
+    /**
+     * @brief Get runtime configuration
+     * 
+     * The configuration the server started with; see get_live_config()
+     * for settings that can change on reload.
+     * 
+     * @return Reference to RuntimeConfig
+     */
+    const RuntimeConfig& get_config() const
+    {
+        return config_;
+    }
+    
+    /**
+     * @brief Get the current configuration, including reloaded settings
+     * 
+     * Holds a snapshot: a concurrent reload does not change it under the
+     * caller. Read reloadable settings (e.g., get_action_defaults()) here.
+     * 
+     * @return Shared snapshot of the current RuntimeConfig
+     */
+    std::shared_ptr<const RuntimeConfig> get_live_config() const
+    {
+        return std::atomic_load(&live_config_);
+    }
+    
+    /**
+     * @brief Re-read the config file and apply its reloadable settings
+     * 
+     * Settings that need a restart are left as they are and logged. An
+     * unreadable or invalid file leaves the current settings in place.
+     * 
+     * @return true if the file was read and applied
+     */
+    bool reload_config()
+    {
+        auto current = get_live_config();
+        if (current->source_path.empty())
+        {
+            Logger::instance().warn("Config reload skipped: configuration was not read from a file");
+            return false;
+        }
+        
+        try
+        {
+            RuntimeConfig next = RuntimeConfig::from_file(current->source_path);
+            next.validate();
+            
+            RuntimeConfig merged = *current;
+            std::vector<std::string> restart_needed = merged.apply_reloadable(next);
+            
+            Logger::instance().set_level(merged.log_level);
+            std::atomic_store(&live_config_, std::shared_ptr<const RuntimeConfig>(
+                std::make_shared<RuntimeConfig>(std::move(merged))));
+            
+            Logger::instance().info("Reloaded ", current->source_path);
+            if (!restart_needed.empty())
+            {
+                std::string keys;
+                for (const auto& key : restart_needed)
+                {
+                    keys += (keys.empty() ? "" : ", ") + key;
+                }
+                Logger::instance().warn("Changed settings not applied until restart: ", keys);
+            }
+            return true;
+        }
+        catch (const std::exception& e)
+        {
+            Logger::instance().warn("Config reload failed, keeping current settings: ", e.what());
+            return false;
+        }
+    }
+    
+    /**
+     * @brief Ask the running server to reload its config file
+     * 
+     * Async-signal-safe, for use in a SIGHUP handler; the reload runs on a
+     * background thread within a quarter of a second.
+     */
+    static void request_reload()
+    {
+        reload_requested_.store(true);
+    }
+    
+    /**
+     * @brief Get metrics registry
+     * 
+     * For derived classes recording their own stages (e.g., in
+     * process_raw_request(), which the base class does not time).
+     * 
+     * @return Pointer to the metrics shared with the client and scheduler
+     */
+    Metrics* get_metrics()
+    {
+        return metrics_.get();
+    }
+    
+    /**
+     * @brief Get admission control for derived classes to use
+     * 
+     * For process_raw_request(), which runs before the base class knows the
+     * action: take admit(action) there to apply per-action limits.
+     * 
+     * @return Pointer to AdmissionControl instance
+     */
+    AdmissionControl* get_admission()
+    {
+        return admission_.get();
     }
 };
 
@@ -0,0 +1,693 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file llama_supervisor.hpp
+ * @brief Launches and Supervises llama-server Processes
+ *
+ * Starts one or more llama-server instances on consecutive ports and keeps
+ * them running:
+ *
+ *  - start() blocks until every instance answers /health with 200 (model
+ *    loaded) and has served a short warm-up completion, so the first real
+ *    request never hits a cold model
+ *  - an instance that exits is restarted, with backoff doubling up to
+ *    max_restart_delay while it keeps failing
+ *  - stop() sends SIGTERM, then SIGKILL to instances that do not exit
+ *
+ * POSIX only (fork/exec). On Linux, instances also receive SIGTERM if the
+ * app server dies without running stop(). On Windows, LlamaSupervisor is a
+ * stub whose start() throws; RuntimeConfig rejects llama_spawn there.
+ *
+ * @author Pooria Yousefi
+ * @date October 6, 2025
+ */
+
+#ifndef POORIAYOUSEFI_LLAMA_APP_LLAMA_SUPERVISOR_HPP
+#define POORIAYOUSEFI_LLAMA_APP_LLAMA_SUPERVISOR_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <cerrno>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+#include "httplib.h"
+#include "json.hpp"
+#include "logger.hpp"
+
+namespace pooriayousefi
+{
+namespace llama
+{
+namespace app
+{
+
+using json = nlohmann::json;
+
+/**
+ * @struct LlamaServerOptions
+ * @brief Command line and supervision settings for llama-server instances
+ */
+struct LlamaServerOptions
+{
+    std::string executable;             ///< Path to llama-server
+    std::string model_path;             ///< -m
+    std::string host = "127.0.0.1";     ///< --host
+    std::vector<int> ports;             ///< One instance per port
+    int threads = 0;                    ///< -t, 0 = llama-server default
+    int ctx_size = 0;                   ///< -c (shared by the instance's slots), 0 = default
+    int parallel = 0;                   ///< -np, 0 = default
+    int gpu_layers = -1;                ///< -ngl, -1 = default
+    bool mmap = true;                   ///< false adds --no-mmap
+    bool mlock = false;                 ///< true adds --mlock
+    std::string draft_model_path;       ///< -md, empty = no speculative decoding
+    int draft_max = 0;                  ///< --draft-max, 0 = default
+    int draft_min = 0;                  ///< --draft-min, 0 = default
+    float draft_p_min = -1.0f;          ///< --draft-p-min, negative = default
+    int draft_gpu_layers = -1;          ///< -ngld, -1 = default
+    std::vector<std::string> extra_args;
+    std::string log_dir;                ///< llama-server-<port>.log goes here; empty = discard
+    int startup_timeout = 300;          ///< Seconds for the model to load
+    std::string warmup_prompt = "Hello"; ///< Empty = no warm-up request
+    int max_restart_delay = 30;         ///< Backoff cap in seconds
+};
+
+#ifndef _WIN32
+
+/**
+ * @class LlamaSupervisor
+ * @brief Owns llama-server child processes, one supervision thread each
+ */
+class LlamaSupervisor
+{
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Instance
+    {
+        int port;
+        pid_t pid = -1;                 ///< Running child, -1 if none (guarded by mutex_)
+        bool ready = false;
+        bool started_once = false;      ///< Has been ready at least once
+        bool failed = false;            ///< Failed before its first readiness
+        unsigned restarts = 0;
+        std::string last_error;
+        std::thread thread;
+    };
+
+    LlamaServerOptions options_;
+    std::vector<std::unique_ptr<Instance>> instances_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+    bool stopping_ = false;
+
+    /**
+     * @brief Command line of the instance on a port
+     */
+    std::vector<std::string> command(int port) const
+    {
+        std::vector<std::string> args = {
+            options_.executable,
+            "-m", options_.model_path,
+            "--host", options_.host,
+            "--port", std::to_string(port)
+        };
+
+        if (options_.threads > 0)
+        {
+            args.insert(args.end(), {"-t", std::to_string(options_.threads)});
+        }
+        if (options_.ctx_size > 0)
+        {
+            args.insert(args.end(), {"-c", std::to_string(options_.ctx_size)});
+        }
+        if (options_.parallel > 0)
+        {
+            args.insert(args.end(), {"-np", std::to_string(options_.parallel)});
+        }
+        if (options_.gpu_layers >= 0)
+        {
+            args.insert(args.end(), {"-ngl", std::to_string(options_.gpu_layers)});
+        }
+        if (!options_.mmap)
+        {
+            args.push_back("--no-mmap");
+        }
+        if (options_.mlock)
+        {
+            args.push_back("--mlock");
+        }
+        if (!options_.draft_model_path.empty())
+        {
+            args.insert(args.end(), {"-md", options_.draft_model_path});
+            if (options_.draft_max > 0)
+            {
+                args.insert(args.end(), {"--draft-max", std::to_string(options_.draft_max)});
+            }
+            if (options_.draft_min > 0)
+            {
+                args.insert(args.end(), {"--draft-min", std::to_string(options_.draft_min)});
+            }
+            if (options_.draft_p_min >= 0.0f)
+            {
+                args.insert(args.end(), {"--draft-p-min", std::to_string(options_.draft_p_min)});
+            }
+            if (options_.draft_gpu_layers >= 0)
+            {
+                args.insert(args.end(), {"-ngld", std::to_string(options_.draft_gpu_layers)});
+            }
+        }
+        args.insert(args.end(), options_.extra_args.begin(), options_.extra_args.end());
+
+        return args;
+    }
+
+    /**
+     * @brief fork/exec one llama-server
+     *
+     * @return Child pid
+     *
+     * @throws std::runtime_error if fork() fails
+     */
+    pid_t spawn(int port) const
+    {
+        // Everything the child needs is prepared before fork(): only
+        // async-signal-safe calls are allowed between fork() and exec
+        std::vector<std::string> args = command(port);
+        std::vector<char*> argv;
+        argv.reserve(args.size() + 1);
+        for (auto& arg : args)
+        {
+            argv.push_back(arg.data());
+        }
+        argv.push_back(nullptr);
+
+        std::string log_path = options_.log_dir.empty()
+            ? "/dev/null" : options_.log_dir + "/llama-server-" + std::to_string(port) + ".log";
+        pid_t parent = getpid();
+
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            throw std::runtime_error("fork() failed for llama-server on port " + std::to_string(port));
+        }
+
+        if (pid == 0)
+        {
+            // Own process group: a Ctrl+C in the terminal reaches only the
+            // app server, so instances are never restarted mid-shutdown
+            setpgid(0, 0);
+#ifdef __linux__
+            // Sent when the forking (supervision) thread dies, which is
+            // only at stop() or process exit
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+            if (getppid() != parent)
+            {
+                _exit(127);
+            }
+#else
+            (void)parent;
+#endif
+            int out = open(log_path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+            if (out >= 0)
+            {
+                dup2(out, STDOUT_FILENO);
+                dup2(out, STDERR_FILENO);
+                close(out);
+            }
+            int in = open("/dev/null", O_RDONLY);
+            if (in >= 0)
+            {
+                dup2(in, STDIN_FILENO);
+                close(in);
+            }
+
+            execv(argv[0], argv.data());
+            _exit(127);
+        }
+
+        return pid;
+    }
+
+    /**
+     * @brief Human-readable wait() status
+     */
+    static std::string describe_exit(int status)
+    {
+        if (WIFEXITED(status))
+        {
+            return "exited with status " + std::to_string(WEXITSTATUS(status));
+        }
+        if (WIFSIGNALED(status))
+        {
+            return "killed by signal " + std::to_string(WTERMSIG(status));
+        }
+        return "stopped";
+    }
+
+    /**
+     * @brief Reap the instance's child if it has exited, without blocking
+     *
+     * @return true (with status set) if it had exited
+     */
+    bool try_reap(Instance& instance, int& status)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (instance.pid > 0 && waitpid(instance.pid, &status, WNOHANG) == instance.pid)
+        {
+            instance.pid = -1;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Block until the instance's child exits, then reap it
+     *
+     * Waits without reaping first, so stop() can never signal a pid that
+     * has been reused by another process.
+     */
+    int wait_exit(Instance& instance)
+    {
+        pid_t pid;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            pid = instance.pid;
+        }
+
+        siginfo_t info;
+        while (waitid(P_PID, static_cast<id_t>(pid), &info, WEXITED | WNOWAIT) < 0 && errno == EINTR)
+        {
+        }
+
+        int status = 0;
+        std::lock_guard<std::mutex> lock(mutex_);
+        waitpid(pid, &status, 0);
+        instance.pid = -1;
+        return status;
+    }
+
+    /**
+     * @brief Sleep unless stopping
+     *
+     * @return false if stop() was called
+     */
+    bool sleep_for(std::chrono::milliseconds duration)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return !changed_.wait_for(lock, duration, [this] { return stopping_; });
+    }
+
+    /**
+     * @brief Poll /health until the model is loaded
+     *
+     * llama-server answers 503 while loading and 200 once ready.
+     *
+     * @param error Set to the reason on failure
+     * @return true once ready
+     */
+    bool wait_ready(Instance& instance, std::string& error)
+    {
+        httplib::Client client(options_.host, instance.port);
+        client.set_connection_timeout(1);
+        client.set_read_timeout(2);
+
+        auto deadline = Clock::now() + std::chrono::seconds(options_.startup_timeout);
+        while (Clock::now() < deadline)
+        {
+            int status = 0;
+            if (try_reap(instance, status))
+            {
+                error = describe_exit(status) + " during startup";
+                return false;
+            }
+
+            auto res = client.Get("/health");
+            if (res && res->status == 200)
+            {
+                return true;
+            }
+
+            if (!sleep_for(std::chrono::milliseconds(250)))
+            {
+                error = "stopped during startup";
+                return false;
+            }
+        }
+
+        error = "not ready after " + std::to_string(options_.startup_timeout) + "s";
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (instance.pid > 0)
+        {
+            kill(instance.pid, SIGKILL);
+        }
+        return false;
+    }
+
+    /**
+     * @brief Send one short completion so weights are paged in and the
+     *        compute buffers allocated before real traffic arrives
+     */
+    void warm_up(int port)
+    {
+        if (options_.warmup_prompt.empty())
+        {
+            return;
+        }
+
+        httplib::Client client(options_.host, port);
+        client.set_read_timeout(options_.startup_timeout);
+
+        auto start = Clock::now();
+        json request = {
+            {"prompt", options_.warmup_prompt},
+            {"n_predict", 8}
+        };
+        auto res = client.Post("/completion", request.dump(), "application/json");
+
+        if (!res || res->status != 200)
+        {
+            Logger::instance().warn("llama-server on port ", port, ": warm-up request failed");
+            return;
+        }
+        Logger::instance().debug("llama-server on port ", port, ": warm-up took ",
+                                 std::chrono::duration<double, std::milli>(Clock::now() - start).count(), "ms");
+    }
+
+    /**
+     * @brief Run, watch and restart one instance until stop()
+     */
+    void supervise(Instance& instance)
+    {
+        std::chrono::seconds delay(1);
+
+        while (true)
+        {
+            std::string failure;
+            try
+            {
+                pid_t pid = spawn(instance.port);
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    instance.pid = pid;
+                    if (stopping_)
+                    {
+                        kill(pid, SIGTERM);
+                    }
+                }
+
+                if (wait_ready(instance, failure))
+                {
+                    warm_up(instance.port);
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        instance.ready = true;
+                        instance.started_once = true;
+                    }
+                    changed_.notify_all();
+                    Logger::instance().info("llama-server on port ", instance.port, " is ready (pid ", pid, ")");
+                    delay = std::chrono::seconds(1);
+
+                    int status = wait_exit(instance);
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        instance.ready = false;
+                    }
+                    failure = describe_exit(status);
+                }
+                else if (failure != "stopped during startup")
+                {
+                    // Reap a child that is still running (e.g., timed out)
+                    int status = 0;
+                    if (!try_reap(instance, status))
+                    {
+                        {
+                            std::lock_guard<std::mutex> lock(mutex_);
+                            if (instance.pid > 0)
+                            {
+                                kill(instance.pid, SIGKILL);
+                            }
+                        }
+                        wait_exit(instance);
+                    }
+                }
+            }
+            catch (const std::exception& e)
+            {
+                failure = e.what();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stopping_)
+                {
+                    break;
+                }
+                instance.last_error = failure;
+                // A first start that fails is a configuration problem:
+                // start() reports it instead of retrying
+                instance.failed = !instance.started_once;
+                if (!instance.failed)
+                {
+                    instance.restarts++;
+                }
+            }
+            changed_.notify_all();
+            if (instance.failed)
+            {
+                break;
+            }
+
+            Logger::instance().warn("llama-server on port ", instance.port, " ", failure,
+                                    "; restarting in ", delay.count(), "s");
+            if (!sleep_for(delay))
+            {
+                break;
+            }
+            delay = std::min(delay * 2, std::chrono::seconds(std::max(options_.max_restart_delay, 1)));
+        }
+
+        // Child stopped by stop(): reap it
+        if (instance.pid > 0)
+        {
+            wait_exit(instance);
+        }
+    }
+
+public:
+    /**
+     * @brief Construct supervisor (nothing is started yet)
+     *
+     * @param options Command line and supervision settings
+     */
+    explicit LlamaSupervisor(LlamaServerOptions options)
+        : options_(std::move(options))
+    {
+    }
+
+    LlamaSupervisor(const LlamaSupervisor&) = delete;
+    LlamaSupervisor& operator=(const LlamaSupervisor&) = delete;
+
+    ~LlamaSupervisor()
+    {
+        stop();
+    }
+
+    /**
+     * @brief Launch every instance and wait until all are ready and warm
+     *
+     * @throws std::runtime_error if an instance fails before its first
+     *         readiness (all instances are stopped again)
+     */
+    void start()
+    {
+        if (!instances_.empty())
+        {
+            return;
+        }
+
+        Logger::instance().info("Starting ", options_.ports.size(), " llama-server instance(s) with ",
+                                options_.model_path,
+                                options_.draft_model_path.empty() ? "" : " (draft model " + options_.draft_model_path + ")");
+
+        for (int port : options_.ports)
+        {
+            auto instance = std::make_unique<Instance>();
+            instance->port = port;
+            instances_.push_back(std::move(instance));
+        }
+        for (auto& instance : instances_)
+        {
+            Instance* target = instance.get();
+            instance->thread = std::thread([this, target] { supervise(*target); });
+        }
+
+        std::string failure;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [this, &failure]
+            {
+                bool all_ready = true;
+                for (const auto& instance : instances_)
+                {
+                    if (instance->failed)
+                    {
+                        failure = "llama-server on port " + std::to_string(instance->port)
+                                + " failed to start: " + instance->last_error;
+                        return true;
+                    }
+                    all_ready = all_ready && instance->started_once;
+                }
+                return all_ready;
+            });
+        }
+
+        if (!failure.empty())
+        {
+            stop();
+            throw std::runtime_error(failure);
+        }
+    }
+
+    /**
+     * @brief Stop every instance (SIGTERM, then SIGKILL after 10s)
+     */
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_)
+            {
+                return;
+            }
+            stopping_ = true;
+            for (auto& instance : instances_)
+            {
+                if (instance->pid > 0)
+                {
+                    kill(instance->pid, SIGTERM);
+                }
+            }
+        }
+        changed_.notify_all();
+
+        auto deadline = Clock::now() + std::chrono::seconds(10);
+        for (auto& instance : instances_)
+        {
+            while (Clock::now() < deadline)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (instance->pid <= 0)
+                    {
+                        break;
+                    }
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (instance->pid > 0)
+                {
+                    kill(instance->pid, SIGKILL);
+                }
+            }
+            if (instance->thread.joinable())
+            {
+                instance->thread.join();
+            }
+        }
+    }
+
+    /**
+     * @brief Per-instance state
+     *
+     * @return JSON array suitable for a diagnostics endpoint
+     */
+    json stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        json result = json::array();
+        for (const auto& instance : instances_)
+        {
+            result.push_back({
+                {"port", instance->port},
+                {"pid", instance->pid},
+                {"ready", instance->ready},
+                {"restarts", instance->restarts},
+                {"last_error", instance->last_error}
+            });
+        }
+        return result;
+    }
+};
+
+#else
+
+/**
+ * @class LlamaSupervisor
+ * @brief Windows stand-in: launching llama-server needs fork/exec
+ */
+class LlamaSupervisor
+{
+public:
+    explicit LlamaSupervisor(LlamaServerOptions)
+    {
+    }
+
+    /**
+     * @throws std::runtime_error always
+     */
+    void start()
+    {
+        throw std::runtime_error("llama_spawn is not supported on Windows; start llama-server "
+                                 "yourself and list it with backend lines");
+    }
+
+    void stop()
+    {
+    }
+
+    json stats() const
+    {
+        return json::array();
+    }
+};
+
+#endif
+
+} // namespace app
+} // namespace llama
+} // namespace pooriayousefi
+
+#endif // POORIAYOUSEFI_LLAMA_APP_LLAMA_SUPERVISOR_HPP
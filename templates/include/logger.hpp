@@ -0,0 +1,260 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file logger.hpp
+ * @brief Asynchronous Level-gated Logger
+ *
+ * Messages below the configured level cost one atomic load; their
+ * arguments are never formatted. Enabled messages are formatted on the
+ * calling thread and handed to a background writer, so request threads
+ * never block on console I/O. The writer flushes once per drained batch
+ * instead of once per line.
+ *
+ * Usage:
+ *   Logger::instance().info("Listening on ", port);
+ *   Logger::instance().debug("[MyApp] action=", action);
+ *
+ * @author Pooria Yousefi
+ * @date October 6, 2025
+ */
+
+#ifndef POORIAYOUSEFI_LLAMA_APP_LOGGER_HPP
+#define POORIAYOUSEFI_LLAMA_APP_LOGGER_HPP
+
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <stdexcept>
+
+namespace pooriayousefi
+{
+namespace llama
+{
+namespace app
+{
+
+/**
+ * @brief Log severity, lowest first
+ */
+enum class LogLevel
+{
+    Debug = 0,
+    Info = 1,
+    Warn = 2,
+    Error = 3,
+    Off = 4
+};
+
+/**
+ * @class Logger
+ * @brief Process-wide asynchronous logger
+ */
+class Logger
+{
+private:
+    /// Lines kept when the writer falls behind; older ones are dropped
+    static constexpr size_t MAX_PENDING = 10000;
+
+    std::atomic<int> level_{static_cast<int>(LogLevel::Info)};
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<std::string> pending_;
+    size_t dropped_ = 0;
+    bool stopping_ = false;
+    std::thread writer_;
+
+    Logger()
+        : writer_([this] { writer_loop(); })
+    {
+    }
+
+    static const char* tag(LogLevel level)
+    {
+        switch (level)
+        {
+            case LogLevel::Debug: return "[debug] ";
+            case LogLevel::Info:  return "[info]  ";
+            case LogLevel::Warn:  return "[warn]  ";
+            case LogLevel::Error: return "[error] ";
+            default:              return "";
+        }
+    }
+
+    /**
+     * @brief Background writer: drain the queue, then flush once
+     */
+    void writer_loop()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        std::deque<std::string> batch;
+
+        while (true)
+        {
+            wake_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+
+            if (pending_.empty())
+            {
+                return; // stopping_ and drained
+            }
+
+            batch.swap(pending_);
+            size_t dropped = dropped_;
+            dropped_ = 0;
+            lock.unlock();
+
+            if (dropped > 0)
+            {
+                std::cout << tag(LogLevel::Warn) << dropped << " log lines dropped\n";
+            }
+            for (const auto& line : batch)
+            {
+                std::cout << line << '\n';
+            }
+            std::cout.flush();
+            batch.clear();
+
+            lock.lock();
+        }
+    }
+
+    void enqueue(std::string line)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (pending_.size() >= MAX_PENDING)
+            {
+                pending_.pop_front();
+                dropped_++;
+            }
+            pending_.push_back(std::move(line));
+        }
+        wake_.notify_one();
+    }
+
+public:
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    /**
+     * @brief Write out pending lines and stop the writer
+     */
+    ~Logger()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        writer_.join();
+    }
+
+    /**
+     * @brief The process-wide logger
+     */
+    static Logger& instance()
+    {
+        static Logger logger;
+        return logger;
+    }
+
+    /**
+     * @brief Parse a level name: debug, info, warn, error or off
+     *
+     * @throws std::runtime_error for unknown names
+     */
+    static LogLevel parse_level(const std::string& name)
+    {
+        if (name == "debug") return LogLevel::Debug;
+        if (name == "info")  return LogLevel::Info;
+        if (name == "warn")  return LogLevel::Warn;
+        if (name == "error") return LogLevel::Error;
+        if (name == "off")   return LogLevel::Off;
+        throw std::runtime_error("Invalid log level: " + name);
+    }
+
+    /**
+     * @brief Set the minimum level that is written
+     */
+    void set_level(LogLevel level)
+    {
+        level_.store(static_cast<int>(level), std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Check whether a level is written (cheap; no formatting)
+     */
+    bool enabled(LogLevel level) const
+    {
+        return static_cast<int>(level) >= level_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Format and queue a message if its level is enabled
+     *
+     * @param level Message severity
+     * @param args Values streamed into the message in order
+     */
+    template<typename... Args>
+    void log(LogLevel level, const Args&... args)
+    {
+        if (!enabled(level) || level == LogLevel::Off)
+        {
+            return;
+        }
+
+        std::ostringstream line;
+        line << tag(level);
+        (line << ... << args);
+        enqueue(line.str());
+    }
+
+    template<typename... Args>
+    void debug(const Args&... args)
+    {
+        log(LogLevel::Debug, args...);
+    }
+
+    template<typename... Args>
+    void info(const Args&... args)
+    {
+        log(LogLevel::Info, args...);
+    }
+
+    template<typename... Args>
+    void warn(const Args&... args)
+    {
+        log(LogLevel::Warn, args...);
+    }
+
+    template<typename... Args>
+    void error(const Args&... args)
+    {
+        log(LogLevel::Error, args...);
+    }
+};
+
+} // namespace app
+} // namespace llama
+} // namespace pooriayousefi
+
+#endif // POORIAYOUSEFI_LLAMA_APP_LOGGER_HPP
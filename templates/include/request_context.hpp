@@ -0,0 +1,436 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file request_context.hpp
+ * @brief Per-request Deadline and Cancellation
+ *
+ * AppServerBase creates one RequestContext per client request and installs
+ * it as the calling thread's current context. RequestScheduler carries it
+ * over to the slot worker that runs the job, and LlamaClient applies it to
+ * every llama-server call:
+ *
+ *  - the remaining time until the deadline becomes the upstream timeout
+ *  - cancel() (e.g., the client disconnected) aborts upstream calls in
+ *    flight and makes queued jobs fail without reaching llama-server
+ *  - wait() blocks on a job's future while watching both
+ *  - the priority class decides which RequestScheduler queue its jobs
+ *    wait in
+ *
+ * A job several requests wait on (RequestScheduler's coalesced jobs) runs
+ * under a shared context of its own instead, which the waiting requests
+ * hold(): it is cancelled only once every holder has been, so one client
+ * going away or running out of time does not abort the others' call.
+ *
+ * @author Pooria Yousefi
+ * @date October 6, 2025
+ */
+
+#ifndef POORIAYOUSEFI_LLAMA_APP_REQUEST_CONTEXT_HPP
+#define POORIAYOUSEFI_LLAMA_APP_REQUEST_CONTEXT_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <functional>
+#include <stdexcept>
+#include <algorithm>
+#include "httplib.h"
+
+namespace pooriayousefi
+{
+namespace llama
+{
+namespace app
+{
+
+/**
+ * @brief Thrown when a request runs past its deadline
+ */
+class DeadlineExceeded : public std::runtime_error
+{
+public:
+    DeadlineExceeded()
+        : std::runtime_error("Request deadline exceeded")
+    {
+    }
+};
+
+/**
+ * @brief Thrown when a request was cancelled (e.g., the client went away)
+ */
+class RequestCancelled : public std::runtime_error
+{
+public:
+    RequestCancelled()
+        : std::runtime_error("Request cancelled")
+    {
+    }
+};
+
+/**
+ * @class RequestContext
+ * @brief Deadline, cancellation flag and in-flight upstream calls of one request
+ */
+class RequestContext
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// How often wait() checks the client connection and deadline
+    static constexpr std::chrono::milliseconds POLL_INTERVAL{100};
+
+    /// priority_class() of a request no class was assigned to
+    static constexpr size_t NO_CLASS = static_cast<size_t>(-1);
+
+private:
+    std::atomic<Clock::rep> deadline_{Clock::time_point::max().time_since_epoch().count()};
+    std::atomic<bool> cancelled_{false};
+    std::atomic<size_t> priority_class_{NO_CLASS};
+    std::function<bool()> connection_closed_;   ///< Probe of the client connection (request thread only)
+
+    std::mutex mutex_;
+    std::vector<httplib::Client*> upstreams_;   ///< llama-server calls to abort on cancel()
+    std::vector<std::shared_ptr<RequestContext>> held_; ///< Shared job contexts released on cancel()
+    std::atomic<size_t> holders_{0};            ///< Requests holding this (shared) context
+
+    static std::shared_ptr<RequestContext>& current_slot()
+    {
+        thread_local std::shared_ptr<RequestContext> current;
+        return current;
+    }
+
+public:
+    /**
+     * @brief Construct context
+     *
+     * @param connection_closed Returns true once the client has disconnected
+     *                          (may be empty)
+     */
+    explicit RequestContext(std::function<bool()> connection_closed = nullptr)
+        : connection_closed_(std::move(connection_closed))
+    {
+    }
+
+    RequestContext(const RequestContext&) = delete;
+    RequestContext& operator=(const RequestContext&) = delete;
+
+    /**
+     * @brief Release the shared job contexts this request still holds
+     */
+    ~RequestContext()
+    {
+        for (auto& shared : held_)
+        {
+            shared->release();
+        }
+    }
+
+    /**
+     * @brief Make a request one of the holders of a shared job context
+     *
+     * @param holder Waiting request; nullptr (no request context) holds
+     *               for good, so the job is never cancelled
+     * @param shared Context the shared job runs under
+     */
+    static void hold(const std::shared_ptr<RequestContext>& holder, const std::shared_ptr<RequestContext>& shared)
+    {
+        shared->holders_.fetch_add(1, std::memory_order_relaxed);
+        if (!holder)
+        {
+            return;
+        }
+
+        bool cancelled = false;
+        {
+            std::lock_guard<std::mutex> lock(holder->mutex_);
+            cancelled = holder->cancelled();
+            if (!cancelled)
+            {
+                holder->held_.push_back(shared);
+            }
+        }
+        if (cancelled)
+        {
+            shared->release();
+        }
+    }
+
+    /**
+     * @brief Drop one holder; the last one cancels the shared context
+     */
+    void release()
+    {
+        if (holders_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            cancel();
+        }
+    }
+
+    /**
+     * @brief Context installed on the calling thread, or nullptr
+     */
+    static std::shared_ptr<RequestContext> current()
+    {
+        return current_slot();
+    }
+
+    /**
+     * @class Scope
+     * @brief Installs a context on the calling thread for its lifetime
+     */
+    class Scope
+    {
+    private:
+        std::shared_ptr<RequestContext> previous_;
+
+    public:
+        explicit Scope(std::shared_ptr<RequestContext> context)
+            : previous_(std::move(current_slot()))
+        {
+            current_slot() = std::move(context);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        ~Scope()
+        {
+            current_slot() = std::move(previous_);
+        }
+    };
+
+    /**
+     * @class Upstream
+     * @brief Registers a llama-server call and bounds it by the deadline
+     *
+     * Sets the connection's total timeout to the time left and clears it
+     * again afterwards, since pooled connections are reused.
+     */
+    class Upstream
+    {
+    private:
+        RequestContext* context_;
+        httplib::Client* client_;
+        bool bounded_ = false;
+
+    public:
+        Upstream(RequestContext* context, httplib::Client* client)
+            : context_(context)
+            , client_(client)
+        {
+            if (!context_)
+            {
+                return;
+            }
+
+            if (context_->has_deadline())
+            {
+                client_->set_max_timeout(std::max<std::chrono::milliseconds::rep>(context_->remaining().count(), 1));
+                bounded_ = true;
+            }
+
+            std::lock_guard<std::mutex> lock(context_->mutex_);
+            context_->upstreams_.push_back(client_);
+        }
+
+        Upstream(const Upstream&) = delete;
+        Upstream& operator=(const Upstream&) = delete;
+
+        ~Upstream()
+        {
+            if (!context_)
+            {
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(context_->mutex_);
+                auto& upstreams = context_->upstreams_;
+                upstreams.erase(std::find(upstreams.begin(), upstreams.end(), client_));
+            }
+
+            if (bounded_)
+            {
+                client_->set_max_timeout(0);
+            }
+        }
+    };
+
+    /**
+     * @brief Set the deadline to a number of milliseconds from now
+     *
+     * @param milliseconds Time budget; 0 or less removes the deadline
+     */
+    void set_timeout(int64_t milliseconds)
+    {
+        Clock::time_point deadline = milliseconds > 0
+            ? Clock::now() + std::chrono::milliseconds(milliseconds)
+            : Clock::time_point::max();
+        deadline_.store(deadline.time_since_epoch().count(), std::memory_order_relaxed);
+    }
+
+    bool has_deadline() const
+    {
+        return deadline_.load(std::memory_order_relaxed) != Clock::time_point::max().time_since_epoch().count();
+    }
+
+    /**
+     * @brief Time left until the deadline (zero once expired)
+     */
+    std::chrono::milliseconds remaining() const
+    {
+        if (!has_deadline())
+        {
+            return std::chrono::milliseconds::max();
+        }
+
+        Clock::time_point deadline{Clock::duration(deadline_.load(std::memory_order_relaxed))};
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+        return std::max(left, std::chrono::milliseconds(0));
+    }
+
+    bool expired() const
+    {
+        return has_deadline() && remaining().count() == 0;
+    }
+
+    /**
+     * @brief Assign the RequestScheduler class of this request's jobs
+     *
+     * @param id Class id from RequestScheduler::find_class()
+     */
+    void set_priority_class(size_t id)
+    {
+        priority_class_.store(id, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Scheduler class of this request, NO_CLASS if none was assigned
+     */
+    size_t priority_class() const
+    {
+        return priority_class_.load(std::memory_order_relaxed);
+    }
+
+    bool cancelled() const
+    {
+        return cancelled_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Cancel the request and abort its llama-server calls in flight
+     *
+     * Shared job contexts it holds are released, not cancelled outright.
+     */
+    void cancel()
+    {
+        cancelled_.store(true, std::memory_order_relaxed);
+
+        std::vector<std::shared_ptr<RequestContext>> held;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto* client : upstreams_)
+            {
+                client->stop();
+            }
+            held.swap(held_);
+        }
+
+        for (auto& shared : held)
+        {
+            shared->release();
+        }
+    }
+
+    /**
+     * @brief Probe the client connection and cancel if it has closed
+     *
+     * Call only from the thread serving the request.
+     *
+     * @return false if the request is cancelled
+     */
+    bool check_connection()
+    {
+        if (!cancelled() && connection_closed_ && connection_closed_())
+        {
+            cancel();
+        }
+        return !cancelled();
+    }
+
+    /**
+     * @brief Wait for a job's result on behalf of the current request
+     *
+     * With a context installed on the calling thread, polls the client
+     * connection and the deadline while waiting; on disconnect or expiry the
+     * request is cancelled (aborting its llama-server calls) and this throws
+     * at once, without waiting for the job to wind down.
+     *
+     * @param future Future of a job running on another thread
+     * @return Job result
+     *
+     * @throws RequestCancelled, DeadlineExceeded, or the job's exception
+     */
+    template<typename T>
+    static T wait(const std::shared_future<T>& future)
+    {
+        auto context = current();
+        if (context)
+        {
+            while (future.wait_for(POLL_INTERVAL) != std::future_status::ready)
+            {
+                if (!context->check_connection())
+                {
+                    throw RequestCancelled();
+                }
+                if (context->expired())
+                {
+                    context->cancel();
+                    throw DeadlineExceeded();
+                }
+            }
+        }
+        return future.get();
+    }
+
+    /**
+     * @brief Throw if the request is cancelled or past its deadline
+     *
+     * @throws RequestCancelled, DeadlineExceeded
+     */
+    void check() const
+    {
+        if (cancelled())
+        {
+            throw RequestCancelled();
+        }
+        if (expired())
+        {
+            throw DeadlineExceeded();
+        }
+    }
+};
+
+} // namespace app
+} // namespace llama
+} // namespace pooriayousefi
+
+#endif // POORIAYOUSEFI_LLAMA_APP_REQUEST_CONTEXT_HPP
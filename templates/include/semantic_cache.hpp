@@ -0,0 +1,477 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file semantic_cache.hpp
+ * @brief Similarity Cache for Completion Responses
+ *
+ * Answers prompts that mean the same as an earlier one ("how do I reset my
+ * password" / "password reset steps?") where ResponseCache only answers
+ * byte-identical ones:
+ *
+ *   prompt --/embedding--> unit vector --dot-product scan--> best match
+ *
+ * A match counts when its cosine similarity reaches the threshold and it
+ * was generated with the same n_predict, temperature and stop list. Like
+ * ResponseCache, only low-temperature requests take part.
+ *
+ * Vectors live in one contiguous row-major buffer and are compared with a
+ * SIMD dot product (AVX2/FMA when the build enables it, SSE2 or NEON
+ * otherwise), so a lookup is one linear pass over memory; at a few
+ * thousand entries that costs far less than the embedding call itself.
+ * Bounded by an approximate memory budget (least recently used entries
+ * are evicted first) and a TTL.
+ *
+ * @author Pooria Yousefi
+ * @date October 6, 2025
+ */
+
+#ifndef POORIAYOUSEFI_LLAMA_APP_SEMANTIC_CACHE_HPP
+#define POORIAYOUSEFI_LLAMA_APP_SEMANTIC_CACHE_HPP
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+#include "json.hpp"
+#include "llama_client.hpp"
+#include "request_context.hpp"
+
+namespace pooriayousefi
+{
+namespace llama
+{
+namespace app
+{
+
+using json = nlohmann::json;
+
+/**
+ * @class SemanticCache
+ * @brief Thread-safe embedding-similarity cache with memory budget and TTL
+ */
+class SemanticCache
+{
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+        uint64_t scope;                 ///< scope_of() the request; only equal scopes match
+        json value;
+        size_t bytes;
+        Clock::time_point expires;
+        uint64_t last_used;             ///< LRU tick
+    };
+
+    /// Rough per-entry bookkeeping cost (vector slot, json header)
+    static constexpr size_t ENTRY_OVERHEAD = 128;
+
+    LlamaClient& embedder_;
+    size_t max_bytes_;
+    float threshold_;
+    std::chrono::seconds ttl_;
+    float max_temperature_;
+    size_t max_prompt_bytes_;
+
+    mutable std::mutex mutex_;
+    size_t dimensions_ = 0;
+    std::vector<float> vectors_;        ///< entries_.size() rows of dimensions_ floats, unit length
+    std::vector<Entry> entries_;        ///< Row i describes vectors_ row i
+    size_t bytes_ = 0;
+    uint64_t tick_ = 0;
+
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t bypassed_ = 0;
+    uint64_t embed_failures_ = 0;
+    uint64_t evictions_ = 0;
+    uint64_t expirations_ = 0;
+    double hit_similarity_sum_ = 0.0;
+    double embed_ms_sum_ = 0.0;
+    uint64_t embeds_ = 0;
+
+    /**
+     * @brief Remove entry i by moving the last one into its place (caller holds mutex_)
+     */
+    void erase_locked(size_t index)
+    {
+        size_t last = entries_.size() - 1;
+        bytes_ -= entries_[index].bytes;
+
+        if (index != last)
+        {
+            entries_[index] = std::move(entries_[last]);
+            std::copy_n(vectors_.begin() + static_cast<std::ptrdiff_t>(last * dimensions_), dimensions_,
+                        vectors_.begin() + static_cast<std::ptrdiff_t>(index * dimensions_));
+        }
+        entries_.pop_back();
+        vectors_.resize(last * dimensions_);
+    }
+
+    bool expired(const Entry& entry, Clock::time_point now) const
+    {
+        return ttl_.count() > 0 && now > entry.expires;
+    }
+
+public:
+    /**
+     * @brief Construct semantic cache
+     *
+     * @param embedder Client for the llama-server that serves /embedding (not owned)
+     * @param max_bytes Approximate memory budget in bytes
+     * @param threshold Cosine similarity a match needs (default: 0.95)
+     * @param ttl_seconds Entry lifetime in seconds, 0 = no expiry (default: 300)
+     * @param max_temperature Requests sampled above this bypass the cache (default: 0.3)
+     * @param max_prompt_bytes Longer prompts bypass the cache; keep them within
+     *                         the embedding model's context (default: 2048)
+     */
+    SemanticCache(LlamaClient& embedder, size_t max_bytes, float threshold = 0.95f, int ttl_seconds = 300,
+                  float max_temperature = 0.3f, size_t max_prompt_bytes = 2048)
+        : embedder_(embedder)
+        , max_bytes_(max_bytes)
+        , threshold_(threshold)
+        , ttl_(ttl_seconds)
+        , max_temperature_(max_temperature)
+        , max_prompt_bytes_(max_prompt_bytes)
+    {
+    }
+
+    SemanticCache(const SemanticCache&) = delete;
+    SemanticCache& operator=(const SemanticCache&) = delete;
+
+    /**
+     * @brief Dot product of two float arrays
+     *
+     * Uses AVX2/FMA when the build enables them (e.g., -march=native), SSE2
+     * on other x86-64 builds and NEON on ARM64; two accumulators keep the
+     * multiply-add latency hidden.
+     */
+    static float dot(const float* a, const float* b, size_t n)
+    {
+        size_t i = 0;
+        float sum = 0.0f;
+
+#if defined(__AVX2__) && defined(__FMA__)
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        for (; i + 16 <= n; i += 16)
+        {
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+        }
+        __m256 acc = _mm256_add_ps(acc0, acc1);
+        __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+        half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+        sum = _mm_cvtss_f32(half);
+#elif defined(__SSE2__)
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+        for (; i + 8 <= n; i += 8)
+        {
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+        }
+        __m128 acc = _mm_add_ps(acc0, acc1);
+        acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+        acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+        sum = _mm_cvtss_f32(acc);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        float32x4_t acc0 = vdupq_n_f32(0.0f);
+        float32x4_t acc1 = vdupq_n_f32(0.0f);
+        for (; i + 8 <= n; i += 8)
+        {
+            acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+            acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+        }
+        sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+#endif
+
+        for (; i < n; i++)
+        {
+            sum += a[i] * b[i];
+        }
+        return sum;
+    }
+
+    /**
+     * @brief Scale a vector to unit length, so dot() gives cosine similarity
+     */
+    static void normalize(std::vector<float>& vector)
+    {
+        float norm = std::sqrt(dot(vector.data(), vector.data(), vector.size()));
+        if (norm > 0.0f)
+        {
+            for (float& value : vector)
+            {
+                value /= norm;
+            }
+        }
+    }
+
+    /**
+     * @brief Sampling parameters a match must share with the request
+     *
+     * @return Hash of n_predict, temperature and stop list
+     */
+    static uint64_t scope_of(const CompletionParams& params)
+    {
+        std::string key = std::to_string(params.n_predict);
+        key += '\0';
+        key += std::to_string(params.temperature);
+        for (const auto& stop : params.stop)
+        {
+            key += '\0';
+            key += stop;
+        }
+        return std::hash<std::string>{}(key);
+    }
+
+    /**
+     * @brief Check whether a request may be served from the cache
+     *
+     * Counts the request as bypassed when it is not.
+     */
+    bool cacheable(const std::string& prompt, const CompletionParams& params)
+    {
+        if (params.temperature <= max_temperature_ && !prompt.empty() && prompt.size() <= max_prompt_bytes_)
+        {
+            return true;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        bypassed_++;
+        return false;
+    }
+
+    /**
+     * @brief Embed a prompt through llama-server
+     *
+     * Failures (e.g., a server started without --embeddings) are counted
+     * and leave the request to run uncached.
+     *
+     * @param prompt Input text prompt
+     * @return Unit-length embedding, or empty on failure
+     *
+     * @throws DeadlineExceeded or RequestCancelled per the calling thread's RequestContext
+     */
+    std::vector<float> embed(const std::string& prompt)
+    {
+        auto start = Clock::now();
+        std::vector<float> vector;
+
+        try
+        {
+            vector = embedder_.embed(prompt);
+        }
+        catch (const DeadlineExceeded&)
+        {
+            throw;
+        }
+        catch (const RequestCancelled&)
+        {
+            throw;
+        }
+        catch (const std::exception&)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            embed_failures_++;
+            return {};
+        }
+
+        normalize(vector);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        embed_ms_sum_ += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        embeds_++;
+        return vector;
+    }
+
+    /**
+     * @brief Look up the most similar cached response
+     *
+     * @param query Embedding from embed() (an empty one is not counted)
+     * @param scope scope_of() the request
+     * @return Cached response, or std::nullopt if nothing is similar enough
+     */
+    std::optional<json> find(const std::vector<float>& query, uint64_t scope)
+    {
+        if (query.empty())
+        {
+            return std::nullopt;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (query.size() != dimensions_)
+        {
+            misses_++;
+            return std::nullopt;
+        }
+
+        auto now = Clock::now();
+        size_t best = entries_.size();
+        float best_similarity = threshold_;
+        const float* row = vectors_.data();
+
+        for (size_t i = 0; i < entries_.size(); i++, row += dimensions_)
+        {
+            if (entries_[i].scope != scope)
+            {
+                continue;
+            }
+
+            float similarity = dot(query.data(), row, dimensions_);
+            if (similarity >= best_similarity && !expired(entries_[i], now))
+            {
+                best = i;
+                best_similarity = similarity;
+            }
+        }
+
+        if (best == entries_.size())
+        {
+            misses_++;
+            return std::nullopt;
+        }
+
+        entries_[best].last_used = ++tick_;
+        hits_++;
+        hit_similarity_sum_ += best_similarity;
+        return entries_[best].value;
+    }
+
+    /**
+     * @brief Store a response under its prompt's embedding
+     *
+     * Expired entries are dropped first, then least recently used ones until
+     * the new entry fits. Responses larger than the whole budget are not
+     * stored. An embedding of a new size (the embedding model changed)
+     * replaces the whole index.
+     *
+     * @param query Embedding from embed() (empty = not stored)
+     * @param scope scope_of() the request
+     * @param value Response to cache
+     */
+    void put(const std::vector<float>& query, uint64_t scope, const json& value)
+    {
+        if (query.empty())
+        {
+            return;
+        }
+
+        size_t bytes = query.size() * sizeof(float) + value.dump().size() + ENTRY_OVERHEAD;
+        if (bytes > max_bytes_)
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (query.size() != dimensions_)
+        {
+            entries_.clear();
+            vectors_.clear();
+            bytes_ = 0;
+            dimensions_ = query.size();
+        }
+
+        auto now = Clock::now();
+        for (size_t i = entries_.size(); i-- > 0;)
+        {
+            if (expired(entries_[i], now))
+            {
+                erase_locked(i);
+                expirations_++;
+            }
+        }
+
+        while (!entries_.empty() && bytes_ + bytes > max_bytes_)
+        {
+            auto oldest = std::min_element(entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b)
+            {
+                return a.last_used < b.last_used;
+            });
+            erase_locked(static_cast<size_t>(oldest - entries_.begin()));
+            evictions_++;
+        }
+
+        entries_.push_back(Entry{scope, value, bytes, now + ttl_, ++tick_});
+        vectors_.insert(vectors_.end(), query.begin(), query.end());
+        bytes_ += bytes;
+    }
+
+    /**
+     * @brief Drop all entries (counters are kept)
+     */
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+        vectors_.clear();
+        bytes_ = 0;
+    }
+
+    /**
+     * @brief Hit/miss counters, similarity and memory usage
+     *
+     * @return JSON object suitable for a diagnostics endpoint
+     */
+    json stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        uint64_t lookups = hits_ + misses_;
+        return {
+            {"entries", entries_.size()},
+            {"dimensions", dimensions_},
+            {"bytes", bytes_},
+            {"max_bytes", max_bytes_},
+            {"threshold", threshold_},
+            {"ttl_seconds", ttl_.count()},
+            {"max_temperature", max_temperature_},
+            {"hits", hits_},
+            {"misses", misses_},
+            {"bypassed", bypassed_},
+            {"embed_failures", embed_failures_},
+            {"evictions", evictions_},
+            {"expirations", expirations_},
+            {"hit_ratio", lookups > 0 ? static_cast<double>(hits_) / static_cast<double>(lookups) : 0.0},
+            {"avg_hit_similarity", hits_ > 0 ? hit_similarity_sum_ / static_cast<double>(hits_) : 0.0},
+            {"avg_embed_ms", embeds_ > 0 ? embed_ms_sum_ / static_cast<double>(embeds_) : 0.0}
+        };
+    }
+};
+
+} // namespace app
+} // namespace llama
+} // namespace pooriayousefi
+
+#endif // POORIAYOUSEFI_LLAMA_APP_SEMANTIC_CACHE_HPP
@@ -0,0 +1,295 @@
+/*
+ * Copyright 2025 Pooria Yousefi
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * @file slot_affinity.hpp
+ * @brief Prompt-prefix Slot Affinity Table
+ *
+ * llama-server keeps the KV cache of the last prompt evaluated in each
+ * slot. With "cache_prompt": true, a request that lands on the slot that
+ * already holds its prefix (same chat session, same instruction template)
+ * skips re-evaluating that prefix.
+ *
+ * SlotAffinity remembers which slot served each affinity key (session id,
+ * template name, ...) and sends later requests with the same key back to
+ * it. If that slot is busy, the request goes out with id_slot = -1 so
+ * llama-server can pick a free slot instead of making the request wait.
+ *
+ * A slot's KV cache lives in one llama-server, so with several backends a
+ * binding is a (backend, slot) pair: the lease names both, LlamaClient
+ * sends the request to that backend (see CompletionParams::backend), and
+ * slot ids stay below each instance's -np.
+ *
+ * @author Pooria Yousefi
+ * @date October 6, 2025
+ */
+
+#ifndef POORIAYOUSEFI_LLAMA_APP_SLOT_AFFINITY_HPP
+#define POORIAYOUSEFI_LLAMA_APP_SLOT_AFFINITY_HPP
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include <algorithm>
+#include "json.hpp"
+
+namespace pooriayousefi
+{
+namespace llama
+{
+namespace app
+{
+
+using json = nlohmann::json;
+
+/**
+ * @class SlotAffinity
+ * @brief Bounded LRU map from affinity key to llama-server slot id
+ */
+class SlotAffinity
+{
+private:
+    struct Binding
+    {
+        size_t slot;    ///< backend * slots_per_backend_ + slot id
+        std::list<const std::string*>::iterator lru_pos;
+    };
+
+    size_t slots_per_backend_;
+    size_t max_entries_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Binding> bindings_;
+    std::list<const std::string*> lru_;   ///< Most recent at front; points at map keys
+    std::vector<size_t> keys_per_slot_;   ///< Bound keys per (backend, slot) (load balancing)
+    std::vector<size_t> in_flight_;       ///< Requests currently pinned to each (backend, slot)
+
+    uint64_t hits_ = 0;
+    uint64_t busy_ = 0;
+    uint64_t assigned_ = 0;
+
+    static constexpr size_t NO_SLOT = static_cast<size_t>(-1);
+
+    /**
+     * @brief Idle slot with the fewest bound keys, or NO_SLOT if all are busy
+     *
+     * Caller holds mutex_.
+     */
+    size_t pick_slot_locked() const
+    {
+        size_t best = NO_SLOT;
+        for (size_t i = 0; i < in_flight_.size(); i++)
+        {
+            if (in_flight_[i] == 0 && (best == NO_SLOT || keys_per_slot_[i] < keys_per_slot_[best]))
+            {
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    /**
+     * @brief Release a pinned slot
+     */
+    void release(size_t slot)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        in_flight_[slot]--;
+    }
+
+public:
+    /**
+     * @class Lease
+     * @brief RAII handle for one request's slot choice
+     *
+     * backend() and id() are the values to send as CompletionParams::backend
+     * and id_slot; -1 means "any backend, any slot".
+     */
+    class Lease
+    {
+    private:
+        SlotAffinity* owner_;
+        size_t slot_;
+
+    public:
+        Lease(SlotAffinity* owner, size_t slot)
+            : owner_(owner)
+            , slot_(slot)
+        {
+        }
+
+        Lease(Lease&& other) noexcept
+            : owner_(other.owner_)
+            , slot_(other.slot_)
+        {
+            other.owner_ = nullptr;
+            other.slot_ = NO_SLOT;
+        }
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease& operator=(Lease&&) = delete;
+
+        ~Lease()
+        {
+            if (owner_ && slot_ != NO_SLOT)
+            {
+                owner_->release(slot_);
+            }
+        }
+
+        /**
+         * @brief BackendPool index of the slot's llama-server, or -1
+         */
+        int backend() const
+        {
+            return slot_ == NO_SLOT ? -1 : static_cast<int>(slot_ / owner_->slots_per_backend_);
+        }
+
+        /**
+         * @brief Slot id within that llama-server, or -1
+         */
+        int id() const
+        {
+            return slot_ == NO_SLOT ? -1 : static_cast<int>(slot_ % owner_->slots_per_backend_);
+        }
+    };
+
+    /**
+     * @brief Construct affinity table
+     *
+     * @param backends Number of llama-server instances (BackendPool size)
+     * @param slots_per_backend Slots of each instance (its --parallel)
+     * @param max_entries Maximum remembered keys, LRU-evicted (default: 4096)
+     */
+    SlotAffinity(size_t backends, size_t slots_per_backend, size_t max_entries = 4096)
+        : slots_per_backend_(slots_per_backend > 0 ? slots_per_backend : 1)
+        , max_entries_(max_entries > 0 ? max_entries : 1)
+        , keys_per_slot_(std::max<size_t>(backends, 1) * slots_per_backend_, 0)
+        , in_flight_(keys_per_slot_.size(), 0)
+    {
+    }
+
+    SlotAffinity(const SlotAffinity&) = delete;
+    SlotAffinity& operator=(const SlotAffinity&) = delete;
+
+    /**
+     * @brief Choose the slot for a request with the given affinity key
+     *
+     * Returns the key's bound slot when it is idle. A new key is bound to
+     * the idle slot with the fewest keys. When the preferred slot is busy
+     * the lease holds -1 and the binding is kept for the next request.
+     *
+     * @param key Affinity key (e.g., "session:<id>" or "template:summarize")
+     * @return Lease holding the slot id to send
+     */
+    Lease acquire(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = bindings_.find(key);
+        if (it != bindings_.end())
+        {
+            lru_.splice(lru_.begin(), lru_, it->second.lru_pos);
+
+            size_t slot = it->second.slot;
+            if (in_flight_[slot] == 0)
+            {
+                hits_++;
+                in_flight_[slot]++;
+                return Lease(this, slot);
+            }
+
+            busy_++;
+            return Lease(this, NO_SLOT);
+        }
+
+        size_t slot = pick_slot_locked();
+        if (slot == NO_SLOT)
+        {
+            busy_++;
+            return Lease(this, NO_SLOT);
+        }
+
+        if (bindings_.size() >= max_entries_)
+        {
+            auto oldest = bindings_.find(*lru_.back());
+            keys_per_slot_[oldest->second.slot]--;
+            lru_.pop_back();
+            bindings_.erase(oldest);
+        }
+
+        auto [inserted, ok] = bindings_.emplace(key, Binding{slot, {}});
+        lru_.push_front(&inserted->first);
+        inserted->second.lru_pos = lru_.begin();
+        keys_per_slot_[slot]++;
+        in_flight_[slot]++;
+        assigned_++;
+
+        return Lease(this, slot);
+    }
+
+    /**
+     * @brief Forget a key (e.g., when its session ends)
+     */
+    void forget(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = bindings_.find(key);
+        if (it != bindings_.end())
+        {
+            keys_per_slot_[it->second.slot]--;
+            lru_.erase(it->second.lru_pos);
+            bindings_.erase(it);
+        }
+    }
+
+    /**
+     * @brief Binding counts and hit rate
+     *
+     * @return JSON object suitable for a diagnostics endpoint
+     */
+    json stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        // One array of per-slot counts per backend
+        json keys_per_slot = json::array();
+        for (size_t first = 0; first < keys_per_slot_.size(); first += slots_per_backend_)
+        {
+            keys_per_slot.push_back(std::vector<size_t>(keys_per_slot_.begin() + first,
+                                                        keys_per_slot_.begin() + first + slots_per_backend_));
+        }
+
+        return {
+            {"keys", bindings_.size()},
+            {"keys_per_slot", std::move(keys_per_slot)},
+            {"hits", hits_},
+            {"busy_fallbacks", busy_},
+            {"assigned", assigned_}
+        };
+    }
+};
+
+} // namespace app
+} // namespace llama
+} // namespace pooriayousefi
+
+#endif // POORIAYOUSEFI_LLAMA_APP_SLOT_AFFINITY_HPP
@@ -6,51 +6,185 @@ Copyright 2025 Pooria Yousefi
 Licensed under the Apache License, Version 2.0
 
 Generated by llama-app-generator on {{DATE}}
+
+Usage:
+  python3 build.py                    # split mode, release profile (-O2)
+  python3 build.py --profile native   # -O3 -march=native
+  python3 build.py --profile lto      # -O3 -march=native -flto
+  python3 build.py --mode single      # one compiler call per target
+  python3 build.py --clean            # remove build/ and bin/
+  python3 build.py --no-compression   # build without zlib/zstd response compression
+
+Split mode (the default) compiles httplib.h's implementation once into
+build/<profile>/libhttplib.a, precompiles httplib's declarations and
+json.hpp into a header every target shares, and compiles the targets in
+parallel. Objects are rebuilt only when a source, an included header or
+the compiler flags change, so edits to src/ rebuild in seconds.
+
+If json.hpp and httplib.h live in a shared vendor directory (vendor.txt,
+written by llama-app-generator --vendor-dir, or $LLAMA_APPGEN_VENDOR_DIR),
+libhttplib.a and the precompiled header are built there too, once per
+compiler and flag set, and reused by every project pointing at it.
 """
 
 import os
 import sys
+import shutil
+import hashlib
+import argparse
 import subprocess
 import platform
+import tempfile
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
 from pathlib import Path
 
+try:
+    import fcntl
+except ImportError:     # Windows: shared builds are not locked
+    fcntl = None
+
+
+# Compiler flags per profile: (compile flags, extra link flags)
+PROFILES = {
+    "debug":   (["-O0", "-g"], []),
+    "release": (["-O2"], []),
+    "native":  (["-O3", "-march=native"], []),
+    "lto":     (["-O3", "-march=native", "-flto"], ["-flto"]),
+}
+
+# httplib configuration macros. Every translation unit and libhttplib.a
+# must see the same values, so they are passed on the command line rather
+# than defined in a header (app_server_base.hpp only supplies defaults).
+HTTPLIB_DEFINES = [
+    "-DCPPHTTPLIB_LISTEN_BACKLOG=128",
+]
 
-def build_target(src_file, output_name, include_dirs, description):
-    """Build a single C++ source file"""
+# Optional response compression codecs: (name, macro, header, library). Each
+# one the compiler can find is enabled with -D<macro> and linked with -l<library>.
+CODECS = [
+    ("zlib", "LLAMA_APP_ZLIB", "zlib.h", "z"),
+    ("zstd", "LLAMA_APP_ZSTD", "zstd.h", "zstd"),
+]
+
+# Marks the start and end of the implementation part of httplib.h; the
+# same split httplib's own split.py performs
+HTTPLIB_BORDER = "// " + "-" * 76
+
+
+def compiler_command():
+    """C++ compiler from $CXX (default: g++)"""
+    return os.environ.get("CXX", "g++")
+
+
+def base_flags(profile):
+    """Flags shared by every compile of a profile"""
+    flags = ["-std=c++17", "-Wall", "-Wextra"] + PROFILES[profile][0] + HTTPLIB_DEFINES
+    if platform.system() != "Windows":
+        flags.append("-pthread")
+    return flags
+
+
+def link_flags(profile):
+    """Flags added when linking executables"""
+    flags = list(PROFILES[profile][1])
+    if platform.system() != "Windows":
+        flags.append("-pthread")
+    return flags
+
+
+def detect_codecs():
+    """Codecs whose header and library are installed, as (name, macro, library)"""
+    found = []
+    with tempfile.TemporaryDirectory() as tmp:
+        for name, macro, header, library in CODECS:
+            source = Path(tmp) / f"{library}.cpp"
+            source.write_text(f"#include <{header}>\nint main() {{ return 0; }}\n")
+            command = [compiler_command(), str(source), "-o", str(Path(tmp) / library), f"-l{library}"]
+            try:
+                if subprocess.run(command, capture_output=True).returncode == 0:
+                    found.append((name, macro, library))
+            except FileNotFoundError:
+                break
+    return found
+
+
+def executable_path(output_name):
+    """bin/<name>, with .exe on Windows"""
+    bin_dir = Path("bin")
+    bin_dir.mkdir(exist_ok=True)
     
-    # Compiler selection
     if platform.system() == "Windows":
-        compiler = os.environ.get("CXX", "g++")
-    else:
-        compiler = os.environ.get("CXX", "g++")
+        return bin_dir / f"{output_name}.exe"
+    return bin_dir / output_name
+
+
+def vendor_directory(project_root):
+    """Shared directory holding json.hpp and httplib.h, or None if the
+    project has its own copies in include/"""
+    vendor = os.environ.get("LLAMA_APPGEN_VENDOR_DIR", "")
+    vendor_file = project_root / "vendor.txt"
+    if not vendor and vendor_file.exists():
+        lines = vendor_file.read_text().splitlines()
+        vendor = lines[0].strip() if lines else ""
+    if not vendor:
+        return None
+    
+    vendor = Path(vendor).expanduser()
+    missing = [name for name in ("json.hpp", "httplib.h") if not (vendor / name).exists()]
+    if missing:
+        print(f"✗ {', '.join(missing)} not found in the vendor directory {vendor}")
+        print("  Re-run llama-app-generator --update --vendor-dir <dir> to republish it.")
+        sys.exit(1)
+    return vendor
+
+
+class SharedLock:
+    """Exclusive lock on a file while shared build artifacts are written,
+    so projects building at the same time do not compile them twice"""
+    
+    def __init__(self, path, enabled):
+        self.path = path
+        self.file = None
+        self.enabled = enabled and fcntl is not None
+    
+    def __enter__(self):
+        if self.enabled:
+            self.file = open(self.path, "a")
+            try:
+                fcntl.flock(self.file, fcntl.LOCK_EX | fcntl.LOCK_NB)
+            except OSError:
+                print(f"  … Waiting for another build of {self.path.parent}")
+                fcntl.flock(self.file, fcntl.LOCK_EX)
+        return self
+    
+    def release(self):
+        if self.file:
+            fcntl.flock(self.file, fcntl.LOCK_UN)
+            self.file.close()
+            self.file = None
+    
+    def __exit__(self, *exc):
+        self.release()
+
+
+def build_target(src_file, output_name, include_dirs, description, profile="release", codecs=()):
+    """Build a single C++ source file (single mode)"""
+    
+    compiler = compiler_command()
     
     # Prepare include flags
-    include_flags = [f"-I{inc}" for inc in include_dirs]
+    include_flags = [f"-I{inc}" for inc in include_dirs] + [f"-D{macro}" for _, macro, _ in codecs]
     
     # Output executable path
-    bin_dir = Path("bin")
-    bin_dir.mkdir(exist_ok=True)
-    
-    if platform.system() == "Windows":
-        output_exe = bin_dir / f"{output_name}.exe"
-    else:
-        output_exe = bin_dir / output_name
+    output_exe = executable_path(output_name)
     
     # Compile command
-    compile_cmd = [
-        compiler,
-        "-std=c++17",
-        "-Wall",
-        "-Wextra",
-        "-O2"
-    ] + include_flags + [
+    compile_cmd = [compiler] + base_flags(profile) + include_flags + [
         str(src_file),
         "-o", str(output_exe)
-    ]
-    
-    # Add threading support on Unix-like systems
-    if platform.system() != "Windows":
-        compile_cmd.append("-pthread")
+    ] + PROFILES[profile][1] + [f"-l{library}" for _, _, library in codecs]
     
     print(f"Building {description}...")
     print(f"  Source:  {src_file}")
@@ -59,9 +193,6 @@ def build_target(src_file, output_name, include_dirs, description):
     print(f"  Progress: ", end="", flush=True)
     
     # Show progress animation
-    import threading
-    import time
-    
     stop_animation = threading.Event()
     
     def show_progress():
@@ -88,7 +219,7 @@ def build_target(src_file, output_name, include_dirs, description):
         
         print(f"✓ {description} built successfully!")
         return True
-        
+    
     except subprocess.CalledProcessError as e:
         stop_animation.set()
         progress_thread.join(timeout=0.5)
@@ -119,16 +250,266 @@ def build_target(src_file, output_name, include_dirs, description):
         return False
 
 
+class SplitBuild:
+    """Incremental, parallel build against a precompiled httplib and json"""
+    
+    def __init__(self, project_root, include_dirs, vendor_dir, profile, jobs, use_pch, codecs=()):
+        self.include_dirs = include_dirs
+        self.codecs = list(codecs)
+        self.headers_dir = vendor_dir or include_dirs[0]
+        self.profile = profile
+        self.jobs = jobs
+        self.use_pch = use_pch
+        self.compiler = compiler_command()
+        self.build_dir = project_root / "build" / profile
+        self.obj_dir = self.build_dir / "obj"
+        self.print_lock = threading.Lock()
+        
+        # httplib's library and the precompiled header depend only on the
+        # vendored headers, the compiler and the flags: with a writable
+        # vendor directory they are kept there, keyed by all three
+        self.shared_dir = self.build_dir
+        if vendor_dir and os.access(vendor_dir, os.W_OK):
+            flags = " ".join([self.compiler] + base_flags(profile))
+            key = hashlib.sha1(flags.encode()).hexdigest()[:12]
+            self.shared_dir = vendor_dir / "build" / f"{profile}-{key}"
+        self.split_dir = self.shared_dir / "httplib"
+        self.shared_obj_dir = self.shared_dir / "obj"
+    
+    def report(self, ok, message, output=""):
+        """Print one result line (and compiler output on failure)"""
+        with self.print_lock:
+            print(f"  {'✓' if ok else '✗'} {message}")
+            if output and not ok:
+                print(output)
+    
+    @staticmethod
+    def is_stale(output, command, depfile):
+        """Whether output must be rebuilt: missing, older than a dependency
+        listed in depfile, or built with a different command"""
+        cmdfile = output.with_name(output.name + ".cmd")
+        if not output.exists() or not depfile.exists() or not cmdfile.exists():
+            return True
+        if cmdfile.read_text() != " ".join(command):
+            return True
+        
+        built = output.stat().st_mtime
+        deps = depfile.read_text().replace("\\\n", " ").split(": ", 1)[-1].split()
+        for dep in deps:
+            try:
+                if os.path.getmtime(dep) > built:
+                    return True
+            except OSError:
+                return True
+        return False
+    
+    def compile(self, description, source, output, extra_flags):
+        """Compile one file if stale; returns True on success"""
+        depfile = output.with_suffix(output.suffix + ".d")
+        command = [self.compiler] + base_flags(self.profile) + extra_flags + [
+            "-MMD", "-MF", str(depfile),
+            "-c", str(source),
+            "-o", str(output)
+        ]
+        
+        if not self.is_stale(output, command, depfile):
+            self.report(True, f"{description} (up to date)")
+            return True
+        
+        start = time.time()
+        try:
+            result = subprocess.run(command, capture_output=True, text=True)
+        except FileNotFoundError:
+            self.report(False, f"Compiler '{self.compiler}' not found! Set the CXX environment variable.")
+            return False
+        
+        if result.returncode != 0:
+            self.report(False, f"{description} failed (error code {result.returncode})",
+                        result.stdout + result.stderr)
+            return False
+        
+        output.with_name(output.name + ".cmd").write_text(" ".join(command))
+        self.report(True, f"{description} ({time.time() - start:.1f}s)")
+        return True
+    
+    def split_httplib(self):
+        """Split include/httplib.h into declarations and an implementation file
+        
+        Regenerated only when httplib.h changes, so the outputs keep their
+        timestamps and dependents are not rebuilt needlessly.
+        """
+        header = self.headers_dir / "httplib.h"
+        split_header = self.split_dir / "httplib.h"
+        split_source = self.split_dir / "httplib.cc"
+        
+        if (split_header.exists() and split_source.exists()
+                and split_header.stat().st_mtime >= header.stat().st_mtime):
+            return True
+        
+        lines = header.read_text(encoding="utf-8").splitlines(keepends=True)
+        if sum(HTTPLIB_BORDER in line for line in lines) != 2:
+            self.report(False, "httplib.h has no split markers; use --mode single")
+            return False
+        
+        declarations = []
+        implementation = []
+        in_implementation = False
+        for line in lines:
+            if HTTPLIB_BORDER in line:
+                in_implementation = not in_implementation
+            elif in_implementation:
+                implementation.append(line.replace("inline ", ""))
+            else:
+                declarations.append(line)
+        
+        self.split_dir.mkdir(parents=True, exist_ok=True)
+        split_header.write_text("".join(declarations), encoding="utf-8")
+        split_source.write_text('#include "httplib.h"\n\nnamespace httplib {\n\n'
+                                + "".join(implementation)
+                                + "\n} // namespace httplib\n", encoding="utf-8")
+        self.report(True, "Split httplib.h into declarations and implementation")
+        return True
+    
+    def build_library(self):
+        """Compile httplib's implementation and archive it"""
+        obj = self.shared_obj_dir / "httplib.o"
+        if not self.compile("httplib implementation", self.split_dir / "httplib.cc", obj, []):
+            return None
+        
+        library = self.shared_dir / "libhttplib.a"
+        if library.exists() and library.stat().st_mtime >= obj.stat().st_mtime:
+            return library
+        
+        # LTO objects need the compiler's archiver plugin
+        archiver = "ar"
+        if "-flto" in PROFILES[self.profile][0]:
+            plugin_ar = "llvm-ar" if "clang" in self.compiler else "gcc-ar"
+            archiver = shutil.which(plugin_ar) or "ar"
+        library.unlink(missing_ok=True)
+        result = subprocess.run([archiver, "rcs", str(library), str(obj)], capture_output=True, text=True)
+        if result.returncode != 0:
+            self.report(False, f"Archiving {library.name} failed", result.stdout + result.stderr)
+            return None
+        return library
+    
+    def build_pch(self):
+        """Precompile httplib's declarations and json.hpp
+        
+        Returns the flag that force-includes them. Force-including the split
+        httplib.h also makes include/httplib.h a no-op (same include guard),
+        so the targets never see the implementation. If the precompiled
+        header cannot be built, the same header is included as text.
+        """
+        header = self.shared_dir / "pch" / "common.hpp"
+        header.parent.mkdir(parents=True, exist_ok=True)
+        content = (
+            "// Generated by build.py: headers shared by every target\n"
+            f'#include "{(self.split_dir / "httplib.h").as_posix()}"\n'
+            f'#include "{(self.headers_dir / "json.hpp").as_posix()}"\n'
+        )
+        if not header.exists() or header.read_text() != content:
+            header.write_text(content)
+        
+        if self.use_pch:
+            pch = header.with_name(header.name + ".gch")
+            if not self.compile("Precompiled header", header, pch, ["-x", "c++-header"]):
+                self.report(False, "Continuing without the precompiled header")
+                pch.unlink(missing_ok=True)
+        
+        return ["-include", str(header)]
+    
+    def link(self, description, obj, library, output_name):
+        """Link one executable against libhttplib.a"""
+        output_exe = executable_path(output_name)
+        command = ([self.compiler, str(obj), str(library), "-o", str(output_exe)] + link_flags(self.profile)
+                   + [f"-l{lib}" for _, _, lib in self.codecs])
+        
+        # Executables are shared by all profiles, so relink when switching
+        stamp = self.build_dir / (output_name + ".link")
+        if (output_exe.exists() and stamp.exists() and stamp.read_text() == " ".join(command)
+                and output_exe.stat().st_mtime >= max(obj.stat().st_mtime, library.stat().st_mtime)
+                and stamp.stat().st_mtime >= output_exe.stat().st_mtime):
+            self.report(True, f"{description} -> {output_exe} (up to date)")
+            return True
+        
+        start = time.time()
+        result = subprocess.run(command, capture_output=True, text=True)
+        if result.returncode != 0:
+            self.report(False, f"Linking {output_exe} failed", result.stdout + result.stderr)
+            return False
+        
+        stamp.write_text(" ".join(command))
+        self.report(True, f"{description} -> {output_exe} ({time.time() - start:.1f}s)")
+        return True
+    
+    def run(self, targets):
+        """Build all targets; returns the number that succeeded"""
+        self.obj_dir.mkdir(parents=True, exist_ok=True)
+        self.shared_obj_dir.mkdir(parents=True, exist_ok=True)
+        
+        # Held until the shared library is archived; the project's own
+        # objects compile meanwhile
+        with SharedLock(self.shared_dir / "build.lock", self.shared_dir != self.build_dir) as lock:
+            if not self.split_httplib():
+                return 0
+            
+            with ThreadPoolExecutor(max_workers=self.jobs) as pool:
+                library = pool.submit(self.build_library)
+                include_flags = (self.build_pch() + [f"-I{inc}" for inc in self.include_dirs]
+                                 + [f"-D{macro}" for _, macro, _ in self.codecs])
+                
+                objects = [
+                    pool.submit(self.compile, target["src"].name, target["src"],
+                                self.obj_dir / (target["output"] + ".o"), include_flags)
+                    for target in targets
+                ]
+                
+                library = library.result()
+                lock.release()
+                if library is None:
+                    return 0
+                
+                links = [
+                    pool.submit(self.link, target["description"], self.obj_dir / (target["output"] + ".o"),
+                                library, target["output"])
+                    for target, compiled in zip(targets, objects) if compiled.result()
+                ]
+                return sum(1 for linked in links if linked.result())
+
+
 def main():
     """Build all targets"""
     
+    parser = argparse.ArgumentParser(description="Build {{PROJECT_NAME}}")
+    parser.add_argument("--profile", choices=sorted(PROFILES), default="release",
+                        help="optimization profile (default: release, -O2)")
+    parser.add_argument("--mode", choices=["split", "single"], default="split",
+                        help="split: shared libhttplib.a, precompiled header and parallel "
+                             "incremental compiles (default); single: one compiler call per target")
+    parser.add_argument("-j", "--jobs", type=int, default=os.cpu_count() or 2,
+                        help="parallel compiler processes in split mode (default: CPU count)")
+    parser.add_argument("--no-pch", action="store_true", help="do not precompile headers")
+    parser.add_argument("--no-compression", action="store_true",
+                        help="do not compile in zlib/zstd response compression even if installed")
+    parser.add_argument("--clean", action="store_true",
+                        help="remove build/ and bin/ and exit (a shared vendor directory is left alone)")
+    args = parser.parse_args()
+    
     # Project paths
     project_root = Path(__file__).parent.resolve()
     src_dir = project_root / "src"
     include_dir = project_root / "include"
+    os.chdir(project_root)
     
-    # Include directories
-    include_dirs = [include_dir]
+    if args.clean:
+        shutil.rmtree(project_root / "build", ignore_errors=True)
+        shutil.rmtree(project_root / "bin", ignore_errors=True)
+        print("✓ Removed build/ and bin/")
+        return 0
+    
+    # Include directories (json.hpp and httplib.h may be shared)
+    vendor_dir = vendor_directory(project_root)
+    include_dirs = [include_dir] + ([vendor_dir] if vendor_dir else [])
     
     # Targets to build
     targets = [
@@ -141,6 +522,11 @@ def main():
             "src": src_dir / "client.cpp",
             "output": "client",
             "description": "CLI Client"
+        },
+        {
+            "src": src_dir / "bench.cpp",
+            "output": "bench",
+            "description": "Benchmark"
         }
     ]
     
@@ -148,24 +534,38 @@ def main():
     project_name = project_root.name
     
     print("=" * 60)
-    print(f"Building {project_name}")
+    print(f"Building {project_name} ({args.mode} mode, {args.profile} profile)")
     print("=" * 60)
     print()
     
-    success_count = 0
-    fail_count = 0
+    start = time.time()
+    
+    codecs = [] if args.no_compression else detect_codecs()
+    print(f"Response compression: {', '.join(name for name, _, _ in codecs) or 'none'}"
+          + ("" if codecs or args.no_compression else " (install zlib or zstd development files to enable)"))
+    print()
     
-    for target in targets:
-        if build_target(target["src"], target["output"], include_dirs, target["description"]):
-            success_count += 1
-        else:
-            fail_count += 1
+    if args.mode == "split":
+        build = SplitBuild(project_root, include_dirs, vendor_dir, args.profile, max(args.jobs, 1), not args.no_pch,
+                           codecs)
+        success_count = build.run(targets)
+        fail_count = len(targets) - success_count
         print()
+    else:
+        success_count = 0
+        fail_count = 0
+        
+        for target in targets:
+            if build_target(target["src"], target["output"], include_dirs, target["description"], args.profile, codecs):
+                success_count += 1
+            else:
+                fail_count += 1
+            print()
     
     # Summary
     print("=" * 60)
     if fail_count == 0:
-        print(f"✓ Build Complete! ({success_count}/{len(targets)} succeeded)")
+        print(f"✓ Build Complete! ({success_count}/{len(targets)} succeeded in {time.time() - start:.1f}s)")
         print("=" * 60)
         print()
         print("Next steps:")
@@ -20,8 +20,10 @@
  * 
  * Demonstrates how to create a custom application server by:
  * 1. Inheriting from AppServerBase<ExampleApp> (CRTP!)
- * 2. Implementing process_request() with your business logic
- * 3. Using get_llama_client() for AI integration
+ * 2. Listing your business logic handlers in actions()
+ * 3. Implementing process_stream_request() for token streaming (optional)
+ *    and process_raw_request() for DOM-free hot paths (optional)
+ * 4. Using get_scheduler() / get_llama_client() for AI integration
  * 
  * The CRTP pattern enables compile-time polymorphism with zero overhead!
  * 
@@ -31,8 +33,11 @@
  */
 
 #include <iostream>
+#include <array>
+#include <mutex>
 #include <signal.h>
 #include "app_server_base.hpp"
+#include "summary_pipeline.hpp"
 
 using namespace pooriayousefi::llama::app;
 
@@ -56,60 +61,217 @@ void signal_handler(int signum)
  * @class ExampleApp
  * @brief Concrete application server using CRTP
  * 
- * Implements process_request() to handle:
- *  - chat: Interactive conversation with LLM
+ * Lists in actions() (also served as POST /api/<action>):
+ *  - chat: Interactive conversation with LLM (multi-turn with session_id)
  *  - summarize: Text summarization using LLM
  *  - echo: Simple echo without LLM (for testing)
+ *  - end_session: Drop a chat session's server-side history
  */
 class ExampleApp : public AppServerBase<ExampleApp>
 {
+private:
+    SummaryPipeline summarizer_;    ///< Map-reduce summarization on the scheduler
+    
+    static SummaryOptions summary_options(const RuntimeConfig& cfg)
+    {
+        SummaryOptions options;
+        options.chunk_tokens = cfg.summarize_chunk_tokens;
+        options.overlap_tokens = cfg.summarize_overlap_tokens;
+        return options;
+    }
+    
+    /**
+     * @brief Sampling for an action: action_max_tokens/action_temperature
+     *        from the live config, else the given built-in defaults
+     */
+    CompletionParams action_params(const std::string& action, int max_tokens, float temperature) const
+    {
+        ActionDefaults defaults = get_live_config()->get_action_defaults(action, max_tokens, temperature);
+        return CompletionParams(defaults.max_tokens, defaults.temperature);
+    }
+    
 public:
     /**
      * @brief Constructor - passes config to base class
      */
     ExampleApp(const RuntimeConfig& cfg) 
         : AppServerBase<ExampleApp>(cfg)
+        , summarizer_(*get_scheduler(), summary_options(cfg))
     {
     }
     
     /**
-     * @brief Business logic implementation
+     * @brief Business logic: action name -> handler
      * 
-     * NOTE: Not virtual! CRTP provides compile-time polymorphism.
+     * NOTE: Not virtual! AppServerBase builds a compile-time hash table
+     * from this list, so dispatch costs one hash and one comparison. A
+     * handler that throws answers {"status": "error"} (see AppServerBase).
      * 
-     * @param request JSON request object with "action" field
-     * @return JSON response
+     * @return Action table
+     */
+    static constexpr auto actions()
+    {
+        return std::array{
+            ActionRoute<ExampleApp>{"chat", &ExampleApp::handle_chat},
+            ActionRoute<ExampleApp>{"summarize", &ExampleApp::handle_summarize},
+            ActionRoute<ExampleApp>{"echo", &ExampleApp::handle_echo},
+            ActionRoute<ExampleApp>{"complete", &ExampleApp::handle_complete},
+            ActionRoute<ExampleApp>{"end_session", &ExampleApp::handle_end_session}
+        };
+    }
+
+    /**
+     * @brief Raw /api fast path (optional CRTP hook)
+     * 
+     * Serves summarize requests, whose "text" can be large, without
+     * building a DOM of the request: only "action" and "text" are
+     * extracted, and the text is only viewed, never copied. Everything
+     * else falls back to process_request().
+     * 
+     * @param body Raw request body
+     * @param response_body Serialized JSON response (set when handled)
+     * @return true if the request was handled here
      */
-    json process_request(const json& request)
+    bool process_raw_request(const std::string& body, std::string& response_body)
     {
-        std::cout << color::BLUE << "[ExampleApp] Processing request..." 
-                  << color::RESET << std::endl;
+        // Cheap pre-check keeps other actions from being parsed twice
+        if (body.find("\"summarize\"") == std::string::npos)
+        {
+            return false;
+        }
         
-        // Extract request data
-        std::string action = request.value("action", "unknown");
+        static const FieldList fields = {"action", "text", "deadline_ms"};
+        auto parse_start = Metrics::Clock::now();
+        json request = extract_fields(body, fields);
+        
+        auto action = request.find("action");
+        if (action == request.end() || *action != "summarize")
+        {
+            return false;
+        }
+        
+        // The base class does not time or admit the raw path, so do it here
+        get_metrics()->request_parse.observe(Metrics::seconds_since(parse_start));
+        apply_deadline(request);
+        AdmissionControl::Ticket ticket = get_admission()->admit("summarize");
+        Metrics::ActionScope scope = get_metrics()->track("summarize");
+        Logger::instance().debug("[ExampleApp] Processing raw request: summarize");
+        
+        std::string_view text;
+        auto text_field = request.find("text");
+        if (text_field != request.end() && text_field->is_string())
+        {
+            text = text_field->get_ref<const std::string&>();
+        }
         
-        if (action == "chat")
+        // No base-class handler wrapper on this path
+        json response;
+        try
         {
-            return handle_chat(request);
+            response = summarize(text);
         }
-        else if (action == "summarize")
+        catch (const std::exception& e)
         {
-            return handle_summarize(request);
+            response = {
+                {"status", "error"},
+                {"message", std::string("LLM error: ") + e.what()}
+            };
         }
-        else if (action == "echo")
+        if (response["status"] == "error")
         {
-            return handle_echo(request);
+            scope.fail();
         }
-        else if (action == "complete")
+        
+        auto serialize_start = Metrics::Clock::now();
+        response_body = response.dump();
+        get_metrics()->response_serialize.observe(Metrics::seconds_since(serialize_start));
+        return true;
+    }
+
+    /**
+     * @brief Streaming business logic (served on /api/stream)
+     * 
+     * Optional CRTP hook: forwards each token to the client as an SSE event
+     * as soon as llama-server produces it, then sends a final event with
+     * the full text.
+     * 
+     * @param request JSON request object with "action" field
+     * @param out Event writer connected to the client
+     */
+    void process_stream_request(const json& request, StreamWriter& out)
+    {
+        std::string action = request.value("action", "unknown");
+        
+        if (action == "chat" || action == "complete")
         {
-            return handle_complete(request);
+            std::string field = (action == "chat") ? "message" : "prompt";
+            std::string input = request.value(field, "");
+            
+            if (input.empty())
+            {
+                out.send({
+                    {"status", "error"},
+                    {"message", field + " field is required"}
+                });
+                return;
+            }
+            
+            CompletionParams params = action_params(action, 512, 0.7f);
+            get_llama_client()->fit_prompt(input, params);
+            
+            // wait() may give up on a disconnect or deadline while the job still
+            // streams, so the job reaches the writer only through a relay that
+            // is cut before this function returns
+            struct TokenRelay
+            {
+                std::mutex mutex;
+                StreamWriter* out = nullptr;
+            };
+            auto relay = std::make_shared<TokenRelay>();
+            relay->out = &out;
+            auto cut = [&relay]
+            {
+                std::lock_guard<std::mutex> lock(relay->mutex);
+                relay->out = nullptr;
+            };
+            
+            // Streams occupy a llama-server slot too, so run them on the scheduler
+            std::shared_future<json> future = get_scheduler()->submit(
+                [input = std::move(input), params, relay](LlamaClient& client)
+            {
+                // Stop generating as soon as the client disconnects or the relay is cut
+                return client.complete_stream(input, [&relay](const std::string& token)
+                {
+                    std::lock_guard<std::mutex> lock(relay->mutex);
+                    return relay->out && relay->out->send({{"token", token}});
+                }, params);
+            });
+            
+            json llm_response;
+            try
+            {
+                llm_response = RequestScheduler::wait(future);
+            }
+            catch (...)
+            {
+                cut();
+                throw;
+            }
+            cut();
+            
+            out.send({
+                {"status", "success"},
+                {"action", action},
+                {"done", true},
+                {action == "chat" ? "ai_response" : "completion", std::move(llm_response["content"])}
+            });
         }
         else
         {
-            return json{
+            out.send({
                 {"status", "error"},
-                {"message", "Unknown action: " + action}
-            };
+                {"message", "Streaming not supported for action: " + action}
+            });
         }
     }
 
@@ -131,64 +293,182 @@ private:
             };
         }
         
+        std::string session_id = request.value("session_id", "");
+        if (!session_id.empty())
+        {
+            return handle_session_chat(session_id, user_message, request);
+        }
+        
+        // Budget the answer against the context, then queue on the
+        // scheduler, which forwards to the internal LlamaClient
+        CompletionParams params = action_params("chat", 512, 0.7f);
+        get_llama_client()->fit_prompt(user_message, params);
+        json llm_response = get_scheduler()->complete(user_message, params);
+        
+        return {
+            {"status", "success"},
+            {"action", "chat"},
+            {"user_message", user_message},
+            {"ai_response", std::move(llm_response["content"])}
+        };
+    }
+    
+    /**
+     * @brief Handle one turn of a server-side chat session
+     * 
+     * History lives in the SessionStore; the client sends only the new
+     * message. The session is pinned to one llama-server slot so its
+     * prompt prefix stays in that slot's KV cache between turns.
+     * 
+     * When the context size is known, messages are measured with the
+     * model's tokenizer and the oldest turns are dropped until the prompt
+     * leaves room for the answer (at most a quarter of the context).
+     */
+    json handle_session_chat(const std::string& session_id, const std::string& user_message, const json& request)
+    {
+        LlamaClient& llm = *get_llama_client();
+        size_t n_ctx = llm.context_size();
+        
+        auto session = get_session_store()->open(session_id);
+        std::lock_guard<std::mutex> turn(session->mutex());
+        
+        if (request.contains("system"))
+        {
+            std::string system = request.value("system", "");
+            session->set_system(system, n_ctx > 0 ? llm.count_tokens(system) : 0);
+        }
+        
+        session->append("user", user_message, n_ctx > 0 ? llm.count_tokens(user_message) : 0);
+        
         try
         {
-            // Use internal LlamaClient to get AI response
-            json llm_response = get_llama_client()->complete(user_message, 512, 0.7);
+            SlotAffinity::Lease slot = get_slot_affinity()->acquire("session:" + session_id);
+            
+            CompletionParams params = action_params("chat", 512, 0.7f);
+            params.backend = slot.backend();
+            params.id_slot = slot.id();
+            
+            if (n_ctx > 0)
+            {
+                size_t reserve = params.n_predict < 0 ? n_ctx / 4
+                                 : std::min(static_cast<size_t>(params.n_predict), n_ctx / 4);
+                size_t prompt_tokens = session->fit_tokens(n_ctx > reserve ? n_ctx - reserve : 0);
+                params.n_predict = llm.fit_n_predict(prompt_tokens, params.n_predict);
+            }
+            std::string messages = session->messages_json();
+            
+            // The job owns its inputs: wait() may give up before the job runs
+            json llm_response = RequestScheduler::wait(get_scheduler()->submit(
+                [messages = std::move(messages), params](LlamaClient& client)
+            {
+                return client.chat_serialized(messages, params);
+            }));
+            
+            std::string reply = llm_response["choices"][0]["message"].value("content", "");
+            size_t reply_tokens = 0;
+            if (auto usage = llm_response.find("usage"); usage != llm_response.end() && usage->is_object())
+            {
+                reply_tokens = usage->value("completion_tokens", size_t(0));
+            }
+            session->append("assistant", reply, reply_tokens);
             
             return {
                 {"status", "success"},
                 {"action", "chat"},
+                {"session_id", session_id},
+                {"history_messages", session->size()},
                 {"user_message", user_message},
-                {"ai_response", llm_response["content"]}
+                {"ai_response", reply}
             };
         }
-        catch (const std::exception& e)
+        catch (...)
         {
-            return {
-                {"status", "error"},
-                {"message", std::string("LLM error: ") + e.what()}
-            };
+            // Keep history consistent: the unanswered turn is dropped
+            session->pop_back();
+            throw;
         }
     }
     
     /**
-     * @brief Handle summarize action
+     * @brief Handle end_session action
      * 
-     * Text summarization using LLM.
+     * Drops server-side history and the session's slot binding.
      */
-    json handle_summarize(const json& request)
+    json handle_end_session(const json& request)
     {
-        std::string text = request.value("text", "");
+        std::string session_id = request.value("session_id", "");
         
-        if (text.empty())
+        if (session_id.empty())
         {
             return {
                 {"status", "error"},
-                {"message", "text field is required"}
+                {"message", "session_id field is required"}
             };
         }
         
-        try
+        bool existed = get_session_store()->erase(session_id);
+        get_slot_affinity()->forget("session:" + session_id);
+        
+        return {
+            {"status", "success"},
+            {"action", "end_session"},
+            {"session_id", session_id},
+            {"existed", existed}
+        };
+    }
+    
+    /**
+     * @brief Handle summarize action
+     * 
+     * Text summarization using LLM.
+     */
+    json handle_summarize(const json& request)
+    {
+        auto text = request.find("text");
+        if (text == request.end() || !text->is_string())
         {
-            // Build summarization prompt
-            std::string prompt = "Summarize the following text concisely:\n\n" + text;
-            json llm_response = get_llama_client()->complete(prompt, 256, 0.5);
-            
-            return {
-                {"status", "success"},
-                {"action", "summarize"},
-                {"original_length", text.length()},
-                {"summary", llm_response["content"]}
-            };
+            return summarize(std::string_view());
         }
-        catch (const std::exception& e)
+        return summarize(text->get_ref<const std::string&>());
+    }
+    
+    /**
+     * @brief Summarize text (shared by the DOM and raw request paths)
+     * 
+     * Texts longer than summarize_chunk_tokens are split into overlapping
+     * chunks, summarized in parallel, and the partial summaries merged
+     * (see SummaryPipeline). The response reports per-stage timings.
+     */
+    json summarize(std::string_view text)
+    {
+        if (text.empty())
         {
             return {
                 {"status", "error"},
-                {"message", std::string("LLM error: ") + e.what()}
+                {"message", "text field is required"}
             };
         }
+        
+        // Short texts are one prompt sharing the instruction prefix
+        SlotAffinity::Lease slot = get_slot_affinity()->acquire("template:summarize");
+        
+        const CompletionParams& builtin = summarizer_.options().params;
+        CompletionParams params = action_params("summarize", builtin.n_predict, builtin.temperature);
+        params.backend = slot.backend();
+        params.id_slot = slot.id();
+        
+        SummaryResult result = summarizer_.run(text, params);
+        
+        Logger::instance().debug("[ExampleApp] summarize: ", result.chunks, " chunks, ",
+                                 result.reduce_levels, " reduce levels, ", result.total_ms, "ms");
+        
+        return {
+            {"status", "success"},
+            {"action", "summarize"},
+            {"original_length", text.length()},
+            {"summary", std::move(result.summary)},
+            {"pipeline", result.stats()}
+        };
     }
     
     /**
@@ -208,24 +488,16 @@ private:
             };
         }
         
-        try
-        {
-            json llm_response = get_llama_client()->complete(prompt, 512, 0.7);
-            
-            return {
-                {"status", "success"},
-                {"action", "complete"},
-                {"prompt", prompt},
-                {"completion", llm_response["content"]}
-            };
-        }
-        catch (const std::exception& e)
-        {
-            return {
-                {"status", "error"},
-                {"message", std::string("LLM error: ") + e.what()}
-            };
-        }
+        CompletionParams params = action_params("complete", 512, 0.7f);
+        get_llama_client()->fit_prompt(prompt, params);
+        json llm_response = get_scheduler()->complete(prompt, params);
+        
+        return {
+            {"status", "success"},
+            {"action", "complete"},
+            {"prompt", prompt},
+            {"completion", std::move(llm_response["content"])}
+        };
     }
     
     /**
@@ -276,18 +548,29 @@ int main(int argc, char* argv[])
         signal(SIGINT, signal_handler);
         signal(SIGTERM, signal_handler);
         
+#ifdef SIGHUP
+        // kill -HUP <pid> re-reads the reloadable settings of config.txt
+        // (Windows has no SIGHUP; settings change there on restart)
+        signal(SIGHUP, [](int) { ExampleApp::request_reload(); });
+#endif
+        
         // Start server
         std::cout << color::YELLOW << "Starting server on port " 
                   << config.app_server_port << "..." << color::RESET << std::endl;
         std::cout << color::BLUE << "Available endpoints:" << color::RESET << std::endl;
         std::cout << "  GET  /health  - Health check" << std::endl;
+        std::cout << "  GET  /stats   - Scheduler statistics" << std::endl;
+        std::cout << "  GET  /metrics - Prometheus metrics" << std::endl;
         std::cout << "  POST /api     - Main API" << std::endl;
+        std::cout << "  POST /api/stream - Streaming API (SSE)" << std::endl;
+        std::cout << "  POST /api/<action> - One action, no \"action\" field needed" << std::endl;
         std::cout << std::endl;
         std::cout << color::BLUE << "API Actions:" << color::RESET << std::endl;
         std::cout << "  {\"action\": \"complete\", \"prompt\": \"...\"}" << std::endl;
-        std::cout << "  {\"action\": \"chat\", \"message\": \"...\"}" << std::endl;
+        std::cout << "  {\"action\": \"chat\", \"message\": \"...\", \"session_id\": \"...\"}" << std::endl;
         std::cout << "  {\"action\": \"summarize\", \"text\": \"...\"}" << std::endl;
         std::cout << "  {\"action\": \"echo\", \"message\": \"...\"}" << std::endl;
+        std::cout << "  {\"action\": \"end_session\", \"session_id\": \"...\"}" << std::endl;
         std::cout << std::endl;
         std::cout << color::YELLOW << "Press Ctrl+C to stop" << color::RESET << std::endl;
         std::cout << std::endl;